@@ -0,0 +1,109 @@
+#include "AllocCounter.h"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+//计数只要求最终一致, 用relaxed, 分配路径上只多一次原子加
+static std::atomic<uint64_t> g_count(0);
+static std::atomic<uint64_t> g_bytes(0);
+//常量初始化, 不需要线程局部变量的构造, 分配路径上可以直接使用
+static thread_local AllocCounter::Usage t_usage = { 0, 0, 0 };
+
+AllocCounter::Scope::Scope()
+	: start_(t_usage), outer_largest_(t_usage.largest)
+{
+	t_usage.largest = 0;
+}
+
+AllocCounter::Scope::~Scope()
+{
+	if (t_usage.largest < outer_largest_)
+	{
+		t_usage.largest = outer_largest_;
+	}
+}
+
+AllocCounter::Usage AllocCounter::Scope::usage() const
+{
+	Usage usage = { t_usage.count - start_.count, t_usage.bytes - start_.bytes, t_usage.largest };
+	return usage;
+}
+
+AllocCounter::Usage AllocCounter::thread_usage()
+{
+	return t_usage;
+}
+
+uint64_t AllocCounter::count()
+{
+	return g_count.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocCounter::bytes()
+{
+	return g_bytes.load(std::memory_order_relaxed);
+}
+
+void AllocCounter::Note(uint64_t size)
+{
+	g_count.fetch_add(1, std::memory_order_relaxed);
+	g_bytes.fetch_add(size, std::memory_order_relaxed);
+	t_usage.count++;
+	t_usage.bytes += size;
+	if (t_usage.largest < size)
+	{
+		t_usage.largest = size;
+	}
+}
+
+static void *countedAlloc(size_t size)
+{
+	AllocCounter::Note(size);
+	return malloc(size ? size : 1);
+}
+
+//替换全局的operator new/delete, 对整个程序生效
+void *operator new(size_t size)
+{
+	void *p = countedAlloc(size);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return countedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return countedAlloc(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+
+//进程内的内存分配计数, 用于基准测试报告每次操作的分配次数和字节数
+//统计全局operator new/new[]以及Util::mmap的按页分配; malloc和Qt容器(QByteArray等)不经过这里,
+//其中与文件大小相当的缓冲区(ElfFixer::Write的malloc, 读入整个文件或段数据的QByteArray, 推迟写出的输出)在分配处调用Note, 其余不在统计之内
+//除全局计数外每个线程另有一份, 一项任务在一个线程上执行时, 前后之差即该任务的分配
+class AllocCounter
+{
+public:
+	struct Usage
+	{
+		uint64_t count;
+		uint64_t bytes;
+		uint64_t largest;	//最大的单次分配
+	};
+
+	//统计一段在同一线程上执行的代码的分配, 可以嵌套
+	class Scope
+	{
+	public:
+		Scope();
+		~Scope();
+
+		//从开始到现在的分配
+		Usage usage() const;
+
+	private:
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+		Usage start_;
+		uint64_t outer_largest_;	//外层Scope已记录的最大分配, 结束时合并回去
+	};
+
+	AllocCounter() = delete;
+	~AllocCounter() = delete;
+
+	//累计的分配次数和字节数, 只增不减
+	static uint64_t count();
+	static uint64_t bytes();
+
+	//当前线程的累计分配, largest为当前最内层Scope开始以来的最大分配
+	static Usage thread_usage();
+
+	//记录一次不经过operator new的分配
+	static void Note(uint64_t size);
+};
@@ -0,0 +1,334 @@
+#include "Baseline.h"
+#include <QTextStream>
+#include <QFile>
+#include <QDateTime>
+#include <QSysInfo>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QStringList>
+#include <math.h>
+#include <thread>
+
+#define QSTR8BIT(s) (QString::fromLocal8Bit(s))
+
+static const double kPi = 3.14159265358979323846;
+
+Baseline::Run Baseline::NewRun(const QString &kind, const QString &commit)
+{
+	Run run;
+	run.kind = kind;
+	run.commit = commit;
+	if (run.commit.isEmpty())
+	{
+		run.commit = QString::fromLocal8Bit(qgetenv("SOFIX_COMMIT"));
+	}
+	if (run.commit.isEmpty())
+	{
+		run.commit = "unknown";
+	}
+	run.date = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+
+	run.machine.insert("host", QSysInfo::machineHostName());
+	run.machine.insert("os", QSysInfo::prettyProductName());
+	run.machine.insert("kernel", QSysInfo::kernelVersion());
+	run.machine.insert("cpu", QSysInfo::currentCpuArchitecture());
+	run.machine.insert("threads", (int)std::thread::hardware_concurrency());
+	run.machine.insert("qt", QString(qVersion()));
+	return run;
+}
+
+void Baseline::AddSample(Run &run, const QString &name, const QString &unit, double value)
+{
+	for (size_t i = 0; i < run.entries.size(); i++)
+	{
+		if (run.entries[i].name == name)
+		{
+			run.entries[i].samples.push_back(value);
+			return;
+		}
+	}
+
+	Entry entry;
+	entry.name = name;
+	entry.unit = unit;
+	entry.samples.push_back(value);
+	run.entries.push_back(entry);
+}
+
+bool Baseline::Save(const Run &run, const QString &path)
+{
+	QJsonArray entries;
+	for (size_t i = 0; i < run.entries.size(); i++)
+	{
+		const Entry &entry = run.entries[i];
+		QJsonArray samples;
+		for (size_t k = 0; k < entry.samples.size(); k++)
+		{
+			samples.append(entry.samples[k]);
+		}
+		QJsonObject obj;
+		obj.insert("name", entry.name);
+		obj.insert("unit", entry.unit);
+		obj.insert("samples", samples);
+		entries.append(obj);
+	}
+
+	QJsonObject root;
+	root.insert("version", 1);
+	root.insert("kind", run.kind);
+	root.insert("commit", run.commit);
+	root.insert("date", run.date);
+	root.insert("machine", run.machine);
+	root.insert("results", entries);
+
+	QFile file(path);
+	QByteArray json = QJsonDocument(root).toJson();
+	return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(json) == json.size();
+}
+
+bool Baseline::Load(const QString &path, Run &run)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+
+	QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+	if (root.value("version").toInt() != 1)
+	{
+		return false;
+	}
+
+	run.kind = root.value("kind").toString();
+	run.commit = root.value("commit").toString();
+	run.date = root.value("date").toString();
+	run.machine = root.value("machine").toObject();
+	run.entries.clear();
+	QJsonArray entries = root.value("results").toArray();
+	for (int i = 0; i < entries.size(); i++)
+	{
+		QJsonObject obj = entries.at(i).toObject();
+		Entry entry;
+		entry.name = obj.value("name").toString();
+		entry.unit = obj.value("unit").toString();
+		QJsonArray samples = obj.value("samples").toArray();
+		for (int k = 0; k < samples.size(); k++)
+		{
+			entry.samples.push_back(samples.at(k).toDouble());
+		}
+		if (!entry.name.isEmpty() && !entry.samples.empty())
+		{
+			run.entries.push_back(entry);
+		}
+	}
+	return true;
+}
+
+double Baseline::normalQuantile(double p)
+{
+	//Abramowitz & Stegun 26.2.23, 误差小于4.5e-4, 对判断显著性足够
+	if (p <= 0 || p >= 1)
+	{
+		return 0;
+	}
+	double q = p < 0.5 ? p : 1 - p;
+	double t = sqrt(-2 * log(q));
+	double z = t - (2.515517 + 0.802853 * t + 0.010328 * t * t) /
+		(1 + 1.432788 * t + 0.189269 * t * t + 0.001308 * t * t * t);
+	return p < 0.5 ? -z : z;
+}
+
+double Baseline::TQuantile(double df, double confidence)
+{
+	double p = (1 + confidence) / 2;	//单侧
+	if (df < 1)
+	{
+		df = 1;
+	}
+
+	//自由度1和2有解析解, 其余用Cornish-Fisher展开
+	if (df < 1.5)
+	{
+		return tan(kPi * (p - 0.5));
+	}
+	if (df < 2.5)
+	{
+		return (2 * p - 1) / sqrt(2 * p * (1 - p));
+	}
+
+	double z = normalQuantile(p);
+	double z2 = z * z;
+	double g1 = (z2 + 1) * z / 4;
+	double g2 = ((5 * z2 + 16) * z2 + 3) * z / 96;
+	double g3 = (((3 * z2 + 19) * z2 + 17) * z2 - 15) * z / 384;
+	double g4 = ((((79 * z2 + 776) * z2 + 1482) * z2 - 1920) * z2 - 945) * z / 92160;
+	return z + g1 / df + g2 / (df * df) + g3 / (df * df * df) + g4 / (df * df * df * df);
+}
+
+Baseline::Summary Baseline::Summarize(const std::vector<double> &samples, double confidence)
+{
+	Summary s = { samples.size(), 0, 0, 0 };
+	if (samples.empty())
+	{
+		return s;
+	}
+
+	double sum = 0;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		sum += samples[i];
+	}
+	s.mean = sum / samples.size();
+	if (samples.size() < 2)
+	{
+		return s;
+	}
+
+	double sq = 0;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		sq += (samples[i] - s.mean) * (samples[i] - s.mean);
+	}
+	s.stddev = sqrt(sq / (samples.size() - 1));
+	s.half_width = TQuantile((double)(samples.size() - 1), confidence) * s.stddev / sqrt((double)samples.size());
+	return s;
+}
+
+const Baseline::Entry *Baseline::find(const Run &run, const QString &name)
+{
+	for (size_t i = 0; i < run.entries.size(); i++)
+	{
+		if (run.entries[i].name == name)
+		{
+			return &run.entries[i];
+		}
+	}
+	return nullptr;
+}
+
+int Baseline::Compare(int argc, char *argv[])
+{
+	QTextStream qout(stdout);
+	QStringList paths;
+	double threshold = 5;
+	double confidence = 0.95;
+
+	//argv[1]为"compare"
+	for (int i = 2; i < argc; i++)
+	{
+		QString arg = QSTR8BIT(argv[i]);
+		if (arg == "--threshold" || arg == "--confidence")
+		{
+			if (i + 1 >= argc)
+			{
+				printUsage();
+				return 2;
+			}
+			double value = QSTR8BIT(argv[++i]).toDouble();
+			(arg == "--threshold" ? threshold : confidence) = value;
+		}
+		else
+		{
+			paths << arg;
+		}
+	}
+	if (paths.size() != 2 || threshold < 0 || confidence <= 0 || confidence >= 1)
+	{
+		printUsage();
+		return 2;
+	}
+
+	Run base;
+	Run head;
+	for (int i = 0; i < 2; i++)
+	{
+		if (!Load(paths.at(i), i == 0 ? base : head))
+		{
+			qout << QSTR8BIT("无法读取基准结果: ") + paths.at(i) << endl;
+			return 2;
+		}
+	}
+
+	qout << QSTR8BIT("基准: %1 (%2, %3)").arg(base.commit).arg(base.date).arg(base.machine.value("host").toString()) << endl;
+	qout << QSTR8BIT("对比: %1 (%2, %3)").arg(head.commit).arg(head.date).arg(head.machine.value("host").toString()) << endl;
+	if (base.machine.value("host").toString() != head.machine.value("host").toString() ||
+		base.machine.value("cpu").toString() != head.machine.value("cpu").toString())
+	{
+		qout << QSTR8BIT("注意: 两次结果来自不同机器, 差异不一定来自代码") << endl;
+	}
+	qout << QString("%1 %2 %3 %4 %5 %6")
+		.arg("name", -36).arg("base", 22).arg("head", 22).arg("change", 9).arg(QString("%1% CI").arg(confidence * 100, 0, 'f', 0), 20).arg("") << endl;
+
+	int regressions = 0;
+	int unknown = 0;
+	for (size_t i = 0; i < head.entries.size(); i++)
+	{
+		const Entry &h = head.entries[i];
+		const Entry *b = find(base, h.name);
+		if (b == nullptr)
+		{
+			continue;
+		}
+
+		Summary sb = Summarize(b->samples, confidence);
+		Summary sh = Summarize(h.samples, confidence);
+		if (sb.mean <= 0)
+		{
+			continue;
+		}
+
+		//Welch t: 两组方差不必相等, 差值的置信区间换算为相对基准均值的百分比
+		double diff = sh.mean - sb.mean;
+		double change = diff / sb.mean * 100;
+		QString verdict;
+		QString range = "-";
+		if (sb.n < 2 || sh.n < 2)
+		{
+			verdict = QSTR8BIT("样本不足");
+			unknown++;
+		}
+		else
+		{
+			double vb = sb.stddev * sb.stddev / sb.n;
+			double vh = sh.stddev * sh.stddev / sh.n;
+			double se = sqrt(vb + vh);
+			double df = se > 0 ? (vb + vh) * (vb + vh) / (vb * vb / (sb.n - 1) + vh * vh / (sh.n - 1)) : (double)(sb.n + sh.n - 2);
+			double half = TQuantile(df, confidence) * se;
+			double low = (diff - half) / sb.mean * 100;
+			double high = (diff + half) / sb.mean * 100;
+			range = QString("[%1%, %2%]").arg(low, 0, 'f', 1).arg(high, 0, 'f', 1);
+			if (low > 0 && change > threshold)
+			{
+				verdict = QSTR8BIT("退化");
+				regressions++;
+			}
+			else if (high < 0 && -change > threshold)
+			{
+				verdict = QSTR8BIT("改进");
+			}
+		}
+
+		qout << QString("%1 %2 %3 %4 %5 %6")
+			.arg(h.name, -36)
+			.arg(QString("%1 +-%2").arg(sb.mean, 0, 'g', 5).arg(sb.half_width, 0, 'g', 2), 22)
+			.arg(QString("%1 +-%2").arg(sh.mean, 0, 'g', 5).arg(sh.half_width, 0, 'g', 2), 22)
+			.arg(QString("%1%").arg(change, 0, 'f', 1), 9)
+			.arg(range, 20)
+			.arg(verdict) << endl;
+	}
+
+	qout << QSTR8BIT("退化 %1 项 (阈值 %2%, 置信度 %3%)").arg(regressions).arg(threshold).arg(confidence * 100) << endl;
+	if (unknown > 0)
+	{
+		qout << QSTR8BIT("%1 项样本不足, 测量时加 --repeat <n> (n >= 2, 建议5以上)").arg(unknown) << endl;
+	}
+	return regressions > 0 ? 1 : 0;
+}
+
+void Baseline::printUsage()
+{
+	QTextStream qout(stdout);
+	qout << QSTR8BIT("用法: SoFix compare <基准JSON> <新结果JSON> [--threshold <百分比, 默认5>] [--confidence <置信度, 默认0.95>]\n"
+		"结果由 SoFix bench/throughput ... --repeat <n> --save <JSON> [--commit <提交号>] 生成") << endl;
+}
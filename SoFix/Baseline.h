@@ -0,0 +1,64 @@
+#pragma once
+#include <QString>
+#include <QJsonObject>
+#include <vector>
+
+//性能基准结果的保存格式和比较: bench/throughput加--save把每项的多次测量连同机器信息和提交号写成JSON,
+//compare比较两次结果, 按置信区间判断每项是否显著变慢
+//用法:
+//	SoFix compare <基准JSON> <新结果JSON> [--threshold <百分比>] [--confidence <0.90|0.95|0.99等>]
+//每项输出两次结果的均值和置信区间, 变化百分比及其置信区间; 差值的置信区间整体大于0且变化超过阈值为退化
+//只比较两次都有的项(按名称); 退出码: 0没有退化, 1有退化, 2参数或文件错误
+//所有指标都是越小越好(ns/op, ms)
+class Baseline
+{
+public:
+	struct Entry
+	{
+		QString name;		//如"FixDynsym/64K", "throughput/normal/warm/wall"
+		QString unit;		//如"ns/op", "ms"
+		std::vector<double> samples;
+	};
+
+	struct Run
+	{
+		QString kind;		//bench/throughput
+		QString commit;
+		QString date;		//UTC, ISO 8601
+		QJsonObject machine;
+		std::vector<Entry> entries;
+	};
+
+	//样本的统计: 均值, 样本标准差, 均值置信区间的半宽(样本少于2个时为0)
+	struct Summary
+	{
+		size_t n;
+		double mean;
+		double stddev;
+		double half_width;
+	};
+
+	Baseline() = delete;
+	~Baseline() = delete;
+
+	//命令行入口
+	static int Compare(int argc, char *argv[]);
+
+	//新的一次结果, 填好机器信息和时间; commit为空时取环境变量SOFIX_COMMIT, 再没有为"unknown"
+	static Run NewRun(const QString &kind, const QString &commit);
+	//同名项追加一个样本
+	static void AddSample(Run &run, const QString &name, const QString &unit, double value);
+	static bool Save(const Run &run, const QString &path);
+	static bool Load(const QString &path, Run &run);
+
+	static Summary Summarize(const std::vector<double> &samples, double confidence);
+
+	//自由度为df的t分布的双侧分位数: P(|T| <= t) = confidence
+	static double TQuantile(double df, double confidence);
+
+private:
+	//标准正态分布的分位数
+	static double normalQuantile(double p);
+	static const Entry *find(const Run &run, const QString &name);
+	static void printUsage();
+};
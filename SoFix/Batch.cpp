@@ -0,0 +1,914 @@
+#include "Batch.h"
+#include "FixJob.h"
+#include <QTextStream>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include "ThreadPool.h"
+#include "Util.h"
+#include "Hash64.h"
+#include "RefCache.h"
+#include "ResultCache.h"
+#include "Pipeline.h"
+#include "MemoryBudget.h"
+#include "Trace.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#define QSTR8BIT(s) (QString::fromLocal8Bit(s))
+
+//小于kSmallFileSize的文件合并调度, 每个任务累计到kCoalesceSize或kCoalesceCount个文件为止
+static const qint64 kSmallFileSize = 64 * 1024;
+static const qint64 kCoalesceSize = 256 * 1024;
+static const size_t kCoalesceCount = 64;
+
+int Batch::Run(int argc, char *argv[])
+{
+	QTextStream qout(stdout);
+	Options opts;
+	std::vector<Job> jobs;
+
+	if (!parseArgs(argc, argv, opts))
+	{
+		printUsage();
+		return 2;
+	}
+
+	//在创建线程池之前开始, 工作线程才能设置轨道名
+	if (!opts.trace.isEmpty())
+	{
+		Trace::Start();
+	}
+
+	bool loaded;
+	{
+		Trace::Span span("load jobs", "batch");
+		loaded = opts.manifest.isEmpty() ? loadDir(opts, jobs) : loadManifest(opts, jobs);
+	}
+	if (!loaded)
+	{
+		return 2;
+	}
+
+	double cpu_start = Util::cpuSeconds();
+	QElapsedTimer total;
+	total.start();
+
+	ThreadPool pool(opts.jobs);
+	if (opts.shard_count > 1)
+	{
+		Trace::Span span("shard", "batch");
+		shard(pool, opts, jobs);
+	}
+
+	std::vector<std::vector<size_t> > tasks;
+	{
+		Trace::Span span("schedule", "batch");
+		tasks = schedule(jobs);
+	}
+	std::vector<Result> results(jobs.size());
+	RefCache ref_cache;
+	ResultCache result_cache(opts.cache);
+	ResultCache *cache = opts.cache.isEmpty() ? nullptr : &result_cache;
+	if (cache != nullptr && !result_cache.valid())
+	{
+		qout << QSTR8BIT("无法创建结果缓存目录: ") + opts.cache << endl;
+		return 2;
+	}
+	MemoryBudget memory_budget(opts.memory);
+	MemoryBudget *budget = opts.memory > 0 ? &memory_budget : nullptr;
+	size_t ok_count = 0;
+	std::mutex out_lock;	//保护ok_count和输出
+
+	//每项一行, 便于脚本解析: 状态	耗时	路径
+	auto finish = [&](size_t index, bool ok, double ms, const QString &error, FixJob &fix_job) {
+		Result &result = results[index];
+		result.ok = ok;
+		result.ms = ms;
+		result.error = error;
+		result.memory = fix_job.memory().total();
+		if (const PhaseStats *phases = fix_job.log().stats())
+		{
+			result.phases = *phases;
+		}
+
+		std::lock_guard<std::mutex> guard(out_lock);
+		if (ok)
+		{
+			ok_count++;
+		}
+		qout << (ok ? "OK" : "FAIL") << "\t" << QString::number(ms, 'f', 3) << " ms\t" << JobName(jobs[index]);
+		if (!ok && !error.isEmpty())
+		{
+			qout << "\t" << error;
+		}
+		qout << endl;
+	};
+
+	QStringList stage_report;
+	if (opts.pipeline > 0)
+	{
+		//流水线按调度顺序逐项处理, 大文件仍然最先开始
+		std::vector<size_t> order;
+		for (size_t t = 0; t < tasks.size(); t++)
+		{
+			order.insert(order.end(), tasks[t].begin(), tasks[t].end());
+		}
+
+		Pipeline pipeline(opts.mode, pool.thread_count(), opts.pipeline, &ref_cache, cache, budget);
+		pipeline.set_phase_stats(!opts.stats.isEmpty());
+		Trace::Span span("pipeline", "batch");
+		pipeline.Run(jobs, order, finish);
+		stage_report = pipeline.Report();
+	}
+	else
+	{
+		for (size_t t = 0; t < tasks.size(); t++)
+		{
+			const std::vector<size_t> *task = &tasks[t];
+			pool.Submit([&, task]() {
+				for (size_t i = 0; i < task->size(); i++)
+				{
+					size_t index = (*task)[i];
+					qint64 footprint = budget != nullptr ? EstimateMemory(opts.mode, jobs[index], false) : 0;
+					if (budget != nullptr)
+					{
+						Trace::Span span("budget wait", "batch", JobName(jobs[index]));
+						budget->Acquire(footprint);
+					}
+
+					Trace::Span span("job", "batch", JobName(jobs[index]));
+
+					QElapsedTimer timer;
+					timer.start();
+					FixJob fix_job;
+					fix_job.log().set_verbose(false);
+					fix_job.log().set_stats(!opts.stats.isEmpty());
+					fix_job.set_ref_cache(&ref_cache);
+					fix_job.set_result_cache(cache);
+					QString error;
+					bool ok;
+					{
+						//只有一个工作线程时每项重新统计峰值, 增量只属于该项
+						PhaseStats::MemoryScope memory(fix_job.log().stats(), pool.thread_count() == 1);
+						ok = RunJob(opts.mode, jobs[index], fix_job, &error);
+					}
+					double ms = timer.nsecsElapsed() / 1e6;
+
+					if (budget != nullptr)
+					{
+						budget->Release(footprint);
+					}
+					finish(index, ok, ms, error, fix_job);
+				}
+			});
+		}
+		Trace::Span span("wait", "batch");
+		pool.Wait();
+	}
+
+	double total_ms = total.nsecsElapsed() / 1e6;
+	double cpu_sec = Util::cpuSeconds() - cpu_start;
+	double cpu_util = total_ms > 0 ? cpu_sec * 1000.0 / (total_ms * pool.thread_count()) * 100 : 0;
+
+	qout << QSTR8BIT("共 %1 项, 成功 %2, 失败 %3, 总耗时 %4 ms, %5 个/秒")
+		.arg((qint64)jobs.size())
+		.arg((qint64)ok_count)
+		.arg((qint64)(jobs.size() - ok_count))
+		.arg(total_ms, 0, 'f', 3)
+		.arg(total_ms > 0 ? jobs.size() * 1000.0 / total_ms : 0.0, 0, 'f', 2) << endl;
+	qout << QSTR8BIT("线程 %1, 任务 %2, 窃取 %3 次, CPU利用率 %4%")
+		.arg(pool.thread_count())
+		.arg((qint64)tasks.size())
+		.arg((quint64)pool.steal_count())
+		.arg(cpu_util, 0, 'f', 1) << endl;
+	for (int i = 0; i < stage_report.size(); i++)
+	{
+		qout << stage_report.at(i) << endl;
+	}
+	if (budget != nullptr)
+	{
+		qint64 max_memory = 0;
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			max_memory = qMax(max_memory, results[i].memory);
+		}
+		qout << QSTR8BIT("内存预算 %1 MB: 估计占用峰值 %2 MB, 单项实际最大 %3 MB, 等待 %4 次, 共 %5 ms")
+			.arg(budget->budget() / 1048576.0, 0, 'f', 1)
+			.arg(budget->peak() / 1048576.0, 0, 'f', 1)
+			.arg(max_memory / 1048576.0, 0, 'f', 1)
+			.arg((quint64)budget->waits())
+			.arg(budget->wait_ms(), 0, 'f', 1) << endl;
+	}
+	if (opts.mode == MODE_DUMP_FROM_NORMAL)
+	{
+		qout << QSTR8BIT("正常so缓存: 命中 %1, 读取 %2").arg((quint64)ref_cache.hits()).arg((quint64)ref_cache.misses()) << endl;
+	}
+	if (cache != nullptr)
+	{
+		qout << QSTR8BIT("结果缓存: 命中 %1, 未命中 %2").arg((quint64)result_cache.hits()).arg((quint64)result_cache.misses()) << endl;
+	}
+
+	if (!opts.stats.isEmpty())
+	{
+		PhaseStats total;
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			total.Merge(results[i].phases);
+		}
+		qout << formatIo(total) << endl;
+
+		std::vector<qint64> rss;
+		std::vector<qint64> alloc_bytes;
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			rss.push_back(results[i].phases.memory().rss_delta);
+			alloc_bytes.push_back(results[i].phases.memory().alloc_bytes);
+		}
+		qout << QSTR8BIT("单项内存: 最大单次分配 %1 MB, 共分配 %2 次 %3 MB")
+			.arg(total.memory().alloc_largest / 1048576.0, 0, 'f', 1)
+			.arg((quint64)total.memory().allocs)
+			.arg(total.memory().alloc_bytes / 1048576.0, 0, 'f', 1) << endl;
+		QStringList lines = formatHistogram(QSTR8BIT("峰值RSS增量"), rss) + formatHistogram(QSTR8BIT("分配字节"), alloc_bytes);
+		for (int i = 0; i < lines.size(); i++)
+		{
+			qout << lines.at(i) << endl;
+		}
+	}
+
+	if (!opts.trace.isEmpty() && !Trace::Save(opts.trace))
+	{
+		qout << QSTR8BIT("无法写入追踪文件: ") + opts.trace << endl;
+		return 2;
+	}
+
+	if (!opts.stats.isEmpty() && !writePhaseStats(opts, jobs, results))
+	{
+		qout << QSTR8BIT("无法写入阶段统计: ") + opts.stats << endl;
+		return 2;
+	}
+
+	if (!opts.results.isEmpty())
+	{
+		Stats stats = { (qint64)jobs.size(), (qint64)ok_count, total_ms, cpu_sec };
+		if (!writeResults(opts, jobs, results, stats))
+		{
+			qout << QSTR8BIT("无法写入结果清单: ") + opts.results << endl;
+			return 2;
+		}
+	}
+
+	return ok_count == jobs.size() ? 0 : 1;
+}
+
+void Batch::shard(ThreadPool &pool, const Options &opts, std::vector<Job> &jobs)
+{
+	//按文件内容哈希划分, 与路径, 清单顺序和机器无关, 同一文件在任何进程中都落在同一分片
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		Job *job = &jobs[i];
+		pool.Submit([job]() {
+			if (!Hash64::OfFile(JobName(*job), job->hash))
+			{
+				//读不到的文件按路径划分, 由所在分片报告失败
+				job->hash = Hash64::Of(JobName(*job).toUtf8().constData(), JobName(*job).toUtf8().size());
+			}
+		});
+	}
+	pool.Wait();
+
+	std::vector<Job> mine;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].hash % (uint64_t)opts.shard_count == (uint64_t)opts.shard_index)
+		{
+			mine.push_back(jobs[i]);
+		}
+	}
+	jobs.swap(mine);
+}
+
+bool Batch::writeResults(const Options &opts, const std::vector<Job> &jobs,
+	const std::vector<Result> &results, const Stats &stats)
+{
+	QFile file(opts.results);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+	{
+		return false;
+	}
+
+	//按路径排序, 同样的输入得到同样的清单
+	std::vector<size_t> order(jobs.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&jobs](size_t a, size_t b) {
+		return JobName(jobs[a]) < JobName(jobs[b]);
+	});
+
+	QTextStream out(&file);
+	out << "# shard\t" << (opts.shard_count > 1 ? QString("%1/%2").arg(opts.shard_index).arg(opts.shard_count) : QString("0/1")) << endl;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const Job &job = jobs[order[i]];
+		const Result &result = results[order[i]];
+		out << (result.ok ? "OK" : "FAIL") << "\t" << QString::number(result.ms, 'f', 3)
+			<< "\t" << (job.hash ? Hash64::ToHex(job.hash) : QString("-")) << "\t" << JobName(job);
+		if (!result.ok && !result.error.isEmpty())
+		{
+			out << "\t" << result.error;
+		}
+		out << endl;
+	}
+	out << formatStats(stats) << endl;
+
+	return true;
+}
+
+QString Batch::formatStats(const Stats &stats)
+{
+	return QString("# stats\tfiles=%1\tok=%2\twall_ms=%3\tcpu_s=%4")
+		.arg(stats.files)
+		.arg(stats.ok)
+		.arg(stats.wall_ms, 0, 'f', 3)
+		.arg(stats.cpu_s, 0, 'f', 3);
+}
+
+QString Batch::formatIo(const PhaseStats &total)
+{
+	QJsonObject io = total.IoToJson(false);
+	return QSTR8BIT("文件访问: seek %1 次, 读 %2 次 %3 MB (读放大 %4), 写 %5 次 %6 MB (写放大 %7), 共 %8 ms")
+		.arg((qint64)io.value("seeks").toDouble())
+		.arg((qint64)io.value("reads").toDouble())
+		.arg(io.value("bytes_read").toDouble() / 1048576.0, 0, 'f', 1)
+		.arg(total.ReadAmplification(), 0, 'f', 2)
+		.arg((qint64)io.value("writes").toDouble())
+		.arg(io.value("bytes_written").toDouble() / 1048576.0, 0, 'f', 1)
+		.arg(total.WriteAmplification(), 0, 'f', 2)
+		.arg(io.value("ms").toDouble(), 0, 'f', 1);
+}
+
+QStringList Batch::formatHistogram(const QString &title, const std::vector<qint64> &values)
+{
+	//桶按2的幂划分: <1MB, 1~2MB, 2~4MB, ...; 只列出到最大值所在的桶
+	std::vector<qint64> counts;
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		size_t bucket = 0;
+		for (qint64 limit = 1024 * 1024; values[i] >= limit; limit *= 2)
+		{
+			bucket++;
+		}
+		if (counts.size() <= bucket)
+		{
+			counts.resize(bucket + 1, 0);
+		}
+		counts[bucket]++;
+	}
+
+	qint64 most = counts.empty() ? 0 : *std::max_element(counts.begin(), counts.end());
+	QStringList lines;
+	lines << title + QSTR8BIT("分布(项数):");
+	for (size_t bucket = 0; bucket < counts.size(); bucket++)
+	{
+		QString range = bucket == 0 ? QString("< 1 MB") : QString("%1 ~ %2 MB").arg(1LL << (bucket - 1)).arg(1LL << bucket);
+		int bar = most > 0 ? (int)((counts[bucket] * 40 + most - 1) / most) : 0;
+		lines << QString("  %1 %2 %3").arg(range, 18).arg(counts[bucket], 7).arg(QString("#").repeated(bar));
+	}
+	return lines;
+}
+
+bool Batch::writePhaseStats(const Options &opts, const std::vector<Job> &jobs, const std::vector<Result> &results)
+{
+	//每项一个对象, 按路径排序; total为全部项按阶段累加
+	std::vector<size_t> order(jobs.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&jobs](size_t a, size_t b) {
+		return JobName(jobs[a]) < JobName(jobs[b]);
+	});
+
+	QJsonArray items;
+	PhaseStats total;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const Result &result = results[order[i]];
+		QJsonObject item;
+		item.insert("path", JobName(jobs[order[i]]));
+		item.insert("ok", result.ok);
+		item.insert("ms", result.ms);
+		item.insert("phases", result.phases.ToJson());
+		item.insert("io", result.phases.IoToJson(true));
+		item.insert("memory", result.phases.MemoryToJson());
+		items.append(item);
+		total.Merge(result.phases);
+	}
+
+	QJsonObject root;
+	root.insert("files", (qint64)jobs.size());
+	root.insert("total", total.ToJson());
+	root.insert("io", total.IoToJson(false));
+	root.insert("memory", total.MemoryToJson());
+	root.insert("jobs", items);
+
+	QFile file(opts.stats);
+	QByteArray json = QJsonDocument(root).toJson();
+	return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(json) == json.size();
+}
+
+int Batch::Merge(int argc, char *argv[])
+{
+	QTextStream qout(stdout);
+	QString outpath;
+	QStringList inputs;
+
+	//argv[1]为"merge"
+	for (int i = 2; i < argc; i++)
+	{
+		QString arg = QSTR8BIT(argv[i]);
+		if (arg == "--out" && i + 1 < argc)
+		{
+			outpath = QSTR8BIT(argv[++i]);
+		}
+		else
+		{
+			inputs << arg;
+		}
+	}
+	if (outpath.isEmpty() || inputs.isEmpty())
+	{
+		printUsage();
+		return 2;
+	}
+
+	std::map<QString, QString> entries;	//路径 -> 结果行, 按路径排序
+	std::map<QString, int> entry_shard;	//路径 -> 所在分片, 清单中重复的路径落在同一分片
+	std::vector<bool> seen;				//已合并的分片
+	int shard_count = 0;
+	Stats total = { 0, 0, 0, 0 };
+	qint64 fail_count = 0;
+
+	for (int i = 0; i < inputs.size(); i++)
+	{
+		QFile file(inputs.at(i));
+		if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		{
+			qout << QSTR8BIT("无法打开结果清单: ") + inputs.at(i) << endl;
+			return 2;
+		}
+
+		int shard_index = -1;	//本文件的分片, 由"# shard"行给出
+		while (!file.atEnd())
+		{
+			QString line = QString::fromLocal8Bit(file.readLine());
+			while (line.endsWith("\n") || line.endsWith("\r"))
+			{
+				line.chop(1);
+			}
+			QStringList fields = line.split('\t');
+
+			if (fields.at(0) == "# shard" && fields.size() > 1)
+			{
+				int index = fields.at(1).section('/', 0, 0).toInt();
+				int count = fields.at(1).section('/', 1, 1).toInt();
+				if (count <= 0 || index < 0 || index >= count || (shard_count != 0 && count != shard_count))
+				{
+					qout << QSTR8BIT("分片数不一致: ") + inputs.at(i) << endl;
+					return 2;
+				}
+				if (shard_count == 0)
+				{
+					shard_count = count;
+					seen.assign(count, false);
+				}
+				if (seen[index])
+				{
+					qout << QSTR8BIT("分片重复: ") + inputs.at(i) << endl;
+					return 2;
+				}
+				seen[index] = true;
+				shard_index = index;
+			}
+			else if (fields.at(0) == "# stats")
+			{
+				//各分片并行运行, 墙钟时间取最大值, CPU时间累加
+				for (int f = 1; f < fields.size(); f++)
+				{
+					QString key = fields.at(f).section('=', 0, 0);
+					double value = fields.at(f).section('=', 1, 1).toDouble();
+					if (key == "files")
+					{
+						total.files += (qint64)value;
+					}
+					else if (key == "ok")
+					{
+						total.ok += (qint64)value;
+					}
+					else if (key == "wall_ms")
+					{
+						total.wall_ms = std::max(total.wall_ms, value);
+					}
+					else if (key == "cpu_s")
+					{
+						total.cpu_s += value;
+					}
+				}
+			}
+			else if (fields.size() >= 4 && !line.startsWith("#"))
+			{
+				std::map<QString, int>::const_iterator it = entry_shard.find(fields.at(3));
+				if (it != entry_shard.end())
+				{
+					if (it->second != shard_index)
+					{
+						qout << QSTR8BIT("文件出现在多个分片中: ") + fields.at(3) << endl;
+						return 2;
+					}
+					//清单中重复列出的文件, 保留第一次的结果
+					continue;
+				}
+				entry_shard[fields.at(3)] = shard_index;
+				entries[fields.at(3)] = line;
+				if (fields.at(0) != "OK")
+				{
+					fail_count++;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < shard_count; i++)
+	{
+		if (!seen[i])
+		{
+			qout << QSTR8BIT("缺少分片 %1/%2").arg(i).arg(shard_count) << endl;
+			return 2;
+		}
+	}
+
+	QFile file(outpath);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+	{
+		qout << QSTR8BIT("无法写入: ") + outpath << endl;
+		return 2;
+	}
+
+	QTextStream out(&file);
+	out << "# shards\t" << shard_count << endl;
+	for (std::map<QString, QString>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		out << it->second << endl;
+	}
+	out << formatStats(total) << endl;
+
+	qout << QSTR8BIT("合并 %1 个分片, 共 %2 项, 成功 %3, 失败 %4, 最长分片耗时 %5 ms, CPU %6 s")
+		.arg(shard_count)
+		.arg((qint64)entries.size())
+		.arg((qint64)entries.size() - fail_count)
+		.arg(fail_count)
+		.arg(total.wall_ms, 0, 'f', 3)
+		.arg(total.cpu_s, 0, 'f', 3) << endl;
+
+	return fail_count == 0 ? 0 : 1;
+}
+
+std::vector<std::vector<size_t> > Batch::schedule(std::vector<Job> &jobs)
+{
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		jobs[i].size = QFileInfo(JobName(jobs[i])).size();
+	}
+
+	//大文件先开始, 避免最后剩下一个大文件拖尾
+	std::stable_sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) {
+		return a.size > b.size;
+	});
+
+	std::vector<std::vector<size_t> > tasks;
+	qint64 coalesced = 0;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		bool small = jobs[i].size < kSmallFileSize;
+		if (!small || tasks.empty() || coalesced == 0
+			|| coalesced >= kCoalesceSize || tasks.back().size() >= kCoalesceCount)
+		{
+			tasks.push_back(std::vector<size_t>());
+			coalesced = 0;
+		}
+
+		tasks.back().push_back(i);
+		coalesced = small ? coalesced + jobs[i].size + 1 : 0;
+	}
+
+	return tasks;
+}
+
+bool Batch::RunJob(Mode mode, const Job &job, QString *error, RefCache *ref_cache, ResultCache *result_cache)
+{
+	//每项一个独立的上下文, 各线程之间只共享只读的正常so缓存
+	FixJob fix_job;
+	fix_job.log().set_verbose(false);
+	fix_job.set_ref_cache(ref_cache);
+	fix_job.set_result_cache(result_cache);
+	return RunJob(mode, job, fix_job, error);
+}
+
+bool Batch::RunJob(Mode mode, const Job &job, FixJob &fix_job, QString *error)
+{
+	bool ok = false;
+
+	switch (mode)
+	{
+	case MODE_NORMAL:
+		ok = fix_job.FixSo(job.sopath, QString());
+		break;
+	case MODE_DUMP_FROM_NORMAL:
+		ok = fix_job.FixSo(job.sopath, job.dumppath);
+		break;
+	case MODE_DUMP:
+		ok = fix_job.FixDumpSo(job.dumppath, job.dump_bias);
+		break;
+	case MODE_REBUILD:
+		ok = fix_job.Rebuild(job.sopath);
+		break;
+	default:
+		break;
+	}
+
+	if (!ok && error && !fix_job.log().errors().isEmpty())
+	{
+		*error = fix_job.log().errors().first();
+	}
+	return ok;
+}
+
+qint64 Batch::EstimateMemory(Mode mode, const Job &job, bool deferred)
+{
+	qint64 input = QFileInfo(JobName(job)).size();
+	if (mode == MODE_REBUILD)
+	{
+		return input;
+	}
+
+	//dump-from-normal按正常so的程序头加载, 再把dump读入镜像
+	//dump的镜像为整个dump文件, 之后修复.normal时再按程序头加载一次
+	qint64 image = FixJob::LoadSizeOf(mode == MODE_DUMP_FROM_NORMAL ? job.sopath : JobName(job));
+	if (image == 0 || mode == MODE_DUMP)
+	{
+		image = qMax(image, PAGE_END(input));
+	}
+
+	//推迟写出时还有.loaded(镜像大小)和.fixed(约为文件大小)
+	return image + input + (deferred ? image + input : 0);
+}
+
+const QString &Batch::JobName(const Job &job)
+{
+	return job.dumppath.isEmpty() ? job.sopath : job.dumppath;
+}
+
+bool Batch::parseArgs(int argc, char *argv[], Options &opts)
+{
+	opts.mode = MODE_NONE;
+	opts.dump_bias = 0;
+	opts.jobs = 0;
+	opts.shard_index = 0;
+	opts.shard_count = 1;
+	opts.pipeline = 0;
+	opts.memory = 0;
+
+	//argv[1]为"batch"
+	for (int i = 2; i < argc; i++)
+	{
+		QString arg = QSTR8BIT(argv[i]);
+		if (i + 1 >= argc)
+		{
+			return false;
+		}
+
+		QString value = QSTR8BIT(argv[++i]);
+		if (arg == "--mode")
+		{
+			opts.mode = ParseMode(value);
+		}
+		else if (arg == "--manifest")
+		{
+			opts.manifest = value;
+		}
+		else if (arg == "--dir")
+		{
+			opts.dir = value;
+		}
+		else if (arg == "--ref")
+		{
+			opts.ref = value;
+		}
+		else if (arg == "--bias")
+		{
+			opts.dump_bias = value.toULongLong(nullptr, 16);
+		}
+		else if (arg == "--jobs")
+		{
+			opts.jobs = value.toInt();
+		}
+		else if (arg == "--shard")
+		{
+			//i/N, i从0开始
+			opts.shard_index = value.section('/', 0, 0).toInt();
+			opts.shard_count = value.section('/', 1, 1).toInt();
+		}
+		else if (arg == "--results")
+		{
+			opts.results = value;
+		}
+		else if (arg == "--cache")
+		{
+			opts.cache = value;
+		}
+		else if (arg == "--pipeline")
+		{
+			opts.pipeline = value.toInt();
+		}
+		else if (arg == "--memory")
+		{
+			opts.memory = value.toLongLong() * 1024 * 1024;
+		}
+		else if (arg == "--stats")
+		{
+			opts.stats = value;
+		}
+		else if (arg == "--trace")
+		{
+			opts.trace = value;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	if (opts.shard_count < 1 || opts.shard_index < 0 || opts.shard_index >= opts.shard_count)
+	{
+		return false;
+	}
+	if (opts.shard_count > 1 && opts.results.isEmpty())
+	{
+		opts.results = QString("results.%1-of-%2.tsv").arg(opts.shard_index).arg(opts.shard_count);
+	}
+
+	//清单和目录必须且只能指定一个
+	return opts.mode != MODE_NONE && (opts.manifest.isEmpty() != opts.dir.isEmpty());
+}
+
+bool Batch::ParseJob(Mode mode, const QStringList &fields, const QString &ref, uint64_t dump_bias, Job &job)
+{
+	job.sopath.clear();
+	job.dumppath.clear();
+	job.dump_bias = dump_bias;
+	job.size = 0;
+	job.hash = 0;
+	if (fields.isEmpty())
+	{
+		return false;
+	}
+
+	switch (mode)
+	{
+	case MODE_DUMP_FROM_NORMAL:
+		job.sopath = fields.size() > 1 ? fields.at(0) : ref;
+		job.dumppath = fields.size() > 1 ? fields.at(1) : fields.at(0);
+		return !job.sopath.isEmpty();
+	case MODE_DUMP:
+		job.dumppath = fields.at(0);
+		if (fields.size() > 1)
+		{
+			job.dump_bias = fields.at(1).toULongLong(nullptr, 16);
+		}
+		return true;
+	case MODE_NONE:
+		return false;
+	default:
+		job.sopath = fields.at(0);
+		return true;
+	}
+}
+
+Batch::Mode Batch::ParseMode(const QString &mode)
+{
+	if (mode == "normal")
+	{
+		return MODE_NORMAL;
+	}
+	else if (mode == "dump-from-normal")
+	{
+		return MODE_DUMP_FROM_NORMAL;
+	}
+	else if (mode == "dump")
+	{
+		return MODE_DUMP;
+	}
+	else if (mode == "rebuild")
+	{
+		return MODE_REBUILD;
+	}
+
+	return MODE_NONE;
+}
+
+bool Batch::loadManifest(const Options &opts, std::vector<Job> &jobs)
+{
+	QTextStream qout(stdout);
+	QFile file(opts.manifest);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		qout << QSTR8BIT("无法打开清单文件: ") + opts.manifest << endl;
+		return false;
+	}
+
+	while (!file.atEnd())
+	{
+		QString line = QString::fromLocal8Bit(file.readLine()).trimmed();
+		if (line.isEmpty() || line.startsWith("#"))
+		{
+			continue;
+		}
+
+		Job job;
+		if (!ParseJob(opts.mode, line.split('\t', QString::SkipEmptyParts), opts.ref, opts.dump_bias, job))
+		{
+			qout << QSTR8BIT("缺少正常so文件: ") + line << endl;
+			return false;
+		}
+		jobs.push_back(job);
+	}
+
+	return true;
+}
+
+bool Batch::loadDir(const Options &opts, std::vector<Job> &jobs)
+{
+	QTextStream qout(stdout);
+	QDir dir(opts.dir);
+	if (!dir.exists())
+	{
+		qout << QSTR8BIT("目录不存在: ") + opts.dir << endl;
+		return false;
+	}
+
+	if (opts.mode == MODE_DUMP_FROM_NORMAL && opts.ref.isEmpty())
+	{
+		qout << QSTR8BIT("目录模式下dump-from-normal需要--ref指定正常so文件") << endl;
+		return false;
+	}
+
+	QFileInfoList entries = dir.entryInfoList(QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+	for (int i = 0; i < entries.size(); i++)
+	{
+		QString path = entries.at(i).filePath();
+
+		//跳过之前修复的输出文件
+		if (path.endsWith(".loaded") || path.endsWith(".fixed") || path.endsWith(".normal"))
+		{
+			continue;
+		}
+		if ((opts.mode == MODE_REBUILD) != path.endsWith(".json"))
+		{
+			continue;
+		}
+
+		Job job = { QString(), QString(), opts.dump_bias, 0, 0 };
+		switch (opts.mode)
+		{
+		case MODE_DUMP_FROM_NORMAL:
+			job.sopath = opts.ref;
+			job.dumppath = path;
+			break;
+		case MODE_DUMP:
+			job.dumppath = path;
+			break;
+		default:
+			job.sopath = path;
+			break;
+		}
+		jobs.push_back(job);
+	}
+
+	return true;
+}
+
+void Batch::printUsage()
+{
+	QTextStream qout(stdout);
+	qout << QSTR8BIT("用法: SoFix batch --mode <normal|dump-from-normal|dump|rebuild> "
+		"(--manifest <清单文件> | --dir <目录>) [--ref <正常so>] [--bias <load_bias>] [--jobs <线程数>] [--shard <i/N>] [--results <结果清单>] [--cache <结果缓存目录>] [--pipeline <队列深度>] [--memory <MB>] [--stats <JSON文件>] [--trace <JSON文件>]\n"
+		"      SoFix merge --out <合并后清单> <分片结果清单>...") << endl;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <stdint.h>
+#include <vector>
+#include "PhaseStats.h"
+
+//批处理: 在一个进程内处理清单或目录中的全部so, 进程启动和Qt初始化只做一次
+//用法:
+//	SoFix batch --mode <normal|dump-from-normal|dump|rebuild> (--manifest <file> | --dir <dir>) [--ref <so>] [--bias <hex>] [--jobs <n>]
+//		[--shard <i/N>] [--results <file>] [--cache <dir>] [--pipeline <depth>] [--memory <MB>] [--stats <file>] [--trace <file>]
+//	SoFix merge --out <file> <results...>
+//清单每行一项, 字段以tab分隔, #开头的行忽略:
+//	normal:				so路径
+//	dump-from-normal:	正常so路径	dump so路径 (或只写dump so路径, 使用--ref)
+//	dump:				dump so路径	[load_bias(十六进制), 缺省使用--bias]
+//	rebuild:			json路径
+//--shard i/N按文件内容哈希只处理第i个分片(0 <= i < N), 多台机器/多个进程各跑一个分片, 不需要协调;
+//结果清单(--results, 分片时缺省为results.<i>-of-<N>.tsv)每行: 状态	耗时(ms)	内容哈希	路径	[错误],
+//首行为# shard, 末行为# stats; merge检查分片是否齐全, 按路径合并并汇总统计
+//--pipeline按预读 -> 修复 -> 写出三段流水线执行(见Pipeline), depth为段间队列容量, 结束时输出各段利用率和队列占用
+//--memory为同时运行的任务的内存预算(见MemoryBudget), 每项开始前按程序头估计占用, 超出时等待
+//--cache指定结果缓存目录(见ResultCache), 内容相同的输入不再重复修复, 可在多次运行和多个进程之间共用
+//--stats记录每项各阶段的耗时和计数(见PhaseStats), 以及按阶段和按文件的文件访问(见CountingDevice),
+//	每项的分配次数, 字节, 最大单次分配和峰值RSS增量, 结束时把每项和汇总写成JSON, 并输出单项内存的分布
+//--trace记录加载各步骤, 修复各阶段, 写出和调度事件的区间(见Trace), 每个工作线程一条轨道, 可在Perfetto中打开
+class ThreadPool;
+class RefCache;
+class ResultCache;
+class FixJob;
+
+class Batch
+{
+public:
+	enum Mode
+	{
+		MODE_NONE = 0,
+		MODE_NORMAL,
+		MODE_DUMP_FROM_NORMAL,
+		MODE_DUMP,
+		MODE_REBUILD
+	};
+
+	//批处理中的一项
+	struct Job
+	{
+		QString sopath;		//正常so, MODE_REBUILD时为json
+		QString dumppath;	//dump so
+		uint64_t dump_bias;	//MODE_DUMP: dump时的load_bias
+		qint64 size;		//文件大小, 用于调度
+		uint64_t hash;		//文件内容哈希, 分片时计算, 否则为0
+	};
+
+	struct Options
+	{
+		Mode mode;
+		QString manifest;
+		QString dir;
+		QString ref;		//dump-from-normal的目录模式使用同一个正常so
+		uint64_t dump_bias;
+		int jobs;			//并行线程数, 0表示硬件线程数
+		int shard_index;	//--shard i/N
+		int shard_count;
+		QString results;	//结果清单路径, 为空则不写
+		QString cache;		//结果缓存目录, 为空则不使用
+		int pipeline;		//流水线队列深度, 0表示不使用流水线
+		qint64 memory;		//内存预算(字节), 0表示不限制
+		QString stats;		//各阶段统计的JSON输出路径, 为空则不统计
+		QString trace;		//Chrome trace-event JSON的输出路径, 为空则不追踪
+	};
+
+	Batch() = delete;
+	~Batch() = delete;
+
+	//命令行入口, 返回进程退出码: 0全部成功, 1有失败, 2参数错误
+	static int Run(int argc, char *argv[]);
+
+	//合并分片结果清单, 返回值同Run, 分片不全或重复返回2
+	static int Merge(int argc, char *argv[]);
+
+	//执行单项, 返回是否成功, 失败时error为任务的第一条错误
+	//ref_cache不为空时dump-from-normal的正常so从缓存中读取
+	//result_cache不为空时修复结果按输入内容缓存(rebuild除外)
+	static bool RunJob(Mode mode, const Job &job, QString *error = nullptr, RefCache *ref_cache = nullptr,
+		ResultCache *result_cache = nullptr);
+
+	//在调用者准备好的fix_job上执行(已设置缓存, 预读的输入等)
+	static bool RunJob(Mode mode, const Job &job, FixJob &fix_job, QString *error = nullptr);
+
+	//估计执行job需要的内存: 镜像(由程序头得到load_size) + 读入的输入 + 推迟写出的结果
+	//正常so由RefCache共享, 不计入单项
+	static qint64 EstimateMemory(Mode mode, const Job &job, bool deferred);
+
+	//job的显示名称(dump so或so/json路径)
+	static const QString &JobName(const Job &job);
+
+	//"normal"等模式名, 无效返回MODE_NONE
+	static Mode ParseMode(const QString &mode);
+
+	//按清单格式解析一项的各字段, ref/dump_bias为缺省值, 字段不足返回false
+	static bool ParseJob(Mode mode, const QStringList &fields, const QString &ref, uint64_t dump_bias, Job &job);
+
+private:
+	struct Result
+	{
+		bool ok;
+		double ms;
+		QString error;
+		qint64 memory;		//FixJob::Memory::total
+		PhaseStats phases;	//--stats时记录
+
+		Result() : ok(false), ms(0), memory(0) {}
+	};
+
+	struct Stats
+	{
+		qint64 files;
+		qint64 ok;
+		double wall_ms;
+		double cpu_s;
+	};
+
+	static bool parseArgs(int argc, char *argv[], Options &opts);
+	static bool loadManifest(const Options &opts, std::vector<Job> &jobs);
+	static bool loadDir(const Options &opts, std::vector<Job> &jobs);
+	//按文件从大到小排序, 并把相邻的小文件合并为一个任务, 返回每个任务包含的job下标
+	static std::vector<std::vector<size_t> > schedule(std::vector<Job> &jobs);
+	//计算内容哈希, 只保留属于本分片的job
+	static void shard(ThreadPool &pool, const Options &opts, std::vector<Job> &jobs);
+	static bool writeResults(const Options &opts, const std::vector<Job> &jobs,
+		const std::vector<Result> &results, const Stats &stats);
+	static QString formatStats(const Stats &stats);
+	//--stats时结束输出的文件访问汇总: 各操作次数, 字节数, 读放大和写放大
+	static QString formatIo(const PhaseStats &total);
+	//按2的幂(MB)分桶的直方图, 每桶一行
+	static QStringList formatHistogram(const QString &title, const std::vector<qint64> &values);
+	static bool writePhaseStats(const Options &opts, const std::vector<Job> &jobs, const std::vector<Result> &results);
+	static void printUsage();
+};
@@ -0,0 +1,454 @@
+#include "Bench.h"
+#include "AllocCounter.h"
+#include "Corpus.h"
+#include "ElfReader.h"
+#include "ElfFixer.h"
+#include "ElfBuilder.h"
+#include "linker.h"
+#include "Util.h"
+#include "Baseline.h"
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QFileInfo>
+#include <QBuffer>
+#include <QDir>
+#include <vector>
+
+#define QSTR8BIT(s) (QString::fromLocal8Bit(s))
+
+//防止被测函数的结果被优化掉
+static volatile uint64_t g_sink;
+
+//地址转换等查找类函数每次操作轮流使用其中一个输入
+static const size_t kProbeCount = 1024;
+
+Bench::Result Bench::Measure(const QString &name, qint64 size, qint64 bytes_per_op,
+	const std::function<void()> &op, double min_ms)
+{
+	op();
+
+	uint64_t iters = 1;
+	while (true)
+	{
+		uint64_t allocs = AllocCounter::count();
+		uint64_t alloc_bytes = AllocCounter::bytes();
+		QElapsedTimer timer;
+		timer.start();
+		for (uint64_t i = 0; i < iters; i++)
+		{
+			op();
+		}
+		qint64 ns = timer.nsecsElapsed();
+
+		//不够最短时间就按已用时间估计下一轮的次数, 最多翻10倍
+		if (ns < min_ms * 1e6 && iters < (1ULL << 40))
+		{
+			double scale = ns > 0 ? min_ms * 1e6 * 1.2 / ns : 10;
+			iters = (uint64_t)(iters * qBound(2.0, scale, 10.0));
+			continue;
+		}
+
+		Result result;
+		result.name = name;
+		result.size = size;
+		result.ops = iters;
+		result.ns_per_op = (double)ns / iters;
+		result.bytes_per_sec = bytes_per_op > 0 ? bytes_per_op * 1e9 / result.ns_per_op : 0;
+		result.allocs_per_op = (double)(AllocCounter::count() - allocs) / iters;
+		result.alloc_bytes_per_op = (double)(AllocCounter::bytes() - alloc_bytes) / iters;
+		return result;
+	}
+}
+
+void Bench::benchKmp(const Options &opts, qint64 size, const Report &report)
+{
+	if (!selected(opts, "kmpSearch"))
+	{
+		return;
+	}
+
+	//随机内容中几乎不会出现16字节的特征码, 每次都扫描到末尾
+	QByteArray haystack((int)size, '\0');
+	uint64_t x = 0x9E3779B97F4A7C15ULL;
+	for (qint64 i = 0; i + 8 <= size; i += 8)
+	{
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		memcpy(haystack.data() + i, &x, 8);
+	}
+
+	size_t code_size = 0;
+	const char *code = Elf32Class::plt_code(&code_size);
+	const char *s = haystack.constData();
+	report(Measure("kmpSearch", size, size, [&]() {
+		g_sink += Util::kmpSearch(s, (int)size, code, (int)code_size);
+	}, opts.min_ms));
+}
+
+bool Bench::benchFixer(const Options &opts, const QString &dir, qint64 size, const Report &report)
+{
+	typedef Elf32Class EC;
+	typedef ElfFixer<EC> Fixer;
+
+	//重定位和符号数随大小增长, 保证固定部分不超过size
+	Corpus::Options gen;
+	gen.count = 1;
+	gen.seed = 1;
+	gen.segments = 3;
+	gen.symbols = (int)qMax((qint64)16, size / 512);
+	gen.relative = (int)(size / 64);
+	gen.abs32 = (int)(size / 512);
+	gen.glob_dat = (int)(size / 1024);
+	gen.jump_slot = (int)(size / 512);
+	gen.init_array = 0;
+	gen.buckets = 0;
+	gen.strtab = 0;
+	gen.size = size;
+	gen.bias = 0xa0000000;
+	gen.adversarial = false;
+
+	QString sopath = QDir(dir).filePath(QString("libbench%1.so").arg(size));
+	if (!Corpus::Generate(gen, gen.seed, sopath, sopath + ".dump"))
+	{
+		return false;
+	}
+
+	QFile sofile(sopath);
+	if (!sofile.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+	QByteArray bytes = sofile.readAll();
+	sofile.close();
+
+	//与FixJob修复正常so的步骤相同, 先完整修复一次, 之后单独重复各个步骤
+	QByteArray sopath8 = sopath.toLocal8Bit();
+	JobLog log;
+	ElfReader<EC> reader(sopath8.constData(), nullptr, &log);
+	reader.set_reference(bytes);
+	if (!reader.Load())
+	{
+		return false;
+	}
+
+	soinfo<EC> si;
+	soinfo_init<EC>(&si, QFileInfo(sopath).fileName().toLocal8Bit().constData());
+	si.image = reader.image();
+	si.flags = 0;
+	si.entry = 0;
+	si.dynamic = NULL;
+	si.phnum = reader.phdr_count();
+	si.phdr = reader.loaded_phdr();
+
+	Fixer fixer(&si, sopath8.constData(), nullptr, &log);
+	fixer.set_reference(bytes);
+	fixer.set_buffered();
+	if (!fixer.Fix())
+	{
+		return false;
+	}
+
+	//与批处理相同, 之后只保留警告, 重复执行时不累积Debug输出
+	log.set_verbose(false);
+
+	//查找的输入: 镜像内随机的虚拟地址和文件内随机的偏移
+	std::vector<EC::Addr> addrs(kProbeCount);
+	std::vector<EC::Off> offs(kProbeCount);
+	uint32_t x = 2463534242u;
+	for (size_t i = 0; i < kProbeCount; i++)
+	{
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		addrs[i] = x % reader.load_size();
+		offs[i] = x % bytes.size();
+	}
+
+	size_t probe = 0;
+	if (selected(opts, "AddrToOff"))
+	{
+		report(Measure("AddrToOff", size, 0, [&]() {
+			g_sink += fixer.AddrToOff(addrs[probe++ % kProbeCount]);
+		}, opts.min_ms));
+	}
+	if (selected(opts, "OffToAddr"))
+	{
+		report(Measure("OffToAddr", size, 0, [&]() {
+			g_sink += fixer.OffToAddr(offs[probe++ % kProbeCount]);
+		}, opts.min_ms));
+	}
+	if (selected(opts, "FindShIdx"))
+	{
+		report(Measure("FindShIdx", size, 0, [&]() {
+			g_sink += fixer.FindShIdx(addrs[probe++ % kProbeCount]);
+		}, opts.min_ms));
+	}
+
+	//FixDynsym/FixDynstr只取较大值, FixRel从正常so读回原值, 重复执行结果不变
+	const EC::Shdr *shdrs = fixer.shdrs_;
+	qint64 rel_bytes = shdrs[Fixer::SI_RELDYN].sh_size + shdrs[Fixer::SI_RELPLT].sh_size;
+	if (selected(opts, "FixDynsym"))
+	{
+		report(Measure("FixDynsym", size, rel_bytes + shdrs[Fixer::SI_HASH].sh_size + shdrs[Fixer::SI_GNU_HASH].sh_size, [&]() {
+			g_sink += fixer.FixDynsym();
+		}, opts.min_ms));
+	}
+	if (selected(opts, "FixDynstr"))
+	{
+		report(Measure("FixDynstr", size, shdrs[Fixer::SI_DYNAMIC].sh_size, [&]() {
+			g_sink += fixer.FixDynstr();
+		}, opts.min_ms));
+	}
+	if (selected(opts, "FixRel"))
+	{
+		report(Measure("FixRel", size, rel_bytes, [&]() {
+			g_sink += fixer.FixRel();
+		}, opts.min_ms));
+	}
+	if (selected(opts, "FixShdrFromDynamic"))
+	{
+		report(Measure("FixShdrFromDynamic", size, shdrs[Fixer::SI_DYNAMIC].sh_size, [&]() {
+			g_sink += fixer.FixShdrFromDynamic();
+		}, opts.min_ms));
+	}
+
+	//重新映射到已保留的地址空间, 不再重新保留
+	if (selected(opts, "LoadSegments"))
+	{
+		report(Measure("LoadSegments", size, reader.load_size(), [&]() {
+			g_sink += reader.LoadSegments();
+		}, opts.min_ms));
+	}
+	return true;
+}
+
+void Bench::benchBuilder(const Options &opts, qint64 size, const Report &report)
+{
+	typedef Elf32Class EC;
+	typedef ElfBuilder<EC> Builder;
+	if (!selected(opts, "ElfBuilder::ApplyOptions"))
+	{
+		return;
+	}
+
+	//前一半为按项修正的字, 后一半的前部为重定位表, 每项指向前一半中的一个字
+	QByteArray data((int)size, '\0');
+	QBuffer file(&data);
+	file.open(QIODevice::ReadWrite);
+
+	JobLog log;
+	Builder builder(QString(), &log);
+	memset(&builder.ph_myload_, 0, sizeof(builder.ph_myload_));
+
+	Builder::Option items;
+	items.offset = 0;
+	items.count = (EC::Word)(size / 2 / sizeof(EC::Addr));
+	items.bias = 0x1000;
+	items.item_size = sizeof(EC::Addr);
+	builder.options_.push_back(items);
+
+	Builder::Option rel;
+	rel.offset = (EC::Off)(size / 2);
+	rel.count = (EC::Word)(size / 2 / sizeof(EC::Rel) / 2);
+	rel.bias = 0x1000;
+	rel.addr_to_off = 0;
+	for (EC::Word i = 0; i < rel.count; i++)
+	{
+		EC::Rel entry = { (EC::Addr)((i * sizeof(EC::Addr)) % (size / 2)), ELF32_R_INFO(0, R_ARM_RELATIVE) };
+		memcpy(data.data() + rel.offset + i * sizeof(EC::Rel), &entry, sizeof(entry));
+	}
+	builder.rel_option_ = rel;
+
+	//.rel.plt留空
+	builder.rel_plt_option_ = rel;
+	builder.rel_plt_option_.count = 0;
+
+	report(Measure("ElfBuilder::ApplyOptions", size, size, [&]() {
+		builder.ApplyOptions(file);
+	}, opts.min_ms));
+}
+
+int Bench::Run(int argc, char *argv[])
+{
+	QTextStream qout(stdout);
+	Options opts;
+	if (!parseArgs(argc, argv, opts))
+	{
+		printUsage();
+		return 2;
+	}
+
+	QTemporaryDir dir;
+	if (!dir.isValid())
+	{
+		qout << QSTR8BIT("无法创建临时目录") << endl;
+		return 2;
+	}
+
+	qout << QString("%1 %2 %3 %4 %5 %6 %7")
+		.arg("name", -26).arg("size", 10).arg("ops", 12).arg("ns/op", 12)
+		.arg("MB/s", 10).arg("allocs/op", 10).arg("B/op", 12) << endl;
+	Baseline::Run run = Baseline::NewRun("bench", opts.commit);
+	Report report = [&qout, &run](const Result &r) {
+		Baseline::AddSample(run, QString("%1/%2").arg(r.name).arg(r.size), "ns/op", r.ns_per_op);
+		qout << QString("%1 %2 %3 %4 %5 %6 %7")
+			.arg(r.name, -26).arg(r.size, 10).arg((quint64)r.ops, 12).arg(r.ns_per_op, 12, 'f', 1)
+			.arg(r.bytes_per_sec > 0 ? QString::number(r.bytes_per_sec / (1024 * 1024), 'f', 1) : QString("-"), 10)
+			.arg(r.allocs_per_op, 10, 'f', 2).arg(r.alloc_bytes_per_op, 12, 'f', 0) << endl;
+	};
+
+	for (int round = 0; round < opts.repeat; round++)
+	{
+		if (opts.repeat > 1)
+		{
+			qout << QSTR8BIT("第 %1/%2 轮").arg(round + 1).arg(opts.repeat) << endl;
+		}
+
+		benchLog(opts, report);
+		for (int i = 0; i < opts.sizes.size(); i++)
+		{
+			qint64 size = opts.sizes.at(i);
+			benchKmp(opts, size, report);
+			if (!benchFixer(opts, dir.path(), size, report))
+			{
+				qout << QSTR8BIT("生成或加载测试输入失败, 大小: %1").arg(size) << endl;
+				return 1;
+			}
+			benchBuilder(opts, size, report);
+		}
+	}
+
+	if (!opts.save.isEmpty() && !Baseline::Save(run, opts.save))
+	{
+		qout << QSTR8BIT("无法写入结果: ") + opts.save << endl;
+		return 1;
+	}
+	return 0;
+}
+
+void Bench::benchLog(const Options &opts, const Report &report)
+{
+	//模拟逐项循环中的日志, 每次操作kProbeCount条; 关闭的级别不应有格式化和参数求值的开销
+	JobLog quiet;
+	quiet.set_verbose(false);
+	if (selected(opts, "log:compiled-out"))
+	{
+		report(Measure("log:compiled-out", kProbeCount, 0, [&]() {
+			for (size_t i = 0; i < kProbeCount; i++)
+			{
+				SOFIX_LOG_AT(LL_NONE, &quiet, LL_DEBUG, Debug, "[bench] entry %d: 0x%x", (int)i, (unsigned)(i * 4));
+				g_sink += i;
+			}
+		}, opts.min_ms));
+	}
+	if (selected(opts, "log:runtime-off"))
+	{
+		report(Measure("log:runtime-off", kProbeCount, 0, [&]() {
+			for (size_t i = 0; i < kProbeCount; i++)
+			{
+				SOFIX_LOG_AT(LL_DEBUG, &quiet, LL_DEBUG, Debug, "[bench] entry %d: 0x%x", (int)i, (unsigned)(i * 4));
+				g_sink += i;
+			}
+		}, opts.min_ms));
+	}
+	//原来的方式: 总是调用, 在Debug内部检查级别
+	if (selected(opts, "log:call-off"))
+	{
+		report(Measure("log:call-off", kProbeCount, 0, [&]() {
+			for (size_t i = 0; i < kProbeCount; i++)
+			{
+				quiet.Debug("[bench] entry %d: 0x%x", (int)i, (unsigned)(i * 4));
+				g_sink += i;
+			}
+		}, opts.min_ms));
+	}
+	//交互模式下的开销, 每次操作使用新的日志避免输出无限增长
+	if (selected(opts, "log:enabled"))
+	{
+		report(Measure("log:enabled", kProbeCount, 0, [&]() {
+			JobLog verbose;
+			for (size_t i = 0; i < kProbeCount; i++)
+			{
+				SOFIX_LOG_AT(LL_DEBUG, &verbose, LL_DEBUG, Debug, "[bench] entry %d: 0x%x", (int)i, (unsigned)(i * 4));
+				g_sink += i;
+			}
+			g_sink += verbose.output().size();
+		}, opts.min_ms));
+	}
+}
+
+bool Bench::selected(const Options &opts, const QString &name)
+{
+	return opts.filter.isEmpty() || name.contains(opts.filter);
+}
+
+bool Bench::parseArgs(int argc, char *argv[], Options &opts)
+{
+	opts.min_ms = 200;
+	opts.repeat = 1;
+	QString sizes = "4K,64K,1M";
+
+	//argv[1]为"bench"
+	for (int i = 2; i < argc; i++)
+	{
+		QString arg = QSTR8BIT(argv[i]);
+		if (i + 1 >= argc)
+		{
+			return false;
+		}
+
+		QString value = QSTR8BIT(argv[++i]);
+		if (arg == "--filter")
+		{
+			opts.filter = value;
+		}
+		else if (arg == "--sizes")
+		{
+			sizes = value;
+		}
+		else if (arg == "--min-time")
+		{
+			opts.min_ms = value.toDouble();
+		}
+		else if (arg == "--repeat")
+		{
+			opts.repeat = value.toInt();
+		}
+		else if (arg == "--save")
+		{
+			opts.save = value;
+		}
+		else if (arg == "--commit")
+		{
+			opts.commit = value;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	QStringList items = sizes.split(',');
+	for (int i = 0; i < items.size(); i++)
+	{
+		//生成的so至少要容纳各个表, 太小的输入没有意义
+		qint64 size = Corpus::ParseSize(items.at(i));
+		if (size < 4096 || size > 1024LL * 1024 * 1024)
+		{
+			return false;
+		}
+		opts.sizes.append(size);
+	}
+	return opts.min_ms > 0 && opts.repeat > 0 && !opts.sizes.isEmpty();
+}
+
+void Bench::printUsage()
+{
+	QTextStream qout(stdout);
+	qout << QSTR8BIT("用法: SoFix bench [--filter <名称子串>] [--sizes <大小列表, 如4K,64K,1M>] [--min-time <每项最短计时, 毫秒>]\n"
+		"	[--repeat <轮数>] [--save <结果JSON>] [--commit <提交号>]\n"
+		"各项: kmpSearch, AddrToOff, OffToAddr, FindShIdx, FixDynsym, FixDynstr, FixRel, FixShdrFromDynamic, LoadSegments, ElfBuilder::ApplyOptions,\n"
+		"log:compiled-out, log:runtime-off, log:call-off, log:enabled") << endl;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <QString>
+#include <QList>
+#include <stdint.h>
+#include <functional>
+
+//修复各热点函数的微基准测试, 每个函数单独计时, 用于衡量针对单个函数的优化
+//用法:
+//	SoFix bench [--filter <名称子串>] [--sizes <大小列表, 如64K,1M,16M>] [--min-time <毫秒>] [--repeat <n>] [--save <JSON>] [--commit <提交号>]
+//输入由Corpus按大小生成, 每项输出: 名称, 输入大小, 次数, ns/op, MB/s, 每次操作的分配次数和字节数
+//--repeat把整组测试重复n轮(各项交替执行, 减少机器状态变化的影响), --save按Baseline格式保存每轮的ns/op, 供compare比较
+class Bench
+{
+public:
+	struct Result
+	{
+		QString name;
+		qint64 size;		//输入大小
+		uint64_t ops;		//计时的次数
+		double ns_per_op;
+		double bytes_per_sec;	//每次操作处理bytes_per_op字节, 不适用时为0
+		double allocs_per_op;
+		double alloc_bytes_per_op;
+	};
+
+	Bench() = delete;
+	~Bench() = delete;
+
+	//命令行入口, 返回进程退出码
+	static int Run(int argc, char *argv[]);
+
+	//先执行一次预热, 之后次数成倍增加直到单轮耗时超过min_ms, 按最后一轮计算
+	static Result Measure(const QString &name, qint64 size, qint64 bytes_per_op,
+		const std::function<void()> &op, double min_ms);
+
+private:
+	struct Options
+	{
+		QString filter;
+		QList<qint64> sizes;
+		double min_ms;
+		int repeat;
+		QString save;
+		QString commit;
+	};
+
+	typedef std::function<void(const Result &)> Report;
+
+	//Util::kmpSearch: 在size字节中查找.plt头部特征码(找不到, 扫描全部)
+	static void benchKmp(const Options &opts, qint64 size, const Report &report);
+
+	//ElfFixer的地址转换, 节查找和FixDynsym/FixDynstr/FixRel/FixShdrFromDynamic, ElfReader::LoadSegments, 输入为生成的so
+	static bool benchFixer(const Options &opts, const QString &dir, qint64 size, const Report &report);
+
+	//不同级别开关下逐项日志的开销, 与输入大小无关, 只执行一次
+	static void benchLog(const Options &opts, const Report &report);
+
+	//ElfBuilder::Write中按option修正段数据的部分, 在size字节的内存文件上执行
+	static void benchBuilder(const Options &opts, qint64 size, const Report &report);
+
+	static bool selected(const Options &opts, const QString &name);
+	static bool parseArgs(int argc, char *argv[], Options &opts);
+	static void printUsage();
+};
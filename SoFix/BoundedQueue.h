@@ -0,0 +1,125 @@
+#pragma once
+#include <QElapsedTimer>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+//有界阻塞队列, 流水线各段之间使用: 满时生产者等待, 空时消费者等待
+//同时统计按时间加权的平均深度, 最大深度和两端的等待时间, 用于调整队列深度:
+//平均深度接近容量且生产者等待多, 说明下游是瓶颈; 平均深度接近0且消费者等待多, 说明上游是瓶颈
+template <typename T>
+class BoundedQueue
+{
+public:
+	struct Stats
+	{
+		size_t capacity;
+		double avg_depth;
+		size_t max_depth;
+		double push_wait_ms;	//生产者因队列满等待的累计时间
+		double pop_wait_ms;		//消费者因队列空等待的累计时间
+	};
+
+	explicit BoundedQueue(size_t capacity)
+		: capacity_(capacity ? capacity : 1), closed_(false), last_ns_(0),
+		depth_ns_(0), max_depth_(0), push_wait_ns_(0), pop_wait_ns_(0)
+	{
+		clock_.start();
+	}
+
+	//队列满时等待, 已关闭返回false
+	bool Push(T &&item)
+	{
+		std::unique_lock<std::mutex> guard(lock_);
+		if (items_.size() >= capacity_ && !closed_)
+		{
+			qint64 start = clock_.nsecsElapsed();
+			not_full_.wait(guard, [this]() { return items_.size() < capacity_ || closed_; });
+			push_wait_ns_ += clock_.nsecsElapsed() - start;
+		}
+		if (closed_)
+		{
+			return false;
+		}
+
+		account();
+		items_.push_back(std::move(item));
+		if (items_.size() > max_depth_)
+		{
+			max_depth_ = items_.size();
+		}
+		not_empty_.notify_one();
+		return true;
+	}
+
+	//队列空时等待, 已关闭且取完返回false
+	bool Pop(T &item)
+	{
+		std::unique_lock<std::mutex> guard(lock_);
+		if (items_.empty() && !closed_)
+		{
+			qint64 start = clock_.nsecsElapsed();
+			not_empty_.wait(guard, [this]() { return !items_.empty() || closed_; });
+			pop_wait_ns_ += clock_.nsecsElapsed() - start;
+		}
+		if (items_.empty())
+		{
+			return false;
+		}
+
+		account();
+		item = std::move(items_.front());
+		items_.pop_front();
+		not_full_.notify_one();
+		return true;
+	}
+
+	//不再放入, 队列中剩余的仍可取出
+	void Close()
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		closed_ = true;
+		not_full_.notify_all();
+		not_empty_.notify_all();
+	}
+
+	Stats stats()
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		account();
+		Stats stats;
+		stats.capacity = capacity_;
+		stats.avg_depth = last_ns_ > 0 ? (double)depth_ns_ / last_ns_ : 0;
+		stats.max_depth = max_depth_;
+		stats.push_wait_ms = push_wait_ns_ / 1e6;
+		stats.pop_wait_ms = pop_wait_ns_ / 1e6;
+		return stats;
+	}
+
+private:
+	//累加上次变化以来的深度 * 时间, 调用时持有lock_
+	void account()
+	{
+		qint64 now = clock_.nsecsElapsed();
+		depth_ns_ += (double)items_.size() * (now - last_ns_);
+		last_ns_ = now;
+	}
+
+	BoundedQueue(const BoundedQueue &) = delete;
+	BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+	std::deque<T> items_;
+	size_t capacity_;
+	bool closed_;
+	std::mutex lock_;
+	std::condition_variable not_full_;
+	std::condition_variable not_empty_;
+
+	QElapsedTimer clock_;
+	qint64 last_ns_;		//上次深度变化的时间
+	double depth_ns_;		//深度对时间的积分
+	size_t max_depth_;
+	qint64 push_wait_ns_;
+	qint64 pop_wait_ns_;
+};
@@ -0,0 +1,157 @@
+#include "Budget.h"
+#include "Throughput.h"
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <stdlib.h>
+
+#define QSTR8BIT(s) (QString::fromLocal8Bit(s))
+
+bool Budget::runWithin(Batch::Mode mode, const Batch::Job &job, int budget_ms, bool &ok, QString &error, double &ms)
+{
+	//超时后线程仍在运行, 共享的状态由shared_ptr保持到线程结束
+	struct State
+	{
+		std::mutex lock;
+		std::condition_variable done_cv;
+		bool done;
+		bool ok;
+		QString error;
+	};
+	std::shared_ptr<State> state(new State());
+	state->done = false;
+	state->ok = false;
+
+	QElapsedTimer timer;
+	timer.start();
+	std::thread worker([state, mode, job]() {
+		QString error;
+		bool ok = Batch::RunJob(mode, job, &error);
+		std::lock_guard<std::mutex> guard(state->lock);
+		state->ok = ok;
+		state->error = error;
+		state->done = true;
+		state->done_cv.notify_all();
+	});
+
+	std::unique_lock<std::mutex> guard(state->lock);
+	bool done = state->done_cv.wait_for(guard, std::chrono::milliseconds(budget_ms), [&]() { return state->done; });
+	ms = timer.nsecsElapsed() / 1e6;
+	if (!done)
+	{
+		worker.detach();
+		return false;
+	}
+
+	ok = state->ok;
+	error = state->error;
+	guard.unlock();
+	worker.join();
+	return true;
+}
+
+int Budget::Run(int argc, char *argv[])
+{
+	QTextStream qout(stdout);
+	Options opts;
+	if (!parseArgs(argc, argv, opts))
+	{
+		printUsage();
+		return 2;
+	}
+
+	qout << QString("%1 %2 %3 %4 %5")
+		.arg("mode", -18).arg("file", -40).arg("result", -8).arg("ms", 10).arg("") << endl;
+	for (int m = 0; m < opts.modes.size(); m++)
+	{
+		const QString &mode = opts.modes.at(m);
+		QString list = QDir(opts.dir).filePath(QString("adversarial-%1.lst").arg(mode));
+		std::vector<Batch::Job> jobs;
+		if (!Throughput::LoadList(list, mode, jobs))
+		{
+			qout << QSTR8BIT("无法读取清单: ") + list << endl;
+			return 2;
+		}
+
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			//先输出文件名并刷新, 修复中崩溃时可以看到是哪一项
+			QString name = QFileInfo(jobs[i].dumppath).fileName();
+			qout << QString("%1 %2 ").arg(mode, -18).arg(name, -40) << flush;
+
+			bool ok = false;
+			QString error;
+			double ms = 0;
+			if (!runWithin(Batch::ParseMode(mode), jobs[i], opts.budget_ms, ok, error, ms))
+			{
+				qout << QString("%1 %2 ").arg("-", -8).arg(ms, 10, 'f', 1)
+					<< QSTR8BIT("超时(上限 %1 ms)").arg(opts.budget_ms) << endl;
+				qout.flush();
+				_Exit(1);
+			}
+
+			qout << QString("%1 %2 ").arg(ok ? "fixed" : "rejected", -8).arg(ms, 10, 'f', 1) << error << endl;
+		}
+	}
+
+	qout << QSTR8BIT("全部在 %1 ms 内结束").arg(opts.budget_ms) << endl;
+	return 0;
+}
+
+bool Budget::parseArgs(int argc, char *argv[], Options &opts)
+{
+	opts.modes << "dump" << "dump-from-normal";
+	opts.budget_ms = 2000;
+
+	//argv[1]为"budget"
+	for (int i = 2; i < argc; i++)
+	{
+		QString arg = QSTR8BIT(argv[i]);
+		if (i + 1 >= argc)
+		{
+			return false;
+		}
+
+		QString value = QSTR8BIT(argv[++i]);
+		if (arg == "--dir")
+		{
+			opts.dir = value;
+		}
+		else if (arg == "--budget")
+		{
+			opts.budget_ms = value.toInt();
+		}
+		else if (arg == "--modes")
+		{
+			opts.modes = value.split(',', QString::SkipEmptyParts);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < opts.modes.size(); i++)
+	{
+		Batch::Mode mode = Batch::ParseMode(opts.modes.at(i));
+		if (mode != Batch::MODE_DUMP && mode != Batch::MODE_DUMP_FROM_NORMAL)
+		{
+			return false;
+		}
+	}
+	return !opts.dir.isEmpty() && !opts.modes.isEmpty() && opts.budget_ms > 0;
+}
+
+void Budget::printUsage()
+{
+	QTextStream qout(stdout);
+	qout << QSTR8BIT("用法: SoFix budget --dir <语料目录> [--budget <每项的耗时上限, 毫秒, 默认2000>] [--modes <dump,dump-from-normal>]\n"
+		"语料目录由 SoFix gen --out <目录> --kind adversarial [--size <大小>] 生成") << endl;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "Batch.h"
+#include <QString>
+#include <QStringList>
+
+//耗时上限测试: 逐个修复gen --kind adversarial生成的损坏输入, 每项必须在固定时间内结束, 修复成功或失败都可以
+//用法:
+//	SoFix budget --dir <语料目录> [--budget <毫秒>] [--modes <dump,dump-from-normal>]
+//每种模式读取<dir>/adversarial-<mode>.lst, 每项输出: 文件, 结果, 耗时, 是否超时
+//超时的修复无法中止, 输出后立即以1退出; 修复中崩溃时进程异常退出, 最后一行"..."即为出错的输入
+//退出码: 0全部在时限内结束, 1有超时, 2参数或清单错误
+class Budget
+{
+public:
+	Budget() = delete;
+	~Budget() = delete;
+
+	//命令行入口
+	static int Run(int argc, char *argv[]);
+
+private:
+	struct Options
+	{
+		QString dir;
+		QStringList modes;
+		int budget_ms;
+	};
+
+	//在单独的线程上执行job, 超过budget_ms返回false(线程继续运行), ms为实际耗时或budget_ms
+	static bool runWithin(Batch::Mode mode, const Batch::Job &job, int budget_ms, bool &ok, QString &error, double &ms);
+	static bool parseArgs(int argc, char *argv[], Options &opts);
+	static void printUsage();
+};
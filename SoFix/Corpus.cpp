@@ -0,0 +1,993 @@
+#include "Corpus.h"
+#include "ElfTraits.h"
+#include "Util.h"
+#include <QTextStream>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <string.h>
+#include <vector>
+
+#define QSTR8BIT(s) (QString::fromLocal8Bit(s))
+
+//未定义符号解析到的外部地址(模拟libc等其他库)
+static const uint32_t kExternBase = 0xb6f00000;
+
+//xorshift64*, 只用于生成可复现的内容, 与平台和Qt版本无关
+struct Rng
+{
+	uint64_t state;
+
+	explicit Rng(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+	uint64_t Next()
+	{
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1DULL;
+	}
+
+	uint32_t Below(uint32_t n) { return n ? (uint32_t)(Next() % n) : 0; }
+};
+
+static uint32_t elfHash(const char *name)
+{
+	uint32_t h = 0;
+	while (*name)
+	{
+		h = (h << 4) + (uint8_t)*name++;
+		uint32_t g = h & 0xf0000000;
+		h ^= g;
+		h ^= g >> 24;
+	}
+	return h;
+}
+
+template <typename T>
+static void put(QByteArray &buf, qint64 off, const T &value)
+{
+	memcpy(buf.data() + off, &value, sizeof(T));
+}
+
+//ElfBuilder读取的json中数值均为十六进制字符串
+static QString hex(uint32_t value)
+{
+	return QString::number(value, 16);
+}
+
+static void fillRandom(QByteArray &buf, qint64 off, qint64 size, Rng &rng)
+{
+	for (qint64 i = 0; i + 4 <= size; i += 4)
+	{
+		put<uint32_t>(buf, off + i, (uint32_t)rng.Next());
+	}
+}
+
+//一个节在文件和内存中的位置
+struct Region
+{
+	uint32_t off;
+	uint32_t addr;
+	uint32_t size;
+};
+
+struct Segment
+{
+	uint32_t off;
+	uint32_t vaddr;
+	uint32_t filesz;
+	uint32_t memsz;
+	uint32_t flags;
+};
+
+bool Corpus::Generate(const Options &opts, uint64_t seed, const QString &sopath, const QString &dumppath)
+{
+	Rng rng(seed);
+	const uint32_t nsym = (uint32_t)qMax(opts.symbols, 2);
+	const uint32_t nundef = qMax(1u, (nsym - 1) / 2);
+	const uint32_t ndef = nsym - 1 - nundef;
+	const uint32_t ninit = opts.init_array;
+	const uint32_t nrel = ninit + opts.relative + opts.abs32 + opts.glob_dat;
+	const uint32_t njmp = opts.jump_slot;
+	const uint32_t nbucket = opts.buckets > 0 ? opts.buckets : qMax(1u, nsym / 2);
+	const int extra = qMax(opts.segments, 2) - 2;
+	const uint32_t phnum = qMax(opts.segments, 2) + 2;	//PT_PHDR, PT_LOAD..., PT_DYNAMIC
+	const QString soname = QFileInfo(sopath).fileName();
+
+	//.dynstr: soname, libc.so, 符号名; 指定了大小时用随机字母把名字补长
+	QByteArray dynstr(1, '\0');
+	uint32_t soname_off = dynstr.size();
+	dynstr += soname.toLatin1() + '\0';
+	uint32_t needed_off = dynstr.size();
+	dynstr += QByteArray("libc.so") + '\0';
+	qint64 name_len = opts.strtab > dynstr.size() ? (opts.strtab - dynstr.size()) / (nsym - 1) - 1 : 0;
+	std::vector<uint32_t> name_offs(nsym, 0);
+	for (uint32_t i = 1; i < nsym; i++)
+	{
+		QByteArray name = QString(i <= ndef ? "gen_f%1" : "ext_f%1").arg(i, 5, 10, QChar('0')).toLatin1();
+		if (name.size() < name_len)
+		{
+			name += '_';
+			while (name.size() < name_len)
+			{
+				name += (char)('a' + rng.Below(26));
+			}
+		}
+		name_offs[i] = dynstr.size();
+		dynstr += name + '\0';
+	}
+
+	//代码段依次放: ELF头, 程序头, .dynsym, .dynstr, .hash, .rel.dyn, .rel.plt, .plt, .text
+	uint32_t off = sizeof(Elf32_Ehdr) + phnum * sizeof(Elf32_Phdr);
+	Region dynsym = { off, off, nsym * (uint32_t)sizeof(Elf32_Sym) };
+	off += dynsym.size;
+	Region strtab = { off, off, (uint32_t)dynstr.size() };
+	off = ALIGN(off + strtab.size, 4);
+	Region hash = { off, off, (2 + nbucket + nsym) * 4 };
+	off += hash.size;
+	Region reldyn = { off, off, nrel * (uint32_t)sizeof(Elf32_Rel) };
+	off += reldyn.size;
+	Region relplt = { off, off, njmp * (uint32_t)sizeof(Elf32_Rel) };
+	off += relplt.size;
+	Region plt = { off, off, njmp ? Elf32Class::kPltHeaderSize + Elf32Class::kPltEntrySize * njmp : 0 };
+	off += plt.size;
+
+	//数据段: .dynamic, .got, .init_array, .data(被重定位的字在前), 之后为.bss
+	//.init_array和.data之间留4个0字, 按重定位密度推断时两段不会连在一起
+	const uint32_t ndyn = 16;
+	const uint32_t got_size = (3 + njmp + opts.glob_dat) * 4;
+	const uint32_t data_fixed = (opts.relative + opts.abs32) * 4;
+	const uint32_t init_size = ninit ? ninit * 4 + 16 : 0;
+	qint64 fixed_size = off + ndyn * sizeof(Elf32_Dyn) + got_size + init_size + data_fixed;
+
+	//其余按比例填充: .text 60%, .data 20%, 只读段 20%(没有只读段时归.text)
+	qint64 filler = qMax(opts.size - fixed_size, (qint64)0) & ~3LL;
+	qint64 data_filler = (filler / 5) & ~3LL;
+	qint64 rodata_filler = extra > 0 ? (filler / 5 / extra) & ~3LL : 0;
+	qint64 text_filler = filler - data_filler - rodata_filler * extra;
+	Region text = { off, off, (uint32_t)qMax(text_filler, (qint64)16) };
+	off += text.size;
+
+	std::vector<Segment> segs;
+	Segment code = { 0, 0, off, off, PF_R | PF_X };
+	segs.push_back(code);
+
+	//各段文件偏移连续, 虚拟地址从上一段结束后的页开始, 与文件偏移模页相等
+	std::vector<Region> rodata;
+	for (int i = 0; i < extra; i++)
+	{
+		const Segment &prev = segs.back();
+		Segment seg = { off, PAGE_END(prev.vaddr + prev.memsz) + PAGE_OFFSET(off), (uint32_t)rodata_filler, (uint32_t)rodata_filler, PF_R };
+		Region region = { seg.off, seg.vaddr, seg.filesz };
+		rodata.push_back(region);
+		segs.push_back(seg);
+		off += seg.filesz;
+	}
+
+	const Segment &prev = segs.back();
+	uint32_t data_vaddr = PAGE_END(prev.vaddr + prev.memsz) + PAGE_OFFSET(off);
+	Region dynamic = { off, data_vaddr, ndyn * (uint32_t)sizeof(Elf32_Dyn) };
+	Region got = { dynamic.off + dynamic.size, dynamic.addr + dynamic.size, got_size };
+	Region init_array = { got.off + got.size, got.addr + got.size, ninit * 4 };
+	Region data = { got.off + got.size + init_size, got.addr + got.size + init_size, data_fixed + (uint32_t)data_filler };
+	const uint32_t rw_size = dynamic.size + got.size + init_size + data.size;
+	Segment rw = { off, data_vaddr, rw_size, rw_size + 256, PF_R | PF_W };
+	segs.push_back(rw);
+	off += rw.filesz;
+
+	//节头表放在最后, 不被加载
+	static const char kShstrtab[] = "\0.dynsym\0.dynstr\0.hash\0.rel.dyn\0.rel.plt\0.plt\0.text\0.rodata\0.dynamic\0.got\0.data\0.bss\0.shstrtab\0.init_array\0";
+	Region shstrtab = { off, 0, sizeof(kShstrtab) };
+	off = ALIGN(off + shstrtab.size, 4);
+	std::vector<Elf32_Shdr> shdrs;
+	uint32_t shoff = off;
+
+	QByteArray so(off, '\0');
+	const uint32_t text_index = 7;	//节头中.text的下标, 见下面的添加顺序
+
+	//.dynsym: 定义的函数在.text中, 其余为未定义的外部函数
+	for (uint32_t i = 1; i < nsym; i++)
+	{
+		Elf32_Sym sym;
+		memset(&sym, 0, sizeof(sym));
+		sym.st_name = name_offs[i];
+		if (i <= ndef)
+		{
+			sym.st_value = text.addr + (rng.Below(text.size - 16) & ~3u);
+			sym.st_size = 16;
+			sym.st_shndx = text_index;
+		}
+		sym.st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC);
+		put(so, dynsym.off + i * sizeof(Elf32_Sym), sym);
+	}
+	memcpy(so.data() + strtab.off, dynstr.constData(), dynstr.size());
+
+	//.hash
+	std::vector<uint32_t> bucket(nbucket, 0);
+	std::vector<uint32_t> chain(nsym, 0);
+	for (uint32_t i = 1; i < nsym; i++)
+	{
+		uint32_t h = elfHash(dynstr.constData() + name_offs[i]) % nbucket;
+		chain[i] = bucket[h];
+		bucket[h] = i;
+	}
+	put<uint32_t>(so, hash.off, nbucket);
+	put<uint32_t>(so, hash.off + 4, nsym);
+	memcpy(so.data() + hash.off + 8, &bucket[0], nbucket * 4);
+	memcpy(so.data() + hash.off + 8 + nbucket * 4, &chain[0], nsym * 4);
+
+	//随机的代码和数据先填, 重定位的字和表之后覆盖
+	fillRandom(so, text.off, text.size, rng);
+	for (size_t i = 0; i < rodata.size(); i++)
+	{
+		fillRandom(so, rodata[i].off, rodata[i].size, rng);
+	}
+	fillRandom(so, data.off + data_fixed, data.size - data_fixed, rng);
+
+	//.rel.dyn: .init_array中的函数指针(RELATIVE), RELATIVE(加数为.text中的地址), ABS32(定义的符号), GLOB_DAT(.got中, 外部符号)
+	uint32_t rel_off = reldyn.off;
+	for (uint32_t i = 0; i < ninit; i++, rel_off += sizeof(Elf32_Rel))
+	{
+		Elf32_Rel rel = { init_array.addr + i * 4, ELF32_R_INFO(0, R_ARM_RELATIVE) };
+		put(so, rel_off, rel);
+		put<uint32_t>(so, init_array.off + i * 4, text.addr + (rng.Below(text.size) & ~3u));
+	}
+	for (int i = 0; i < opts.relative; i++, rel_off += sizeof(Elf32_Rel))
+	{
+		Elf32_Rel rel = { data.addr + i * 4, ELF32_R_INFO(0, R_ARM_RELATIVE) };
+		put(so, rel_off, rel);
+		put<uint32_t>(so, data.off + i * 4, text.addr + (rng.Below(text.size) & ~3u));
+	}
+	for (int i = 0; i < opts.abs32; i++, rel_off += sizeof(Elf32_Rel))
+	{
+		uint32_t sym = ndef ? 1 + rng.Below(ndef) : 1 + ndef + rng.Below(nundef);
+		Elf32_Rel rel = { data.addr + (opts.relative + i) * 4, ELF32_R_INFO(sym, R_ARM_ABS32) };
+		put(so, rel_off, rel);
+	}
+	for (int i = 0; i < opts.glob_dat; i++, rel_off += sizeof(Elf32_Rel))
+	{
+		uint32_t sym = 1 + ndef + rng.Below(nundef);
+		Elf32_Rel rel = { got.addr + (3 + njmp + i) * 4, ELF32_R_INFO(sym, R_ARM_GLOB_DAT) };
+		put(so, rel_off, rel);
+	}
+
+	//.rel.plt和.got: JUMP_SLOT在延迟绑定前指向.plt头部
+	for (uint32_t i = 0; i < njmp; i++)
+	{
+		uint32_t sym = 1 + ndef + i % nundef;
+		Elf32_Rel rel = { got.addr + (3 + i) * 4, ELF32_R_INFO(sym, R_ARM_JUMP_SLOT) };
+		put(so, relplt.off + i * sizeof(Elf32_Rel), rel);
+		put<uint32_t>(so, got.off + (3 + i) * 4, plt.addr);
+	}
+
+	//.plt: 头部特征码 + _GLOBAL_OFFSET_TABLE_ - (.plt + 16), 表项为add ip/add ip/ldr pc
+	if (njmp)
+	{
+		size_t code_size = 0;
+		memcpy(so.data() + plt.off, Elf32Class::plt_code(&code_size), code_size);
+		put<uint32_t>(so, plt.off + 16, got.addr - (plt.addr + 16));
+		for (uint32_t i = 0; i < njmp; i++)
+		{
+			uint32_t entry = plt.addr + Elf32Class::kPltHeaderSize + i * Elf32Class::kPltEntrySize;
+			uint32_t disp = got.addr + (3 + i) * 4 - (entry + 8);
+			uint32_t entry_off = plt.off + Elf32Class::kPltHeaderSize + i * Elf32Class::kPltEntrySize;
+			put<uint32_t>(so, entry_off, 0xE28FC600 | ((disp >> 20) & 0xFF));
+			put<uint32_t>(so, entry_off + 4, 0xE28CCA00 | ((disp >> 12) & 0xFF));
+			put<uint32_t>(so, entry_off + 8, 0xE5BCF000 | (disp & 0xFFF));
+		}
+	}
+
+	//.dynamic
+	Elf32_Dyn dyns[ndyn];
+	memset(dyns, 0, sizeof(dyns));
+	int nd = 0;
+	dyns[nd].d_tag = DT_NEEDED; dyns[nd++].d_un.d_val = needed_off;
+	dyns[nd].d_tag = DT_SONAME; dyns[nd++].d_un.d_val = soname_off;
+	dyns[nd].d_tag = DT_HASH; dyns[nd++].d_un.d_ptr = hash.addr;
+	dyns[nd].d_tag = DT_STRTAB; dyns[nd++].d_un.d_ptr = strtab.addr;
+	dyns[nd].d_tag = DT_SYMTAB; dyns[nd++].d_un.d_ptr = dynsym.addr;
+	dyns[nd].d_tag = DT_STRSZ; dyns[nd++].d_un.d_val = strtab.size;
+	dyns[nd].d_tag = DT_SYMENT; dyns[nd++].d_un.d_val = sizeof(Elf32_Sym);
+	if (nrel)
+	{
+		dyns[nd].d_tag = DT_REL; dyns[nd++].d_un.d_ptr = reldyn.addr;
+		dyns[nd].d_tag = DT_RELSZ; dyns[nd++].d_un.d_val = reldyn.size;
+		dyns[nd].d_tag = DT_RELENT; dyns[nd++].d_un.d_val = sizeof(Elf32_Rel);
+	}
+	if (njmp)
+	{
+		dyns[nd].d_tag = DT_PLTREL; dyns[nd++].d_un.d_val = DT_REL;
+		dyns[nd].d_tag = DT_JMPREL; dyns[nd++].d_un.d_ptr = relplt.addr;
+		dyns[nd].d_tag = DT_PLTRELSZ; dyns[nd++].d_un.d_val = relplt.size;
+	}
+	dyns[nd].d_tag = DT_PLTGOT; dyns[nd++].d_un.d_ptr = got.addr;
+	memcpy(so.data() + dynamic.off, dyns, sizeof(dyns));
+
+	//节头
+	struct ShdrDesc
+	{
+		uint32_t name;
+		uint32_t type;
+		uint32_t flags;
+		Region region;
+		uint32_t link;
+		uint32_t align;
+		uint32_t entsize;
+	};
+	Region bss = { rw.off + rw.filesz, rw.vaddr + rw.filesz, rw.memsz - rw.filesz };
+	Region none = { 0, 0, 0 };
+	std::vector<ShdrDesc> descs;
+	ShdrDesc null_desc = { 0, SHT_NULL, 0, none, 0, 0, 0 };
+	ShdrDesc dynsym_desc = { 1, SHT_DYNSYM, SHF_ALLOC, dynsym, 2, 4, sizeof(Elf32_Sym) };
+	ShdrDesc dynstr_desc = { 9, SHT_STRTAB, SHF_ALLOC, strtab, 0, 1, 0 };
+	ShdrDesc hash_desc = { 17, SHT_HASH, SHF_ALLOC, hash, 1, 4, 4 };
+	ShdrDesc reldyn_desc = { 23, SHT_REL, SHF_ALLOC, reldyn, 1, 4, sizeof(Elf32_Rel) };
+	ShdrDesc relplt_desc = { 32, SHT_REL, SHF_ALLOC, relplt, 1, 4, sizeof(Elf32_Rel) };
+	ShdrDesc plt_desc = { 41, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, plt, 0, 4, 0 };
+	ShdrDesc text_desc = { 46, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text, 0, 4, 0 };
+	descs.push_back(null_desc);
+	descs.push_back(dynsym_desc);
+	descs.push_back(dynstr_desc);
+	descs.push_back(hash_desc);
+	descs.push_back(reldyn_desc);
+	descs.push_back(relplt_desc);
+	descs.push_back(plt_desc);
+	descs.push_back(text_desc);
+	for (size_t i = 0; i < rodata.size(); i++)
+	{
+		ShdrDesc desc = { 52, SHT_PROGBITS, SHF_ALLOC, rodata[i], 0, 4, 0 };
+		descs.push_back(desc);
+	}
+	ShdrDesc dynamic_desc = { 60, SHT_DYNAMIC, SHF_ALLOC | SHF_WRITE, dynamic, 2, 4, sizeof(Elf32_Dyn) };
+	ShdrDesc got_desc = { 69, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, got, 0, 4, 0 };
+	ShdrDesc data_desc = { 74, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, data, 0, 4, 0 };
+	ShdrDesc bss_desc = { 80, SHT_NOBITS, SHF_ALLOC | SHF_WRITE, bss, 0, 4, 0 };
+	ShdrDesc shstrtab_desc = { 85, SHT_STRTAB, 0, shstrtab, 0, 1, 0 };
+	descs.push_back(dynamic_desc);
+	descs.push_back(got_desc);
+	if (ninit)
+	{
+		ShdrDesc init_array_desc = { 95, SHT_INIT_ARRAY, SHF_ALLOC | SHF_WRITE, init_array, 0, 4, 4 };
+		descs.push_back(init_array_desc);
+	}
+	descs.push_back(data_desc);
+	descs.push_back(bss_desc);
+	descs.push_back(shstrtab_desc);
+
+	memcpy(so.data() + shstrtab.off, kShstrtab, sizeof(kShstrtab));
+	so.resize(shoff + descs.size() * sizeof(Elf32_Shdr));
+	for (size_t i = 0; i < descs.size(); i++)
+	{
+		Elf32_Shdr shdr;
+		memset(&shdr, 0, sizeof(shdr));
+		shdr.sh_name = descs[i].name;
+		shdr.sh_type = descs[i].type;
+		shdr.sh_flags = descs[i].flags;
+		shdr.sh_addr = descs[i].region.addr;
+		shdr.sh_offset = descs[i].region.off;
+		shdr.sh_size = descs[i].region.size;
+		shdr.sh_link = descs[i].link;
+		shdr.sh_addralign = descs[i].align;
+		shdr.sh_entsize = descs[i].entsize;
+		put(so, shoff + i * sizeof(Elf32_Shdr), shdr);
+	}
+
+	//程序头
+	std::vector<Elf32_Phdr> phdrs;
+	Elf32_Phdr phdr;
+	memset(&phdr, 0, sizeof(phdr));
+	phdr.p_type = PT_PHDR;
+	phdr.p_offset = phdr.p_vaddr = phdr.p_paddr = sizeof(Elf32_Ehdr);
+	phdr.p_filesz = phdr.p_memsz = phnum * sizeof(Elf32_Phdr);
+	phdr.p_flags = PF_R;
+	phdr.p_align = 4;
+	phdrs.push_back(phdr);
+	for (size_t i = 0; i < segs.size(); i++)
+	{
+		phdr.p_type = PT_LOAD;
+		phdr.p_offset = segs[i].off;
+		phdr.p_vaddr = phdr.p_paddr = segs[i].vaddr;
+		phdr.p_filesz = segs[i].filesz;
+		phdr.p_memsz = segs[i].memsz;
+		phdr.p_flags = segs[i].flags;
+		phdr.p_align = PAGE_SIZE;
+		phdrs.push_back(phdr);
+	}
+	phdr.p_type = PT_DYNAMIC;
+	phdr.p_offset = dynamic.off;
+	phdr.p_vaddr = phdr.p_paddr = dynamic.addr;
+	phdr.p_filesz = phdr.p_memsz = dynamic.size;
+	phdr.p_flags = PF_R | PF_W;
+	phdr.p_align = 4;
+	phdrs.push_back(phdr);
+	memcpy(so.data() + sizeof(Elf32_Ehdr), &phdrs[0], phdrs.size() * sizeof(Elf32_Phdr));
+
+	//ELF头
+	Elf32_Ehdr ehdr;
+	memset(&ehdr, 0, sizeof(ehdr));
+	memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+	ehdr.e_ident[EI_CLASS] = ELFCLASS32;
+	ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+	ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+	ehdr.e_type = ET_DYN;
+	ehdr.e_machine = EM_ARM;
+	ehdr.e_version = EV_CURRENT;
+	ehdr.e_phoff = sizeof(Elf32_Ehdr);
+	ehdr.e_shoff = shoff;
+	ehdr.e_flags = Elf32Class::kEFlags;
+	ehdr.e_ehsize = sizeof(Elf32_Ehdr);
+	ehdr.e_phentsize = sizeof(Elf32_Phdr);
+	ehdr.e_phnum = phnum;
+	ehdr.e_shentsize = sizeof(Elf32_Shdr);
+	ehdr.e_shnum = descs.size();
+	ehdr.e_shstrndx = descs.size() - 1;
+	put(so, 0, ehdr);
+
+	QFile sofile(sopath);
+	if (!sofile.open(QIODevice::WriteOnly | QIODevice::Truncate) || sofile.write(so) != so.size())
+	{
+		return false;
+	}
+	sofile.close();
+
+	//dump: 与linker一样按页映射各段, 只读段映射到页尾, 可写段文件之外的部分为0, 之后完成重定位
+	QByteArray image(PAGE_END(rw.vaddr + rw.memsz), '\0');
+	for (size_t i = 0; i < segs.size(); i++)
+	{
+		uint32_t file_end = segs[i].off + segs[i].filesz;
+		if ((segs[i].flags & PF_W) == 0)
+		{
+			file_end = qMin((uint32_t)PAGE_END(file_end), (uint32_t)so.size());
+		}
+		memcpy(image.data() + PAGE_START(segs[i].vaddr), so.constData() + PAGE_START(segs[i].off), file_end - PAGE_START(segs[i].off));
+	}
+
+	auto resolve = [&](uint32_t sym) -> uint32_t {
+		if (sym <= ndef)
+		{
+			const Elf32_Sym *s = reinterpret_cast<const Elf32_Sym *>(so.constData() + dynsym.off) + sym;
+			return s->st_value + opts.bias;
+		}
+		return kExternBase + sym * 16;
+	};
+	for (uint32_t i = 0; i < nrel + njmp; i++)
+	{
+		const Elf32_Rel *rel = i < nrel ?
+			reinterpret_cast<const Elf32_Rel *>(so.constData() + reldyn.off) + i :
+			reinterpret_cast<const Elf32_Rel *>(so.constData() + relplt.off) + (i - nrel);
+		uint32_t stored = *reinterpret_cast<const uint32_t *>(image.constData() + rel->r_offset);
+		switch (ELF32_R_TYPE(rel->r_info))
+		{
+		case R_ARM_RELATIVE:
+			put<uint32_t>(image, rel->r_offset, stored + opts.bias);
+			break;
+		case R_ARM_ABS32:
+			put<uint32_t>(image, rel->r_offset, stored + resolve(ELF32_R_SYM(rel->r_info)));
+			break;
+		default:
+			put<uint32_t>(image, rel->r_offset, resolve(ELF32_R_SYM(rel->r_info)));
+			break;
+		}
+	}
+
+	//内存中的ELF头指向的节头没有被加载, 模拟dump工具把它清空
+	ehdr.e_shoff = 0;
+	ehdr.e_shnum = 0;
+	ehdr.e_shstrndx = 0;
+	put(image, 0, ehdr);
+
+	QFile dumpfile(dumppath);
+	if (!dumpfile.open(QIODevice::WriteOnly | QIODevice::Truncate) || dumpfile.write(image) != image.size())
+	{
+		return false;
+	}
+	dumpfile.close();
+
+	//rebuild: 各PT_LOAD的段数据取自镜像, 范围与ElfBuilder::Write写入的[PAGE_START(p_offset), PAGE_END(p_offset + p_filesz))相同
+	QJsonArray phdr_array;
+	for (size_t i = 0; i < segs.size(); i++)
+	{
+		QString rawpath = QString("%1.seg%2").arg(sopath).arg((int)i);
+		uint32_t raw_size = PAGE_END(segs[i].off + segs[i].filesz) - PAGE_START(segs[i].off);
+		QFile rawfile(rawpath);
+		if (!rawfile.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+			rawfile.write(image.constData() + PAGE_START(segs[i].vaddr), raw_size) != raw_size)
+		{
+			return false;
+		}
+
+		QJsonObject obj;
+		obj.insert("p_type", hex(PT_LOAD));
+		obj.insert("p_offset", hex(segs[i].off));
+		obj.insert("p_vaddr", hex(segs[i].vaddr + opts.bias));
+		obj.insert("p_paddr", hex(segs[i].vaddr + opts.bias));
+		obj.insert("p_filesz", hex(segs[i].filesz));
+		obj.insert("p_memsz", hex(segs[i].memsz));
+		obj.insert("p_flags", hex(segs[i].flags));
+		obj.insert("p_align", hex(PAGE_SIZE));
+		obj.insert("raw_file", rawpath);
+		phdr_array.append(obj);
+	}
+
+	QJsonObject dyn_obj;
+	dyn_obj.insert("DT_HASH", hex(hash.addr + opts.bias));
+	dyn_obj.insert("DT_STRTAB", hex(strtab.addr + opts.bias));
+	dyn_obj.insert("DT_STRSZ", hex(strtab.size));
+	dyn_obj.insert("DT_SYMTAB", hex(dynsym.addr + opts.bias));
+	if (nrel)
+	{
+		dyn_obj.insert("DT_REL", hex(reldyn.addr + opts.bias));
+		dyn_obj.insert("DT_RELSZ", hex(reldyn.size));
+	}
+	if (njmp)
+	{
+		dyn_obj.insert("DT_JMPREL", hex(relplt.addr + opts.bias));
+		dyn_obj.insert("DT_PLTRELSZ", hex(relplt.size));
+	}
+	QJsonArray needed;
+	needed.append(hex(strtab.addr + needed_off + opts.bias));
+	dyn_obj.insert("DT_NEEDED", needed);
+
+	//重定位目标都在数据段, addr_to_off为其文件偏移与虚拟地址之差;
+	//bias按32位回绕加上-load_bias, 写成正数避免超出int
+	QString addr_to_off = QString("-%1").arg(rw.vaddr - rw.off, 0, 16);
+	QJsonObject rel_obj;
+	rel_obj.insert("offset", hex(reldyn.off));
+	rel_obj.insert("count", hex(nrel));
+	rel_obj.insert("bias", hex(0u - opts.bias));
+	rel_obj.insert("addr_to_off", addr_to_off);
+	QJsonObject rel_plt_obj;
+	rel_plt_obj.insert("offset", hex(relplt.off));
+	rel_plt_obj.insert("count", hex(njmp));
+	rel_plt_obj.insert("bias", hex(0));
+	rel_plt_obj.insert("addr_to_off", addr_to_off);
+
+	QJsonObject root;
+	root.insert("file name", sopath + ".rebuilt");
+	root.insert("load_bias", hex(opts.bias));
+	root.insert("program headers", phdr_array);
+	root.insert("dynamic section", dyn_obj);
+	root.insert("options", QJsonArray());
+	root.insert("rel_option", rel_obj);
+	root.insert("rel_plt_option", rel_plt_obj);
+
+	QFile jsonfile(sopath + ".json");
+	QByteArray json = QJsonDocument(root).toJson();
+	return jsonfile.open(QIODevice::WriteOnly | QIODevice::Truncate) && jsonfile.write(json) == json.size();
+}
+
+QStringList Corpus::AdversarialKinds()
+{
+	QStringList kinds;
+	kinds << "hash-cycle"			//.hash的chain成环
+		<< "hash-index"				//bucket中的符号索引远超nchain和.dynsym
+		<< "hash-size"				//nbucket, nchain使表远超镜像
+		<< "dynamic-unterminated"	//.dynamic到镜像末尾都没有DT_NULL
+		<< "dynamic-memsz"			//同上, 且PT_DYNAMIC的p_memsz远超镜像
+		<< "relsz"					//DT_RELSZ, DT_PLTRELSZ远超所在的段
+		<< "reloc-symbol"			//重定位引用的符号索引越界
+		<< "strtab-unterminated"	//DT_STRTAB指向镜像末尾, 字符串没有结尾
+		<< "plt-missing"			//没有.plt特征码, 搜索整个可执行段
+		<< "load-filesz";			//可写PT_LOAD的p_filesz远大于p_memsz, 按文件大小拷贝会写出镜像
+	return kinds;
+}
+
+bool Corpus::Corrupt(const QString &kind, QByteArray &image)
+{
+	//镜像从虚拟地址0开始, 虚拟地址即为偏移
+	const qint64 size = image.size();
+	if (size < (qint64)sizeof(Elf32_Ehdr))
+	{
+		return false;
+	}
+
+	const Elf32_Ehdr *ehdr = reinterpret_cast<const Elf32_Ehdr *>(image.constData());
+	Elf32_Phdr *dyn_phdr = nullptr;
+	Elf32_Phdr *rw_phdr = nullptr;
+	for (int i = 0; i < ehdr->e_phnum; i++)
+	{
+		Elf32_Phdr *phdr = reinterpret_cast<Elf32_Phdr *>(image.data() + ehdr->e_phoff) + i;
+		if (phdr->p_type == PT_DYNAMIC)
+		{
+			dyn_phdr = phdr;
+		}
+		else if (phdr->p_type == PT_LOAD && (phdr->p_flags & PF_W))
+		{
+			rw_phdr = phdr;
+		}
+	}
+	if (dyn_phdr == nullptr)
+	{
+		return false;
+	}
+
+	Elf32_Dyn *dyns = reinterpret_cast<Elf32_Dyn *>(image.data() + dyn_phdr->p_vaddr);
+	const size_t ndyn = dyn_phdr->p_memsz / sizeof(Elf32_Dyn);
+	auto dyn = [&](Elf32_Sword tag) -> Elf32_Dyn * {
+		for (size_t i = 0; i < ndyn && dyns[i].d_tag != DT_NULL; i++)
+		{
+			if (dyns[i].d_tag == tag)
+			{
+				return &dyns[i];
+			}
+		}
+		return nullptr;
+	};
+
+	Elf32_Dyn *hash = dyn(DT_HASH);
+	uint32_t *table = hash ? reinterpret_cast<uint32_t *>(image.data() + hash->d_un.d_ptr) : nullptr;
+	if (table == nullptr)
+	{
+		return false;
+	}
+	uint32_t *bucket = table + 2;
+	uint32_t *chain = bucket + table[0];
+
+	if (kind == "hash-cycle")
+	{
+		for (uint32_t i = 1; i < table[1]; i++)
+		{
+			chain[i] = i;
+		}
+	}
+	else if (kind == "hash-index")
+	{
+		for (uint32_t i = 0; i < table[0]; i++)
+		{
+			bucket[i] = 0x7fffffff - i;
+		}
+	}
+	else if (kind == "hash-size")
+	{
+		table[0] = 0x40000000;
+		table[1] = 0x40000000;
+	}
+	else if (kind == "dynamic-unterminated" || kind == "dynamic-memsz")
+	{
+		//.dynamic之后的.got, .data也一起覆盖, 直到镜像末尾
+		for (qint64 off = dyn_phdr->p_vaddr; off + (qint64)sizeof(Elf32_Dyn) <= size; off += sizeof(Elf32_Dyn))
+		{
+			Elf32_Dyn *d = reinterpret_cast<Elf32_Dyn *>(image.data() + off);
+			if (d->d_tag == DT_NULL || off >= dyn_phdr->p_vaddr + dyn_phdr->p_memsz)
+			{
+				d->d_tag = DT_DEBUG;
+				d->d_un.d_val = 0;
+			}
+		}
+		if (kind == "dynamic-memsz")
+		{
+			dyn_phdr->p_memsz = 0xfffffff0;
+		}
+	}
+	else if (kind == "relsz")
+	{
+		Elf32_Dyn *relsz = dyn(DT_RELSZ);
+		Elf32_Dyn *pltrelsz = dyn(DT_PLTRELSZ);
+		if (relsz == nullptr || pltrelsz == nullptr)
+		{
+			return false;
+		}
+		relsz->d_un.d_val = 0xfffffff8;
+		pltrelsz->d_un.d_val = 0xfffffff8;
+	}
+	else if (kind == "reloc-symbol")
+	{
+		Elf32_Dyn *rel = dyn(DT_REL);
+		Elf32_Dyn *relsz = dyn(DT_RELSZ);
+		if (rel == nullptr || relsz == nullptr)
+		{
+			return false;
+		}
+		Elf32_Rel *rels = reinterpret_cast<Elf32_Rel *>(image.data() + rel->d_un.d_ptr);
+		for (uint32_t i = 0; i < relsz->d_un.d_val / sizeof(Elf32_Rel); i++)
+		{
+			rels[i].r_info = ELF32_R_INFO(0xffffff - i % 256, R_ARM_ABS32);
+		}
+	}
+	else if (kind == "strtab-unterminated")
+	{
+		Elf32_Dyn *strtab = dyn(DT_STRTAB);
+		if (strtab == nullptr || size < 64)
+		{
+			return false;
+		}
+		strtab->d_un.d_ptr = (Elf32_Addr)(size - 64);
+		memset(image.data() + size - 64, 'A', 64);
+	}
+	else if (kind == "plt-missing")
+	{
+		size_t code_size = 0;
+		const char *code = Elf32Class::plt_code(&code_size);
+		int off = image.indexOf(QByteArray(code, (int)code_size));
+		if (off == -1)
+		{
+			return false;
+		}
+		memset(image.data() + off, 0, code_size);
+	}
+	else if (kind == "load-filesz")
+	{
+		if (rw_phdr == nullptr)
+		{
+			return false;
+		}
+		rw_phdr->p_filesz = rw_phdr->p_memsz + 0x100000;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+int Corpus::runAdversarial(const Options &opts)
+{
+	QTextStream qout(stdout);
+	QDir dir(opts.out);
+	QString sopath = dir.absoluteFilePath("libadv.so");
+	QString dumppath = sopath + ".dump";
+	if (!Generate(opts, opts.seed, sopath, dumppath))
+	{
+		qout << QSTR8BIT("生成失败: ") + sopath << endl;
+		return 1;
+	}
+
+	QFile dumpfile(dumppath);
+	QFile dump_list(dir.filePath("adversarial-dump.lst"));
+	QFile from_normal_list(dir.filePath("adversarial-dump-from-normal.lst"));
+	if (!dumpfile.open(QIODevice::ReadOnly) ||
+		!dump_list.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+		!from_normal_list.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		qout << QSTR8BIT("无法写入清单: ") + opts.out << endl;
+		return 2;
+	}
+	const QByteArray image = dumpfile.readAll();
+
+	QTextStream dump_out(&dump_list);
+	QTextStream from_normal_out(&from_normal_list);
+	QString bias = QString::number(opts.bias, 16);
+	QStringList kinds = AdversarialKinds();
+	for (int i = 0; i < kinds.size(); i++)
+	{
+		QByteArray corrupt = image;
+		QString path = dir.absoluteFilePath(QString("libadv-%1.so.dump").arg(kinds.at(i)));
+		QFile file(path);
+		if (!Corrupt(kinds.at(i), corrupt) ||
+			!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(corrupt) != corrupt.size())
+		{
+			qout << QSTR8BIT("生成失败: ") + path << endl;
+			return 1;
+		}
+
+		dump_out << path << "\t" << bias << "\n";
+		from_normal_out << sopath << "\t" << path << "\n";
+	}
+
+	qout << QSTR8BIT("已生成 %1 个对抗性输入: %2").arg(kinds.size()).arg(opts.out) << endl;
+	return 0;
+}
+
+int Corpus::Run(int argc, char *argv[])
+{
+	QTextStream qout(stdout);
+	Options opts;
+	if (!parseArgs(argc, argv, opts))
+	{
+		printUsage();
+		return 2;
+	}
+	if (!QDir().mkpath(opts.out))
+	{
+		qout << QSTR8BIT("无法创建输出目录: ") + opts.out << endl;
+		return 2;
+	}
+	if (opts.adversarial)
+	{
+		return runAdversarial(opts);
+	}
+
+	QFile normal(QDir(opts.out).filePath("normal.lst"));
+	QFile from_normal(QDir(opts.out).filePath("dump-from-normal.lst"));
+	QFile dump(QDir(opts.out).filePath("dump.lst"));
+	QFile rebuild(QDir(opts.out).filePath("rebuild.lst"));
+	if (!normal.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+		!from_normal.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+		!dump.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+		!rebuild.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		qout << QSTR8BIT("无法写入清单: ") + opts.out << endl;
+		return 2;
+	}
+
+	QTextStream normal_out(&normal);
+	QTextStream from_normal_out(&from_normal);
+	QTextStream dump_out(&dump);
+	QTextStream rebuild_out(&rebuild);
+	QString bias = QString::number(opts.bias, 16);
+	for (int i = 0; i < opts.count; i++)
+	{
+		QString sopath = QDir(opts.out).absoluteFilePath(QString("libgen%1.so").arg(i));
+		QString dumppath = sopath + ".dump";
+		if (!Generate(opts, opts.seed + i, sopath, dumppath))
+		{
+			qout << QSTR8BIT("生成失败: ") + sopath << endl;
+			return 1;
+		}
+
+		normal_out << sopath << "\n";
+		from_normal_out << sopath << "\t" << dumppath << "\n";
+		dump_out << dumppath << "\t" << bias << "\n";
+		rebuild_out << sopath << ".json\n";
+	}
+
+	qout << QSTR8BIT("已生成 %1 个库: %2").arg(opts.count).arg(opts.out) << endl;
+	return 0;
+}
+
+qint64 Corpus::ParseSize(const QString &value)
+{
+	QString number = value.trimmed().toUpper();
+	qint64 unit = 1;
+	if (number.endsWith("K"))
+	{
+		unit = 1024;
+	}
+	else if (number.endsWith("M"))
+	{
+		unit = 1024 * 1024;
+	}
+	if (unit != 1)
+	{
+		number.chop(1);
+	}
+
+	bool ok = false;
+	qint64 size = number.toLongLong(&ok);
+	return ok && size >= 0 ? size * unit : -1;
+}
+
+bool Corpus::parseRelocs(const QString &value, Options &opts)
+{
+	QStringList items = value.split(',');
+	for (int i = 0; i < items.size(); i++)
+	{
+		QString key = items.at(i).section('=', 0, 0);
+		bool ok = false;
+		int count = items.at(i).section('=', 1, 1).toInt(&ok);
+		if (!ok || count < 0)
+		{
+			return false;
+		}
+
+		if (key == "relative")
+		{
+			opts.relative = count;
+		}
+		else if (key == "abs32")
+		{
+			opts.abs32 = count;
+		}
+		else if (key == "glob-dat")
+		{
+			opts.glob_dat = count;
+		}
+		else if (key == "jump-slot")
+		{
+			opts.jump_slot = count;
+		}
+		else if (key == "init-array")
+		{
+			opts.init_array = count;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Corpus::parseArgs(int argc, char *argv[], Options &opts)
+{
+	opts.count = 1;
+	opts.seed = 1;
+	opts.segments = 2;
+	opts.symbols = 256;
+	opts.relative = 512;
+	opts.abs32 = 64;
+	opts.glob_dat = 32;
+	opts.jump_slot = 64;
+	opts.init_array = 16;
+	opts.buckets = 0;
+	opts.strtab = 0;
+	opts.size = 64 * 1024;
+	opts.bias = 0xa0000000;
+	opts.adversarial = false;
+
+	//argv[1]为"gen"
+	for (int i = 2; i < argc; i++)
+	{
+		QString arg = QSTR8BIT(argv[i]);
+		if (i + 1 >= argc)
+		{
+			return false;
+		}
+
+		QString value = QSTR8BIT(argv[++i]);
+		if (arg == "--out")
+		{
+			opts.out = value;
+		}
+		else if (arg == "--count")
+		{
+			opts.count = value.toInt();
+		}
+		else if (arg == "--seed")
+		{
+			opts.seed = value.toULongLong();
+		}
+		else if (arg == "--segments")
+		{
+			opts.segments = value.toInt();
+		}
+		else if (arg == "--symbols")
+		{
+			opts.symbols = value.toInt();
+		}
+		else if (arg == "--relocs")
+		{
+			if (!parseRelocs(value, opts))
+			{
+				return false;
+			}
+		}
+		else if (arg == "--buckets")
+		{
+			opts.buckets = value.toInt();
+		}
+		else if (arg == "--strtab")
+		{
+			opts.strtab = ParseSize(value);
+		}
+		else if (arg == "--size")
+		{
+			opts.size = ParseSize(value);
+		}
+		else if (arg == "--bias")
+		{
+			opts.bias = value.toUInt(nullptr, 16);
+		}
+		else if (arg == "--kind")
+		{
+			if (value != "normal" && value != "adversarial")
+			{
+				return false;
+			}
+			opts.adversarial = value == "adversarial";
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	//load_bias必须按页对齐, 镜像不超过32位地址空间
+	return !opts.out.isEmpty() && opts.count > 0 && opts.segments >= 2 && opts.symbols >= 2 &&
+		opts.buckets >= 0 && opts.strtab >= 0 && opts.size >= 0 && opts.size <= 1024LL * 1024 * 1024 &&
+		PAGE_OFFSET(opts.bias) == 0;
+}
+
+void Corpus::printUsage()
+{
+	QTextStream qout(stdout);
+	qout << QSTR8BIT("用法: SoFix gen --out <输出目录> [--count <个数>] [--seed <种子>] [--segments <PT_LOAD个数>] [--symbols <符号数>]\n"
+		"      [--relocs relative=<n>,abs32=<n>,glob-dat=<n>,jump-slot=<n>,init-array=<n>] [--buckets <nbucket>] [--strtab <字节>]\n"
+		"      [--size <字节, 可带K/M>] [--bias <load_bias>] [--kind <normal|adversarial>]\n"
+		"--kind adversarial生成针对各处遍历的损坏dump: ") + AdversarialKinds().join(", ") << endl;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <stdint.h>
+
+//合成测试语料: 生成有效的ELF32 ARM共享库(已strip)以及对应的模拟dump, 用于在任意规模上对各阶段做基准测试
+//用法:
+//	SoFix gen --out <dir> [--count <n>] [--seed <n>] [--segments <n>] [--symbols <n>]
+//		[--relocs relative=<n>,abs32=<n>,glob-dat=<n>,jump-slot=<n>] [--buckets <n>] [--strtab <字节>]
+//		[--size <字节, 可带K/M后缀>] [--bias <load_bias>] [--kind <normal|adversarial>]
+//每个库输出<dir>/libgen<i>.so和<dir>/libgen<i>.so.dump, rebuild用的libgen<i>.so.json和段数据libgen<i>.so.seg<k>,
+//以及四种模式的batch清单: normal.lst, dump-from-normal.lst, dump.lst, rebuild.lst
+//dump为按load_bias加载并完成重定位后的内存镜像: RELATIVE加上load_bias, 符号重定位填入解析后的地址,
+//ELF头中的节头信息被清空; 相同的参数和种子生成逐字节相同的文件
+//--kind adversarial: 生成一个库后按AdversarialKinds逐项篡改其dump(链表成环, nbucket越界, .dynamic没有DT_NULL等),
+//输出<dir>/libadv-<种类>.so.dump以及清单adversarial-dump.lst, adversarial-dump-from-normal.lst, 供SoFix budget检查耗时上限
+class Corpus
+{
+public:
+	struct Options
+	{
+		QString out;
+		int count;
+		uint64_t seed;
+		int segments;			//PT_LOAD个数, 至少2(代码段和数据段), 其余为只读数据段
+		int symbols;			//.dynsym项数(含第0项)
+		int relative;			//各类型的重定位个数
+		int abs32;
+		int glob_dat;
+		int jump_slot;
+		int init_array;			//.init_array项数(RELATIVE, 不生成DT_INIT_ARRAY, 修复时须推断)
+		int buckets;			//.hash的nbucket, 0表示symbols / 2
+		qint64 strtab;			//.dynstr的大小, 0表示按符号名实际长度
+		qint64 size;			//文件大小, 不足的部分用随机的代码和数据填充
+		uint32_t bias;			//dump时的load_bias
+		bool adversarial;		//--kind adversarial
+	};
+
+	Corpus() = delete;
+	~Corpus() = delete;
+
+	//命令行入口, 返回进程退出码
+	static int Run(int argc, char *argv[]);
+
+	//生成一个库写到sopath, 模拟dump写到dumppath, rebuild的json写到sopath.json, 失败返回false
+	static bool Generate(const Options &opts, uint64_t seed, const QString &sopath, const QString &dumppath);
+
+	//解析字节数, 可带K/M后缀, 失败返回-1
+	static qint64 ParseSize(const QString &value);
+
+	//对抗性输入的种类, 每种针对修复中的一处遍历
+	static QStringList AdversarialKinds();
+
+	//按kind篡改Generate生成的dump(32位, 镜像从虚拟地址0开始), 未知的种类返回false
+	static bool Corrupt(const QString &kind, QByteArray &image);
+
+private:
+	//生成对抗性语料和清单, 返回进程退出码
+	static int runAdversarial(const Options &opts);
+	static bool parseArgs(int argc, char *argv[], Options &opts);
+	static bool parseRelocs(const QString &value, Options &opts);
+	static void printUsage();
+};
@@ -0,0 +1,100 @@
+#include "CountingDevice.h"
+#include "JobLog.h"
+#include <QFile>
+#include <QElapsedTimer>
+
+CountingDevice::CountingDevice(QIODevice *inner, JobLog *log, const QString &name)
+	: inner_(inner), log_(log), name_(name), file_(nullptr)
+{
+}
+
+CountingDevice::~CountingDevice()
+{
+	if (isOpen())
+	{
+		close();
+	}
+}
+
+bool CountingDevice::open(OpenMode mode)
+{
+	if (!inner_->isOpen() && !inner_->open(mode))
+	{
+		return false;
+	}
+
+	//不使用QIODevice自己的缓冲, read/write直接到readData/writeData, 次数与调用方一致
+	QIODevice::open(mode | QIODevice::Unbuffered);
+	file_ = nullptr;
+	if (PhaseStats *stats = log_->stats())
+	{
+		QString name = name_;
+		if (name.isEmpty())
+		{
+			QFile *file = dynamic_cast<QFile *>(inner_);
+			name = file != nullptr ? file->fileName() : QString("(memory)");
+		}
+		file_ = stats->File(name);
+		file_->size = qMax(file_->size, inner_->size());
+	}
+	return true;
+}
+
+void CountingDevice::close()
+{
+	QIODevice::close();
+	inner_->close();
+	file_ = nullptr;
+}
+
+bool CountingDevice::seek(qint64 pos)
+{
+	PhaseStats *stats = file_ != nullptr ? log_->stats() : nullptr;
+	if (stats == nullptr)
+	{
+		return QIODevice::seek(pos) && inner_->seek(pos);
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	bool ok = QIODevice::seek(pos) && inner_->seek(pos);
+	stats->AddIo(file_, PhaseStats::IO_SEEK, 0, timer.nsecsElapsed());
+	return ok;
+}
+
+qint64 CountingDevice::size() const
+{
+	return inner_->size();
+}
+
+qint64 CountingDevice::readData(char *data, qint64 maxlen)
+{
+	PhaseStats *stats = file_ != nullptr ? log_->stats() : nullptr;
+	if (stats == nullptr)
+	{
+		return inner_->read(data, maxlen);
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	qint64 rc = inner_->read(data, maxlen);
+	stats->AddIo(file_, PhaseStats::IO_READ, qMax(rc, (qint64)0), timer.nsecsElapsed());
+	return rc;
+}
+
+qint64 CountingDevice::writeData(const char *data, qint64 len)
+{
+	PhaseStats *stats = file_ != nullptr ? log_->stats() : nullptr;
+	if (stats == nullptr)
+	{
+		return inner_->write(data, len);
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	qint64 rc = inner_->write(data, len);
+	stats->AddIo(file_, PhaseStats::IO_WRITE, qMax(rc, (qint64)0), timer.nsecsElapsed());
+	//写到的最远位置, 不必每次查询文件大小
+	file_->size = qMax(file_->size, inner_->pos());
+	return rc;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <QIODevice>
+#include <QString>
+#include "PhaseStats.h"
+
+class JobLog;
+
+//包装一个QIODevice, 经过它的seek/read/write的次数, 字节数和耗时记到JobLog的PhaseStats(当前阶段和该文件)
+//统计未启用时直接转发, 不计时; 本身不缓冲, 每次调用对应被包装设备的一次调用
+class CountingDevice : public QIODevice
+{
+public:
+	//name为空时打开时取被包装的QFile的文件名
+	CountingDevice(QIODevice *inner, JobLog *log, const QString &name = QString());
+	~CountingDevice();
+
+	//同时打开被包装的设备; 已打开的设备直接使用
+	virtual bool open(OpenMode mode);
+	virtual void close();
+	virtual bool seek(qint64 pos);
+	virtual qint64 size() const;
+	virtual bool isSequential() const { return false; }
+
+protected:
+	virtual qint64 readData(char *data, qint64 maxlen);
+	virtual qint64 writeData(const char *data, qint64 len);
+
+private:
+	CountingDevice(const CountingDevice &) = delete;
+	CountingDevice &operator=(const CountingDevice &) = delete;
+
+	QIODevice *inner_;
+	JobLog *log_;
+	QString name_;
+	PhaseStats::FileIo *file_;	//打开时取得, 统计未启用时为nullptr
+};
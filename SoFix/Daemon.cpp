@@ -0,0 +1,286 @@
+#include "Daemon.h"
+#include "LocalSocket.h"
+#include <QTextStream>
+#include <QStringList>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define QSTR8BIT(s) (QString::fromLocal8Bit(s))
+
+//一个客户端连接, 由连接线程和该连接上未完成的请求共同持有
+struct Daemon::Connection
+{
+	LocalSocket sock;
+	std::mutex lock;				//保护写入和pending
+	std::condition_variable done;
+	size_t pending;					//已提交未应答的请求数
+
+	Connection() : pending(0) {}
+};
+
+Daemon::Daemon(int jobs, const QString &cache)
+	: pool_(jobs), result_cache_(cache), started_ms_(QDateTime::currentMSecsSinceEpoch()),
+	served_(0), failed_(0), busy_ns_(0), connections_(0)
+{
+}
+
+int Daemon::Run(int argc, char *argv[])
+{
+	QTextStream qout(stdout);
+	QString path;
+	int jobs = 0;
+	QString cache;
+	QStringList rest;
+
+	if (!parseArgs(argc, argv, path, jobs, cache, rest) || !rest.isEmpty())
+	{
+		printUsage();
+		return 2;
+	}
+
+	LocalSocket server;
+	if (!server.Listen(path))
+	{
+		qout << QSTR8BIT("无法监听套接字: ") + path << endl;
+		return 1;
+	}
+
+	//连接线程是detach的, 服务对象在进程结束前不释放
+	Daemon *daemon = new Daemon(jobs, cache);
+	if (!cache.isEmpty() && !daemon->result_cache_.valid())
+	{
+		qout << QSTR8BIT("无法创建结果缓存目录: ") + cache << endl;
+		return 2;
+	}
+	qout << QSTR8BIT("监听 %1, 线程 %2").arg(path).arg(daemon->pool_.thread_count()) << endl;
+
+	while (true)
+	{
+		std::shared_ptr<Connection> conn(new Connection);
+		if (!server.Accept(conn->sock))
+		{
+			qout << QSTR8BIT("accept失败, 退出") << endl;
+			return 1;
+		}
+
+		//连接线程只负责读取请求, 修复在线程池上执行
+		std::thread(&Daemon::serve, daemon, conn).detach();
+	}
+}
+
+void Daemon::serve(std::shared_ptr<Connection> conn)
+{
+	QByteArray line;
+	qint64 seq = 0;
+
+	connections_++;
+	while (conn->sock.ReadLine(line))
+	{
+		QStringList fields = QString::fromLocal8Bit(line).trimmed().split('\t', QString::SkipEmptyParts);
+		qint64 cur = seq++;
+		if (fields.isEmpty())
+		{
+			continue;
+		}
+
+		if (fields.at(0) == "stats")
+		{
+			reply(*conn, QByteArray::number(cur) + "\tSTATS\t" + stats());
+			continue;
+		}
+
+		Batch::Mode mode = Batch::ParseMode(fields.takeFirst());
+		Batch::Job job;
+		if (!Batch::ParseJob(mode, fields, QString(), 0, job))
+		{
+			reply(*conn, QByteArray::number(cur) + "\tFAIL\t0 ms\t\t" + QSTR8BIT("无效请求").toLocal8Bit());
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(conn->lock);
+			conn->pending++;
+		}
+		pool_.Submit([this, conn, cur, mode, job]() {
+			runRequest(conn, cur, mode, job);
+		});
+	}
+
+	//客户端不再发送请求, 等该连接上的请求全部应答后再关闭
+	std::unique_lock<std::mutex> guard(conn->lock);
+	conn->done.wait(guard, [&conn] { return conn->pending == 0; });
+	conn->sock.Close();
+	connections_--;
+}
+
+void Daemon::runRequest(std::shared_ptr<Connection> conn, qint64 seq, Batch::Mode mode, const Batch::Job &job)
+{
+	QString error;
+	QElapsedTimer timer;
+	timer.start();
+	bool ok = Batch::RunJob(mode, job, &error, &ref_cache_, result_cache_.valid() ? &result_cache_ : nullptr);
+	qint64 ns = timer.nsecsElapsed();
+
+	served_++;
+	busy_ns_ += ns;
+	if (!ok)
+	{
+		failed_++;
+	}
+
+	QString line = QString("%1\t%2\t%3 ms\t%4")
+		.arg(seq)
+		.arg(ok ? "OK" : "FAIL")
+		.arg(ns / 1e6, 0, 'f', 3)
+		.arg(Batch::JobName(job));
+	if (!ok && !error.isEmpty())
+	{
+		line += "\t" + error;
+	}
+
+	reply(*conn, line.toLocal8Bit());
+
+	std::lock_guard<std::mutex> guard(conn->lock);
+	if (--conn->pending == 0)
+	{
+		conn->done.notify_all();
+	}
+}
+
+void Daemon::reply(Connection &conn, const QByteArray &line)
+{
+	//客户端提前断开时写入失败, 忽略即可
+	std::lock_guard<std::mutex> guard(conn.lock);
+	conn.sock.Write(line + "\n");
+}
+
+QByteArray Daemon::stats() const
+{
+	uint64_t served = served_;
+	double uptime = (QDateTime::currentMSecsSinceEpoch() - started_ms_) / 1000.0;
+	double avg_ms = served ? busy_ns_ / 1e6 / served : 0;
+
+	return QString("served=%1 failed=%2 avg_ms=%3 uptime_s=%4 threads=%5 steals=%6 connections=%7 ref_hits=%8 ref_misses=%9 cache_hits=%10 cache_misses=%11")
+		.arg((quint64)served)
+		.arg((quint64)failed_)
+		.arg(avg_ms, 0, 'f', 3)
+		.arg(uptime, 0, 'f', 1)
+		.arg(pool_.thread_count())
+		.arg((quint64)pool_.steal_count())
+		.arg((int)connections_)
+		.arg((quint64)ref_cache_.hits())
+		.arg((quint64)ref_cache_.misses())
+		.arg((quint64)result_cache_.hits())
+		.arg((quint64)result_cache_.misses())
+		.toLocal8Bit();
+}
+
+int Daemon::RunClient(int argc, char *argv[])
+{
+	QTextStream qout(stdout);
+	QString path;
+	int jobs = 0;
+	QString cache;
+	QStringList rest;
+
+	if (!parseArgs(argc, argv, path, jobs, cache, rest))
+	{
+		printUsage();
+		return 2;
+	}
+
+	LocalSocket sock;
+	if (!sock.Connect(path))
+	{
+		qout << QSTR8BIT("无法连接套接字: ") + path << endl;
+		return 2;
+	}
+
+	//发送和接收分开, 请求很多时不会因双方缓冲区写满而互相等待
+	std::thread sender([&sock, &rest]() {
+		if (!rest.isEmpty())
+		{
+			sock.Write(rest.join('\t').toLocal8Bit() + "\n");
+		}
+		else
+		{
+			QTextStream qin(stdin);
+			while (!qin.atEnd())
+			{
+				QString line = qin.readLine().trimmed();
+				if (!line.isEmpty() && !line.startsWith("#"))
+				{
+					sock.Write(line.toLocal8Bit() + "\n");
+				}
+			}
+		}
+		sock.ShutdownWrite();
+	});
+
+	QByteArray line;
+	bool all_ok = true;
+	while (sock.ReadLine(line))
+	{
+		QString text = QString::fromLocal8Bit(line);
+		if (text.section('\t', 1, 1) == "FAIL")
+		{
+			all_ok = false;
+		}
+		qout << text << endl;
+	}
+	sender.join();
+
+	return all_ok ? 0 : 1;
+}
+
+bool Daemon::parseArgs(int argc, char *argv[], QString &socket, int &jobs, QString &cache, QStringList &rest)
+{
+	socket = LocalSocket::DefaultPath();
+	jobs = 0;
+	cache.clear();
+
+	//argv[1]为"daemon"或"client", 选项之后的参数放入rest
+	int i = 2;
+	for (; i + 1 < argc; i += 2)
+	{
+		QString arg = QSTR8BIT(argv[i]);
+		QString value = QSTR8BIT(argv[i + 1]);
+		if (arg == "--socket")
+		{
+			socket = value;
+		}
+		else if (arg == "--jobs")
+		{
+			jobs = value.toInt();
+		}
+		else if (arg == "--cache")
+		{
+			cache = value;
+		}
+		else if (arg.startsWith("--"))
+		{
+			return false;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	for (; i < argc; i++)
+	{
+		rest << QSTR8BIT(argv[i]);
+	}
+
+	return rest.isEmpty() || !rest.first().startsWith("--");
+}
+
+void Daemon::printUsage()
+{
+	QTextStream qout(stdout);
+	qout << QSTR8BIT("用法: SoFix daemon [--socket <套接字路径>] [--jobs <线程数>] [--cache <结果缓存目录>]\n"
+		"      SoFix client [--socket <套接字路径>] [<normal|dump-from-normal|dump|rebuild|stats> <字段>...]") << endl;
+}
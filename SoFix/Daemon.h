@@ -0,0 +1,51 @@
+#pragma once
+#include <QString>
+#include <QByteArray>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include "Batch.h"
+#include "ThreadPool.h"
+#include "RefCache.h"
+#include "ResultCache.h"
+
+//常驻服务: 在本机Unix域套接字上接收修复请求, 在内部线程池上执行
+//进程启动, Qt初始化只做一次, 适合被其他服务频繁调用
+//用法:
+//	SoFix daemon [--socket <path>] [--jobs <n>] [--cache <dir>]
+//	SoFix client [--socket <path>] [<mode> <字段>...]	不带mode时从标准输入逐行读取请求
+//协议按行收发, 字段以tab分隔:
+//	请求: <mode>	<字段...>		mode和字段与batch清单相同, 例如 dump	a.so	c0000000
+//		  stats					查询服务统计
+//	应答: <序号>	OK|FAIL	<耗时> ms	<路径>	[错误]
+//		  <序号>	STATS	<统计信息>
+//序号为请求在该连接上的行号(从0开始), 同一连接的请求并行执行, 应答按完成顺序返回
+class Daemon
+{
+public:
+	//命令行入口, 返回进程退出码
+	static int Run(int argc, char *argv[]);
+	static int RunClient(int argc, char *argv[]);
+
+private:
+	struct Connection;
+
+	Daemon(int jobs, const QString &cache);
+
+	void serve(std::shared_ptr<Connection> conn);
+	void runRequest(std::shared_ptr<Connection> conn, qint64 seq, Batch::Mode mode, const Batch::Job &job);
+	QByteArray stats() const;
+
+	static void reply(Connection &conn, const QByteArray &line);
+	static bool parseArgs(int argc, char *argv[], QString &socket, int &jobs, QString &cache, QStringList &rest);
+	static void printUsage();
+
+	ThreadPool pool_;
+	RefCache ref_cache_;			//正常so在请求之间保留
+	ResultCache result_cache_;		//--cache, 目录为空时无效
+	qint64 started_ms_;				//启动时间, 用于统计
+	std::atomic<uint64_t> served_;	//已完成的请求数
+	std::atomic<uint64_t> failed_;
+	std::atomic<uint64_t> busy_ns_;	//请求累计耗时
+	std::atomic<int> connections_;	//当前连接数
+};
@@ -1,20 +1,33 @@
 #pragma once
-#include "exec_elf.h"
+#include "ElfTraits.h"
+#include "JobLog.h"
+#include "CountingDevice.h"
 #include <QVector>
 #include <QJsonDocument>
 #include <QFile>
 
+template <typename ElfClass>
 class ElfBuilder
 {
+public:
+	typedef typename ElfClass::Ehdr Elf_Ehdr;
+	typedef typename ElfClass::Phdr Elf_Phdr;
+	typedef typename ElfClass::Shdr Elf_Shdr;
+	typedef typename ElfClass::Dyn Elf_Dyn;
+	typedef typename ElfClass::Rel Elf_Rel;
+	typedef typename ElfClass::Addr Elf_Addr;
+	typedef typename ElfClass::Off Elf_Off;
+	typedef typename ElfClass::Word Elf_Word;
+
 private:
 	typedef struct Option
 	{
-		Elf32_Off offset;
-		Elf32_Word count;
+		Elf_Off offset;
+		Elf_Word count;
 		int bias;
 		union 
 		{
-			Elf32_Word item_size;
+			Elf_Word item_size;
 			int addr_to_off;
 		};	
 	} Option;
@@ -25,34 +38,51 @@ private:
 
 	QJsonDocument json_doc;
 	QFile json_file_;
-	QString json_;	//jsonļ
+	QString json_;	//json文件名称
+	JobLog *log_;	//所属任务的日志
 
-	Elf32_Addr load_bias_;
-	QVector<Elf32_Phdr> phdrs_;
+	Elf_Addr load_bias_;
+	QVector<Elf_Phdr> phdrs_;
 	QStringList phdr_datapaths;
-	QVector<Elf32_Dyn> dyns_;
+	QVector<Elf_Dyn> dyns_;
 
-	Elf32_Ehdr ehdr_;
-	Elf32_Phdr ph_myload_;
-	Elf32_Phdr ph_phdr_;
-	Elf32_Phdr ph_dynamic_;
+	Elf_Ehdr ehdr_;
+	Elf_Phdr ph_myload_;
+	Elf_Phdr ph_phdr_;
+	Elf_Phdr ph_dynamic_;
 
 	QVector<Option> options_;
 	Option rel_option_;
 	Option rel_plt_option_;
 
 public:
-	ElfBuilder(QString json);
+	ElfBuilder(QString json, JobLog *log);
 	~ElfBuilder();
 
-	//jsonļжȡsoıҪϢ
+	//从json文件中读取so的必要信息
 	bool ReadJson();
 
-	//jsonеϢsoļ
+	//根据json中的信息重组so文件
 	bool BuildInfo();
 
-	//д, õsoļ
+	//将数据写入, 得到so文件
 	bool Write();
 
 	bool Build();
+
+	//按options_, rel_option_, rel_plt_option_修正已写入file的段数据, Write在写完段数据后调用
+	void ApplyOptions(QIODevice &file);
+
+private:
+	//options_中的一项: 从offset起count个item_size大小的项加上bias
+	void biasItems(QIODevice &file, const Option &op, Elf_Off base);
+
+	//重定位项的r_offset加上addr_to_off, 其指向的字加上bias
+	void biasRelTargets(QIODevice &file, const Option &op, Elf_Off base);
+
+	//基准测试单独调用各个步骤
+	friend class Bench;
 };
+
+//读取json中的"elf class"字段(32/64), 缺省为ELFCLASS32, 失败返回ELFCLASSNONE
+int json_elf_class(const QString &json);
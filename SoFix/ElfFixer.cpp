@@ -1,23 +1,24 @@
 #include "ElfFixer.h"
 #include "linker.h"
-#include <QDebug>
 #include "Util.h"
+#include "AllocCounter.h"
+#include <algorithm>
+#include <climits>
+#include <vector>
 
 #define QSTR8BIT(s) (QString::fromLocal8Bit(s))
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 
-#define DEBUG qDebug
-#define DL_ERR qDebug
+#define DEBUG(...) LOG_DEBUG(log_, __VA_ARGS__)
+#define WARN(...) LOG_WARN(log_, __VA_ARGS__)
+#define DL_ERR(...) LOG_ERROR(log_, __VA_ARGS__)
 
-const char ElfFixer::strtab[] =
-"\0.dynsym\0.dynstr\0.hash\0.rel.dyn\0.rel.plt\0.plt\0.text\0.ARM.exidx\0.rodata\0"
-".fini_array\0.init_array\0.data.rel.ro\0.dynamic\0.got\0.data\0.bss\0.shstrtab\0";
-
-Elf32_Word ElfFixer::GetShdrName(int idx)
+template <typename ElfClass>
+typename ElfFixer<ElfClass>::Elf_Word ElfFixer<ElfClass>::GetShdrName(int idx)
 {
-	Elf32_Word ret = 0;
-	const char *str = strtab;
+	Elf_Word ret = 0;
+	const char *str = ElfClass::shstrtab(nullptr);
 	for (int i = 0; i < idx; i++)
 	{
 		ret += strlen(str) + 1;
@@ -27,63 +28,94 @@ Elf32_Word ElfFixer::GetShdrName(int idx)
 	return ret;
 }
 
-ElfFixer::ElfFixer(soinfo *si, const char *sopath, const char *fixedpath)
-	: si_(si), sopath_(nullptr), fixedpath_(nullptr), phdr_(nullptr), phnum_(0)
+template <typename ElfClass>
+ElfFixer<ElfClass>::ElfFixer(soinfo<ElfClass> *si, const char *sopath, const char *fixedpath, JobLog *log)
+	: si_(si), log_(log), ref_io_(&sofile_, log), fixed_io_(&fixedfile_, log), fixeddev_(&fixed_io_), phdr_(nullptr), phnum_(0), plt_got_(0), dump_bias_(0)
 {
 	if (sopath)
 	{
-		sopath_ = strdup(sopath);
+		sopath_ = sopath;
 		sofile_.setFileName(QSTR8BIT(sopath));
 	}
 
 	if (fixedpath)
 	{
-		fixedpath_ = strdup(fixedpath);
+		fixedpath_ = fixedpath;
 		fixedfile_.setFileName(QSTR8BIT(fixedpath));
 	}
 
 	memset(shdrs_, 0, sizeof(shdrs_));
 }
 
-ElfFixer::~ElfFixer()
+template <typename ElfClass>
+void ElfFixer<ElfClass>::set_reference(const QByteArray &bytes)
+{
+	ref_ = bytes;
+}
+
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::readRef(qint64 off, void *buf, qint64 size)
 {
-	if (sopath_)
+	if (PhaseStats *stats = log_->stats())
 	{
-		free(sopath_);
+		stats->AddRead(size);
 	}
 
-	if (fixedpath_)
+	//内存中的正常so直接拷贝, FixRel每个重定位项读一次, 不再seek/read
+	if (!ref_.isEmpty())
 	{
-		free(fixedpath_);
+		if (off < 0 || size < 0 || off + size > ref_.size())
+		{
+			return false;
+		}
+		memcpy(buf, ref_.constData() + off, (size_t)size);
+		return true;
 	}
 
-	sofile_.close();
-	fixedfile_.close();
+	return ref_io_.seek(off) && ref_io_.read((char *)buf, size) == size;
+}
+
+template <typename ElfClass>
+qint64 ElfFixer<ElfClass>::refSize()
+{
+	return ref_.isEmpty() ? sofile_.size() : ref_.size();
 }
 
-bool ElfFixer::Fix()
+template <typename ElfClass>
+ElfFixer<ElfClass>::~ElfFixer()
+{
+	ref_io_.close();
+	fixed_io_.close();
+	fixedbuf_.close();
+}
+
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::Fix()
 {
 	return FixPhdr() &&
 		FixEhdr() &&
 		FixShdr() &&
-		FixRel();
+		(dump_bias_ ? FixRelFromBias() : FixRel());
 }
 
-bool ElfFixer::Write()
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::Write()
 {
-	if (!fixedfile_.open(QIODevice::ReadWrite | QIODevice::Truncate))
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_WRITE);
+	const ImageView &image = si_->image;
+	if (!fixeddev_->open(QIODevice::ReadWrite | QIODevice::Truncate))
 	{
 		return false;
 	}
 
-	const Elf32_Phdr* phdr = phdr_;
-	const Elf32_Phdr* phdr_limit = phdr + phnum_;
-	Elf32_Off phdr_min_off = 0;
-	Elf32_Off phdr_max_off = 0;
+	const Elf_Phdr* phdr = phdr_;
+	const Elf_Phdr* phdr_limit = phdr + phnum_;
+	Elf_Off phdr_min_off = 0;
+	Elf_Off phdr_max_off = 0;
 
-	//ǵݿʱı, dumpļжȡݲд뵽ļ, 
-	//еļӳ䵽ڴ, ֪ýĸڴдļ...
-	//Ĵ: ȶԭso, Ѳͬдȥ
+	//考虑到段数据可能运行时被改变, 这里从dump后文件中读取段数据并写入到文件, 
+	//有的文件块会映射到多个内存块, 不知道该将哪个内存块写回文件...
+	//这里做这样的处理: 比对原正常so, 把不同的写进去
 	for (phdr = phdr_; phdr < phdr_limit; phdr++)
 	{
 		if (phdr->p_type != PT_LOAD)
@@ -91,46 +123,55 @@ bool ElfFixer::Write()
 			continue;
 		}
 
-		Elf32_Addr file_page_start = PAGE_START(phdr->p_offset);
-		Elf32_Addr file_end = phdr->p_offset + phdr->p_filesz;
+		Elf_Addr file_page_start = PAGE_START(phdr->p_offset);
+		Elf_Addr file_end = phdr->p_offset + phdr->p_filesz;
 
-		//ûпдȨ, ļʵӳС
+		//如果没有可写权限, 修正文件的实际映射大小
 		if ((phdr->p_flags & PF_W) == 0)
 		{
 			file_end = PAGE_END(file_end);
 		}
 
-		//ȡ[file_page_start, file_end)[phdr_min_off, phdr_max_off)Ľ
+		//段所在页的宿主内存
+		char *seg_page = image.At<char>(PAGE_START(phdr->p_vaddr), file_end - file_page_start);
+		if (seg_page == nullptr)
+		{
+			WARN("[Write] segment out of image, skip");
+			continue;
+		}
+
+		//求取[file_page_start, file_end)和[phdr_min_off, phdr_max_off)的交集
 		if (MAX(file_page_start, phdr_min_off) < MIN(file_end, phdr_max_off))
 		{
-			Elf32_Addr overlap_size = MIN(file_end, phdr_max_off) - MAX(file_page_start, phdr_min_off);
+			Elf_Addr overlap_size = MIN(file_end, phdr_max_off) - MAX(file_page_start, phdr_min_off);
 			char *overlap = (char *)malloc(overlap_size);
-			sofile_.seek(MAX(file_page_start, phdr_min_off));
-			sofile_.read(overlap, overlap_size);
-			if (memcmp(overlap, (char *)(PAGE_START(si_->load_bias + phdr->p_vaddr)), overlap_size))
+			AllocCounter::Note(overlap_size);
+			readRef(MAX(file_page_start, phdr_min_off), overlap, overlap_size);
+			if (memcmp(overlap, seg_page, overlap_size))
 			{
-				fixedfile_.seek(file_page_start);
-				fixedfile_.write((char *)(PAGE_START(si_->load_bias + phdr->p_vaddr)), overlap_size);
+				fixeddev_->seek(file_page_start);
+				fixeddev_->write(seg_page, overlap_size);
 			}
+			free(overlap);
 
-			fixedfile_.seek(file_page_start + overlap_size);
-			fixedfile_.write((char *)(PAGE_START(si_->load_bias + phdr->p_vaddr) + overlap_size), file_end - file_page_start - overlap_size);
+			fixeddev_->seek(file_page_start + overlap_size);
+			fixeddev_->write(seg_page + overlap_size, file_end - file_page_start - overlap_size);
 		}
 		else
 		{
-			fixedfile_.seek(file_page_start);
-			fixedfile_.write((char *)(PAGE_START(si_->load_bias + phdr->p_vaddr)), file_end - file_page_start);
+			fixeddev_->seek(file_page_start);
+			fixeddev_->write(seg_page, file_end - file_page_start);
 		}
 
 		if (PAGE_END(file_end) - file_end > 0)
 		{
 			char *readbytes = (char *)malloc(PAGE_END(file_end) - file_end);
+			AllocCounter::Note(PAGE_END(file_end) - file_end);
 			memset(readbytes, 0, PAGE_END(file_end) - file_end);
-			sofile_.seek(file_end);
-			sofile_.read(readbytes, PAGE_END(file_end) - file_end);
+			readRef(file_end, readbytes, PAGE_END(file_end) - file_end);
 
-			fixedfile_.seek(file_end);
-			fixedfile_.write(readbytes, PAGE_END(file_end) - file_end);
+			fixeddev_->seek(file_end);
+			fixeddev_->write(readbytes, PAGE_END(file_end) - file_end);
 			free(readbytes);
 		}
 
@@ -138,88 +179,101 @@ bool ElfFixer::Write()
 		phdr_max_off = MAX(phdr_max_off, PAGE_END(file_end));
 	}
 
-	//soļп0ͷ֮
+	//从正常so文件中拷贝0到段头部之间的数据
 	if (phdr_min_off > 0)
 	{
 		char *readbytes = (char *)malloc(phdr_min_off);
-		sofile_.seek(0);
-		sofile_.read(readbytes, phdr_min_off);
+		AllocCounter::Note(phdr_min_off);
+		readRef(0, readbytes, phdr_min_off);
 
-		fixedfile_.seek(0);
-		fixedfile_.write(readbytes, phdr_min_off);
+		fixeddev_->seek(0);
+		fixeddev_->write(readbytes, phdr_min_off);
 		free(readbytes);
 	}
 
-	//޸ElfͷӦڶд֮д, ⱻݸ
-	fixedfile_.seek(0);
-	fixedfile_.write((char *)&ehdr_, sizeof(Elf32_Ehdr));
+	//修复后的Elf头部应该在段数据写入之后写入, 避免被段数据覆盖
+	fixeddev_->seek(0);
+	fixeddev_->write((char *)&ehdr_, sizeof(Elf_Ehdr));
 
-	//soļжȡ֮ļ
-	if (phdr_max_off < sofile_.size())
+	//从正常so文件中读取段数据之后的文件数据
+	if (phdr_max_off < refSize())
 	{
-		char *readbytes = (char *)malloc(sofile_.size() - phdr_max_off);
-		sofile_.seek(phdr_max_off);
-		sofile_.read(readbytes, sofile_.size() - phdr_max_off);
+		char *readbytes = (char *)malloc(refSize() - phdr_max_off);
+		AllocCounter::Note(refSize() - phdr_max_off);
+		readRef(phdr_max_off, readbytes, refSize() - phdr_max_off);
 
-		fixedfile_.seek(phdr_max_off);
-		fixedfile_.write(readbytes, sofile_.size() - phdr_max_off);
+		fixeddev_->seek(phdr_max_off);
+		fixeddev_->write(readbytes, refSize() - phdr_max_off);
 		free(readbytes);
 	}
 
-	//дͷ
-	fixedfile_.seek(ehdr_.e_shoff);
-	fixedfile_.write((char *)&shdrs_[SI_NULL], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_DYNSYM], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_DYNSTR], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_HASH], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_RELDYN], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_RELPLT], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_PLT], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_TEXT], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_ARMEXIDX], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_RODATA], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_FINI_ARRAY], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_INIT_ARRAY], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_DATA_REL_RO], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_DYNAMIC], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_GOT], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_DATA], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_BSS], sizeof(Elf32_Shdr));
-	fixedfile_.write((char *)&shdrs_[SI_SHSTRTAB], sizeof(Elf32_Shdr));
-
-	//дͷ
-	fixedfile_.seek(shdrs_[SI_SHSTRTAB].sh_offset);
-	fixedfile_.write(strtab, shdrs_[SI_SHSTRTAB].sh_size);
-
+	//写入节头
+	fixeddev_->seek(ehdr_.e_shoff);
+	fixeddev_->write((char *)&shdrs_[SI_NULL], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_DYNSYM], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_DYNSTR], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_HASH], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_GNU_HASH], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_RELDYN], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_RELPLT], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_PLT], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_TEXT], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_ARMEXIDX], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_RODATA], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_FINI_ARRAY], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_INIT_ARRAY], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_DATA_REL_RO], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_DYNAMIC], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_GOT], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_DATA], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_BSS], sizeof(Elf_Shdr));
+	fixeddev_->write((char *)&shdrs_[SI_SHSTRTAB], sizeof(Elf_Shdr));
+
+	//写入节头名称
+	fixeddev_->seek(shdrs_[SI_SHSTRTAB].sh_offset);
+	fixeddev_->write(ElfClass::shstrtab(nullptr), shdrs_[SI_SHSTRTAB].sh_size);
+
+	//写入内存时输出随写入增长, 按最终大小记一次分配
+	if (fixeddev_ == &fixedbuf_)
+	{
+		AllocCounter::Note(fixedbuf_.size());
+	}
+	if (PhaseStats *stats = log_->stats())
+	{
+		stats->AddWritten(fixeddev_->size());
+	}
 	return true;
 }
 
-bool ElfFixer::FixEhdr()
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixEhdr()
 {
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_EHDR);
 	DEBUG("[fixEhdr] fix ehdr...");
 
-	//soļжȡelfͷ
-	if (sopath_ && sofile_.open(QIODevice::ReadOnly | QIODevice::ExistingOnly))
+	//从正常so文件中读取elf头部
+	if (!ref_.isEmpty() || (!sopath_.isEmpty() && ref_io_.open(QIODevice::ReadOnly | QIODevice::ExistingOnly)))
 	{
-		qint64 rc = sofile_.read((char *)&ehdr_, sizeof(Elf32_Ehdr));
-		if (rc != sizeof(Elf32_Ehdr))
+		if (!readRef(0, &ehdr_, sizeof(Elf_Ehdr)))
 		{
 			return false;
 		}
 	}
 
-	ehdr_.e_shoff = sofile_.size();
-	ehdr_.e_shentsize = sizeof(Elf32_Shdr);
+	ehdr_.e_shoff = refSize();
+	ehdr_.e_shentsize = sizeof(Elf_Shdr);
 	ehdr_.e_shnum = SI_MAX;
 	ehdr_.e_shstrndx = SI_SHSTRTAB;
 
-	//shdrβӸƱ
+	//在shdr尾部加个节名称表
 	shdrs_[SI_SHSTRTAB].sh_name = GetShdrName(SI_SHSTRTAB);
 	shdrs_[SI_SHSTRTAB].sh_type = SHT_STRTAB;
 	shdrs_[SI_SHSTRTAB].sh_flags = 0;
 	shdrs_[SI_SHSTRTAB].sh_addr = 0;
-	shdrs_[SI_SHSTRTAB].sh_offset = ehdr_.e_shoff + ehdr_.e_shnum * sizeof(Elf32_Shdr);
-	shdrs_[SI_SHSTRTAB].sh_size = sizeof(strtab);
+	shdrs_[SI_SHSTRTAB].sh_offset = ehdr_.e_shoff + ehdr_.e_shnum * sizeof(Elf_Shdr);
+	size_t shstrtab_size = 0;
+	ElfClass::shstrtab(&shstrtab_size);
+	shdrs_[SI_SHSTRTAB].sh_size = shstrtab_size;
 	shdrs_[SI_SHSTRTAB].sh_link = 0;
 	shdrs_[SI_SHSTRTAB].sh_info = 0;
 	shdrs_[SI_SHSTRTAB].sh_addralign = 1;
@@ -229,8 +283,10 @@ bool ElfFixer::FixEhdr()
 	return true;
 }
 
-bool ElfFixer::FixPhdr()
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixPhdr()
 {
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_PHDR);
 	DEBUG("[fixPhdr] fix phdr...");
 
 	if (si_)
@@ -241,26 +297,32 @@ bool ElfFixer::FixPhdr()
 		return true;
 	}
 
-	DEBUG("[fixPhdr] fix phdr Fail!");
+	WARN("[fixPhdr] fix phdr Fail!");
 	return false;
 }
 
-bool ElfFixer::FixShdr()
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixShdr()
 {
 	return FixShdrFromPhdr() &&
 		FixShdrFromDynamic() &&
 		FixShdrFromShdr() && 
 		FixDynsym() &&
-		FixDynstr();
+		FixDynstr() &&
+		FixShdrFromRelDensity() &&
+		FixShdrFromLayout() &&
+		FixSymShndx();
 }
 
-bool ElfFixer::FixShdrFromPhdr()
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixShdrFromPhdr()
 {
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_SHDR_FROM_PHDR);
 	DEBUG("[fixShdrFromPhdr] fix Shdr: .dynamic, .arm.exidx ...");
 
-	//޸.dynamic: ֱӶȡ, СDT_NULL
-	phdr_table_get_dynamic_section(phdr_, phnum_, si_->load_bias, &si_->dynamic, NULL, NULL);
-	if (!si_->dynamic)
+	//修复.dynamic: 直接读取段, 大小遍历到DT_NULL, 最多遍历到PT_DYNAMIC的末尾
+	phdr_table_get_dynamic_section<ElfClass>(phdr_, phnum_, si_->image, &si_->dynamic, &si_->dynamic_count, NULL);
+	if (!si_->dynamic || si_->dynamic_count == 0)
 	{
 		return false;
 	}
@@ -268,22 +330,22 @@ bool ElfFixer::FixShdrFromPhdr()
 	shdrs_[SI_DYNAMIC].sh_name = GetShdrName(SI_DYNAMIC);
 	shdrs_[SI_DYNAMIC].sh_type = SHT_DYNAMIC;
 	shdrs_[SI_DYNAMIC].sh_flags = SHF_WRITE | SHF_ALLOC;
-	shdrs_[SI_DYNAMIC].sh_addr = (Elf32_Addr)si_->dynamic - si_->load_bias;
+	shdrs_[SI_DYNAMIC].sh_addr = (Elf_Addr)si_->image.ToVaddr(si_->dynamic);
 	shdrs_[SI_DYNAMIC].sh_offset = AddrToOff(shdrs_[SI_DYNAMIC].sh_addr);
-	//dynamic_.sh_size = 0;		//DT_NULLȷС
+	//dynamic_.sh_size = 0;		//遍历到DT_NULL即可确定大小
 	shdrs_[SI_DYNAMIC].sh_link = SI_DYNSTR;
 	shdrs_[SI_DYNAMIC].sh_info = 0;
-	shdrs_[SI_DYNAMIC].sh_addralign = 4;
-	shdrs_[SI_DYNAMIC].sh_entsize = sizeof(Elf32_Dyn);
+	shdrs_[SI_DYNAMIC].sh_addralign = sizeof(Elf_Addr);
+	shdrs_[SI_DYNAMIC].sh_entsize = sizeof(Elf_Dyn);
 
-	//޸.arm.exidx: ֱӶȡ
-	(void)phdr_table_get_arm_exidx(phdr_, phnum_, si_->load_bias, &si_->ARM_exidx, &si_->ARM_exidx_count);
-	if (si_->ARM_exidx && AddrToOff((Elf32_Addr)si_->ARM_exidx - si_->load_bias) != -1)
+	//修复.arm.exidx: 直接读取段
+	(void)phdr_table_get_arm_exidx<ElfClass>(phdr_, phnum_, si_->image, &si_->ARM_exidx, &si_->ARM_exidx_count);
+	if (si_->ARM_exidx && AddrToOff((Elf_Addr)si_->image.ToVaddr(si_->ARM_exidx)) != -1)
 	{
 		shdrs_[SI_ARMEXIDX].sh_name = GetShdrName(SI_ARMEXIDX);
 		shdrs_[SI_ARMEXIDX].sh_type = SHT_AMMEXIDX;
 		shdrs_[SI_ARMEXIDX].sh_flags = SHF_ALLOC | SHF_LINK_ORDER;
-		shdrs_[SI_ARMEXIDX].sh_addr = (Elf32_Addr)si_->ARM_exidx - si_->load_bias;
+		shdrs_[SI_ARMEXIDX].sh_addr = (Elf_Addr)si_->image.ToVaddr(si_->ARM_exidx);
 		shdrs_[SI_ARMEXIDX].sh_offset = AddrToOff(shdrs_[SI_ARMEXIDX].sh_addr);
 		shdrs_[SI_ARMEXIDX].sh_size = si_->ARM_exidx_count * 8;
 		shdrs_[SI_ARMEXIDX].sh_link = SI_TEXT;
@@ -296,61 +358,127 @@ bool ElfFixer::FixShdrFromPhdr()
 	return true;
 }
 
-bool ElfFixer::FixShdrFromDynamic()
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixShdrFromDynamic()
 {
-	//.dynamic, ޸½:
-	//.hash: ֱӶȡDT_HASH
-	//.dynstr: ȡDT_STRTABȡʼλ, Сøýڵ.dynamic(DT_NEED), dynsymȡ
-	//.dynsym: ȡDT_SYMTABȡʼλ, Сøýڵ.rel.dyn, .rel.plt, .hashȡ
-	//.rel.dyn: ֱӶȡDT_REL, DT_RELSZɻȡʼλúʹС
-	//.rel.plt: ֱӶȡDT_JMPREL, DT_PLTRELSZɻȡʼλúʹС
-	//.init_array: ֱӶȡDT_INIT_ARRAY, DT_INIT_ARRAYSZɻȡʼλúʹС
-	//.fini_array: ֱӶȡDT_FINI_ARRAY, DT_FINI_ARRAYSZɻȡʼλúʹС
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_SHDR_FROM_DYNAMIC);
+	//遍历.dynamic, 修复以下节:
+	//.hash: 直接读取DT_HASH
+	//.gnu.hash: 读取DT_GNU_HASH获取起始位置, 链的长度由.dynsym的符号数决定
+	//.dynstr: 读取DT_STRTAB获取起始位置, 大小由引用该节的.dynamic(DT_NEED), dynsym获取
+	//.dynsym: 读取DT_SYMTAB获取起始位置, 大小由引用该节的.rel.dyn, .rel.plt, .hash, .gnu.hash获取
+	//.rel.dyn: 直接读取DT_REL, DT_RELSZ即可获取起始位置和大小
+	//.rel.plt: 直接读取DT_JMPREL, DT_PLTRELSZ即可获取起始位置和大小
+	//.init_array: 直接读取DT_INIT_ARRAY, DT_INIT_ARRAYSZ即可获取起始位置和大小
+	//.fini_array: 直接读取DT_FINI_ARRAY, DT_FINI_ARRAYSZ即可获取起始位置和大小
 
 	DEBUG("[fixShdrFromDynamic] fix Shdr: .hash, .dynstr, .dynsym, .rel.dyn,"
 		".rel.plt, .init_array, .fini_array ...");
 
-	/* "base" might wrap around UINT32_MAX. */
-	Elf32_Addr base = si_->load_bias;
-	shdrs_[SI_DYNAMIC].sh_size = sizeof(Elf32_Dyn);	//DT_NULL
+	//动态节中的地址均为虚拟地址, 通过镜像视图转换, 越界时得到nullptr
+	const ImageView &image = si_->image;
+	shdrs_[SI_DYNAMIC].sh_size = sizeof(Elf_Dyn);	//DT_NULL
 	shdrs_[SI_DYNSTR].sh_size = 0;
-	uint32_t needed_count = 0; //¼DT_NEEDED
-	// Extract useful information from dynamic section. ȡ̬еϢDT_
-	// ȡentry(ֵַ), DT_NULLΪýڵĽ־
-
-	for (Elf32_Dyn* d = si_->dynamic; d->d_tag != DT_NULL; ++d)
+	uint32_t needed_count = 0; //记录DT_NEEDED的数量
+	// Extract useful information from dynamic section. 抽取动态节中的有用信息，各种DT_
+	// 获取各个entry的数据(地址或值), DT_NULL为该节的结束标志
+	// 损坏的dump中可能没有DT_NULL, 最多遍历PT_DYNAMIC的p_memsz
+
+	Elf_Dyn* dyn_end = si_->dynamic + si_->dynamic_count;
+	Elf_Dyn* d = si_->dynamic;
+	for (; d < dyn_end && d->d_tag != DT_NULL; ++d)
 	{
-		shdrs_[SI_DYNAMIC].sh_size += sizeof(Elf32_Dyn);	//DTõdynamic_׼ȷС
+		shdrs_[SI_DYNAMIC].sh_size += sizeof(Elf_Dyn);	//遍历DT得到dynamic_节准确大小
 		switch (d->d_tag)
 		{
 		case DT_HASH:
-			si_->nbucket = ((unsigned *)(base + d->d_un.d_ptr))[0];
-			si_->nchain = ((unsigned *)(base + d->d_un.d_ptr))[1];
-			si_->bucket = (unsigned *)(base + d->d_un.d_ptr + 8);
-			si_->chain = (unsigned *)(base + d->d_un.d_ptr + 8 + si_->nbucket * 4);
+			{
+				unsigned *hash = image.At<unsigned>(d->d_un.d_ptr, 2);
+				if (hash == nullptr)
+				{
+					WARN("[fixShdrFromDynamic] DT_HASH out of image!");
+					break;
+				}
+				si_->nbucket = hash[0];
+				si_->nchain = hash[1];
+				si_->bucket = image.At<unsigned>((uint64_t)d->d_un.d_ptr + 8, si_->nbucket);
+				si_->chain = image.At<unsigned>((uint64_t)d->d_un.d_ptr + 8 + (uint64_t)si_->nbucket * 4, si_->nchain);
+
+				//nbucket, nchain同样来自镜像, 两个表必须完整地落在镜像内
+				if (si_->nbucket == 0 || si_->bucket == nullptr || si_->chain == nullptr)
+				{
+					WARN("[fixShdrFromDynamic] DT_HASH nbucket=%llu nchain=%llu out of image!",
+						(unsigned long long)si_->nbucket, (unsigned long long)si_->nchain);
+					si_->nbucket = 0;
+					si_->nchain = 0;
+					si_->bucket = nullptr;
+					si_->chain = nullptr;
+					break;
+				}
+			}
 
 			shdrs_[SI_HASH].sh_name = GetShdrName(SI_HASH);
 			shdrs_[SI_HASH].sh_type = SHT_HASH;
 			shdrs_[SI_HASH].sh_flags = SHF_ALLOC;
 			shdrs_[SI_HASH].sh_addr = d->d_un.d_ptr;
 			shdrs_[SI_HASH].sh_offset = AddrToOff(shdrs_[SI_HASH].sh_addr);
-			shdrs_[SI_HASH].sh_size = (2 + si_->nbucket + si_->nchain) * sizeof(Elf32_Word);
-			shdrs_[SI_HASH].sh_link = ShIdx::SI_DYNSYM;	//.dynsymĽ
+			shdrs_[SI_HASH].sh_size = (2 + si_->nbucket + si_->nchain) * sizeof(Elf_Word);
+			shdrs_[SI_HASH].sh_link = ShIdx::SI_DYNSYM;	//.dynsym的节索引
 			shdrs_[SI_HASH].sh_info = 0;
 			shdrs_[SI_HASH].sh_addralign = 4;
-			shdrs_[SI_HASH].sh_entsize = sizeof(Elf32_Word);
+			shdrs_[SI_HASH].sh_entsize = sizeof(Elf_Word);
 
 			DEBUG("[fixShdrFromDynamic] found DT_HASH!");
 			break;
+		case DT_GNU_HASH:
+			{
+				//nbucket, symndx, maskwords, shift2, 之后为bloom[maskwords](Elf_Addr), bucket[nbucket], chain[]
+				uint32_t *gnu_hash = image.At<uint32_t>(d->d_un.d_ptr, 4);
+				if (gnu_hash == nullptr)
+				{
+					WARN("[fixShdrFromDynamic] DT_GNU_HASH out of image!");
+					break;
+				}
+				uint64_t bucket_addr = (uint64_t)d->d_un.d_ptr + 16 + (uint64_t)gnu_hash[2] * sizeof(Elf_Addr);
+				si_->gnu_nbucket = gnu_hash[0];
+				si_->gnu_symndx = gnu_hash[1];
+				si_->gnu_bucket = image.At<uint32_t>(bucket_addr, si_->gnu_nbucket);
+				si_->gnu_chain = image.At<uint32_t>(bucket_addr + (uint64_t)si_->gnu_nbucket * 4, 0);
+
+				if (si_->gnu_nbucket == 0 || si_->gnu_bucket == nullptr || si_->gnu_chain == nullptr)
+				{
+					WARN("[fixShdrFromDynamic] DT_GNU_HASH nbucket=%llu maskwords=%u out of image!",
+						(unsigned long long)si_->gnu_nbucket, gnu_hash[2]);
+					si_->gnu_nbucket = 0;
+					si_->gnu_symndx = 0;
+					si_->gnu_bucket = nullptr;
+					si_->gnu_chain = nullptr;
+					break;
+				}
+			}
+
+			shdrs_[SI_GNU_HASH].sh_name = GetShdrName(SI_GNU_HASH);
+			shdrs_[SI_GNU_HASH].sh_type = SHT_GNU_HASH;
+			shdrs_[SI_GNU_HASH].sh_flags = SHF_ALLOC;
+			shdrs_[SI_GNU_HASH].sh_addr = d->d_un.d_ptr;
+			shdrs_[SI_GNU_HASH].sh_offset = AddrToOff(shdrs_[SI_GNU_HASH].sh_addr);
+			shdrs_[SI_GNU_HASH].sh_size = image.ToVaddr(si_->gnu_chain) - d->d_un.d_ptr;	//不含chain, 由FixDynsym补上
+			shdrs_[SI_GNU_HASH].sh_link = ShIdx::SI_DYNSYM;	//.dynsym的节索引
+			shdrs_[SI_GNU_HASH].sh_info = 0;
+			shdrs_[SI_GNU_HASH].sh_addralign = sizeof(Elf_Addr);
+			shdrs_[SI_GNU_HASH].sh_entsize = 0;
+
+			DEBUG("[fixShdrFromDynamic] found DT_GNU_HASH!");
+			break;
 		case DT_STRTAB:
-			si_->strtab = (const char *)(base + d->d_un.d_ptr);
+			si_->strtab = image.At<const char>(d->d_un.d_ptr);
 
 			shdrs_[SI_DYNSTR].sh_name = GetShdrName(SI_DYNSTR);
 			shdrs_[SI_DYNSTR].sh_type = SHT_STRTAB;
 			shdrs_[SI_DYNSTR].sh_flags = SHF_ALLOC;
 			shdrs_[SI_DYNSTR].sh_addr = d->d_un.d_ptr;
 			shdrs_[SI_DYNSTR].sh_offset = AddrToOff(shdrs_[SI_DYNSTR].sh_addr);
-			//shdrs_[SI_DYNSTR].sh_size = 0;	//ֶβǱ, DT_STRSZȡСܲ׼ȷ
+			//shdrs_[SI_DYNSTR].sh_size = 0;	//由于这个字段不是必须的, 由DT_STRSZ获取大小可能不准确
 			shdrs_[SI_DYNSTR].sh_link = 0;
 			shdrs_[SI_DYNSTR].sh_info = 0;
 			shdrs_[SI_DYNSTR].sh_addralign = 1;
@@ -359,125 +487,126 @@ bool ElfFixer::FixShdrFromDynamic()
 			DEBUG("[fixShdrFromDynamic] found DT_STRTAB!");
 			break;
 		case DT_STRSZ:
-			//shdrs_[SI_DYNSTR].sh_size = d->d_un.d_val;	//DT_STRSZȡСܲ׼ȷ, ͨøý(.symtab, .dynamic)ķΧȷС
+			//shdrs_[SI_DYNSTR].sh_size = d->d_un.d_val;	//由DT_STRSZ获取大小可能不准确, 后续可以通过引用该节(.symtab, .dynamic)的范围来确定大小
 			break;
 		case DT_SYMTAB:
-			si_->symtab = (Elf32_Sym *)(base + d->d_un.d_ptr);
+			si_->symtab = image.At<Elf_Sym>(d->d_un.d_ptr);
 
 			shdrs_[SI_DYNSYM].sh_name = GetShdrName(SI_DYNSYM);
 			shdrs_[SI_DYNSYM].sh_type = SHT_DYNSYM;
 			shdrs_[SI_DYNSYM].sh_flags = SHF_ALLOC;
 			shdrs_[SI_DYNSYM].sh_addr = d->d_un.d_ptr;
 			shdrs_[SI_DYNSYM].sh_offset = AddrToOff(shdrs_[SI_DYNSYM].sh_addr);
-			shdrs_[SI_DYNSYM].sh_size = 0;		//ݷHASH
-			shdrs_[SI_DYNSYM].sh_link = ShIdx::SI_DYNSTR;	//.dynstrĽ
-			shdrs_[SI_DYNSYM].sh_info = 1;	//һֲŵķűֵһ, ʱ1
-			shdrs_[SI_DYNSYM].sh_addralign = 4;
-			shdrs_[SI_DYNSYM].sh_entsize = sizeof(Elf32_Sym);
+			shdrs_[SI_DYNSYM].sh_size = 0;		//后续根据符号HASH表决定
+			shdrs_[SI_DYNSYM].sh_link = ShIdx::SI_DYNSTR;	//.dynstr的节索引
+			shdrs_[SI_DYNSYM].sh_info = 1;	//最后一个局部符号的符号表索引值加一, 暂时给1
+			shdrs_[SI_DYNSYM].sh_addralign = sizeof(Elf_Addr);
+			shdrs_[SI_DYNSYM].sh_entsize = sizeof(Elf_Sym);
 
 			DEBUG("[fixShdrFromDynamic] found DT_SYMTAB!");
 			break;
 		case DT_JMPREL:
-			si_->plt_rel = (Elf32_Rel*)(base + d->d_un.d_ptr);
+			si_->plt_rel = image.At<Elf_Rel>(d->d_un.d_ptr);
 
 			shdrs_[SI_RELPLT].sh_name = GetShdrName(SI_RELPLT);
-			shdrs_[SI_RELPLT].sh_type = SHT_REL;
+			shdrs_[SI_RELPLT].sh_type = ElfClass::kShtRel;
 			shdrs_[SI_RELPLT].sh_flags = SHF_ALLOC | SHF_INFO_LINK;
 			shdrs_[SI_RELPLT].sh_addr = d->d_un.d_ptr;
 			shdrs_[SI_RELPLT].sh_offset = AddrToOff(shdrs_[SI_RELPLT].sh_addr);
-			//shdrs_[SI_RELPLT].sh_size = 0;		//DT_PLTRELSZȡ׼ȷС
-			shdrs_[SI_RELPLT].sh_link = ShIdx::SI_DYNSYM;	//.dynsymĽ
-			shdrs_[SI_RELPLT].sh_info = ShIdx::SI_GOT;		//.gotĽ
-			shdrs_[SI_RELPLT].sh_addralign = 4;
-			shdrs_[SI_RELPLT].sh_entsize = sizeof(Elf32_Rel);
+			//shdrs_[SI_RELPLT].sh_size = 0;		//根据DT_PLTRELSZ获取准确大小
+			shdrs_[SI_RELPLT].sh_link = ShIdx::SI_DYNSYM;	//.dynsym的节索引
+			shdrs_[SI_RELPLT].sh_info = ShIdx::SI_GOT;		//.got的节索引
+			shdrs_[SI_RELPLT].sh_addralign = sizeof(Elf_Addr);
+			shdrs_[SI_RELPLT].sh_entsize = sizeof(Elf_Rel);
 
 			DEBUG("[fixShdrFromDynamic] found DT_JMPREL!");
 			break;
 		case DT_PLTRELSZ:
-			si_->plt_rel_count = d->d_un.d_val / sizeof(Elf32_Rel);
+			si_->plt_rel_count = d->d_un.d_val / sizeof(Elf_Rel);
 
-			shdrs_[SI_RELPLT].sh_size = d->d_un.d_val;	//DT_PLTRELSZȡ.rel.plt׼ȷС
+			shdrs_[SI_RELPLT].sh_size = d->d_un.d_val;	//根据DT_PLTRELSZ获取.rel.plt准确大小
 			break;
-		case DT_REL:
-			si_->rel = (Elf32_Rel*)(base + d->d_un.d_ptr);
+		case ElfClass::kDtRel:
+			si_->rel = image.At<Elf_Rel>(d->d_un.d_ptr);
 
 			shdrs_[SI_RELDYN].sh_name = GetShdrName(SI_RELDYN);
-			shdrs_[SI_RELDYN].sh_type = SHT_REL;
+			shdrs_[SI_RELDYN].sh_type = ElfClass::kShtRel;
 			shdrs_[SI_RELDYN].sh_flags = SHF_ALLOC;
 			shdrs_[SI_RELDYN].sh_addr = d->d_un.d_ptr;
 			shdrs_[SI_RELDYN].sh_offset = AddrToOff(shdrs_[SI_RELDYN].sh_addr);
-			//shdrs_[SI_RELDYN].sh_size = 0;	//DT_RELSZȷ׼ȷС
-			shdrs_[SI_RELDYN].sh_link = ShIdx::SI_DYNSYM;	//.dynsymĽ
+			//shdrs_[SI_RELDYN].sh_size = 0;	//可以由DT_RELSZ确定准确大小
+			shdrs_[SI_RELDYN].sh_link = ShIdx::SI_DYNSYM;	//.dynsym的节索引
 			shdrs_[SI_RELDYN].sh_info = 0;
-			shdrs_[SI_RELDYN].sh_addralign = 4;
-			shdrs_[SI_RELDYN].sh_entsize = sizeof(Elf32_Rel);
+			shdrs_[SI_RELDYN].sh_addralign = sizeof(Elf_Addr);
+			shdrs_[SI_RELDYN].sh_entsize = sizeof(Elf_Rel);
 
 			DEBUG("[fixShdrFromDynamic] found DT_REL!");
 			break;
-		case DT_RELSZ:
-			si_->rel_count = d->d_un.d_val / sizeof(Elf32_Rel);
+		case ElfClass::kDtRelSz:
+			si_->rel_count = d->d_un.d_val / sizeof(Elf_Rel);
 
-			shdrs_[SI_RELDYN].sh_size = d->d_un.d_val;	//ȡ.rel.dyn׼ȷС
+			shdrs_[SI_RELDYN].sh_size = d->d_un.d_val;	//获取.rel.dyn准确大小
 
 			DEBUG("[fixShdrFromDynamic] found DT_RELSZ!");
 			break;
 		case DT_PLTGOT:
 			/* Save this in case we decide to do lazy binding. We don't yet. */
-			si_->plt_got = (unsigned *)(base + d->d_un.d_ptr);	//_global_offset_table_ַ, ǱϢ, ֻ׼ȷ޸
+			si_->plt_got = image.At<unsigned>(d->d_un.d_ptr);	//_global_offset_table_的虚拟地址, 不是必需信息, 因此只能用作不准确修复
+			plt_got_ = d->d_un.d_ptr;
 			break;
 		case DT_INIT_ARRAY:
-			si_->init_array = reinterpret_cast<linker_function_t*>(base + d->d_un.d_ptr);
+			si_->init_array = image.At<linker_function_t>(d->d_un.d_ptr);
 
 			shdrs_[SI_INIT_ARRAY].sh_name = GetShdrName(SI_INIT_ARRAY);
 			shdrs_[SI_INIT_ARRAY].sh_type = SHT_INIT_ARRAY;
 			shdrs_[SI_INIT_ARRAY].sh_flags = SHF_WRITE | SHF_ALLOC;
 			shdrs_[SI_INIT_ARRAY].sh_addr = d->d_un.d_ptr;
 			shdrs_[SI_INIT_ARRAY].sh_offset = AddrToOff(shdrs_[SI_INIT_ARRAY].sh_addr);
-			//shdrs_[SI_INIT_ARRAY].sh_size = 0;	//ԸDT_INIT_ARRAYSZȡ׼ȷС
+			//shdrs_[SI_INIT_ARRAY].sh_size = 0;	//可以根据DT_INIT_ARRAYSZ获取准确大小
 			shdrs_[SI_INIT_ARRAY].sh_link = 0;
 			shdrs_[SI_INIT_ARRAY].sh_info = 0;
-			shdrs_[SI_INIT_ARRAY].sh_addralign = 4;
-			shdrs_[SI_INIT_ARRAY].sh_entsize = 4;
+			shdrs_[SI_INIT_ARRAY].sh_addralign = sizeof(Elf_Addr);
+			shdrs_[SI_INIT_ARRAY].sh_entsize = sizeof(Elf_Addr);
 
 			DEBUG("[fixShdrFromDynamic] found DT_INIT_ARRAY!");
 			break;
 		case DT_INIT_ARRAYSZ:
-			si_->init_array_count = ((unsigned)d->d_un.d_val) / sizeof(Elf32_Addr);
+			si_->init_array_count = (unsigned)(d->d_un.d_val / sizeof(Elf_Addr));
 
-			shdrs_[SI_INIT_ARRAY].sh_size = d->d_un.d_val;	//ȡ.init_array׼ȷС
+			shdrs_[SI_INIT_ARRAY].sh_size = d->d_un.d_val;	//获取.init_array的准确大小
 
 			DEBUG("[fixShdrFromDynamic] found DT_INIT_ARRAYSZ!");
 			break;
 		case DT_FINI_ARRAY:
-			si_->fini_array = reinterpret_cast<linker_function_t*>(base + d->d_un.d_ptr);
+			si_->fini_array = image.At<linker_function_t>(d->d_un.d_ptr);
 
 			shdrs_[SI_FINI_ARRAY].sh_name = GetShdrName(SI_FINI_ARRAY);
 			shdrs_[SI_FINI_ARRAY].sh_type = SHT_FINI_ARRAY;
 			shdrs_[SI_FINI_ARRAY].sh_flags = SHF_WRITE | SHF_ALLOC;
 			shdrs_[SI_FINI_ARRAY].sh_addr = d->d_un.d_ptr;
 			shdrs_[SI_FINI_ARRAY].sh_offset = AddrToOff(shdrs_[SI_FINI_ARRAY].sh_addr);
-			//shdrs_[SI_FINI_ARRAY].sh_size = 0;	//ԸDT_FINI_ARRAYSZȡ׼ȷС
+			//shdrs_[SI_FINI_ARRAY].sh_size = 0;	//可以根据DT_FINI_ARRAYSZ获取准确大小
 			shdrs_[SI_FINI_ARRAY].sh_link = 0;
 			shdrs_[SI_FINI_ARRAY].sh_info = 0;
-			shdrs_[SI_FINI_ARRAY].sh_addralign = 4;
-			shdrs_[SI_FINI_ARRAY].sh_entsize = 4;
+			shdrs_[SI_FINI_ARRAY].sh_addralign = sizeof(Elf_Addr);
+			shdrs_[SI_FINI_ARRAY].sh_entsize = sizeof(Elf_Addr);
 
 			DEBUG("[fixShdrFromDynamic] found DT_FINI_ARRAY!");
 			break;
 		case DT_FINI_ARRAYSZ:
-			si_->fini_array_count = ((unsigned)d->d_un.d_val) / sizeof(Elf32_Addr);
+			si_->fini_array_count = (unsigned)(d->d_un.d_val / sizeof(Elf_Addr));
 
-			shdrs_[SI_FINI_ARRAY].sh_size = d->d_un.d_val;	//ȡ.fini_array׼ȷС
+			shdrs_[SI_FINI_ARRAY].sh_size = d->d_un.d_val;	//获取.fini_array的准确大小
 
 			DEBUG("[fixShdrFromDynamic] found DT_FINI_ARRAYSZ!");
 			break;
 		case DT_INIT:
-			si_->init_func = reinterpret_cast<linker_function_t>(base + d->d_un.d_ptr);
-			DEBUG("[fixShdrFromDynamic] %s constructors (DT_INIT) found at addr=%p", si_->name, d->d_un.d_ptr);
+			si_->init_func = reinterpret_cast<linker_function_t>(image.At<uint8_t>(d->d_un.d_ptr));
+			DEBUG("[fixShdrFromDynamic] %s constructors (DT_INIT) found at addr=0x%llx", si_->name, (unsigned long long)d->d_un.d_ptr);
 			break;
 		case DT_FINI:
-			si_->fini_func = reinterpret_cast<linker_function_t>(base + d->d_un.d_ptr);
-			DEBUG("[fixShdrFromDynamic] %s destructors (DT_FINI) found at addr=%p", si_->name, d->d_un.d_ptr);
+			si_->fini_func = reinterpret_cast<linker_function_t>(image.At<uint8_t>(d->d_un.d_ptr));
+			DEBUG("[fixShdrFromDynamic] %s destructors (DT_FINI) found at addr=0x%llx", si_->name, (unsigned long long)d->d_un.d_ptr);
 			break;
 		case DT_NEEDED:
 			++needed_count;
@@ -487,9 +616,22 @@ bool ElfFixer::FixShdrFromDynamic()
 		}
 	}
 
-	if (si_->nbucket == 0)
+	if (d == dyn_end)
 	{
-		return false;
+		WARN("[fixShdrFromDynamic] no DT_NULL in %llu entries of PT_DYNAMIC!", (unsigned long long)si_->dynamic_count);
+		shdrs_[SI_DYNAMIC].sh_size = si_->dynamic_count * sizeof(Elf_Dyn);
+	}
+
+	//各表的大小同样来自.dynamic, 限制在表所在的段之内, 之后的遍历都以此为界
+	si_->plt_rel_count = clipTable(SI_RELPLT, si_->plt_rel, si_->plt_rel_count, "DT_PLTRELSZ");
+	si_->rel_count = clipTable(SI_RELDYN, si_->rel, si_->rel_count, "DT_RELSZ");
+	si_->init_array_count = clipTable(SI_INIT_ARRAY, si_->init_array, si_->init_array_count, "DT_INIT_ARRAYSZ");
+	si_->fini_array_count = clipTable(SI_FINI_ARRAY, si_->fini_array, si_->fini_array_count, "DT_FINI_ARRAYSZ");
+
+	//两个哈希表都没有或都损坏时不放弃, .dynsym的大小只由重定位引用的符号确定
+	if (si_->nbucket == 0 && si_->gnu_nbucket == 0)
+	{
+		WARN("[fixShdrFromDynamic] no usable DT_HASH or DT_GNU_HASH, .dynsym sized from relocations only!");
 	}
 	if (si_->strtab == 0)
 	{
@@ -506,16 +648,22 @@ bool ElfFixer::FixShdrFromDynamic()
 	return true;
 }
 
-bool ElfFixer::FixDynstr()
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixDynstr()
 {
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_DYNSTR);
 	DEBUG("[fixDynstr] fix .dynstr...");
-	//.dynamicõַȷ.dynstrڵĴС
-	for (Elf32_Dyn* d = si_->dynamic; d->d_tag != DT_NULL; ++d)
+	//根据.dynamic引用的字符串来确定.dynstr节的大小
+	Elf_Dyn* dyn_end = si_->dynamic + si_->dynamic_count;
+	for (Elf_Dyn* d = si_->dynamic; d < dyn_end && d->d_tag != DT_NULL; ++d)
 	{
 		if (d->d_tag == DT_NEEDED)
 		{
-			const char* library_name = si_->strtab + d->d_un.d_val; //so
-			shdrs_[SI_DYNSTR].sh_size = MAX(shdrs_[SI_DYNSTR].sh_size, d->d_un.d_val + strlen(library_name) + 1);
+			size_t name_size = strSize(d->d_un.d_val); //so库名称, 越界或没有结尾时为0
+			if (name_size != 0)
+			{
+				shdrs_[SI_DYNSTR].sh_size = MAX(shdrs_[SI_DYNSTR].sh_size, d->d_un.d_val + name_size);
+			}
 		}
 	}
 
@@ -523,95 +671,167 @@ bool ElfFixer::FixDynstr()
 	return true;
 }
 
-bool ElfFixer::FixDynsym()
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixDynsym()
 {
-	//޸.dynsym, .dynstrĴС
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_DYNSYM);
+	//修复.dynsym, .dynstr的大小
 	DEBUG("[fixDynsym] fix .dynsym...");
 
 	shdrs_[SI_DYNSYM].sh_size = 0;
 	shdrs_[SI_DYNSYM].sh_info = 1;
-	//ͨ.rel.pltõķȷdynsym, dynstrĽڴС
+	uint64_t visited = 0;	//.hash, .gnu.hash中遍历到的符号数
+	uint64_t ignored = 0;	//越界的符号引用
+	//通过.rel.plt中引用的符号来确定dynsym, dynstr的节大小
 	{
-		Elf32_Rel* rel = si_->plt_rel;
+		Elf_Rel* rel = si_->plt_rel;
 		unsigned count = si_->plt_rel_count;
 
-		Elf32_Sym* symtab = si_->symtab;
-		const char* strtab = si_->strtab;
-
-		//ضλ DT_JMPREL/DT_REL
+		//遍历重定位节 DT_JMPREL/DT_REL
 		for (size_t idx = 0; idx < count; ++idx, ++rel)
 		{
-			unsigned type = ELF32_R_TYPE(rel->r_info);
-			unsigned sym = ELF32_R_SYM(rel->r_info);
-			char* sym_name = NULL;
+			unsigned type = ElfClass::RType(rel->r_info);
+			unsigned sym = ElfClass::RSym(rel->r_info);
 			if (type == 0) // R_*_NONE
 			{
 				continue;
 			}
-			if (sym != 0)
+			if (sym != 0 && !noteSymbol(sym))
 			{
-				sym_name = (char *)(strtab + symtab[sym].st_name); //ȡ
-				shdrs_[SI_DYNSYM].sh_size = MAX(shdrs_[SI_DYNSYM].sh_size, (sym + 1) * sizeof(Elf32_Sym));
-				shdrs_[SI_DYNSTR].sh_size = MAX(shdrs_[SI_DYNSTR].sh_size, symtab[sym].st_name + strlen(sym_name) + 1);
+				ignored++;
 			}
 		}
 	}
 
-	//ͨ.rel.dynõķȷdynsym, dynstrĽڴС
+	//通过.rel.dyn中引用的符号来确定dynsym, dynstr的节大小
 	{
-		Elf32_Rel* rel = si_->rel;
+		Elf_Rel* rel = si_->rel;
 		unsigned count = si_->rel_count;
 
-		Elf32_Sym* symtab = si_->symtab;
-		const char* strtab = si_->strtab;
-
-		//ضλ DT_JMPREL/DT_REL
+		//遍历重定位节 DT_JMPREL/DT_REL
 		for (size_t idx = 0; idx < count; ++idx, ++rel)
 		{
-			unsigned type = ELF32_R_TYPE(rel->r_info);
-			unsigned sym = ELF32_R_SYM(rel->r_info);
-			char* sym_name = NULL;
+			unsigned type = ElfClass::RType(rel->r_info);
+			unsigned sym = ElfClass::RSym(rel->r_info);
 			if (type == 0) // R_*_NONE
 			{
 				continue;
 			}
-			if (sym != 0)
+			if (sym != 0 && !noteSymbol(sym))
 			{
-				sym_name = (char *)(strtab + symtab[sym].st_name); //ȡ
-				shdrs_[SI_DYNSYM].sh_size = MAX(shdrs_[SI_DYNSYM].sh_size, (sym + 1) * sizeof(Elf32_Sym));
-				shdrs_[SI_DYNSTR].sh_size = MAX(shdrs_[SI_DYNSTR].sh_size, symtab[sym].st_name + strlen(sym_name) + 1);
+				ignored++;
 			}
 		}
 	}
 
-	//ͨ.hashõķȷdynsym, dynstrĽڴС
+	//通过.hash中引用的符号来确定dynsym, dynstr的节大小
 	{
-		Elf32_Sym* symtab = si_->symtab;
-		const char* strtab = si_->strtab;
-		char* sym_name = NULL;
-
-		//si->bucket, ѯsym
-		for (unsigned hash = 0; hash < si_->nbucket; hash++)
+		//遍历si->bucket, 查询sym
+		//合法的表中链上的索引都小于nchain, 每个符号只出现一次, 总共最多访问nchain次; 超过说明链有环
+		bool corrupt = false;
+		for (unsigned hash = 0; hash < si_->nbucket && !corrupt; hash++)
 		{
 			for (unsigned n = si_->bucket[hash]; n != 0; n = si_->chain[n])
 			{
-				sym_name = (char *)(strtab + symtab[n].st_name); //ȡ
-				shdrs_[SI_DYNSYM].sh_size = MAX(shdrs_[SI_DYNSYM].sh_size, (n + 1) * sizeof(Elf32_Sym));
-				shdrs_[SI_DYNSTR].sh_size = MAX(shdrs_[SI_DYNSTR].sh_size, symtab[n].st_name + strlen(sym_name) + 1);
+				if (n >= si_->nchain || visited >= si_->nchain)
+				{
+					WARN("[fixDynsym] .hash chain of bucket %u is corrupt (index %u, nchain %llu), stop walking!",
+						hash, n, (unsigned long long)si_->nchain);
+					corrupt = true;
+					break;
+				}
+
+				visited++;
+				if (!noteSymbol(n))
+				{
+					ignored++;
+				}
 			}
 		}
 	}
 
-	//dynsym_õsh_info
-	for (Elf32_Sym *sym = si_->symtab; sym < si_->symtab + (shdrs_[SI_DYNSYM].sh_size / sizeof(Elf32_Sym)); sym++)
+	//通过.gnu.hash中的符号来确定dynsym, dynstr的节大小, 同时得到chain的长度
+	//合法的表中各链互不重叠, 总共最多访问chain_count次; 超过说明有桶指向同一条链
+	if (si_->gnu_nbucket != 0)
 	{
-		if (ELF32_ST_BIND(sym->st_info) == STB_LOCAL && sym->st_shndx != SHN_UNDEF)
+		const ImageView &image = si_->image;
+		size_t chain_count = image.CountTo<uint32_t>(image.ToVaddr(si_->gnu_chain));
+		uint64_t sym_end = si_->gnu_symndx;	//表中最后一个符号的索引加一
+		uint64_t walked = 0;
+		bool corrupt = false;
+		for (size_t hash = 0; hash < si_->gnu_nbucket && !corrupt; hash++)
+		{
+			uint32_t n = si_->gnu_bucket[hash];
+			if (n == 0)
+			{
+				continue;
+			}
+
+			for (;; n++)
+			{
+				if (n < si_->gnu_symndx || n - si_->gnu_symndx >= chain_count || walked >= chain_count)
+				{
+					WARN("[fixDynsym] .gnu.hash chain of bucket %llu is corrupt (index %u, symndx %u), stop walking!",
+						(unsigned long long)hash, n, si_->gnu_symndx);
+					corrupt = true;
+					break;
+				}
+
+				walked++;
+				visited++;
+				if (!noteSymbol(n))
+				{
+					ignored++;
+				}
+				if (si_->gnu_chain[n - si_->gnu_symndx] & 1)
+				{
+					sym_end = MAX(sym_end, (uint64_t)n + 1);
+					break;
+				}
+			}
+		}
+
+		shdrs_[SI_GNU_HASH].sh_size = image.ToVaddr(si_->gnu_chain) - shdrs_[SI_GNU_HASH].sh_addr
+			+ (sym_end - si_->gnu_symndx) * sizeof(uint32_t);
+	}
+
+	if (ignored != 0)
+	{
+		WARN("[fixDynsym] %llu symbol references out of image ignored!", (unsigned long long)ignored);
+	}
+
+	//遍历dynsym_得到sh_info
+	for (Elf_Sym *sym = si_->symtab; sym < si_->symtab + (shdrs_[SI_DYNSYM].sh_size / sizeof(Elf_Sym)); sym++)
+	{
+		if (ELF_ST_BIND(sym->st_info) == STB_LOCAL && sym->st_shndx != SHN_UNDEF)
 		{
 			int local_idx = si_->symtab - sym;
 			shdrs_[SI_DYNSYM].sh_info = local_idx + 1;
 		}
+	}
+
+	if (PhaseStats *stats = log_->stats())
+	{
+		stats->AddRelocs(si_->plt_rel_count + si_->rel_count);
+		stats->AddSymbols(visited);
+	}
 
-		//жַڵĽ, st_shndx
+	DEBUG("[fixDynsym] fix .dynsym Done!");
+	return true;
+}
+
+//节表全部确定后再修正符号的st_shndx
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixSymShndx()
+{
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_SYM_SHNDX);
+	if (PhaseStats *stats = log_->stats())
+	{
+		stats->AddSymbols(shdrs_[SI_DYNSYM].sh_size / sizeof(Elf_Sym));
+	}
+	for (Elf_Sym *sym = si_->symtab; sym < si_->symtab + (shdrs_[SI_DYNSYM].sh_size / sizeof(Elf_Sym)); sym++)
+	{
+		//判断虚拟地址所在的节, 修正st_shndx
 		if (sym->st_shndx != SHN_UNDEF && (sym->st_shndx < SHN_LORESERVE || sym->st_shndx > SHN_HIRESERVE))
 		{
 			sym->st_shndx = FindShIdx(sym->st_value);
@@ -622,72 +842,86 @@ bool ElfFixer::FixDynsym()
 		}
 	}
 
-	DEBUG("[fixDynsym] fix .dynsym Done!");
 	return true;
 }
 
-//޸ܲ׼ȷ, ΪϢȫ, ֻܳ޸
-//ýida, ޸׼ȷĻ
-//ڽڵص, ڲӰIDAķsoĶִ̬, ﲻ
-bool ElfFixer::FixShdrFromShdr()
+//这里的修复可能不够准确, 因为信息不够全, 只能尝试修复
+//最好结合ida人肉修正, 如果修复不准确的话
+//关于节的重叠问题, 由于并不影响IDA的分析和so的动态链接执行, 这里不做处理
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixShdrFromShdr()
 {
-	DEBUG("[fixShdrFromShdr] fix shdr: .plt, .got, .data.rel.ro, .text, .rodata, .data, .bss ...");
-	//޸.plt
-	//޸ʼַ, ַ: 
-	//	1. ͨ16ֽ(shellcode)ұ֪֮
-	//	2. ͨ.rel.pltΪR_ARM_JUMP_SLOTķΧȷ
-	//04 E0 2D E5                 STR             LR, [SP, #  - 4]!
-	//04 E0 9F E5                 LDR             LR, =(_GLOBAL_OFFSET_TABLE_ - 0x5EB0)
-	//0E E0 8F E0                 ADD             LR, PC, LR; _GLOBAL_OFFSET_TABLE_
-	//08 F0 BE E5                 LDR             PC, [LR, #8]!; dword_0
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_SHDR_FROM_SHDR);
+	DEBUG("[fixShdrFromShdr] fix shdr: .plt, .got ...");
+	const ImageView &image = si_->image;
+	//修复.plt
+	//修复起始地址, 两种方法: 
+	//	1. 通过特征码(shellcode, 见ElfClass::plt_code)且必须落在已知节之外
+	//	2. 通过.rel.plt表中类型为JUMP_SLOT的范围来确定
 
 	DEBUG("[fixShdrFromShdr] fix .plt...");
 
-	Elf32_Addr _GLOBAL_OFFSET_TABLE_ = 0;	//_GLOBAL_OFFSET_TABLE_ַ
+	Elf_Addr _GLOBAL_OFFSET_TABLE_ = 0;	//_GLOBAL_OFFSET_TABLE_的虚拟地址
 
-	//޸С = (20 + 12 * .rel.pltĿ);
-	const char plt_code[] = {
-		'\x4', '\xE0', '\x2D', '\xE5',
-		'\x4', '\xE0', '\x9F', '\xE5',
-		'\xE', '\xE0', '\x8F', '\xE0',
-		'\x8', '\xF0', '\xBE', '\xE5'
-	};
+	//修复大小 = (头部大小 + 表项大小 * .rel.plt项目数);
+	size_t plt_code_size = 0;
+	const char *plt_code = ElfClass::plt_code(&plt_code_size);
 
-	//ͨ۲췢, .plt, .gotڱȻ, ΪҪlibc__cxa_atexit, __cxa_finalize
-	int addr = Util::kmpSearch((char *)si_->base, si_->size, plt_code, 16);
-	if (addr == -1)
+	//通过观察发现, .plt节, .got节必然存在, 因为需要调用libc的__cxa_atexit, __cxa_finalize
+	//.plt在可执行的PT_LOAD段内, 只搜索这些段; 段标志被清除(没有可执行段)时才搜索整个镜像
+	uint64_t plt_addr = 0;
+	qint64 scanned = 0;
+	bool found = false;
+	bool has_exec = false;
+	for (size_t i = 0; i < phnum_ && !found; i++)
+	{
+		if (phdr_[i].p_type == PT_LOAD && (phdr_[i].p_flags & PF_X))
+		{
+			has_exec = true;
+			found = searchCode(phdr_[i].p_vaddr, phdr_[i].p_memsz, plt_code, plt_code_size, plt_addr, scanned);
+		}
+	}
+	if (!has_exec)
+	{
+		found = searchCode(image.min_vaddr(), image.size(), plt_code, plt_code_size, plt_addr, scanned);
+	}
+	if (PhaseStats *stats = log_->stats())
 	{
-		DEBUG("[fixShdrFromShdr] fix .plt Fail!");
+		stats->AddScanned(scanned);
+	}
+	if (!found || image.At<uint8_t>(plt_addr, ElfClass::kPltHeaderSize) == nullptr)
+	{
+		WARN("[fixShdrFromShdr] fix .plt Fail!");
 	}
 	else
 	{
 		shdrs_[SI_PLT].sh_name = GetShdrName(SI_PLT);
 		shdrs_[SI_PLT].sh_type = SHT_PROGBITS;
 		shdrs_[SI_PLT].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
-		shdrs_[SI_PLT].sh_addr = addr;
+		shdrs_[SI_PLT].sh_addr = (Elf_Addr)plt_addr;
 		shdrs_[SI_PLT].sh_offset = AddrToOff(shdrs_[SI_PLT].sh_addr);
-		shdrs_[SI_PLT].sh_size = 20 + 12 * (shdrs_[SI_RELPLT].sh_size / sizeof(Elf32_Rel));
+		shdrs_[SI_PLT].sh_size = ElfClass::kPltHeaderSize + ElfClass::kPltEntrySize * (shdrs_[SI_RELPLT].sh_size / sizeof(Elf_Rel));
 		shdrs_[SI_PLT].sh_link = 0;
 		shdrs_[SI_PLT].sh_info = 0;
 		shdrs_[SI_PLT].sh_addralign = 4;
 		shdrs_[SI_PLT].sh_entsize = 0;
 
-		_GLOBAL_OFFSET_TABLE_ = shdrs_[SI_PLT].sh_addr + 16 + *(Elf32_Addr *)(si_->load_bias + shdrs_[SI_PLT].sh_addr + 16);
+		_GLOBAL_OFFSET_TABLE_ = ElfClass::GotFromPlt(image.At<uint8_t>(shdrs_[SI_PLT].sh_addr, ElfClass::kPltHeaderSize), shdrs_[SI_PLT].sh_addr, plt_got_);
 		DEBUG("[fixShdrFromShdr] fix .plt Done!");
 
 		DEBUG("[fixShdrFromShdr] fix .got...");
-		//޸.got, ͨ.rel.dynΪR_ARM_GLOB_DATķΧȷ, С_GLOBAL_OFFSET_TABLE_ַȷ
+		//修复.got, 通过遍历.rel.dyn节中类型为GLOB_DAT的范围来确定, 大小可以由_GLOBAL_OFFSET_TABLE_的虚拟地址确定
 		{
-			Elf32_Addr got_start = _GLOBAL_OFFSET_TABLE_;
-			Elf32_Addr got_end = _GLOBAL_OFFSET_TABLE_ + 12 + 4 * (shdrs_[SI_RELPLT].sh_size / sizeof(Elf32_Rel));
+			Elf_Addr got_start = _GLOBAL_OFFSET_TABLE_;
+			Elf_Addr got_end = _GLOBAL_OFFSET_TABLE_ + 3 * sizeof(Elf_Addr) + sizeof(Elf_Addr) * (shdrs_[SI_RELPLT].sh_size / sizeof(Elf_Rel));
 
-			Elf32_Rel* rel = si_->rel;
+			Elf_Rel* rel = si_->rel;
 			unsigned count = si_->rel_count;
 
 			for (size_t idx = 0; idx < count; ++idx, ++rel)
 			{
-				unsigned type = ELF32_R_TYPE(rel->r_info);
-				if (type == R_ARM_GLOB_DAT)
+				unsigned type = ElfClass::RType(rel->r_info);
+				if (type == ElfClass::kRelGlobDat)
 				{
 					got_start = MIN(got_start, rel->r_offset);
 				}
@@ -701,373 +935,476 @@ bool ElfFixer::FixShdrFromShdr()
 			shdrs_[SI_GOT].sh_size = got_end - got_start;
 			shdrs_[SI_GOT].sh_link = 0;
 			shdrs_[SI_GOT].sh_info = 0;
-			shdrs_[SI_GOT].sh_addralign = 4;
+			shdrs_[SI_GOT].sh_addralign = sizeof(Elf_Addr);
 			shdrs_[SI_GOT].sh_entsize = 0;
 
 			DEBUG("[fixShdrFromShdr] fix .got Done!");
 		}
 	}
 
-	//޸ƺп, ʱЩζ, ͬע...
+	DEBUG("[fixShdrFromShdr] fix Done!");
+	return true;
+}
+
+//重定位密度分析: 一次遍历.rel.dyn, 把可写PT_LOAD段内被ABS/RELATIVE重定位的字记到位图中,
+//再扫描位图得到密集区间(相邻重定位字的间隔不超过kRelRunMaxHole个字, 至少kRelRunMinWords个字)
+//指针表(.data.rel.ro, .init_array)几乎每个字都被重定位, 而零散的指针不会形成密集区间,
+//避免了简单地取所有重定位地址的最小/最大值而把无关的数据包含进来
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixShdrFromRelDensity()
+{
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_SHDR_FROM_REL_DENSITY);
+	DEBUG("[fixShdrFromRelDensity] fix shdr: .data.rel.ro, .init_array ...");
+
+	static const size_t kRelRunMaxHole = 1;
+	static const size_t kRelRunMinWords = 4;
+
+	const ImageView &image = si_->image;
+	const size_t word = sizeof(Elf_Addr);
 
-	//޸.data.rel.ro, ͨ.rel.dynΪR_ARM_ABS32ķΧȷ, ʼַ-4
-	if(0)
+	//每个可写段一张位图, 一个位对应一个字
+	struct SegBitmap
 	{
-		DEBUG("[fixShdrFromShdr] fix .data.rel.ro...");
-		Elf32_Addr data_rel_ro_start = 0;
-		Elf32_Addr data_rel_ro_end = 0;
+		Elf_Addr start;
+		Elf_Addr end;
+		std::vector<uint32_t> bits;
+		std::vector<uint32_t> func;	//该字的重定位目标是否在可执行段内
+	};
+	std::vector<SegBitmap> segs;
+	std::vector<std::pair<Elf_Addr, Elf_Addr> > exec_ranges;
 
-		Elf32_Rel* rel = si_->rel;
-		unsigned count = si_->rel_count;
+	for (size_t i = 0; i < phnum_; i++)
+	{
+		const Elf_Phdr *phdr = &phdr_[i];
+		if (phdr->p_type != PT_LOAD)
+		{
+			continue;
+		}
 
-		for (size_t idx = 0; idx < count; ++idx, ++rel)
+		if (phdr->p_flags & PF_X)
 		{
-			unsigned type = ELF32_R_TYPE(rel->r_info);
-			if (type == R_ARM_ABS32)
-			{
-				if (data_rel_ro_start == 0)
-				{
-					data_rel_ro_start = rel->r_offset - 4;
-					data_rel_ro_end = rel->r_offset + 4;
-				}
-				else
-				{
-					data_rel_ro_start = MIN(data_rel_ro_start, rel->r_offset - 4);
-					data_rel_ro_end = MAX(data_rel_ro_end, rel->r_offset + 4);
-				}			
-			}
+			exec_ranges.push_back(std::make_pair(phdr->p_vaddr, phdr->p_vaddr + phdr->p_memsz));
 		}
 
-		if (data_rel_ro_start != 0
-			&& !FindShIdx(data_rel_ro_start) 
-			&& !FindShIdx(data_rel_ro_end - 1))
+		if (phdr->p_flags & PF_W)
 		{
-			shdrs_[SI_DATA_REL_RO].sh_name = GetShdrName(SI_DATA_REL_RO);
-			shdrs_[SI_DATA_REL_RO].sh_type = SHT_PROGBITS;
-			shdrs_[SI_DATA_REL_RO].sh_flags = SHF_ALLOC | SHF_WRITE;
-			shdrs_[SI_DATA_REL_RO].sh_addr = data_rel_ro_start;
-			shdrs_[SI_DATA_REL_RO].sh_offset = AddrToOff(shdrs_[SI_DATA_REL_RO].sh_addr);
-			shdrs_[SI_DATA_REL_RO].sh_size = data_rel_ro_end - data_rel_ro_start;
-			shdrs_[SI_DATA_REL_RO].sh_link = 0;
-			shdrs_[SI_DATA_REL_RO].sh_info = 0;
-			shdrs_[SI_DATA_REL_RO].sh_addralign = 4;
-			shdrs_[SI_DATA_REL_RO].sh_entsize = 0;
-
-			DEBUG("[fixShdrFromShdr] fix .data.rel.ro Done!");
+			SegBitmap seg;
+			seg.start = phdr->p_vaddr & ~(Elf_Addr)(word - 1);
+			seg.end = phdr->p_vaddr + phdr->p_filesz;
+			size_t words = (size_t)((seg.end - seg.start + word - 1) / word);
+			seg.bits.assign((words + 31) / 32, 0);
+			seg.func.assign((words + 31) / 32, 0);
+			segs.push_back(seg);
 		}
 	}
 
-	//޸.text, 򵥵Ľ.plt/.rel.plt/.rel.dyn/.hash֮.ARM.exidx/.fini_array/.init_array/.data.rel.ro/.dynamic֮ĽΪ.text, ֮ͨIDA޸
-	if (0)
+	if (segs.empty() || si_->rel == nullptr)
 	{
-		DEBUG("[fixShdrFromShdr] fix .text...");
-
-		Elf32_Shdr *start_shdr = nullptr;
-		Elf32_Shdr *end_shdr = nullptr;
+		return true;
+	}
 
-		if (shdrs_[SI_PLT].sh_type)
-		{
-			start_shdr = &shdrs_[SI_PLT];
-		}
-		else if (shdrs_[SI_RELPLT].sh_type)
-		{
-			start_shdr = &shdrs_[SI_RELPLT];
-		}
-		else if (shdrs_[SI_RELDYN].sh_type)
-		{
-			start_shdr = &shdrs_[SI_RELDYN];
-		}
-		else if (shdrs_[SI_HASH].sh_type)
+	//一次遍历重定位表
+	Elf_Rel* rel = si_->rel;
+	unsigned count = si_->rel_count;
+	for (size_t idx = 0; idx < count; ++idx, ++rel)
+	{
+		unsigned type = ElfClass::RType(rel->r_info);
+		if (type != ElfClass::kRelAbs && type != ElfClass::kRelRelative)
 		{
-			start_shdr = &shdrs_[SI_HASH];
+			continue;
 		}
 
-		if (shdrs_[SI_ARMEXIDX].sh_type)
-		{
-			end_shdr = &shdrs_[SI_ARMEXIDX];
-		}
-		else if (shdrs_[SI_FINI_ARRAY].sh_type)
-		{
-			end_shdr = &shdrs_[SI_FINI_ARRAY];
-		}
-		else if (shdrs_[SI_INIT_ARRAY].sh_type)
-		{
-			end_shdr = &shdrs_[SI_INIT_ARRAY];
-		}
-		else if (shdrs_[SI_DATA_REL_RO].sh_type)
+		for (size_t s = 0; s < segs.size(); s++)
 		{
-			end_shdr = &shdrs_[SI_DATA_REL_RO];
-		}
-		else if (shdrs_[SI_DYNAMIC].sh_type)
-		{
-			end_shdr = &shdrs_[SI_DYNAMIC];
-		}
+			SegBitmap &seg = segs[s];
+			if (rel->r_offset < seg.start || rel->r_offset >= seg.end || (rel->r_offset & (word - 1)))
+			{
+				continue;
+			}
 
-		Elf32_Off start_off = ALIGN(start_shdr->sh_offset + start_shdr->sh_size, 4);
-		Elf32_Addr start_addr = OffToAddr(start_off);
-		Elf32_Addr end_addr = start_addr + end_shdr->sh_offset - start_off;
+			size_t bit = (size_t)((rel->r_offset - seg.start) / word);
+			seg.bits[bit / 32] |= 1u << (bit % 32);
 
-		if (start_shdr && end_shdr &&
-			(ALIGN(start_shdr->sh_offset + start_shdr->sh_size, end_shdr->sh_addralign) != end_shdr->sh_offset)
-			&& !FindShIdx(start_addr)
-			&& !FindShIdx(end_addr - 1))
-		{
-			shdrs_[SI_TEXT].sh_name = GetShdrName(SI_TEXT);
-			shdrs_[SI_TEXT].sh_type = SHT_PROGBITS;
-			shdrs_[SI_TEXT].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
-			shdrs_[SI_TEXT].sh_offset = start_off;
-			shdrs_[SI_TEXT].sh_addr = OffToAddr(shdrs_[SI_TEXT].sh_offset);
-			shdrs_[SI_TEXT].sh_size = end_shdr->sh_offset - shdrs_[SI_TEXT].sh_offset;
-			shdrs_[SI_TEXT].sh_link = 0;
-			shdrs_[SI_TEXT].sh_info = 0;
-			shdrs_[SI_TEXT].sh_addralign = 4;
-			shdrs_[SI_TEXT].sh_entsize = 0;
-
-			DEBUG("[fixShdrFromShdr] fix .text Done!");
+			//计算重定位目标, 判断是否为函数指针; 外部符号不是本so中的函数
+			unsigned sym = ElfClass::RSym(rel->r_info);
+			const Elf_Sym *symbol = sym != 0 ? symbolAt(sym) : nullptr;
+			if (sym != 0 && (symbol == nullptr || symbol->st_shndx == SHN_UNDEF))
+			{
+				break;
+			}
+
+			//REL的加数是重定位前的字: dump中已加上load_bias和符号值, 先减去;
+			//dump-from-normal的load_bias未知, 与FixRel相同从正常so读取
+			Elf_Addr stored = 0;
+			if (dump_bias_)
+			{
+				const Elf_Addr *place = image.At<const Elf_Addr>(rel->r_offset);
+				stored = place ? *place - dump_bias_ - (symbol ? symbol->st_value : 0) : 0;
+			}
+			else
+			{
+				readRef(AddrToOff(rel->r_offset), &stored, sizeof(Elf_Addr));
+			}
+			Elf_Addr target = ElfClass::Addend(*rel, stored) + (symbol ? symbol->st_value : 0);
+
+			for (size_t e = 0; e < exec_ranges.size(); e++)
+			{
+				if (target >= exec_ranges[e].first && target < exec_ranges[e].second)
+				{
+					seg.func[bit / 32] |= 1u << (bit % 32);
+					break;
+				}
+			}
+			break;
 		}
 	}
 
-	//޸.rodata, 򵥵Ľ.ARM.exidx/.text/.plt/.rel.plt/.rel.dyn/.hash֮fini_array/.init_array/.data.rel.ro/.dynamic֮Ϊ.rodata
-	if (0)
+	//扫描位图得到密集区间, 全0的32位块整体跳过
+	std::vector<RelRun> runs;
+	for (size_t s = 0; s < segs.size(); s++)
 	{
-		DEBUG("[fixShdrFromShdr] fix .rodata...");
+		const SegBitmap &seg = segs[s];
+		size_t words = seg.bits.size() * 32;
+		RelRun run = { 0, 0, 0, 0 };
+		size_t last = 0;
 
-		Elf32_Shdr *start_shdr = nullptr;
-		Elf32_Shdr *end_shdr = nullptr;
-
-		if (shdrs_[SI_ARMEXIDX].sh_type)
+		for (size_t bit = 0; bit < words; bit++)
 		{
-			start_shdr = &shdrs_[SI_ARMEXIDX];
+			if (seg.bits[bit / 32] == 0)
+			{
+				bit = bit / 32 * 32 + 31;
+				continue;
+			}
+			if ((seg.bits[bit / 32] & (1u << (bit % 32))) == 0)
+			{
+				continue;
+			}
+
+			Elf_Addr addr = seg.start + bit * word;
+			if (run.count != 0 && bit - last > kRelRunMaxHole + 1)
+			{
+				if (run.count >= kRelRunMinWords)
+				{
+					runs.push_back(run);
+				}
+				run.count = 0;
+			}
+
+			if (run.count == 0)
+			{
+				run.start = addr;
+				run.func = 0;
+			}
+			run.end = addr + word;
+			run.count++;
+			if (seg.func[bit / 32] & (1u << (bit % 32)))
+			{
+				run.func++;
+			}
+			last = bit;
 		}
-		else if (shdrs_[SI_TEXT].sh_type)
+
+		if (run.count >= kRelRunMinWords)
 		{
-			start_shdr = &shdrs_[SI_TEXT];
+			runs.push_back(run);
 		}
-		else if (shdrs_[SI_PLT].sh_type)
+	}
+
+	DEBUG("[fixShdrFromRelDensity] %d dense relocation runs", (int)runs.size());
+
+	//没有DT_INIT_ARRAY时, 地址最低的全部为函数指针的区间视为.init_array候选
+	if (shdrs_[SI_INIT_ARRAY].sh_type == SHT_NULL)
+	{
+		for (size_t i = 0; i < runs.size(); i++)
 		{
-			start_shdr = &shdrs_[SI_PLT];
+			if (runs[i].func == runs[i].count
+				&& runs[i].count == (runs[i].end - runs[i].start) / word
+				&& !FindShIdx(runs[i].start) && !FindShIdx(runs[i].end - 1))
+			{
+				const Elf_Phdr *phdr = FindLoadPhdr(runs[i].start);
+				FillGapShdr(SI_INIT_ARRAY, SHT_INIT_ARRAY, SHF_ALLOC | SHF_WRITE, phdr, runs[i].start, runs[i].end, word);
+				shdrs_[SI_INIT_ARRAY].sh_entsize = word;
+				runs.erase(runs.begin() + i);
+				break;
+			}
 		}
-		else if (shdrs_[SI_RELPLT].sh_type)
+	}
+
+	//最大的且不与已知节重叠的区间视为.data.rel.ro
+	if (shdrs_[SI_DATA_REL_RO].sh_type == SHT_NULL)
+	{
+		size_t best = runs.size();
+		for (size_t i = 0; i < runs.size(); i++)
 		{
-			start_shdr = &shdrs_[SI_RELPLT];
+			if (FindShIdx(runs[i].start) || FindShIdx(runs[i].end - 1))
+			{
+				continue;
+			}
+			if (best == runs.size() || runs[i].end - runs[i].start > runs[best].end - runs[best].start)
+			{
+				best = i;
+			}
 		}
-		else if (shdrs_[SI_RELDYN].sh_type)
+
+		if (best != runs.size())
 		{
-			start_shdr = &shdrs_[SI_RELDYN];
+			const Elf_Phdr *phdr = FindLoadPhdr(runs[best].start);
+			FillGapShdr(SI_DATA_REL_RO, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, phdr, runs[best].start, runs[best].end, word);
 		}
-		else if (shdrs_[SI_HASH].sh_type)
+	}
+
+	DEBUG("[fixShdrFromRelDensity] fix Done!");
+	return true;
+}
+
+//节布局推断: 已知的节按地址排序一次, 然后对每个PT_LOAD段做一次扫描, 收集已知节之间的空隙,
+//再根据段的权限(PF_X/PF_W)把空隙分配给.text, .rodata, .data.rel.ro, .data, .bss
+//复杂度为O(n log n), n为已知节的数量
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixShdrFromLayout()
+{
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_SHDR_FROM_LAYOUT);
+	DEBUG("[fixShdrFromLayout] fix shdr: .text, .rodata, .data.rel.ro, .data, .bss ...");
+
+	int known[SI_MAX];
+	int known_count = 0;
+	for (int i = SI_NULL + 1; i < SI_MAX; i++)
+	{
+		if (shdrs_[i].sh_type != SHT_NULL && (shdrs_[i].sh_flags & SHF_ALLOC) && shdrs_[i].sh_size > 0)
 		{
-			start_shdr = &shdrs_[SI_HASH];
+			known[known_count++] = i;
 		}
-	
-		if (shdrs_[SI_FINI_ARRAY].sh_type)
+	}
+
+	std::sort(known, known + known_count, [this](int a, int b) {
+		return shdrs_[a].sh_addr < shdrs_[b].sh_addr;
+	});
+
+	std::vector<Gap> gaps;
+	for (size_t i = 0; i < phnum_; i++)
+	{
+		const Elf_Phdr *phdr = &phdr_[i];
+		if (phdr->p_type != PT_LOAD)
 		{
-			end_shdr = &shdrs_[SI_FINI_ARRAY];
+			continue;
 		}
-		else if (shdrs_[SI_INIT_ARRAY].sh_type)
+
+		Elf_Addr seg_start = phdr->p_vaddr;
+		Elf_Addr seg_file_end = seg_start + phdr->p_filesz;
+		Elf_Addr seg_end = seg_start + phdr->p_memsz;
+
+		//第一个落在段内的已知节
+		int *first = std::lower_bound(known, known + known_count, seg_start, [this](int idx, Elf_Addr addr) {
+			return shdrs_[idx].sh_addr < addr;
+		});
+
+		//文件偏移为0的段以Elf头部和程序头开始, 第一个已知节之前的部分不算空隙
+		bool started = phdr->p_offset != 0;
+		Elf_Addr cursor = seg_start;
+
+		gaps.clear();
+		for (int *k = first; k < known + known_count && shdrs_[*k].sh_addr < seg_end; k++)
 		{
-			end_shdr = &shdrs_[SI_INIT_ARRAY];
+			const Elf_Shdr &shdr = shdrs_[*k];
+			if (started && shdr.sh_addr > cursor)
+			{
+				Gap gap = { cursor, shdr.sh_addr, *k };
+				gaps.push_back(gap);
+			}
+
+			started = true;
+			cursor = MAX(cursor, shdr.sh_addr + shdr.sh_size);
 		}
-		else if (shdrs_[SI_DATA_REL_RO].sh_type)
+
+		if (!started)
 		{
-			end_shdr = &shdrs_[SI_DATA_REL_RO];
+			continue;
 		}
-		else if (shdrs_[SI_DYNAMIC].sh_type)
+
+		//段尾有文件映射的部分
+		if (cursor < seg_file_end)
 		{
-			end_shdr = &shdrs_[SI_DYNAMIC];
+			Gap gap = { cursor, seg_file_end, SI_NULL };
+			gaps.push_back(gap);
 		}
-		
-		Elf32_Off start_off = ALIGN(start_shdr->sh_offset + start_shdr->sh_size, 16);
-		Elf32_Addr start_addr = OffToAddr(start_off);
-		Elf32_Addr end_addr = start_addr + end_shdr->sh_offset - start_off;
-
-		if (end_shdr && start_shdr &&
-			(ALIGN(start_shdr->sh_offset + start_shdr->sh_size, end_shdr->sh_addralign) != end_shdr->sh_offset)
-			&& !FindShIdx(start_addr)
-			&& !FindShIdx(end_addr - 1))
+
+		AssignGaps(phdr, gaps);
+
+		//段尾没有文件映射的部分视为.bss
+		Elf_Addr bss_start = MAX(cursor, seg_file_end);
+		if ((phdr->p_flags & PF_W) && bss_start < seg_end && shdrs_[SI_BSS].sh_type == SHT_NULL)
 		{
-			shdrs_[SI_RODATA].sh_name = GetShdrName(SI_RODATA);
-			shdrs_[SI_RODATA].sh_type = SHT_PROGBITS;
-			shdrs_[SI_RODATA].sh_flags = SHF_ALLOC;
-			shdrs_[SI_RODATA].sh_offset = start_off;
-			shdrs_[SI_RODATA].sh_addr = OffToAddr(shdrs_[SI_RODATA].sh_offset);
-			shdrs_[SI_RODATA].sh_size = end_shdr->sh_offset - shdrs_[SI_RODATA].sh_offset;
-			shdrs_[SI_RODATA].sh_link = 0;
-			shdrs_[SI_RODATA].sh_info = 0;
-			shdrs_[SI_RODATA].sh_addralign = 16;
-			shdrs_[SI_RODATA].sh_entsize = 0;
-
-			DEBUG("[fixShdrFromShdr] fix .rodata Done!");
+			FillGapShdr(SI_BSS, SHT_NOBITS, SHF_ALLOC | SHF_WRITE, phdr, bss_start, seg_end, 16);
 		}
 	}
 
-	//޸.data, 򵥵Ľ.got/.dynamic֮󵽿ɼضεʵļӳ䷶ΧΪ.data
-	if (0)
+	DEBUG("[fixShdrFromLayout] fix Done!");
+	return true;
+}
+
+template <typename ElfClass>
+void ElfFixer<ElfClass>::AssignGaps(const Elf_Phdr *phdr, const std::vector<Gap> &gaps)
+{
+	if (gaps.empty())
 	{
-		DEBUG("[fixShdrFromShdr] fix .data...");
+		return;
+	}
 
-		Elf32_Shdr *start_shdr = nullptr;
-		Elf32_Addr end_off = 0;
-		if (shdrs_[SI_GOT].sh_type)
-		{
-			start_shdr = &shdrs_[SI_GOT];
-		}
-		else if (shdrs_[SI_DYNAMIC].sh_type)
+	if (phdr->p_flags & PF_X)
+	{
+		//.text: .plt之后的第一个空隙, 如果.plt在代码之后(lld)则取最大的空隙
+		//.rodata: .text之后的下一个空隙
+		size_t text = gaps.size();
+		if (shdrs_[SI_TEXT].sh_type == SHT_NULL)
 		{
-			start_shdr = &shdrs_[SI_DYNAMIC];
-		}
-
-		const Elf32_Phdr* phdr = si_->phdr;
-		const Elf32_Phdr* phdr_limit = phdr + si_->phnum;
+			Elf_Addr plt_end = shdrs_[SI_PLT].sh_type ? shdrs_[SI_PLT].sh_addr + shdrs_[SI_PLT].sh_size : 0;
+			for (size_t i = 0; i < gaps.size(); i++)
+			{
+				if (gaps[i].start >= plt_end)
+				{
+					text = i;
+					break;
+				}
+			}
 
-		for (phdr = si_->phdr; phdr < phdr_limit; phdr++)
-		{
-			if (phdr->p_type != PT_LOAD)
+			if (text == gaps.size())
 			{
-				continue;
+				text = 0;
+				for (size_t i = 1; i < gaps.size(); i++)
+				{
+					if (gaps[i].end - gaps[i].start > gaps[text].end - gaps[text].start)
+					{
+						text = i;
+					}
+				}
 			}
 
-			end_off = MAX(end_off, phdr->p_offset + phdr->p_filesz);
+			FillGapShdr(SI_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, phdr, gaps[text].start, gaps[text].end, 4);
 		}
 
-		Elf32_Off start_off = ALIGN(start_shdr->sh_offset + start_shdr->sh_size, 4);
-		Elf32_Addr start_addr = OffToAddr(start_off);
-		Elf32_Addr end_addr = start_addr + end_off - start_off;
-
-		if (start_shdr
-			&& !FindShIdx(start_addr)
-			&& !FindShIdx(end_addr - 1))
+		if (text + 1 < gaps.size() && shdrs_[SI_RODATA].sh_type == SHT_NULL)
 		{
-			shdrs_[SI_DATA].sh_name = GetShdrName(SI_DATA);
-			shdrs_[SI_DATA].sh_type = SHT_PROGBITS;
-			shdrs_[SI_DATA].sh_flags = SHF_ALLOC | SHF_WRITE;
-			shdrs_[SI_DATA].sh_offset = start_off;
-			shdrs_[SI_DATA].sh_addr = OffToAddr(shdrs_[SI_DATA].sh_offset);
-			shdrs_[SI_DATA].sh_size = end_off - shdrs_[SI_DATA].sh_offset;
-			shdrs_[SI_DATA].sh_link = 0;
-			shdrs_[SI_DATA].sh_info = 0;
-			shdrs_[SI_DATA].sh_addralign = 4;
-			shdrs_[SI_DATA].sh_entsize = 0;
-
-			DEBUG("[fixShdrFromShdr] fix .data Done!");
+			FillGapShdr(SI_RODATA, SHT_PROGBITS, SHF_ALLOC, phdr, gaps[text + 1].start, gaps[text + 1].end, 16);
 		}
 	}
-
-	//޸.bss, 򵥵Ľ.data/.got/.dynamic֮󵽿ɼضεʵڴַΪ.bss
-	if (0)
+	else if (phdr->p_flags & PF_W)
 	{
-		DEBUG("[fixShdrFromShdr] fix .bss...");
-
-		Elf32_Shdr *start_shdr = &shdrs_[SI_DATA];
-		Elf32_Addr end_addr = 0;
-
-		if (shdrs_[SI_DATA].sh_type)
-		{
-			start_shdr = &shdrs_[SI_DATA];
-		}
-		else if (shdrs_[SI_GOT].sh_type)
-		{
-			start_shdr = &shdrs_[SI_GOT];
-		}
-		else if (shdrs_[SI_DYNAMIC].sh_type)
+		//.data.rel.ro: 紧挨在.dynamic之前的空隙
+		//.data: 段尾有文件映射的空隙
+		for (size_t i = 0; i < gaps.size(); i++)
 		{
-			start_shdr = &shdrs_[SI_DYNAMIC];
+			if (gaps[i].next == SI_DYNAMIC && shdrs_[SI_DATA_REL_RO].sh_type == SHT_NULL)
+			{
+				FillGapShdr(SI_DATA_REL_RO, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, phdr, gaps[i].start, gaps[i].end, sizeof(Elf_Addr));
+			}
+			else if (gaps[i].next == SI_NULL && shdrs_[SI_DATA].sh_type == SHT_NULL)
+			{
+				FillGapShdr(SI_DATA, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, phdr, gaps[i].start, gaps[i].end, sizeof(Elf_Addr));
+			}
 		}
-
-		const Elf32_Phdr* phdr = si_->phdr;
-		const Elf32_Phdr* phdr_limit = phdr + si_->phnum;
-
-		for (phdr = si_->phdr; phdr < phdr_limit; phdr++)
+	}
+	else if (shdrs_[SI_RODATA].sh_type == SHT_NULL)
+	{
+		//只读段(lld将.rodata单独放在一个段中): 取最大的空隙
+		size_t rodata = 0;
+		for (size_t i = 1; i < gaps.size(); i++)
 		{
-			if (phdr->p_type != PT_LOAD)
+			if (gaps[i].end - gaps[i].start > gaps[rodata].end - gaps[rodata].start)
 			{
-				continue;
+				rodata = i;
 			}
-
-			end_addr = MAX(end_addr, phdr->p_paddr + phdr->p_memsz);
 		}
 
-		Elf32_Addr start_addr = ALIGN(start_shdr->sh_addr + start_shdr->sh_size, 16);
-
-		if (start_shdr
-			&& !FindShIdx(start_addr)
-			&& !FindShIdx(end_addr - 1))
-		{
-			shdrs_[SI_BSS].sh_name = GetShdrName(SI_BSS);
-			shdrs_[SI_BSS].sh_type = SHT_NOBITS;
-			shdrs_[SI_BSS].sh_flags = SHF_ALLOC | SHF_WRITE;
-			shdrs_[SI_BSS].sh_addr = ALIGN(start_shdr->sh_addr + start_shdr->sh_size, 16);
-			shdrs_[SI_BSS].sh_offset = ALIGN(start_shdr->sh_offset + start_shdr->sh_size, 16);
-			shdrs_[SI_BSS].sh_size = end_addr - shdrs_[SI_BSS].sh_addr;
-			shdrs_[SI_BSS].sh_link = 0;
-			shdrs_[SI_BSS].sh_info = 0;
-			shdrs_[SI_BSS].sh_addralign = 16;
-			shdrs_[SI_BSS].sh_entsize = 0;
+		FillGapShdr(SI_RODATA, SHT_PROGBITS, SHF_ALLOC, phdr, gaps[rodata].start, gaps[rodata].end, 16);
+	}
+}
 
-			DEBUG("[fixShdrFromShdr] fix .bss Done!");
-		}	
+template <typename ElfClass>
+void ElfFixer<ElfClass>::FillGapShdr(int idx, Elf_Word type, Elf_Word flags, const Elf_Phdr *phdr,
+	Elf_Addr start, Elf_Addr end, Elf_Word align)
+{
+	start = ALIGN(start, (Elf_Addr)align);
+	if (start >= end)
+	{
+		return;
 	}
 
-	DEBUG("[fixShdrFromShdr] fix Done!");
-	return true;
+	shdrs_[idx].sh_name = GetShdrName(idx);
+	shdrs_[idx].sh_type = type;
+	shdrs_[idx].sh_flags = flags;
+	shdrs_[idx].sh_addr = start;
+	shdrs_[idx].sh_offset = phdr->p_offset + (start - phdr->p_vaddr);	//.bss的偏移同样按段内偏移计算
+	shdrs_[idx].sh_size = end - start;
+	shdrs_[idx].sh_link = 0;
+	shdrs_[idx].sh_info = 0;
+	shdrs_[idx].sh_addralign = align;
+	shdrs_[idx].sh_entsize = 0;
+
+	DEBUG("[fixShdrFromLayout] fix %s Done!", ElfClass::shstrtab(nullptr) + shdrs_[idx].sh_name);
 }
 
-//soļ.rel.dyn, .rel.plt޸Ҫضλĵַ
-bool ElfFixer::FixRel()
+//根据正常so文件的.rel.dyn, .rel.plt修复需要重定位的地址
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixRel()
 {
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_REL);
+	const ImageView &image = si_->image;
+	if (PhaseStats *stats = log_->stats())
+	{
+		stats->AddRelocs(si_->plt_rel_count + si_->rel_count);
+	}
+
 	//.rel.plt
 	{
-		Elf32_Rel* rel = si_->plt_rel;
+		Elf_Rel* rel = si_->plt_rel;
 		unsigned count = si_->plt_rel_count;
 
-		Elf32_Sym* symtab = si_->symtab;
+		Elf_Sym* symtab = si_->symtab;
 		const char* strtab = si_->strtab;
 
-		//ضλ DT_JMPREL/DT_REL
+		//遍历重定位节 DT_JMPREL/DT_REL
 		for (size_t idx = 0; idx < count; ++idx, ++rel)
 		{
-			unsigned type = ELF32_R_TYPE(rel->r_info);
-			unsigned sym = ELF32_R_SYM(rel->r_info);
-			Elf32_Addr reloc = static_cast<Elf32_Addr>(rel->r_offset + si_->load_bias);	//Ҫضλĵַ
+			unsigned type = ElfClass::RType(rel->r_info);
+			unsigned sym = ElfClass::RSym(rel->r_info);
+			Elf_Addr* reloc = image.At<Elf_Addr>(rel->r_offset);	//需要重定位的地址
 
-			if (type == 0) // R_*_NONE
+			if (type == 0 || reloc == nullptr) // R_*_NONE或越界
 			{
 				continue;
 			}
 			
-			Elf32_Addr addr = 0;
-			sofile_.seek(AddrToOff(rel->r_offset));
-			sofile_.read((char *)&addr, sizeof(Elf32_Addr));
+			Elf_Addr addr = 0;
+			readRef(AddrToOff(rel->r_offset), &addr, sizeof(Elf_Addr));
 
-			*reinterpret_cast<Elf32_Addr*>(reloc) = addr;
+			*reloc = addr;
 		}
 	}
 
 	//.rel.dyn
 	{
-		Elf32_Rel* rel = si_->rel;
+		Elf_Rel* rel = si_->rel;
 		unsigned count = si_->rel_count;
 
-		Elf32_Sym* symtab = si_->symtab;
+		Elf_Sym* symtab = si_->symtab;
 		const char* strtab = si_->strtab;
 
-		//ضλ DT_JMPREL/DT_REL
+		//遍历重定位节 DT_JMPREL/DT_REL
 		for (size_t idx = 0; idx < count; ++idx, ++rel)
 		{
-			unsigned type = ELF32_R_TYPE(rel->r_info);
-			unsigned sym = ELF32_R_SYM(rel->r_info);
-			Elf32_Addr reloc = static_cast<Elf32_Addr>(rel->r_offset + si_->load_bias);	//Ҫضλĵַ
+			unsigned type = ElfClass::RType(rel->r_info);
+			unsigned sym = ElfClass::RSym(rel->r_info);
+			Elf_Addr* reloc = image.At<Elf_Addr>(rel->r_offset);	//需要重定位的地址
 
-			if (type == 0) // R_*_NONE
+			if (type == 0 || reloc == nullptr) // R_*_NONE或越界
 			{
 				continue;
 			}
 
-			Elf32_Addr addr = 0;
-			sofile_.seek(AddrToOff(rel->r_offset));
-			sofile_.read((char *)&addr, sizeof(Elf32_Addr));
+			Elf_Addr addr = 0;
+			readRef(AddrToOff(rel->r_offset), &addr, sizeof(Elf_Addr));
 
-			*reinterpret_cast<Elf32_Addr*>(reloc) = addr;
+			*reloc = addr;
 		}
 	}
 
@@ -1075,11 +1412,201 @@ bool ElfFixer::FixRel()
 }
 
 
-Elf32_Off ElfFixer::AddrToOff(Elf32_Addr addr)
+//把需要还原的地址收集起来排序, 地址连续的一段直接在镜像上批量减去dump_bias_
+//.rel.dyn通常已按r_offset排序, 这时不再排序
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::FixRelFromBias()
 {
-	const Elf32_Phdr* phdr = si_->phdr;
-	const Elf32_Phdr* phdr_limit = phdr + si_->phnum;
-	Elf32_Off off = -1;
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_REL);
+	DEBUG("[fixRelFromBias] unbias relocated words, load_bias: 0x%llx", (unsigned long long)dump_bias_);
+
+	const ImageView &image = si_->image;
+	const Elf_Addr word = sizeof(Elf_Addr);
+	std::vector<Elf_Addr> offsets;
+	offsets.reserve(si_->rel_count + si_->init_array_count + si_->fini_array_count);
+
+	Elf_Rel* rel = si_->rel;
+	for (size_t idx = 0; rel && idx < si_->rel_count; ++idx, ++rel)
+	{
+		unsigned type = ElfClass::RType(rel->r_info);
+		unsigned sym = ElfClass::RSym(rel->r_info);
+		const Elf_Sym *s = sym != 0 ? symbolAt(sym) : nullptr;
+		if (type == ElfClass::kRelRelative
+			|| (type == ElfClass::kRelAbs && s && s->st_shndx != SHN_UNDEF))
+		{
+			offsets.push_back(rel->r_offset);
+		}
+	}
+
+	//.init_array, .fini_array中的0和-1不是地址
+	const int arrays[] = { SI_INIT_ARRAY, SI_FINI_ARRAY };
+	for (int a = 0; a < 2; a++)
+	{
+		const Elf_Shdr &shdr = shdrs_[arrays[a]];
+		for (Elf_Addr addr = shdr.sh_addr; shdr.sh_type && addr + word <= shdr.sh_addr + shdr.sh_size; addr += word)
+		{
+			const Elf_Addr *entry = image.At<const Elf_Addr>(addr);
+			if (entry && *entry != 0 && *entry != (Elf_Addr)-1)
+			{
+				offsets.push_back(addr);
+			}
+		}
+	}
+
+	if (!std::is_sorted(offsets.begin(), offsets.end()))
+	{
+		std::sort(offsets.begin(), offsets.end());
+	}
+	offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+	if (PhaseStats *stats = log_->stats())
+	{
+		stats->AddRelocs(offsets.size());
+	}
+
+	size_t i = 0;
+	while (i < offsets.size())
+	{
+		size_t j = i + 1;
+		while (j < offsets.size() && offsets[j] == offsets[j - 1] + word)
+		{
+			j++;
+		}
+
+		Elf_Addr *run = image.At<Elf_Addr>(offsets[i], j - i);
+		if (run)
+		{
+			Util::subtractBias(run, j - i, dump_bias_);
+		}
+		else
+		{
+			for (size_t k = i; k < j; k++)
+			{
+				Elf_Addr *reloc = image.At<Elf_Addr>(offsets[k]);
+				if (reloc)
+				{
+					Util::subtractBias(reloc, 1, dump_bias_);
+				}
+			}
+		}
+		i = j;
+	}
+
+	DEBUG("[fixRelFromBias] %d words unbiased", (int)offsets.size());
+	return true;
+}
+
+template <typename ElfClass>
+typename ElfFixer<ElfClass>::Elf_Sym* ElfFixer<ElfClass>::symbolAt(size_t sym)
+{
+	if (si_->symtab == nullptr)
+	{
+		return nullptr;
+	}
+
+	const ImageView &image = si_->image;
+	return image.At<Elf_Sym>(image.ToVaddr(si_->symtab) + (uint64_t)sym * sizeof(Elf_Sym));
+}
+
+template <typename ElfClass>
+size_t ElfFixer<ElfClass>::strSize(uint64_t off)
+{
+	if (si_->strtab == nullptr)
+	{
+		return 0;
+	}
+
+	const ImageView &image = si_->image;
+	uint64_t vaddr = image.ToVaddr(si_->strtab) + off;
+	const char *name = image.At<const char>(vaddr);
+	if (name == nullptr)
+	{
+		return 0;
+	}
+
+	//最多找到镜像末尾
+	size_t limit = image.CountTo<char>(vaddr);
+	size_t len = 0;
+	while (len < limit && name[len] != '\0')
+	{
+		len++;
+	}
+	return len < limit ? len + 1 : 0;
+}
+
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::noteSymbol(size_t sym)
+{
+	const Elf_Sym *entry = symbolAt(sym);
+	size_t name_size = entry ? strSize(entry->st_name) : 0;
+	if (name_size == 0)
+	{
+		return false;
+	}
+
+	shdrs_[SI_DYNSYM].sh_size = MAX(shdrs_[SI_DYNSYM].sh_size, (sym + 1) * sizeof(Elf_Sym));
+	shdrs_[SI_DYNSTR].sh_size = MAX(shdrs_[SI_DYNSTR].sh_size, entry->st_name + name_size);
+	return true;
+}
+
+template <typename ElfClass>
+size_t ElfFixer<ElfClass>::clipTable(int idx, const void *table, size_t count, const char *name)
+{
+	const ImageView &image = si_->image;
+	size_t limit = 0;
+	size_t entsize = (size_t)shdrs_[idx].sh_entsize;
+	if (table && entsize)
+	{
+		Elf_Addr addr = shdrs_[idx].sh_addr;
+		limit = image.CountTo<uint8_t>(addr) / entsize;
+		const Elf_Phdr *phdr = FindLoadPhdr(addr);
+		if (phdr)
+		{
+			limit = MIN(limit, (size_t)(((uint64_t)phdr->p_vaddr + phdr->p_memsz - addr) / entsize));
+		}
+	}
+
+	if (count > limit)
+	{
+		WARN("[fixShdrFromDynamic] %s: %llu entries exceed the segment, clipped to %llu!",
+			name, (unsigned long long)count, (unsigned long long)limit);
+		count = limit;
+		shdrs_[idx].sh_size = count * entsize;
+	}
+	return count;
+}
+
+template <typename ElfClass>
+bool ElfFixer<ElfClass>::searchCode(uint64_t start, uint64_t size, const char *code, size_t code_size,
+	uint64_t &found, qint64 &scanned)
+{
+	//限制在镜像内; kmpSearch的长度为int, 更大的段只搜索前2G
+	const ImageView &image = si_->image;
+	size_t len = (size_t)MIN(size, (uint64_t)image.CountTo<char>(start));
+	len = MIN(len, (size_t)INT_MAX);
+	const char *data = image.At<const char>(start, len);
+	if (data == nullptr || len < code_size)
+	{
+		return false;
+	}
+
+	int off = Util::kmpSearch(data, (int)len, code, (int)code_size);
+	if (off == -1)
+	{
+		scanned += len;
+		return false;
+	}
+
+	scanned += off + (qint64)code_size;
+	found = start + off;
+	return true;
+}
+
+template <typename ElfClass>
+typename ElfFixer<ElfClass>::Elf_Off ElfFixer<ElfClass>::AddrToOff(Elf_Addr addr)
+{
+	const Elf_Phdr* phdr = si_->phdr;
+	const Elf_Phdr* phdr_limit = phdr + si_->phnum;
+	Elf_Off off = -1;
 
 	for (phdr = si_->phdr; phdr < phdr_limit; phdr++)
 	{
@@ -1088,22 +1615,22 @@ Elf32_Off ElfFixer::AddrToOff(Elf32_Addr addr)
 			continue;
 		}
 
-		Elf32_Addr seg_start = phdr->p_vaddr;	//ڴӳʵʼַ
-		Elf32_Addr seg_end = seg_start + phdr->p_memsz;	//ڴӳʵַֹ
+		Elf_Addr seg_start = phdr->p_vaddr;	//内存映射实际起始地址
+		Elf_Addr seg_end = seg_start + phdr->p_memsz;	//内存映射实际终止地址
 
-		Elf32_Addr seg_page_start = PAGE_START(seg_start); //ڴӳҳ׵ַ
-		Elf32_Addr seg_page_end = PAGE_END(seg_end);	   //ڴӳֹҳ
+		Elf_Addr seg_page_start = PAGE_START(seg_start); //内存映射页首地址
+		Elf_Addr seg_page_end = PAGE_END(seg_end);	   //内存映射终止页
 
-		Elf32_Addr seg_file_end = seg_start + phdr->p_filesz; //ļӳֹҳ
+		Elf_Addr seg_file_end = seg_start + phdr->p_filesz; //文件映射终止页
 
 		// File offsets.
-		Elf32_Addr file_start = phdr->p_offset;
-		Elf32_Addr file_end = file_start + phdr->p_filesz;
+		Elf_Addr file_start = phdr->p_offset;
+		Elf_Addr file_end = file_start + phdr->p_filesz;
 
-		Elf32_Addr file_page_start = PAGE_START(file_start); //ļӳҳ׵ַ
-		Elf32_Addr file_length = file_end - file_page_start; //ļӳС
+		Elf_Addr file_page_start = PAGE_START(file_start); //文件映射页首地址
+		Elf_Addr file_length = file_end - file_page_start; //文件映射大小
 
-		//ûпдȨ, ļʵӳС
+		//如果没有可写权限, 修正文件的实际映射大小
 		if ((phdr->p_flags & PF_W) == 0)
 		{
 			seg_file_end = PAGE_END(seg_file_end);
@@ -1111,7 +1638,7 @@ Elf32_Off ElfFixer::AddrToOff(Elf32_Addr addr)
 			file_length = PAGE_END(file_length);
 		}
 
-		//жaddrǷLOAD
+		//判断addr是否在LOAD段中
 		if (addr >= seg_page_start && addr < seg_file_end)
 		{
 			off = file_page_start + addr - seg_page_start;
@@ -1122,13 +1649,14 @@ Elf32_Off ElfFixer::AddrToOff(Elf32_Addr addr)
 	return off;
 }
 
-//һļӳ䵽ڴ, úܲ׼ȷ
-//һһֻӳһ, 
-Elf32_Addr ElfFixer::OffToAddr(Elf32_Off off)
+//由于一块文件可能映射到多块内存, 该函数可能不准确
+//但是一个节一般只会映射一次, 正常不会出问题
+template <typename ElfClass>
+typename ElfFixer<ElfClass>::Elf_Addr ElfFixer<ElfClass>::OffToAddr(Elf_Off off)
 {
-	const Elf32_Phdr* phdr = si_->phdr;
-	const Elf32_Phdr* phdr_limit = phdr + si_->phnum;
-	Elf32_Off addr = -1;
+	const Elf_Phdr* phdr = si_->phdr;
+	const Elf_Phdr* phdr_limit = phdr + si_->phnum;
+	Elf_Off addr = -1;
 	
 	for (phdr = si_->phdr; phdr < phdr_limit; phdr++)
 	{
@@ -1137,22 +1665,22 @@ Elf32_Addr ElfFixer::OffToAddr(Elf32_Off off)
 			continue;
 		}
 
-		Elf32_Addr seg_start = phdr->p_vaddr;	//ڴӳʵʼַ
-		Elf32_Addr seg_end = seg_start + phdr->p_memsz;	//ڴӳʵַֹ
+		Elf_Addr seg_start = phdr->p_vaddr;	//内存映射实际起始地址
+		Elf_Addr seg_end = seg_start + phdr->p_memsz;	//内存映射实际终止地址
 
-		Elf32_Addr seg_page_start = PAGE_START(seg_start); //ڴӳҳ׵ַ
-		Elf32_Addr seg_page_end = PAGE_END(seg_end);	   //ڴӳֹҳ
+		Elf_Addr seg_page_start = PAGE_START(seg_start); //内存映射页首地址
+		Elf_Addr seg_page_end = PAGE_END(seg_end);	   //内存映射终止页
 
-		Elf32_Addr seg_file_end = seg_start + phdr->p_filesz; //ļӳֹҳ
+		Elf_Addr seg_file_end = seg_start + phdr->p_filesz; //文件映射终止页
 
 															  // File offsets.
-		Elf32_Addr file_start = phdr->p_offset;
-		Elf32_Addr file_end = file_start + phdr->p_filesz;
+		Elf_Addr file_start = phdr->p_offset;
+		Elf_Addr file_end = file_start + phdr->p_filesz;
 
-		Elf32_Addr file_page_start = PAGE_START(file_start); //ļӳҳ׵ַ
-		Elf32_Addr file_length = file_end - file_page_start; //ļӳС
+		Elf_Addr file_page_start = PAGE_START(file_start); //文件映射页首地址
+		Elf_Addr file_length = file_end - file_page_start; //文件映射大小
 
-		//ûпдȨ, ļʵӳС
+		//如果没有可写权限, 修正文件的实际映射大小
 		if ((phdr->p_flags & PF_W) == 0)
 		{
 			seg_file_end = PAGE_END(seg_file_end);
@@ -1160,7 +1688,7 @@ Elf32_Addr ElfFixer::OffToAddr(Elf32_Off off)
 			file_length = PAGE_END(file_length);
 		}
 
-		//жoffǷLOAD
+		//判断off是否在LOAD段中
 		if (off >= file_page_start && off < file_end)
 		{
 			addr = seg_page_start + off - file_page_start;
@@ -1171,7 +1699,23 @@ Elf32_Addr ElfFixer::OffToAddr(Elf32_Off off)
 	return addr;
 }
 
-int ElfFixer::FindShIdx(Elf32_Addr addr)
+template <typename ElfClass>
+const typename ElfFixer<ElfClass>::Elf_Phdr* ElfFixer<ElfClass>::FindLoadPhdr(Elf_Addr addr)
+{
+	for (size_t i = 0; i < phnum_; i++)
+	{
+		const Elf_Phdr *phdr = &phdr_[i];
+		if (phdr->p_type == PT_LOAD && addr >= phdr->p_vaddr && addr < phdr->p_vaddr + phdr->p_memsz)
+		{
+			return phdr;
+		}
+	}
+
+	return nullptr;
+}
+
+template <typename ElfClass>
+int ElfFixer<ElfClass>::FindShIdx(Elf_Addr addr)
 {
 	int idx = 0;
 	for (int i = 0; i < SI_MAX; i++)
@@ -1185,3 +1729,6 @@ int ElfFixer::FindShIdx(Elf32_Addr addr)
 	
 	return idx;
 }
+
+template class ElfFixer<Elf32Class>;
+template class ElfFixer<Elf64Class>;
@@ -1,18 +1,35 @@
 #pragma once
 #include "linker.h"
+#include "JobLog.h"
+#include "CountingDevice.h"
 #include <QFile>
+#include <QBuffer>
+#include <vector>
 
+template <typename ElfClass>
 class ElfFixer
 {
+public:
+	typedef typename ElfClass::Ehdr Elf_Ehdr;
+	typedef typename ElfClass::Phdr Elf_Phdr;
+	typedef typename ElfClass::Shdr Elf_Shdr;
+	typedef typename ElfClass::Dyn Elf_Dyn;
+	typedef typename ElfClass::Sym Elf_Sym;
+	typedef typename ElfClass::Rel Elf_Rel;
+	typedef typename ElfClass::Addr Elf_Addr;
+	typedef typename ElfClass::Off Elf_Off;
+	typedef typename ElfClass::Word Elf_Word;
+
 private:
 
-	//ͷ, Ӧ
+	//节头, 下面的这三个变量对应好
 	enum ShIdx
 	{
 		SI_NULL = 0,
 		SI_DYNSYM,
 		SI_DYNSTR,
 		SI_HASH,
+		SI_GNU_HASH,
 		SI_RELDYN,
 		SI_RELPLT,
 		SI_PLT,
@@ -30,62 +47,134 @@ private:
 		SI_MAX
 	};
 
-	Elf32_Shdr shdrs_[SI_MAX];
-	static const char strtab[];
+	Elf_Shdr shdrs_[SI_MAX];
 
-	static Elf32_Word GetShdrName(int idx);
+	static Elf_Word GetShdrName(int idx);
 
-	char *sopath_;		//soļ·
-	char *fixedpath_;	//޸ļ·
-	soinfo *si_;		//޸dump soElfReadersoļõ
+	QByteArray sopath_;		//正常so文件路径
+	QByteArray fixedpath_;	//修复后文件路径
+	soinfo<ElfClass> *si_;		//待修复dump so或由ElfReader加载正常so文件得到的
+	JobLog *log_;		//所属任务的日志
 	QFile sofile_;
+	CountingDevice ref_io_;	//经此读取sofile_, 记录文件访问
+	QByteArray ref_;	//RefCache中的正常so, 只读共享
 	QFile fixedfile_;
+	CountingDevice fixed_io_;
+	QBuffer fixedbuf_;		//set_buffered时写入内存
+	QIODevice *fixeddev_;	//fixed_io_或fixedbuf_
 
-	Elf32_Ehdr ehdr_;	//ͨsoļȡ
+	Elf_Ehdr ehdr_;	//通过正常的so文件获取
 
-	//ͨsoinfoȡ
-	const Elf32_Phdr *phdr_;
+	//通过soinfo获取
+	const Elf_Phdr *phdr_;
 	size_t phnum_;
 
+	Elf_Addr plt_got_;	//DT_PLTGOT
+	Elf_Addr dump_bias_;	//dump时的load_bias, 非0时不依赖正常so, 直接从镜像中减去load_bias还原重定位
+
+	//PT_LOAD段内已知节之间的空隙[start, end), next为空隙之后的节, SI_NULL表示段尾
+	struct Gap
+	{
+		Elf_Addr start;
+		Elf_Addr end;
+		int next;
+	};
+
+	//可写段内被重定位的字组成的密集区间[start, end), func为其中指向可执行段的字数
+	struct RelRun
+	{
+		Elf_Addr start;
+		Elf_Addr end;
+		size_t count;
+		size_t func;
+	};
+
 public:
-	ElfFixer(soinfo *si, const char *sopath, const char *fixedpath);
+	ElfFixer(soinfo<ElfClass> *si, const char *sopath, const char *fixedpath, JobLog *log);
 	~ElfFixer();
 	bool Fix();
+	void set_dump_bias(Elf_Addr bias) { dump_bias_ = bias; }
+	//正常so已由RefCache读入内存时使用, 不再打开sopath
+	void set_reference(const QByteArray &bytes);
+	//Write写入内存而不是fixedpath, 由调用者之后写出, 需在Write之前调用
+	void set_buffered() { fixeddev_ = &fixedbuf_; }
+	const QByteArray &buffer() const { return fixedbuf_.data(); }
 	bool Write();
 
 private:
-	//޸Ehdr
+	//从正常so读取, 内存中有则直接拷贝
+	bool readRef(qint64 off, void *buf, qint64 size);
+	qint64 refSize();
+
+	//修复Ehdr
 	bool FixEhdr();
 
-	//޸Phdr
+	//修复Phdr
 	bool FixPhdr();
 
-	//޸Shdr, , ļƫ
+	//修复整个Shdr, 名称, 文件偏移
 	bool FixShdr();
 
-	//Phdr޸Shdr: .dynamic, .arm.exidx
+	//从Phdr中修复部分Shdr: .dynamic, .arm.exidx
 	bool FixShdrFromPhdr();
 
-	//.dynamic޸Shdr:  .hash, .dynsym, .dynstr, .rel.dyn, .rel.plt, .init_array, fini_array
+	//从.dynamic中修复部分Shdr:  .hash, .gnu.hash, .dynsym, .dynstr, .rel.dyn, .rel.plt, .init_array, fini_array
 	bool FixShdrFromDynamic();
 
-	//.dynamic.dynsymõַȷ.dynstrڵĴС
+	//根据.dynamic和.dynsym引用的字符串来确定.dynstr节的大小
 	bool FixDynstr();
 
-	//.hash,.rel.plt,.rel.dynõķϢȷ.dynsym, .dynstrڵĴС
+	//根据.hash,.gnu.hash,.rel.plt,.rel.dyn引用的符号信息来确定.dynsym, .dynstr节的大小
 	bool FixDynsym();
 
-	//ShdrĹϵ޸ .plt, .text, .got, .data, .bss
+	//根据Shdr的关系修复 .plt, .got
 	bool FixShdrFromShdr();
 
-	//ļм¼ڴַתΪļƫ, -1ʾʧ
-	Elf32_Off AddrToOff(Elf32_Addr addr);
+	//根据.rel.dyn重定位目标的密度修复 .data.rel.ro, 缺少DT_INIT_ARRAY时推断 .init_array
+	bool FixShdrFromRelDensity();
 
-	Elf32_Addr OffToAddr(Elf32_Off off);
+	//根据PT_LOAD段内已知节之间的空隙修复 .text, .rodata, .data.rel.ro, .data, .bss
+	bool FixShdrFromLayout();
 
-	//ļм¼ڴַڵĽ, -1ʾûҵ
-	int FindShIdx(Elf32_Addr addr);
+	//按段权限将一个段内的空隙分配给对应的节
+	void AssignGaps(const Elf_Phdr *phdr, const std::vector<Gap> &gaps);
+
+	//用空隙[start, end)填写节头, start按align对齐
+	void FillGapShdr(int idx, Elf_Word type, Elf_Word flags, const Elf_Phdr *phdr,
+		Elf_Addr start, Elf_Addr end, Elf_Word align);
+
+	//节头全部确定后修正.dynsym中符号的st_shndx
+	bool FixSymShndx();
+
+	//将文件中记录的内存地址转为文件偏移, -1表示失败
+	Elf_Off AddrToOff(Elf_Addr addr);
+
+	Elf_Addr OffToAddr(Elf_Off off);
+
+	//返回文件中记录的内存地址所在的节, -1表示没找到
+	int FindShIdx(Elf_Addr addr);
+
+	//返回内存地址所在的PT_LOAD段, 没找到返回nullptr
+	const Elf_Phdr* FindLoadPhdr(Elf_Addr addr);
+
+	//以下用于遍历来自镜像的表, 镜像可能是损坏或构造的, 所有索引和大小都要先检查
+	//.dynsym的第sym项, 不完整地在镜像内时返回nullptr
+	Elf_Sym* symbolAt(size_t sym);
+	//.dynstr中off处字符串的大小(含结尾的0), 越界或到镜像末尾都没有结尾时为0
+	size_t strSize(uint64_t off);
+	//按第sym个符号及其名称更新.dynsym, .dynstr的大小, 越界时返回false
+	bool noteSymbol(size_t sym);
+	//table的项数限制在其所在的PT_LOAD段和镜像之内, 超过时修正shdrs_[idx].sh_size
+	size_t clipTable(int idx, const void *table, size_t count, const char *name);
+	//在[start, start + size)与镜像的交集中搜索code, 找到时返回true和地址, 扫描的字节数累加到scanned
+	bool searchCode(uint64_t start, uint64_t size, const char *code, size_t code_size, uint64_t &found, qint64 &scanned);
 
 	bool FixRel();
+
+	//仅有dump时还原重定位: RELATIVE, 定义在本so中的ABS, .init_array, .fini_array中的值减去dump_bias_
+	bool FixRelFromBias();
+
+	//基准测试单独调用各个步骤
+	friend class Bench;
 };
 
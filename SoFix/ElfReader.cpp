@@ -1,55 +1,60 @@
 #include "ElfReader.h"
 #include "Util.h"
+#include "Trace.h"
 
 #define QSTR8BIT(s) (QString::fromLocal8Bit(s))
 
-#define DL_ERR qDebug
+#define DL_ERR(...) LOG_ERROR(log_, __VA_ARGS__)
 
-ElfReader::ElfReader(const char* sopath, const char* dumppath)
-	: sopath_(nullptr), dumppath_(nullptr), phdr_num_(0), phdr_mmap_(NULL),
+template <typename ElfClass>
+ElfReader<ElfClass>::ElfReader(const char* sopath, const char* dumppath, JobLog *log)
+	: log_(log), so_io_(&sofile_, log), sodev_(&so_io_), dump_io_(&dumpfile_, log), dumpdev_(&dump_io_), phdr_num_(0), phdr_mmap_(NULL),
 	phdr_table_(NULL), phdr_size_(0), load_start_(NULL),
-	load_size_(0), load_bias_(0), loaded_phdr_(NULL)
+	load_size_(0), image_(), loaded_phdr_(NULL)
 {
 	if (sopath)
 	{
-		sopath_ = strdup(sopath);
+		sopath_ = sopath;
 		sofile_.setFileName(QSTR8BIT(sopath));
 	}
 
 	if (dumppath)
 	{
-		dumppath_ = strdup(dumppath);
+		dumppath_ = dumppath;
 		dumpfile_.setFileName(QSTR8BIT(dumppath));
 	}
 }
 
-ElfReader::~ElfReader()
+template <typename ElfClass>
+ElfReader<ElfClass>::~ElfReader()
 {
-	if (sopath_)
-	{
-		free(sopath_);
-	}
-	sofile_.close();
+	so_io_.close();
+	refbuf_.close();
+	dump_io_.close();
+	dumpbuf_.close();
 
-	if (dumppath_)
+	if (phdr_mmap_ != NULL)
 	{
-		free(dumppath_);
+		Util::munmap(phdr_mmap_, phdr_size_);
 	}
-	dumpfile_.close();
 
-	if (phdr_mmap_ != NULL)
+	//镜像随reader(批处理中为每项的FixJob::Context)一起释放
+	//dump直接映射时映射的是整个dump文件, 大小以image_为准而不是load_size_
+	if (load_start_ != NULL)
 	{
-		Util::munmap(phdr_mmap_, phdr_size_);
+		Util::munmap(load_start_, image_.size());
 	}
 }
 
-//elfļ
-bool ElfReader::Load()
+//完成elf的加载
+template <typename ElfClass>
+bool ElfReader<ElfClass>::Load()
 {
+	PhaseStats::Scope scope(log_->stats(), PhaseStats::PH_LOAD);
 	bool loaded = false;
-	if (sopath_)
+	if (!sopath_.isEmpty())
 	{
-		//soļ, οlinkerԴм
+		//如果是正常的so文件, 则参考linker源码进行加载
 		loaded = OpenElf() &&
 			ReadElfHeader() &&
 			VerifyElfHeader() &&
@@ -58,11 +63,16 @@ bool ElfReader::Load()
 			LoadSegments() &&
 			FindPhdr();
 
-		if (loaded && dumppath_) //so, ޸dump so, ֱ͵
+		if (loaded && !dumppath_.isEmpty()) //如果根据正常的so, 修复dump so, 直接偷梁换柱
 		{
-			if (dumpfile_.open(QIODevice::ReadOnly | QIODevice::ExistingOnly))
+			if (dumpdev_->open(dumpdev_ == &dump_io_ ? QIODevice::ReadOnly | QIODevice::ExistingOnly : QIODevice::ReadOnly))
 			{
-				dumpfile_.read((char *)load_start_, load_size_);
+				Trace::Span span("ReadDump", "load");
+				qint64 rc = dumpdev_->read((char *)load_start_, load_size_);
+				if (PhaseStats *stats = log_->stats())
+				{
+					stats->AddRead(qMax(rc, (qint64)0));
+				}
 				return true;
 			}
 			else
@@ -71,33 +81,40 @@ bool ElfReader::Load()
 			}
 		}
 	}
-	else if(dumppath_)
+	else if(!dumppath_.isEmpty())
 	{
-		//޸dump so, ȡdumpļȡElfͷϢ
+		//如果仅仅修复dump so, 读取dump文件获取Elf头部信息
 		//This is Ugly...
-		sopath_ = strdup(dumppath_);
-		sofile_.setFileName(QSTR8BIT(dumppath_));
+		sopath_ = dumppath_;
+		sofile_.setFileName(QSTR8BIT(dumppath_.constData()));
+		sodev_ = dumpdev_ == &dumpbuf_ ? dumpdev_ : &so_io_;
 
 		if (OpenElf() && ReadElfHeader() && VerifyElfHeader() && ReadProgramHeader())
 		{
-			Elf32_Addr min_vaddr;
-			load_size_ = phdr_table_get_load_size(phdr_table_, phdr_num_, &min_vaddr); //ȡԴеĿɼصĽڵҳС
+			Elf_Addr min_vaddr;
+			load_size_ = phdr_table_get_load_size(phdr_table_, phdr_num_, &min_vaddr); //获取可以存放所有的可加载的节的页大小
 			if (load_size_ == 0)
 			{
-				DL_ERR("\"%s\" has no loadable segments", sopath_);
+				DL_ERR("\"%s\" has no loadable segments", sopath_.constData());
 				return false;
 			}
 
-			uint8_t* addr = reinterpret_cast<uint8_t*>(min_vaddr);
-			void* start = Util::mmap(NULL, sofile_.size(), sofile_, 0);
+			Trace::Span span("MapDump", "load");
+			void* start = Util::mmap(NULL, sodev_->size(), *sodev_, 0);
 			if (start == nullptr)
 			{
-				DL_ERR("couldn't reserve %d bytes of address space for \"%s\"", load_size_, sopath_);
+				DL_ERR("couldn't reserve %d bytes of address space for \"%s\"", (int)load_size_, sopath_.constData());
 				return false;
 			}
 
+			if (PhaseStats *stats = log_->stats())
+			{
+				stats->AddRead(sodev_->size());
+			}
+
+			//dump文件从min_vaddr开始, 视图大小以实际读入的页为准
 			load_start_ = start;
-			load_bias_ = reinterpret_cast<uint8_t*>(start) - addr;
+			image_ = ImageView(reinterpret_cast<uint8_t*>(start), min_vaddr, PAGE_END((size_t)sodev_->size()));
 
 			loaded = FindPhdr();
 		}
@@ -107,115 +124,150 @@ bool ElfReader::Load()
 	return loaded;
 }
 
-bool ElfReader::OpenElf()
+template <typename ElfClass>
+bool ElfReader<ElfClass>::Probe()
+{
+	if (!OpenElf() || !ReadElfHeader() || !VerifyElfHeader() || !ReadProgramHeader())
+	{
+		return false;
+	}
+
+	load_size_ = phdr_table_get_load_size(phdr_table_, phdr_num_, NULL);
+	return load_size_ != 0;
+}
+
+template <typename ElfClass>
+bool ElfReader<ElfClass>::OpenElf()
+{
+	Trace::Span span("OpenElf", "load");
+	return sodev_->open(sodev_ == &so_io_ ? QIODevice::ReadOnly | QIODevice::ExistingOnly : QIODevice::ReadOnly);
+}
+
+template <typename ElfClass>
+void ElfReader<ElfClass>::set_reference(const QByteArray &bytes)
 {
-	return sofile_.open(QIODevice::ReadOnly | QIODevice::ExistingOnly);
+	//只读共享, QBuffer读取时不会复制数据
+	refbuf_.setData(bytes);
+	sodev_ = &refbuf_;
 }
 
-bool ElfReader::ReadElfHeader()
+template <typename ElfClass>
+void ElfReader<ElfClass>::set_dump(const QByteArray &bytes)
 {
-	//ɹضȡֽ, -1errno, ڵread֮ǰѵļĩβ, read0
-	sofile_.seek(0);
-	qint64 rc = sofile_.read((char *)&header_, sizeof(header_));
+	dumpbuf_.setData(bytes);
+	dumpdev_ = &dumpbuf_;
+}
+
+template <typename ElfClass>
+bool ElfReader<ElfClass>::ReadElfHeader()
+{
+	Trace::Span span("ReadElfHeader", "load");
+	//成功返回读取的字节数, 出错返回-1并设置errno, 如果在调read之前已到达文件末尾, 则这次read返回0
+	sodev_->seek(0);
+	qint64 rc = sodev_->read((char *)&header_, sizeof(header_));
 	if (rc < 0)
 	{
-		DL_ERR("can't read file \"%s\"", sopath_);
+		DL_ERR("can't read file \"%s\"", sopath_.constData());
 		return false;
 	}
 	if (rc != sizeof(header_))
 	{
-		DL_ERR("\"%s\" is too small to be an ELF executable", sopath_);
+		DL_ERR("\"%s\" is too small to be an ELF executable", sopath_.constData());
 		return false;
 	}
 
 	return true;
 }
 
-bool ElfReader::VerifyElfHeader()
+template <typename ElfClass>
+bool ElfReader<ElfClass>::VerifyElfHeader()
 {
 	if (header_.e_ident[EI_MAG0] != ELFMAG0 ||
 		header_.e_ident[EI_MAG1] != ELFMAG1 ||
 		header_.e_ident[EI_MAG2] != ELFMAG2 ||
 		header_.e_ident[EI_MAG3] != ELFMAG3)
 	{
-		DL_ERR("\"%s\" has bad ELF magic", sopath_);
+		DL_ERR("\"%s\" has bad ELF magic", sopath_.constData());
 		return false;
 	}
 
-	if (header_.e_ident[EI_CLASS] != ELFCLASS32)
+	if (header_.e_ident[EI_CLASS] != ElfClass::kClass)
 	{
-		DL_ERR("\"%s\" not 32-bit: %d", sopath_, header_.e_ident[EI_CLASS]);
+		DL_ERR("\"%s\" has unexpected ELF class: %d", sopath_.constData(), header_.e_ident[EI_CLASS]);
 		return false;
 	}
 	if (header_.e_ident[EI_DATA] != ELFDATA2LSB)
 	{
-		DL_ERR("\"%s\" not little-endian: %d", sopath_, header_.e_ident[EI_DATA]);
+		DL_ERR("\"%s\" not little-endian: %d", sopath_.constData(), header_.e_ident[EI_DATA]);
 		return false;
 	}
 
 	if (header_.e_type != ET_DYN)
 	{
-		DL_ERR("\"%s\" has unexpected e_type: %d", sopath_, header_.e_type);
+		DL_ERR("\"%s\" has unexpected e_type: %d", sopath_.constData(), header_.e_type);
 		return false;
 	}
 
 	if (header_.e_version != EV_CURRENT)
 	{
-		DL_ERR("\"%s\" has unexpected e_version: %d", sopath_, header_.e_version);
+		DL_ERR("\"%s\" has unexpected e_version: %d", sopath_.constData(), header_.e_version);
 		return false;
 	}
 
-	if (header_.e_machine != EM_ARM)
+	if (header_.e_machine != ElfClass::kMachine)
 	{
-		DL_ERR("\"%s\" has unexpected e_machine: %d", sopath_, header_.e_machine);
+		DL_ERR("\"%s\" has unexpected e_machine: %d", sopath_.constData(), header_.e_machine);
 		return false;
 	}
 
 	return true;
 }
 
-bool ElfReader::ReadProgramHeader()
+template <typename ElfClass>
+bool ElfReader<ElfClass>::ReadProgramHeader()
 {
+	Trace::Span span("ReadProgramHeader", "load");
 	phdr_num_ = header_.e_phnum;
 
 	// Like the kernel, we only accept program header tables that
 	// are smaller than 64KiB.
-	if (phdr_num_ < 1 || phdr_num_ > 65536 / sizeof(Elf32_Phdr))
+	if (phdr_num_ < 1 || phdr_num_ > 65536 / sizeof(Elf_Phdr))
 	{
-		DL_ERR("\"%s\" has invalid e_phnum: %d", sopath_, phdr_num_);
+		DL_ERR("\"%s\" has invalid e_phnum: %d", sopath_.constData(), (int)phdr_num_);
 		return false;
 	}
 
-	Elf32_Addr page_min = PAGE_START(header_.e_phoff); //phڵҳ׵ַ
-	Elf32_Addr page_max = PAGE_END(header_.e_phoff + (phdr_num_ * sizeof(Elf32_Phdr))); //phβڵҳһҳ׵ַ
-	Elf32_Addr page_offset = PAGE_OFFSET(header_.e_phoff);	//phҳ(4KС)еƫ
+	Elf_Addr page_min = PAGE_START(header_.e_phoff); //ph所在的页的首地址
+	Elf_Addr page_max = PAGE_END(header_.e_phoff + (phdr_num_ * sizeof(Elf_Phdr))); //ph的尾部所在的页的下一个页的首地址
+	Elf_Addr page_offset = PAGE_OFFSET(header_.e_phoff);	//ph在页(4K大小)中的偏移
 
-	phdr_size_ = page_max - page_min;//phռҳС
+	phdr_size_ = page_max - page_min;//ph所占的页大小
 
-	void* mmap_result = Util::mmap(NULL, phdr_size_, sofile_, page_min);//phӳ䵽ڴ
+	void* mmap_result = Util::mmap(NULL, phdr_size_, *sodev_, page_min);//将ph映射到内存中
 	if (mmap_result == nullptr)
 	{
-		DL_ERR("\"%s\" phdr mmap failed", sopath_);
+		DL_ERR("\"%s\" phdr mmap failed", sopath_.constData());
 		return false;
 	}
 
 	phdr_mmap_ = mmap_result;
-	phdr_table_ = reinterpret_cast<Elf32_Phdr*>(reinterpret_cast<char*>(mmap_result) + page_offset);
+	phdr_table_ = reinterpret_cast<Elf_Phdr*>(reinterpret_cast<char*>(mmap_result) + page_offset);
 	return true;
 }
 
-size_t ElfReader::phdr_table_get_load_size(const Elf32_Phdr* phdr_table,
+template <typename ElfClass>
+size_t ElfReader<ElfClass>::phdr_table_get_load_size(const Elf_Phdr* phdr_table,
 	size_t phdr_count,
-	Elf32_Addr* out_min_vaddr,
-	Elf32_Addr* out_max_vaddr)
+	Elf_Addr* out_min_vaddr,
+	Elf_Addr* out_max_vaddr)
 {
-	Elf32_Addr min_vaddr = 0xFFFFFFFFU;
-	Elf32_Addr max_vaddr = 0x00000000U;
+	Elf_Addr min_vaddr = (Elf_Addr)-1;
+	Elf_Addr max_vaddr = 0;
 
 	bool found_pt_load = false;
 	for (size_t i = 0; i < phdr_count; ++i)
 	{
-		const Elf32_Phdr* phdr = &phdr_table[i];
+		const Elf_Phdr* phdr = &phdr_table[i];
 
 		if (phdr->p_type != PT_LOAD)
 		{
@@ -235,7 +287,7 @@ size_t ElfReader::phdr_table_get_load_size(const Elf32_Phdr* phdr_table,
 	}
 	if (!found_pt_load)
 	{
-		min_vaddr = 0x00000000U;
+		min_vaddr = 0;
 	}
 
 	min_vaddr = PAGE_START(min_vaddr);
@@ -252,74 +304,107 @@ size_t ElfReader::phdr_table_get_load_size(const Elf32_Phdr* phdr_table,
 	return max_vaddr - min_vaddr;
 }
 
-bool ElfReader::ReserveAddressSpace()
+template <typename ElfClass>
+bool ElfReader<ElfClass>::ReserveAddressSpace()
 {
-	Elf32_Addr min_vaddr;
-	load_size_ = phdr_table_get_load_size(phdr_table_, phdr_num_, &min_vaddr); //ȡԴеĿɼصĽڵҳС
+	Trace::Span span("ReserveAddressSpace", "load");
+	Elf_Addr min_vaddr;
+	load_size_ = phdr_table_get_load_size(phdr_table_, phdr_num_, &min_vaddr); //获取可以存放所有的可加载的节的页大小
 	if (load_size_ == 0)
 	{
-		DL_ERR("\"%s\" has no loadable segments", sopath_);
+		DL_ERR("\"%s\" has no loadable segments", sopath_.constData());
 		return false;
 	}
 
-	uint8_t* addr = reinterpret_cast<uint8_t*>(min_vaddr);
 	void* start = Util::mmap(nullptr, load_size_);
 	if (start == nullptr)
 	{
-		DL_ERR("couldn't reserve %d bytes of address space for \"%s\"", load_size_, sopath_);
+		DL_ERR("couldn't reserve %d bytes of address space for \"%s\"", (int)load_size_, sopath_.constData());
 		return false;
 	}
 
 	load_start_ = start;
-	load_bias_ = reinterpret_cast<uint8_t*>(start) - addr;
+	image_ = ImageView(reinterpret_cast<uint8_t*>(start), min_vaddr, load_size_);
 	return true;
 }
 
-bool ElfReader::LoadSegments()
+template <typename ElfClass>
+bool ElfReader<ElfClass>::LoadSegments()
 {
+	Trace::Span span("LoadSegments", "load");
 	for (size_t i = 0; i < phdr_num_; ++i)
 	{
-		const Elf32_Phdr* phdr = &phdr_table_[i];
+		const Elf_Phdr* phdr = &phdr_table_[i];
 
 		if (phdr->p_type != PT_LOAD)
 		{
 			continue;
 		}
 
-		// Segment addresses in memory.
-		Elf32_Addr seg_start = phdr->p_vaddr + load_bias_;	//ڴӳʵʼַ
-		Elf32_Addr seg_end = seg_start + phdr->p_memsz;	//ڴӳʵַֹ
+		// Segment addresses in memory. 以下均为虚拟地址, 通过image_转换为宿主内存
+		Elf_Addr seg_start = phdr->p_vaddr;	//内存映射起始地址
+		Elf_Addr seg_end = seg_start + phdr->p_memsz;	//内存映射终止地址
 
-		Elf32_Addr seg_page_start = PAGE_START(seg_start); //ڴӳҳ׵ַ
-		Elf32_Addr seg_page_end = PAGE_END(seg_end);	   //ڴӳֹҳ
+		Elf_Addr seg_page_start = PAGE_START(seg_start); //内存映射页首地址
+		Elf_Addr seg_page_end = PAGE_END(seg_end);	   //内存映射终止页
 
-		Elf32_Addr seg_file_end = seg_start + phdr->p_filesz; //ļӳֹҳ
+		Elf_Addr seg_file_end = seg_start + phdr->p_filesz; //文件映射终止页
 
 		// File offsets.
-		Elf32_Addr file_start = phdr->p_offset;
-		Elf32_Addr file_end = file_start + phdr->p_filesz;
+		Elf_Addr file_start = phdr->p_offset;
+		Elf_Addr file_end = file_start + phdr->p_filesz;
 
-		Elf32_Addr file_page_start = PAGE_START(file_start); //ļӳҳ׵ַ
-		Elf32_Addr file_length = file_end - file_page_start; //ļӳС
+		Elf_Addr file_page_start = PAGE_START(file_start); //文件映射页首地址
+		Elf_Addr file_length = file_end - file_page_start; //文件映射大小
+
+		//文件部分不能超过内存部分, 否则按文件大小拷贝会写出镜像
+		if (phdr->p_filesz > phdr->p_memsz)
+		{
+			DL_ERR("\"%s\" segment %d p_filesz 0x%llx > p_memsz 0x%llx", sopath_.constData(), (int)i,
+				(unsigned long long)phdr->p_filesz, (unsigned long long)phdr->p_memsz);
+			return false;
+		}
+
+		if (!image_.Contains(seg_page_start, seg_page_end - seg_page_start))
+		{
+			DL_ERR("\"%s\" segment %d out of reserved address space", sopath_.constData(), (int)i);
+			return false;
+		}
 
-		if (file_length != 0) //ļڴӳ
+		if (file_length != 0) //进行文件内存映射
 		{
-			void* seg_addr = Util::mmap((void*)seg_page_start,
+			//Util::mmap按页拷贝PAGE_END(file_length)字节
+			if (!image_.Contains(seg_page_start, PAGE_END(file_length)))
+			{
+				DL_ERR("\"%s\" segment %d file part out of reserved address space", sopath_.constData(), (int)i);
+				return false;
+			}
+			void* seg_addr = Util::mmap(image_.At<uint8_t>(seg_page_start),
 				file_length,
-				sofile_,
+				*sodev_,
 				file_page_start);
 			if (seg_addr == nullptr)
 			{
-				DL_ERR("couldn't map \"%s\" segment %d", sopath_, i);
+				DL_ERR("couldn't map \"%s\" segment %d", sopath_.constData(), (int)i);
 				return false;
 			}
+			if (PhaseStats *stats = log_->stats())
+			{
+				stats->AddRead(file_length);
+			}
 		}
 
 		// if the segment is writable, and does not end on a page boundary,
-		// zero-fill it until the page limit. ļӳ߽0ҳ߽
+		// zero-fill it until the page limit. 从文件映射边界填充0到页边界
 		if ((phdr->p_flags & PF_W) != 0 && PAGE_OFFSET(seg_file_end) > 0)
 		{
-			memset((void*)seg_file_end, 0, PAGE_SIZE - PAGE_OFFSET(seg_file_end));
+			uint8_t *fill = image_.At<uint8_t>(seg_file_end, PAGE_SIZE - PAGE_OFFSET(seg_file_end));
+			if (fill == nullptr)
+			{
+				DL_ERR("\"%s\" segment %d zero-fill out of reserved address space", sopath_.constData(), (int)i);
+				return false;
+			}
+			memset(fill, 0, PAGE_SIZE - PAGE_OFFSET(seg_file_end));
 		}
 
 		seg_file_end = PAGE_END(seg_file_end);
@@ -328,13 +413,13 @@ bool ElfReader::LoadSegments()
 		// content. If seg_end is larger, we need to zero anything
 		// between them. This is done by using a private anonymous
 		// map for all extra pages.
-		// ڴӳ>ļӳӳ䲢ʼΪ0
+		// 如果内存映射>文件映射则会额外映射并初始化为0
 		if (seg_page_end > seg_file_end)
 		{
-			void* zeromap = Util::mmap((void*)seg_file_end, seg_page_end - seg_file_end);
+			void* zeromap = Util::mmap(image_.At<uint8_t>(seg_file_end), seg_page_end - seg_file_end);
 			if (zeromap == nullptr)
 			{
-				DL_ERR("couldn't zero fill \"%s\"", sopath_);
+				DL_ERR("couldn't zero fill \"%s\"", sopath_.constData());
 				return false;
 			}
 		}
@@ -342,62 +427,71 @@ bool ElfReader::LoadSegments()
 	return true;
 }
 
-bool ElfReader::FindPhdr()
+template <typename ElfClass>
+bool ElfReader<ElfClass>::FindPhdr()
 {
-	const Elf32_Phdr* phdr_limit = phdr_table_ + phdr_num_;
+	Trace::Span span("FindPhdr", "load");
+	const Elf_Phdr* phdr_limit = phdr_table_ + phdr_num_;
 
-	// If there is a PT_PHDR, use it directly. Phд PT_PHDR , 
-	for (const Elf32_Phdr* phdr = phdr_table_; phdr < phdr_limit; ++phdr)
+	// If there is a PT_PHDR, use it directly. 如果Ph表中存在 PT_PHDR 即自身, 则检查它
+	for (const Elf_Phdr* phdr = phdr_table_; phdr < phdr_limit; ++phdr)
 	{
 		if (phdr->p_type == PT_PHDR)
 		{
-			return CheckPhdr(load_bias_ + phdr->p_vaddr);
+			return CheckPhdr(phdr->p_vaddr);
 		}
 	}
 
 	// Otherwise, check the first loadable segment. If its file offset
 	// is 0, it starts with the ELF header, and we can trivially find the
 	// loaded program header from it. 
-	//, һɼضļƫΪ0, ʼElf Header, 
-	for (const Elf32_Phdr* phdr = phdr_table_; phdr < phdr_limit; ++phdr)
+	//否则, 检查第一个可加载段且文件偏移为0, 起始于Elf Header, 则检查它
+	for (const Elf_Phdr* phdr = phdr_table_; phdr < phdr_limit; ++phdr)
 	{
 		if (phdr->p_type == PT_LOAD)
 		{
 			if (phdr->p_offset == 0)
 			{
-				Elf32_Addr  elf_addr = load_bias_ + phdr->p_vaddr;
-				const Elf32_Ehdr* ehdr = (const Elf32_Ehdr*)(void*)elf_addr;
-				Elf32_Addr  offset = ehdr->e_phoff;
-				return CheckPhdr((Elf32_Addr)ehdr + offset);
+				const Elf_Ehdr* ehdr = image_.At<const Elf_Ehdr>(phdr->p_vaddr);
+				if (ehdr == nullptr)
+				{
+					break;
+				}
+				Elf_Addr  offset = ehdr->e_phoff;
+				return CheckPhdr(phdr->p_vaddr + offset);
 			}
 			break;
 		}
 	}
 
-	DL_ERR("can't find loaded phdr for \"%s\"", sopath_);
+	DL_ERR("can't find loaded phdr for \"%s\"", sopath_.constData());
 	return false;
 }
 
-bool ElfReader::CheckPhdr(Elf32_Addr loaded)
+template <typename ElfClass>
+bool ElfReader<ElfClass>::CheckPhdr(Elf_Addr loaded)
 {
-	const Elf32_Phdr* phdr_limit = phdr_table_ + phdr_num_;
-	Elf32_Addr loaded_end = loaded + (phdr_num_ * sizeof(Elf32_Phdr));
-	for (Elf32_Phdr* phdr = phdr_table_; phdr < phdr_limit; ++phdr)
+	const Elf_Phdr* phdr_limit = phdr_table_ + phdr_num_;
+	Elf_Addr loaded_end = loaded + (phdr_num_ * sizeof(Elf_Phdr));
+	for (Elf_Phdr* phdr = phdr_table_; phdr < phdr_limit; ++phdr)
 	{
 		if (phdr->p_type != PT_LOAD)
 		{
 			continue;
 		}
 
-		//ʾЧļӳ
-		Elf32_Addr seg_start = phdr->p_vaddr + load_bias_;	//ڴַ
-		Elf32_Addr seg_end = phdr->p_filesz + seg_start;	//ڴַ + ļС
+		//表示了有效的文件映射
+		Elf_Addr seg_start = phdr->p_vaddr;	//段虚拟地址
+		Elf_Addr seg_end = phdr->p_filesz + seg_start;	//段虚拟地址 + 文件大小
 		if (seg_start <= loaded && loaded_end <= seg_end)
 		{
-			loaded_phdr_ = reinterpret_cast<const Elf32_Phdr*>(loaded);
-			return true;
+			loaded_phdr_ = image_.At<const Elf_Phdr>(loaded, phdr_num_);
+			return loaded_phdr_ != nullptr;
 		}
 	}
-	DL_ERR("\"%s\" loaded phdr %x not in loadable segment", sopath_, loaded);
+	DL_ERR("\"%s\" loaded phdr %llx not in loadable segment", sopath_.constData(), (unsigned long long)loaded);
 	return false;
 }
+
+template class ElfReader<Elf32Class>;
+template class ElfReader<Elf64Class>;
@@ -1,55 +1,84 @@
 #pragma once
-#include "exec_elf.h"
+#include "ElfTraits.h"
+#include "ImageView.h"
+#include "JobLog.h"
+#include "CountingDevice.h"
 #include <QFile>
+#include <QBuffer>
 
 
+template <typename ElfClass>
 class ElfReader 
 {
 public:
-	ElfReader(const char* sopath, const char *dumppath);
+	typedef typename ElfClass::Ehdr Elf_Ehdr;
+	typedef typename ElfClass::Phdr Elf_Phdr;
+	typedef typename ElfClass::Addr Elf_Addr;
+
+
+	ElfReader(const char* sopath, const char *dumppath, JobLog *log);
 	~ElfReader();
 
 	bool Load();
 
+	//只读取elf头和程序头得到load_size, 不分配镜像, 用于在任务开始前估计内存占用
+	bool Probe();
+
+	//正常so已由RefCache读入内存时, 从内存读取而不再打开文件, 需在Load之前调用
+	void set_reference(const QByteArray &bytes);
+
+	//dump已读入内存时(计算结果缓存键或流水线预读时读入), 从内存读取, 需在Load之前调用
+	void set_dump(const QByteArray &bytes);
+
 	size_t phdr_count() { return phdr_num_; }
-	Elf32_Addr load_start() { return reinterpret_cast<Elf32_Addr>(load_start_); }
-	Elf32_Addr load_size() { return load_size_; }
-	Elf32_Addr load_bias() { return load_bias_; }
-	const Elf32_Phdr* loaded_phdr() { return loaded_phdr_; }
-	Elf32_Ehdr header() { return header_; }
+	void* load_start() { return load_start_; }
+	size_t load_size() { return load_size_; }
+	const ImageView& image() { return image_; }
+	const Elf_Phdr* loaded_phdr() { return loaded_phdr_; }
+	const Elf_Ehdr& header() { return header_; }
 
 private:
 	bool OpenElf();
 	bool ReadElfHeader();
 	bool VerifyElfHeader();
 	bool ReadProgramHeader();
-	static size_t phdr_table_get_load_size(const Elf32_Phdr* phdr_table, 
-		size_t phdr_count, Elf32_Addr* out_min_vaddr, Elf32_Addr* out_max_vaddr = 0);
+	static size_t phdr_table_get_load_size(const Elf_Phdr* phdr_table, 
+		size_t phdr_count, Elf_Addr* out_min_vaddr, Elf_Addr* out_max_vaddr = 0);
 	bool ReserveAddressSpace();
 	bool LoadSegments();
 	bool FindPhdr();
-	bool CheckPhdr(Elf32_Addr);
+	bool CheckPhdr(Elf_Addr loaded);
 
-	char* sopath_;		//so
-	char* dumppath_;	//޸dump so, Ϊ˵޸so
+	JobLog *log_;		//所属任务的日志
+	QByteArray sopath_;		//正常so
+	QByteArray dumppath_;	//待修复dump so, 如果为空说明修复正常so
 
 	QFile sofile_;
+	CountingDevice so_io_;	//经此访问sofile_, 记录文件访问
+	QBuffer refbuf_;	//set_reference的内存文件
+	QIODevice *sodev_;	//读取正常so: so_io_或refbuf_
 	QFile dumpfile_;
+	CountingDevice dump_io_;
+	QBuffer dumpbuf_;	//set_dump的内存文件
+	QIODevice *dumpdev_;	//读取dump: dump_io_或dumpbuf_
 
-	Elf32_Ehdr header_;			//elfļͷ
-	size_t phdr_num_;			//ͷ
+	Elf_Ehdr header_;			//elf文件头部
+	size_t phdr_num_;			//程序头表项数量
 
-	void* phdr_mmap_;			//ͷڴӳҳʼַ
-	Elf32_Phdr* phdr_table_;	//ͷڴַ
-	Elf32_Addr phdr_size_;		//ͷռҳС
+	void* phdr_mmap_;			//程序头表内存映射的页起始地址
+	Elf_Phdr* phdr_table_;	//程序头表的内存地址
+	Elf_Addr phdr_size_;		//程序头表所占页大小
 
-	// First page of reserved address space. ڶμصĵַռʼҳڴӳʼҳ
+	// First page of reserved address space. 保留的用于段加载的地址空间的起始页即内存映射起始页
 	void* load_start_;
-	// Size in bytes of reserved address space. ַռĴСڴӳС
-	Elf32_Addr load_size_;
-	// Load bias. ʵڴӳڴӳƫ
-	Elf32_Addr load_bias_;
+	// Size in bytes of reserved address space. 保留地址空间的大小即内存映射大小
+	size_t load_size_;
+	// 内存映射的视图, 代替load_bias完成虚拟地址到宿主内存的转换
+	ImageView image_;
+
+	// Loaded phdr. 已加载的PT_PHDR段, 或第一个可加载的段PT_LOAD并且文件偏移p_offset为0的段
+	const Elf_Phdr* loaded_phdr_;
 
-	// Loaded phdr. ѼصPT_PHDR, һɼصĶPT_LOADļƫp_offsetΪ0Ķ
-	const Elf32_Phdr* loaded_phdr_;
+	//基准测试单独调用各个步骤
+	friend class Bench;
 };
@@ -0,0 +1,146 @@
+#pragma once
+#include "exec_elf.h"
+#include <stddef.h>
+
+//ELF类型萃取: 读取/修复/重建流程以此为模板参数, 32位(ARM)与64位(AArch64)分别实例化,
+//所有与位数, 机器相关的类型和常量都在这里给出, 热点循环中不再有运行时判断
+
+struct Elf32Class
+{
+	typedef Elf32_Ehdr Ehdr;
+	typedef Elf32_Phdr Phdr;
+	typedef Elf32_Shdr Shdr;
+	typedef Elf32_Dyn Dyn;
+	typedef Elf32_Sym Sym;
+	typedef Elf32_Rel Rel;		//ARM只使用REL
+	typedef Elf32_Addr Addr;
+	typedef Elf32_Off Off;
+	typedef Elf32_Word Word;
+
+	static const unsigned char kClass = ELFCLASS32;
+	static const Elf32_Half kMachine = EM_ARM;
+	static const Elf32_Word kEFlags = 0x5000000;	//EABI5
+
+	//重定位表的动态节标志和节类型
+	static const int kDtRel = DT_REL;
+	static const int kDtRelSz = DT_RELSZ;
+	static const Elf32_Word kShtRel = SHT_REL;
+
+	//重定位类型
+	static const unsigned kRelNone = R_ARM_NONE;
+	static const unsigned kRelAbs = R_ARM_ABS32;
+	static const unsigned kRelGlobDat = R_ARM_GLOB_DAT;
+	static const unsigned kRelJumpSlot = R_ARM_JUMP_SLOT;
+	static const unsigned kRelRelative = R_ARM_RELATIVE;
+
+	//.plt = 头部 + 每个.rel.plt项一个表项
+	static const Elf32_Word kPltHeaderSize = 20;
+	static const Elf32_Word kPltEntrySize = 12;
+
+	static unsigned RType(Elf32_Word info) { return ELF32_R_TYPE(info); }
+	static unsigned RSym(Elf32_Word info) { return ELF32_R_SYM(info); }
+	//REL的加数保存在被重定位的位置上
+	static Elf32_Addr Addend(const Elf32_Rel &rel, Elf32_Addr stored) { (void)rel; return stored; }
+
+	//节名称表, 顺序与ElfFixer::ShIdx一致
+	static const char *shstrtab(size_t *size)
+	{
+		static const char strtab[] =
+			"\0.dynsym\0.dynstr\0.hash\0.gnu.hash\0.rel.dyn\0.rel.plt\0.plt\0.text\0.ARM.exidx\0.rodata\0"
+			".fini_array\0.init_array\0.data.rel.ro\0.dynamic\0.got\0.data\0.bss\0.shstrtab\0";
+		if (size)
+		{
+			*size = sizeof(strtab);
+		}
+		return strtab;
+	}
+
+	//.plt头部特征码
+	//04 E0 2D E5                 STR             LR, [SP, #  - 4]!
+	//04 E0 9F E5                 LDR             LR, =(_GLOBAL_OFFSET_TABLE_ - 0x5EB0)
+	//0E E0 8F E0                 ADD             LR, PC, LR; _GLOBAL_OFFSET_TABLE_
+	//08 F0 BE E5                 LDR             PC, [LR, #8]!; dword_0
+	static const char *plt_code(size_t *size)
+	{
+		static const char code[] = {
+			'\x4', '\xE0', '\x2D', '\xE5',
+			'\x4', '\xE0', '\x9F', '\xE5',
+			'\xE', '\xE0', '\x8F', '\xE0',
+			'\x8', '\xF0', '\xBE', '\xE5'
+		};
+		*size = sizeof(code);
+		return code;
+	}
+
+	//根据.plt头部第5个字(_GLOBAL_OFFSET_TABLE_ - (.plt + 16))计算_GLOBAL_OFFSET_TABLE_的虚拟地址
+	static Elf32_Addr GotFromPlt(const void *plt, Elf32_Addr plt_addr, Elf32_Addr dt_pltgot)
+	{
+		(void)dt_pltgot;
+		return plt_addr + 16 + *reinterpret_cast<const Elf32_Addr *>(reinterpret_cast<const char *>(plt) + 16);
+	}
+};
+
+struct Elf64Class
+{
+	typedef Elf64_Ehdr Ehdr;
+	typedef Elf64_Phdr Phdr;
+	typedef Elf64_Shdr Shdr;
+	typedef Elf64_Dyn Dyn;
+	typedef Elf64_Sym Sym;
+	typedef Elf64_Rela Rel;		//AArch64只使用RELA
+	typedef Elf64_Addr Addr;
+	typedef Elf64_Off Off;
+	typedef Elf64_Word Word;
+
+	static const unsigned char kClass = ELFCLASS64;
+	static const Elf64_Half kMachine = EM_AARCH64;
+	static const Elf64_Word kEFlags = 0;
+
+	static const int kDtRel = DT_RELA;
+	static const int kDtRelSz = DT_RELASZ;
+	static const Elf64_Word kShtRel = SHT_RELA;
+
+	static const unsigned kRelNone = R_AARCH64_NONE;
+	static const unsigned kRelAbs = R_AARCH64_ABS64;
+	static const unsigned kRelGlobDat = R_AARCH64_GLOB_DAT;
+	static const unsigned kRelJumpSlot = R_AARCH64_JUMP_SLOT;
+	static const unsigned kRelRelative = R_AARCH64_RELATIVE;
+
+	static const Elf64_Word kPltHeaderSize = 32;
+	static const Elf64_Word kPltEntrySize = 16;
+
+	static unsigned RType(Elf64_Xword info) { return (unsigned)ELF64_R_TYPE(info); }
+	static unsigned RSym(Elf64_Xword info) { return (unsigned)ELF64_R_SYM(info); }
+	static Elf64_Addr Addend(const Elf64_Rela &rel, Elf64_Addr stored) { (void)stored; return rel.r_addend; }
+
+	static const char *shstrtab(size_t *size)
+	{
+		static const char strtab[] =
+			"\0.dynsym\0.dynstr\0.hash\0.gnu.hash\0.rela.dyn\0.rela.plt\0.plt\0.text\0.ARM.exidx\0.rodata\0"
+			".fini_array\0.init_array\0.data.rel.ro\0.dynamic\0.got\0.data\0.bss\0.shstrtab\0";
+		if (size)
+		{
+			*size = sizeof(strtab);
+		}
+		return strtab;
+	}
+
+	//.plt头部特征码, 其后的adrp/ldr/add与地址相关, 只匹配第一条指令
+	//F0 7B BF A9                 STP             X16, X30, [SP,#-0x10]!
+	static const char *plt_code(size_t *size)
+	{
+		static const char code[] = {
+			'\xF0', '\x7B', '\xBF', '\xA9'
+		};
+		*size = sizeof(code);
+		return code;
+	}
+
+	//AArch64的.plt通过adrp寻址, 直接使用DT_PLTGOT
+	static Elf64_Addr GotFromPlt(const void *plt, Elf64_Addr plt_addr, Elf64_Addr dt_pltgot)
+	{
+		(void)plt;
+		(void)plt_addr;
+		return dt_pltgot;
+	}
+};
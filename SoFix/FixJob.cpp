@@ -0,0 +1,466 @@
+#include "FixJob.h"
+#include "ElfReader.h"
+#include "ElfFixer.h"
+#include "ElfBuilder.h"
+#include "Util.h"
+#include "Trace.h"
+#include "CountingDevice.h"
+#include "RefCache.h"
+#include "ResultCache.h"
+#include "Hash64.h"
+#include "AllocCounter.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+
+#define QSTR8BIT(s) (QString::fromLocal8Bit(s))
+
+template <typename ElfClass>
+struct FixJob::Context : public FixJob::ContextBase
+{
+	Context(const char *sopath, const char *dumppath, JobLog *log)
+		: reader(sopath, dumppath, log), si()
+	{
+	}
+
+	ElfReader<ElfClass> reader;
+	soinfo<ElfClass> si;
+	std::unique_ptr<ElfFixer<ElfClass> > fixer;
+};
+
+FixJob::FixJob()
+	: ref_cache_(nullptr), result_cache_(nullptr), input_hash_(0), deferred_(false)
+{
+	store_.valid = false;
+	store_.key = 0;
+	memory_.image = 0;
+	memory_.input = 0;
+	memory_.reference = 0;
+	memory_.scratch = 0;
+}
+
+FixJob::~FixJob()
+{
+}
+
+int FixJob::ElfClassOf(const QString &path)
+{
+	unsigned char ident[ELF_NIDENT] = { 0 };
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::ExistingOnly) ||
+		file.read((char *)ident, ELF_NIDENT) != ELF_NIDENT)
+	{
+		return ELFCLASSNONE;
+	}
+
+	return ident[EI_CLASS];
+}
+
+qint64 FixJob::LoadSizeOf(const QString &path)
+{
+	switch (ElfClassOf(path))
+	{
+	case ELFCLASS32:
+		return loadSizeOf<Elf32Class>(path);
+	case ELFCLASS64:
+		return loadSizeOf<Elf64Class>(path);
+	default:
+		return 0;
+	}
+}
+
+template <typename ElfClass>
+qint64 FixJob::loadSizeOf(const QString &path)
+{
+	JobLog log;
+	QByteArray path8 = path.toLocal8Bit();
+	ElfReader<ElfClass> reader(path8.constData(), nullptr, &log);
+	return reader.Probe() ? (qint64)reader.load_size() : 0;
+}
+
+void FixJob::noteMemory(qint64 image, qint64 input, qint64 reference)
+{
+	Memory memory = { image, input, reference, 0 };
+	for (size_t i = 0; i < outputs_.size(); i++)
+	{
+		memory.scratch += outputs_[i].bytes.size();
+	}
+
+	if (memory.total() > memory_.total())
+	{
+		memory_ = memory;
+	}
+}
+
+bool FixJob::FixSo(const QString &sopath, const QString &dumppath, uint64_t dump_bias)
+{
+	const QString &name = dumppath.isEmpty() ? sopath : dumppath;
+	int mark = log_.output().size();
+
+	QByteArray input;
+	QByteArray ref;
+	uint64_t input_hash = 0;
+	uint64_t ref_hash = 0;
+	bool cached = result_cache_ != nullptr && result_cache_->valid();
+
+	//计算缓存键时读入的输入直接交给reader, 未命中也不会多读一遍
+	if (!input_.isEmpty() && name == input_path_)
+	{
+		input = input_;
+		input_hash = input_hash_;
+	}
+	else if (cached && !readFile(name, input, input_hash))
+	{
+		log_.Error(QSTR8BIT("无法读取: ") + name);
+		return false;
+	}
+
+	//同一个正常so修复多个dump时只读一次
+	if (!dumppath.isEmpty() && (ref_cache_ != nullptr || cached))
+	{
+		bool ok = ref_cache_ != nullptr ? ref_cache_->Get(sopath, ref, &ref_hash) :
+			readFile(sopath, ref, ref_hash);
+		if (!ok)
+		{
+			log_.Error(QSTR8BIT("无法读取正常so文件: ") + sopath);
+			return false;
+		}
+	}
+
+	//报告中的路径换成占位符, 同样内容不同文件名的输入也能共用
+	QString loadedpath = name + ".loaded";
+	QString fixedpath = name + ".fixed";
+	uint64_t key = 0;
+	if (cached)
+	{
+		key = ResultCache::Key(input_hash, ref_hash, dumppath.isEmpty() ? 0 : 1, dump_bias);
+
+		QString report;
+		if (result_cache_->Fetch(key, loadedpath, fixedpath, report))
+		{
+			log_.Print(report.replace("%NAME%", name));
+			log_.Print(QSTR8BIT("命中结果缓存: ") + Hash64::ToHex(key));
+			Trace::Instant("ResultCache hit", "cache", name);
+			noteMemory(0, input.size(), ref.size());
+			return true;
+		}
+	}
+
+	int elf_class = input.size() > EI_CLASS ? (unsigned char)input[EI_CLASS] : ElfClassOf(name);
+	bool ok = false;
+	switch (elf_class)
+	{
+	case ELFCLASS32:
+		ok = fixSo<Elf32Class>(sopath, dumppath, dump_bias, input, ref);
+		break;
+	case ELFCLASS64:
+		ok = fixSo<Elf64Class>(sopath, dumppath, dump_bias, input, ref);
+		break;
+	default:
+		log_.Error(QSTR8BIT("so加载失败, 可能不是有效的so文件"));
+		break;
+	}
+
+	if (ok && cached)
+	{
+		QString report = log_.output().mid(mark);
+		report.chop(1);	//Print逐行追加, 去掉最后的换行
+		store_.valid = true;
+		store_.key = key;
+		store_.loadedpath = loadedpath;
+		store_.fixedpath = fixedpath;
+		store_.report = report.replace(name, "%NAME%");
+	}
+	return ok && (deferred_ || Flush());
+}
+
+void FixJob::set_input(const QString &path, const QByteArray &bytes, uint64_t hash)
+{
+	input_path_ = path;
+	input_ = bytes;
+	input_hash_ = hash;
+}
+
+bool FixJob::Flush()
+{
+	PhaseStats::Scope scope(log_.stats(), PhaseStats::PH_WRITE);
+	for (size_t i = 0; i < outputs_.size(); i++)
+	{
+		const Output &output = outputs_[i];
+		if (!writeFile(output.path, output.bytes.constData(), output.bytes.size()))
+		{
+			log_.Error(QSTR8BIT("无法写入: ") + output.path);
+			return false;
+		}
+		if (PhaseStats *stats = log_.stats())
+		{
+			stats->AddWritten(output.bytes.size());
+		}
+	}
+	outputs_.clear();
+
+	//结果写出后才放入缓存
+	if (store_.valid)
+	{
+		result_cache_->Store(store_.key, store_.loadedpath, store_.fixedpath, store_.report);
+		store_.valid = false;
+	}
+	return true;
+}
+
+bool FixJob::writeOutput(const QString &path, const char *data, qint64 size)
+{
+	if (deferred_)
+	{
+		Output output = { path, QByteArray(data, (int)size) };
+		AllocCounter::Note(size);
+		outputs_.push_back(output);
+		return true;
+	}
+
+	PhaseStats::Scope scope(log_.stats(), PhaseStats::PH_WRITE);
+	if (PhaseStats *stats = log_.stats())
+	{
+		stats->AddWritten(size);
+	}
+	return writeFile(path, data, size);
+}
+
+bool FixJob::writeFile(const QString &path, const char *data, qint64 size)
+{
+	//输出可能是结果缓存中文件的硬链接, 先删除再写, 不能截断
+	QFile::remove(path);
+	QFile file(path);
+	CountingDevice io(&file, &log_);
+	return io.open(QIODevice::WriteOnly | QIODevice::Truncate) && io.write(data, size) == size;
+}
+
+bool FixJob::readFile(const QString &path, QByteArray &bytes, uint64_t &hash)
+{
+	QElapsedTimer timer;
+	timer.start();
+	bool ok = Hash64::ReadFile(path, bytes, hash);
+	if (PhaseStats *stats = log_.stats())
+	{
+		stats->AddFileIo(path, PhaseStats::IO_READ, bytes.size(), timer.nsecsElapsed());
+	}
+	return ok;
+}
+
+bool FixJob::DumpSoToNormal(const QString &dumppath)
+{
+	switch (ElfClassOf(dumppath))
+	{
+	case ELFCLASS32:
+		return dumpSoToNormal<Elf32Class>(dumppath);
+	case ELFCLASS64:
+		return dumpSoToNormal<Elf64Class>(dumppath);
+	default:
+		log_.Error(QSTR8BIT("so加载失败, 可能不是有效的so文件"));
+		return false;
+	}
+}
+
+bool FixJob::FixDumpSo(const QString &dumppath, uint64_t dump_bias)
+{
+	//将dump so转为正常文件so, 再修复节-_-
+	//没有load_bias时重定位过的指针无法还原, 越修越坏, 只保留文件so
+	if (!DumpSoToNormal(dumppath))
+	{
+		return false;
+	}
+
+	return dump_bias == 0 || FixSo(dumppath + ".normal", QString(), dump_bias);
+}
+
+bool FixJob::Rebuild(const QString &json_path)
+{
+	switch (json_elf_class(json_path))
+	{
+	case ELFCLASS32:
+		return rebuild<Elf32Class>(json_path);
+	case ELFCLASS64:
+		return rebuild<Elf64Class>(json_path);
+	default:
+		log_.Error(QSTR8BIT("json文件无效: ") + json_path);
+		return false;
+	}
+}
+
+template <typename ElfClass>
+bool FixJob::rebuild(const QString &json_path)
+{
+	ElfBuilder<ElfClass> elf_bd(json_path, &log_);
+	return elf_bd.Build();
+}
+
+template <typename ElfClass>
+bool FixJob::dumpSoToNormal(const QString &dumppath)
+{
+	typedef typename ElfClass::Phdr Elf_Phdr;
+	typedef typename ElfClass::Addr Elf_Addr;
+
+	QString normalpath = dumppath + ".normal";
+	QFile normalFile(normalpath);
+	CountingDevice normal_io(&normalFile, &log_);
+
+	QByteArray dumppath8 = dumppath.toLocal8Bit();
+	Context<ElfClass> *ctx = new Context<ElfClass>(nullptr, dumppath8.constData(), &log_);
+	ctx_.reset(ctx);
+	if (!input_.isEmpty() && dumppath == input_path_)
+	{
+		ctx->reader.set_dump(input_);
+	}
+
+	ElfReader<ElfClass> &elf_reader = ctx->reader;
+	if (!elf_reader.Load() || !normal_io.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		log_.Error(QSTR8BIT("so加载失败, 可能不是有效的so文件"));
+		return false;
+	}
+
+	PhaseStats::Scope scope(log_.stats(), PhaseStats::PH_WRITE);
+	const Elf_Phdr* phdr = elf_reader.loaded_phdr();
+	const Elf_Phdr* phdr_limit = phdr + elf_reader.phdr_count();
+	const ImageView &image = elf_reader.image();
+
+	for (phdr = elf_reader.loaded_phdr(); phdr < phdr_limit; phdr++)
+	{
+		if (phdr->p_type != PT_LOAD)
+		{
+			continue;
+		}
+
+		Elf_Addr seg_start = phdr->p_vaddr;	//内存映射起始虚拟地址
+		Elf_Addr seg_page_start = PAGE_START(seg_start); //内存映射页首地址
+
+		Elf_Addr seg_file_end = seg_start + phdr->p_filesz; //文件映射终止页
+
+		// File offsets.
+		Elf_Addr file_start = phdr->p_offset;
+		Elf_Addr file_end = file_start + phdr->p_filesz;
+
+		Elf_Addr file_page_start = PAGE_START(file_start); //文件映射页首地址
+		Elf_Addr file_length = file_end - file_page_start; //文件映射大小
+
+		//如果没有可写权限, 修正文件的实际映射大小
+		if ((phdr->p_flags & PF_W) == 0)
+		{
+			seg_file_end = PAGE_END(seg_file_end);
+			file_end = PAGE_END(file_end);
+			file_length = PAGE_END(file_length);
+		}
+
+		//从内存写回文件, 如果一个文件块被映射到多个内存块,
+		//并且内存块被修改过, 这么做会出现问题
+		const char *seg_page = image.At<const char>(seg_page_start, file_length);
+		if (file_length != 0 && seg_page != nullptr)
+		{
+			normal_io.seek(file_page_start);
+			normal_io.write(seg_page, file_length);
+		}
+	}
+
+	normal_io.seek(0);
+	normal_io.write((char *)&elf_reader.header(), sizeof(typename ElfClass::Ehdr));
+	if (PhaseStats *stats = log_.stats())
+	{
+		stats->AddWritten(normal_io.size());
+	}
+	normal_io.close();
+	noteMemory(elf_reader.image().size(), dumppath == input_path_ ? input_.size() : 0, 0);
+	log_.Print(QSTR8BIT("还原为文件so成功: ") + normalpath);
+	return true;
+}
+
+template <typename ElfClass>
+bool FixJob::fixSo(const QString &sopath, const QString &dumppath, uint64_t dump_bias,
+	const QByteArray &input, const QByteArray &ref)
+{
+	const QString &name = dumppath.isEmpty() ? sopath : dumppath;
+	QByteArray sopath8 = sopath.toLocal8Bit();
+	QByteArray dumppath8 = dumppath.toLocal8Bit();
+
+	Context<ElfClass> *ctx = new Context<ElfClass>(sopath.isEmpty() ? nullptr : sopath8.constData(),
+		dumppath.isEmpty() ? nullptr : dumppath8.constData(), &log_);
+	ctx_.reset(ctx);
+
+	//修复正常so时输入就是参考文件
+	const QByteArray &reference = dumppath.isEmpty() ? input : ref;
+	if (!reference.isEmpty())
+	{
+		ctx->reader.set_reference(reference);
+	}
+	if (!dumppath.isEmpty() && !input.isEmpty())
+	{
+		ctx->reader.set_dump(input);
+	}
+
+	ElfReader<ElfClass> &elf_reader = ctx->reader;
+	if (!elf_reader.Load())
+	{
+		log_.Error(QSTR8BIT("so加载失败, 可能不是有效的so文件"));
+		return false;
+	}
+
+	//推迟写出时保存一份, 修复会修改镜像
+	QString loadedpath = name + ".loaded";
+	if (!writeOutput(loadedpath, (const char *)elf_reader.load_start(), elf_reader.load_size()))
+	{
+		log_.Error(QSTR8BIT("无法写入: ") + loadedpath);
+		return false;
+	}
+	log_.Print(QSTR8BIT("加载成功!加载后文件路径: ") + loadedpath);
+
+	//不含路径的文件名
+	soinfo<ElfClass> *si = &ctx->si;
+	if (!soinfo_init<ElfClass>(si, QFileInfo(name).fileName().toLocal8Bit().constData()))
+	{
+		log_.Error(QSTR8BIT("抱歉, 文件名不能超过128个字符!"));
+		return false;
+	}
+
+	//初始化soinfo的其他字段
+	si->image = elf_reader.image();
+	si->flags = 0;
+	si->entry = 0;
+	si->dynamic = NULL;
+	si->phnum = elf_reader.phdr_count();
+	si->phdr = elf_reader.loaded_phdr();
+
+	QString fixedpath = name + ".fixed";
+	QByteArray fixedpath8 = fixedpath.toLocal8Bit();
+	if (!deferred_)
+	{
+		//输出可能是结果缓存中文件的硬链接, 先删除再写, 不能截断
+		QFile::remove(fixedpath);
+	}
+
+	ctx->fixer.reset(new ElfFixer<ElfClass>(si, sopath.isEmpty() ? nullptr : sopath8.constData(),
+		fixedpath8.constData(), &log_));
+	ElfFixer<ElfClass> &elf_fixer = *ctx->fixer;
+	elf_fixer.set_dump_bias((typename ElfClass::Addr)dump_bias);
+	if (deferred_)
+	{
+		elf_fixer.set_buffered();
+	}
+	if (!reference.isEmpty())
+	{
+		elf_fixer.set_reference(reference);
+	}
+	if (!elf_fixer.Fix() || !elf_fixer.Write())
+	{
+		log_.Error(QSTR8BIT("so修复失败, 可能不是有效的so文件(不包含PT_DYNAMIC, DT_STRTAB, DT_SYMTAB)") + fixedpath);
+		return false;
+	}
+
+	if (deferred_)
+	{
+		Output output = { fixedpath, elf_fixer.buffer() };
+		outputs_.push_back(output);
+	}
+	noteMemory(elf_reader.load_size(), input.size(), ref.size());
+
+	log_.Print(QSTR8BIT("修复成功!修复后文件路径: ") + fixedpath);
+	return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <QString>
+#include <QByteArray>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "JobLog.h"
+
+class RefCache;
+class ResultCache;
+
+//一次修复任务的上下文: 持有reader, soinfo, fixer以及日志
+//不使用任何全局或静态可变状态, 不同线程上的多个FixJob可以同时运行, 互不加锁
+//一个FixJob同一时间只能在一个线程上使用
+class FixJob
+{
+public:
+	//任务持有的内存, 按字节; FixDumpSo分两步, 记录较大的一步
+	struct Memory
+	{
+		qint64 image;		//加载后的镜像(load_size)
+		qint64 input;		//读入内存的输入文件
+		qint64 reference;	//正常so(RefCache中的与其他任务共享)
+		qint64 scratch;		//推迟写出的.loaded/.fixed
+
+		qint64 total() const { return image + input + reference + scratch; }
+	};
+
+	FixJob();
+	~FixJob();
+
+	//dumppath为空则直接修复正常so文件, 否则根据正常so文件修复dump文件
+	//dump_bias非0时表示仅有dump, 直接从镜像中减去dump时的load_bias还原重定位
+	bool FixSo(const QString &sopath, const QString &dumppath, uint64_t dump_bias = 0);
+
+	//dump so还原为文件so(dumppath + ".normal")
+	bool DumpSoToNormal(const QString &dumppath);
+
+	//dump so还原为文件so, dump_bias非0时再去除load_bias并修复节
+	bool FixDumpSo(const QString &dumppath, uint64_t dump_bias);
+
+	//根据json重建so
+	bool Rebuild(const QString &json_path);
+
+	JobLog &log() { return log_; }
+
+	//根据正常so修复dump时, 正常so从cache中取得, 不再每个任务重新读取
+	void set_ref_cache(RefCache *cache) { ref_cache_ = cache; }
+
+	//FixSo先按输入内容查找结果缓存, 命中时直接取得.loaded/.fixed, 修复成功后放入缓存
+	void set_result_cache(ResultCache *cache) { result_cache_ = cache; }
+
+	//输入文件已由流水线的预读阶段读入, 处理path时直接使用, hash为其内容哈希
+	void set_input(const QString &path, const QByteArray &bytes, uint64_t hash);
+
+	//.loaded/.fixed先保存在内存中, 由Flush写出(流水线的写出阶段), 修复线程不等待磁盘
+	void set_deferred_write(bool deferred) { deferred_ = deferred; }
+
+	//写出内存中的结果并放入结果缓存, 失败返回false; 未推迟写出时由FixSo调用
+	bool Flush();
+
+	const Memory &memory() const { return memory_; }
+
+	//读取文件的e_ident[EI_CLASS], 失败返回ELFCLASSNONE
+	static int ElfClassOf(const QString &path);
+
+	//根据程序头得到加载后镜像的大小, 不加载, 失败返回0
+	static qint64 LoadSizeOf(const QString &path);
+
+private:
+	//按ElfClass实例化的reader/soinfo/fixer, 生命周期与任务一致
+	struct ContextBase
+	{
+		virtual ~ContextBase() {}
+	};
+	template <typename ElfClass>
+	struct Context;
+
+	//input为已读入的输入文件(正常so或dump), ref为正常so, 为空时各自读取文件
+	template <typename ElfClass>
+	bool fixSo(const QString &sopath, const QString &dumppath, uint64_t dump_bias,
+		const QByteArray &input, const QByteArray &ref);
+	template <typename ElfClass>
+	bool dumpSoToNormal(const QString &dumppath);
+	template <typename ElfClass>
+	bool rebuild(const QString &json_path);
+	template <typename ElfClass>
+	static qint64 loadSizeOf(const QString &path);
+
+	//记录一步的内存占用, 保留较大的
+	void noteMemory(qint64 image, qint64 input, qint64 reference);
+
+	//推迟写出时保存一份data, 否则直接写文件
+	bool writeOutput(const QString &path, const char *data, qint64 size);
+	bool writeFile(const QString &path, const char *data, qint64 size);
+
+	//Hash64::ReadFile, 整个文件的读取计入文件访问统计
+	bool readFile(const QString &path, QByteArray &bytes, uint64_t &hash);
+
+	//推迟写出的结果
+	struct Output
+	{
+		QString path;
+		QByteArray bytes;
+	};
+
+	//写出后放入结果缓存的内容
+	struct PendingStore
+	{
+		bool valid;
+		uint64_t key;
+		QString loadedpath;
+		QString fixedpath;
+		QString report;
+	};
+
+	FixJob(const FixJob &) = delete;
+	FixJob &operator=(const FixJob &) = delete;
+
+	JobLog log_;
+	RefCache *ref_cache_;
+	ResultCache *result_cache_;
+	QString input_path_;
+	QByteArray input_;
+	uint64_t input_hash_;
+	bool deferred_;
+	std::vector<Output> outputs_;
+	PendingStore store_;
+	Memory memory_;
+	std::unique_ptr<ContextBase> ctx_;
+};
@@ -0,0 +1,204 @@
+#include "Hash64.h"
+#include "AllocCounter.h"
+#include <QFile>
+#include <string.h>
+#include <vector>
+
+static const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+static const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+//按机器字节序读取, x86与ARM均为小端, 与官方实现一致
+static inline uint64_t read64(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t rotl(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t accumulate(uint64_t acc, uint64_t input)
+{
+	acc += input * kPrime2;
+	acc = rotl(acc, 31);
+	return acc * kPrime1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t val)
+{
+	acc ^= accumulate(0, val);
+	return acc * kPrime1 + kPrime4;
+}
+
+Hash64::Hash64(uint64_t seed)
+	: seed_(seed), total_(0), buffered_(0)
+{
+	v_[0] = seed + kPrime1 + kPrime2;
+	v_[1] = seed + kPrime2;
+	v_[2] = seed;
+	v_[3] = seed - kPrime1;
+}
+
+void Hash64::Update(const void *data, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	const uint8_t *end = p + len;
+	total_ += len;
+
+	//先补满上次剩下的条带
+	if (buffered_ + len < sizeof(buf_))
+	{
+		memcpy(buf_ + buffered_, p, len);
+		buffered_ += len;
+		return;
+	}
+	if (buffered_ != 0)
+	{
+		size_t fill = sizeof(buf_) - buffered_;
+		memcpy(buf_ + buffered_, p, fill);
+		p += fill;
+		v_[0] = accumulate(v_[0], read64(buf_));
+		v_[1] = accumulate(v_[1], read64(buf_ + 8));
+		v_[2] = accumulate(v_[2], read64(buf_ + 16));
+		v_[3] = accumulate(v_[3], read64(buf_ + 24));
+		buffered_ = 0;
+	}
+
+	for (; p + 32 <= end; p += 32)
+	{
+		v_[0] = accumulate(v_[0], read64(p));
+		v_[1] = accumulate(v_[1], read64(p + 8));
+		v_[2] = accumulate(v_[2], read64(p + 16));
+		v_[3] = accumulate(v_[3], read64(p + 24));
+	}
+
+	buffered_ = end - p;
+	memcpy(buf_, p, buffered_);
+}
+
+uint64_t Hash64::Digest() const
+{
+	uint64_t h;
+	if (total_ >= 32)
+	{
+		h = rotl(v_[0], 1) + rotl(v_[1], 7) + rotl(v_[2], 12) + rotl(v_[3], 18);
+		h = mergeRound(h, v_[0]);
+		h = mergeRound(h, v_[1]);
+		h = mergeRound(h, v_[2]);
+		h = mergeRound(h, v_[3]);
+	}
+	else
+	{
+		h = seed_ + kPrime5;
+	}
+	h += total_;
+
+	const uint8_t *p = buf_;
+	const uint8_t *end = buf_ + buffered_;
+	for (; p + 8 <= end; p += 8)
+	{
+		h ^= accumulate(0, read64(p));
+		h = rotl(h, 27) * kPrime1 + kPrime4;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= (uint64_t)read32(p) * kPrime1;
+		h = rotl(h, 23) * kPrime2 + kPrime3;
+		p += 4;
+	}
+	for (; p < end; p++)
+	{
+		h ^= (*p) * kPrime5;
+		h = rotl(h, 11) * kPrime1;
+	}
+
+	h ^= h >> 33;
+	h *= kPrime2;
+	h ^= h >> 29;
+	h *= kPrime3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t Hash64::Of(const void *data, size_t len, uint64_t seed)
+{
+	Hash64 hash(seed);
+	hash.Update(data, len);
+	return hash.Digest();
+}
+
+bool Hash64::OfFile(const QString &path, uint64_t &hash)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::ExistingOnly))
+	{
+		return false;
+	}
+
+	Hash64 state;
+	std::vector<char> chunk(1024 * 1024);
+	while (true)
+	{
+		qint64 n = file.read(&chunk[0], chunk.size());
+		if (n < 0)
+		{
+			return false;
+		}
+		if (n == 0)
+		{
+			break;
+		}
+		state.Update(&chunk[0], (size_t)n);
+	}
+
+	hash = state.Digest();
+	return true;
+}
+
+bool Hash64::ReadFile(const QString &path, QByteArray &bytes, uint64_t &hash)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::ExistingOnly))
+	{
+		return false;
+	}
+
+	const qint64 kChunk = 1024 * 1024;
+	qint64 size = file.size();
+	bytes.resize((int)size);
+	AllocCounter::Note(size);
+
+	Hash64 state;
+	qint64 done = 0;
+	while (done < size)
+	{
+		qint64 n = file.read(bytes.data() + done, qMin(kChunk, size - done));
+		if (n <= 0)
+		{
+			return false;
+		}
+		state.Update(bytes.constData() + done, (size_t)n);
+		done += n;
+	}
+
+	hash = state.Digest();
+	return true;
+}
+
+QString Hash64::ToHex(uint64_t hash)
+{
+	return QString("%1").arg((quint64)hash, 16, 16, QChar('0'));
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <QString>
+#include <QByteArray>
+#include <stddef.h>
+#include <stdint.h>
+
+//XXH64, 可以分段输入, 读文件时边读边算, 结果与官方xxHash的XXH64一致
+class Hash64
+{
+public:
+	explicit Hash64(uint64_t seed = 0);
+
+	void Update(const void *data, size_t len);
+	uint64_t Digest() const;
+
+	//一次性计算
+	static uint64_t Of(const void *data, size_t len, uint64_t seed = 0);
+
+	//计算整个文件, 打开或读取失败返回false
+	static bool OfFile(const QString &path, uint64_t &hash);
+
+	//读入整个文件, 边读边算哈希, 之后直接使用bytes, 不需要为哈希再读一遍
+	static bool ReadFile(const QString &path, QByteArray &bytes, uint64_t &hash);
+
+	//16位十六进制, 用于文件名和清单
+	static QString ToHex(uint64_t hash);
+
+private:
+	uint64_t seed_;
+	uint64_t v_[4];
+	uint64_t total_;		//已输入的字节数
+	uint8_t buf_[32];		//不足一个条带(32字节)的剩余数据
+	size_t buffered_;
+};
@@ -1,18 +1,15 @@
 #include "Helper.h"
-#include "ElfReader.h"
 #include "QTextStream"
-#include "ElfFixer.h"
-#include <QSettings>
-#include "Util.h"
-#include "ElfBuilder.h"
+#include "FixJob.h"
+#include <stdint.h>
 
 #define QSTR8BIT(s) (QString::fromLocal8Bit(s))
 
 const Helper::Command Helper::cmdSo =
 {
 	QSTR8BIT("------------Android Arm so Fix Tool, By Youlor------------\n"
-	"ѡ޸ļ:\n1.Soļ(Reference ThomasKing)\n2.Dump Soļ(soļ޸, ڽsoڴ޸)"
-	"\n3.Dump Soļ(ԭΪsoļ, !)\n4.ؽsoļ(Ҫjsonļ)\n5.˳"),
+	"请选择修复文件类型:\n1.正常So文件(Reference ThomasKing)\n2.Dump So文件(需正常so文件辅助修复, 适用于解密so在内存中修复后的情况)"
+	"\n3.Dump So文件(还原为正常so文件, 慎用!)\n4.重建so文件(需要配置json文件)\n5.退出"),
 	5,
 	{ ElfFixNormalSo , ElfFixDumpSoFromNormal, ElfFixDumpSo , ElfRebuild, Exit}
 };
@@ -28,10 +25,12 @@ void Helper::ElfFixNormalSo()
 	QTextStream qin(stdin);
 	QString sopath;
 
-	qout << QSTR8BIT("޸soļ·:") << endl;
+	qout << QSTR8BIT("请输入待修复的正常so文件路径:") << endl;
 	qin >> sopath;
 
-	elfFixSo(sopath.toLocal8Bit(), nullptr);
+	FixJob job;
+	job.FixSo(sopath, QString());
+	printLog(job);
 }
 
 void Helper::ElfFixDumpSoFromNormal()
@@ -41,13 +40,15 @@ void Helper::ElfFixDumpSoFromNormal()
 	QString sopath;
 	QString dumppath;
 
-	qout << QSTR8BIT("ڸ޸soļ·:") << endl;
+	qout << QSTR8BIT("请输入用于辅助修复的正常so文件路径:") << endl;
 	qin >> sopath;
 
-	qout << QSTR8BIT("޸dump soļ·:") << endl;
+	qout << QSTR8BIT("请输入待修复的dump so文件路径:") << endl;
 	qin >> dumppath;
 
-	elfFixSo(sopath.toLocal8Bit(), dumppath.toLocal8Bit());
+	FixJob job;
+	job.FixSo(sopath, dumppath);
+	printLog(job);
 }
 
 void Helper::ElfRebuild()
@@ -56,152 +57,42 @@ void Helper::ElfRebuild()
 	QTextStream qin(stdin);
 	QString json_path;
 
-	qout << QSTR8BIT("ؽjsonļ:") << endl;
+	qout << QSTR8BIT("请输入用于重建的json文件:") << endl;
 	qin >> json_path;
 
-	ElfBuilder elf_bd(json_path);
-	if (elf_bd.Build())
+	FixJob job;
+	bool ok = job.Rebuild(json_path);
+	printLog(job);
+	if (ok)
 	{
-		qout << QSTR8BIT("ؽɹ!") << endl;
+		qout << QSTR8BIT("重建成功!") << endl;
 	}
 	else
 	{
-		qout << QSTR8BIT("ؽʧ!") << endl;
+		qout << QSTR8BIT("重建失败!") << endl;
 	}
 }
 
-
-bool Helper::elfDumpSoToNormal(QString &dumppath)
-{
-	QString normalpath;
-	QTextStream qout(stdout);
-
-	normalpath = dumppath + ".normal";
-	QFile normalFile(normalpath);
-
-	ElfReader elf_reader(nullptr, dumppath.toLocal8Bit());
-	if (elf_reader.Load() && normalFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
-	{
-		const Elf32_Phdr* phdr = elf_reader.loaded_phdr();
-		const Elf32_Phdr* phdr_limit = phdr + elf_reader.phdr_count();
-		Elf32_Addr load_bias = (Elf32_Addr)elf_reader.load_bias();
-
-		for (phdr = elf_reader.loaded_phdr(); phdr < phdr_limit; phdr++)
-		{
-			if (phdr->p_type != PT_LOAD)
-			{
-				continue;
-			}
-
-			Elf32_Addr seg_start = phdr->p_vaddr + load_bias;	//ڴӳʵʼַ
-			Elf32_Addr seg_end = seg_start + phdr->p_memsz;	//ڴӳʵַֹ
-
-			Elf32_Addr seg_page_start = PAGE_START(seg_start); //ڴӳҳ׵ַ
-			Elf32_Addr seg_page_end = PAGE_END(seg_end);	   //ڴӳֹҳ
-
-			Elf32_Addr seg_file_end = seg_start + phdr->p_filesz; //ļӳֹҳ
-
-			// File offsets.
-			Elf32_Addr file_start = phdr->p_offset;
-			Elf32_Addr file_end = file_start + phdr->p_filesz;
-
-			Elf32_Addr file_page_start = PAGE_START(file_start); //ļӳҳ׵ַ
-			Elf32_Addr file_length = file_end - file_page_start; //ļӳС
-
-			//ûпдȨ, ļʵӳС
-			if ((phdr->p_flags & PF_W) == 0)
-			{
-				seg_file_end = PAGE_END(seg_file_end);
-				file_end = PAGE_END(file_end);
-				file_length = PAGE_END(file_length);
-			}
-
-			//ڴдļ, һļ鱻ӳ䵽ڴ, 
-			//ڴ鱻޸Ĺ, ô
-			if (file_length != 0)
-			{
-				normalFile.seek(file_page_start);
-				normalFile.write((char *)seg_page_start, file_length);
-			}
-		}
-	}
-
-	normalFile.seek(0);
-	normalFile.write((char *)&elf_reader.header(), sizeof(Elf32_Ehdr));
-	normalFile.close();
-	qout << QSTR8BIT("ԭΪļsoɹ: ") + normalpath << endl;
-	return true;
-}
-
 void Helper::ElfFixDumpSo()
 {
 	QTextStream qout(stdout);
 	QTextStream qin(stdin);
 	QString dumppath;
-	QString normalpath;
+	QString bias;
 
-	qout << QSTR8BIT("޸dump soļ·:") << endl;
+	qout << QSTR8BIT("请输入待修复的dump so文件路径:") << endl;
 	qin >> dumppath;
-	normalpath = dumppath + ".normal";
 
-	//dump soתΪļso, ٵelfFixNormalSo޸-_-
-	//...ԽԽ -_- ļsoܿ~_~
-	if (elfDumpSoToNormal(dumppath))
-	{
-		//elfFixSo(normalpath.toLocal8Bit(), nullptr);
-	}
+	qout << QSTR8BIT("请输入dump时so的加载基址load_bias(十六进制, 输入0则不还原重定位):") << endl;
+	qin >> bias;
+	uint64_t dump_bias = bias.toULongLong(nullptr, 16);
+
+	FixJob job;
+	job.FixDumpSo(dumppath, dump_bias);
+	printLog(job);
 }
 
-//dumppathΪֱ޸soļ, ݸsoļ޸dumpļ
-bool Helper::elfFixSo(const char *sopath, const char *dumppath)
+void Helper::printLog(FixJob &job)
 {
-	const char *name = dumppath ? dumppath : sopath;
-	ElfReader elf_reader(sopath, dumppath);
-	QTextStream qout(stdout);
-
-	if (elf_reader.Load())
-	{
-		QString loadedpath = QSTR8BIT(name) + ".loaded";
-		QFile loadedFile(loadedpath);
-		if (loadedFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
-		{
-			loadedFile.write((char *)elf_reader.load_start(), elf_reader.load_size());
-			qout << QSTR8BIT("سɹ!غļ·: ") + loadedpath << endl;
-
-			const char* bname = strrchr(name, '\\');//һγ"/"ַ֮, ȡ·ļ
-			soinfo* si = soinfo_alloc(bname ? bname + 1 : name);//soinfoڴ, ڴʼΪ0, name
-			if (si == NULL)
-			{
-				qout << QSTR8BIT("Ǹ, ļܳ128ַ!") << endl;
-				return NULL;
-			}
-
-			//ʼsoinfoֶ
-			si->base = elf_reader.load_start();
-			si->size = elf_reader.load_size();
-			si->load_bias = elf_reader.load_bias();
-			si->flags = 0;
-			si->entry = 0;
-			si->dynamic = NULL;
-			si->phnum = elf_reader.phdr_count();
-			si->phdr = elf_reader.loaded_phdr();
-
-			QString fixedpath = QSTR8BIT(name) + ".fixed";
-			
-			ElfFixer elf_fixer(si, sopath, fixedpath.toLocal8Bit());
-			if (elf_fixer.Fix() && elf_fixer.Write())
-			{
-				qout << QSTR8BIT("޸ɹ!޸ļ·: ") + fixedpath << endl;
-			}
-			else
-			{
-				qout << QSTR8BIT("so޸ʧ, ܲЧsoļ(PT_DYNAMIC, DT_HASH, DT_STRTAB, DT_SYMTAB)") + fixedpath << endl;
-			}
-		}
-	}
-	else
-	{
-		qout << QSTR8BIT("soʧ, ܲЧsoļ") << endl;
-	}
-	return true;
+	QTextStream(stdout) << job.log().output() << flush;
 }
@@ -3,6 +3,8 @@
 
 #define MAX_CMD_COUNT (10)
 
+class FixJob;
+
 class Helper
 {
 public:
@@ -22,9 +24,10 @@ public:
 	static void Exit();
 	static void ElfFixNormalSo();
 	static void ElfFixDumpSoFromNormal();
-	static bool elfDumpSoToNormal(QString &dumppath);
 	static void ElfFixDumpSo();
-	static bool elfFixSo(const char *sopath, const char *dumppath);
 	static void ElfRebuild();
-};
 
+private:
+	//交互模式下把任务日志输出到控制台
+	static void printLog(FixJob &job);
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+//已加载so镜像的视图: 宿主内存基址 + 虚拟地址到宿主内存的转换
+//所有对镜像的访问都通过它进行, 不再把宿主指针强转为Elf32_Addr, 因此可以在64位进程中运行
+//虚拟地址统一用64位表示, 32位和64位ELF共用
+class ImageView
+{
+public:
+	ImageView()
+		: base_(nullptr), min_vaddr_(0), size_(0)
+	{
+	}
+
+	//base为min_vaddr对应的宿主内存, size为镜像大小
+	ImageView(uint8_t *base, uint64_t min_vaddr, size_t size)
+		: base_(base), min_vaddr_(min_vaddr), size_(size)
+	{
+	}
+
+	uint8_t *base() const { return base_; }
+	uint64_t min_vaddr() const { return min_vaddr_; }
+	uint64_t max_vaddr() const { return min_vaddr_ + size_; }
+	size_t size() const { return size_; }
+	bool empty() const { return base_ == nullptr || size_ == 0; }
+
+	//[vaddr, vaddr + len)是否完全落在镜像内
+	bool Contains(uint64_t vaddr, size_t len = 1) const
+	{
+		if (vaddr < min_vaddr_)
+		{
+			return false;
+		}
+
+		uint64_t off = vaddr - min_vaddr_;
+		return off <= size_ && len <= size_ - off;
+	}
+
+	//虚拟地址转宿主指针, 要求[vaddr, vaddr + count * sizeof(T))在镜像内, 否则返回nullptr
+	//count常来自镜像中的数据(nbucket等), 先与镜像大小比较, 避免乘法溢出
+	template <typename T>
+	T *At(uint64_t vaddr, size_t count = 1) const
+	{
+		if (count > size_ / sizeof(T) || !Contains(vaddr, count * sizeof(T)))
+		{
+			return nullptr;
+		}
+
+		return reinterpret_cast<T *>(base_ + (size_t)(vaddr - min_vaddr_));
+	}
+
+	//从vaddr到镜像末尾最多能容纳几个T, vaddr不在镜像内时为0
+	template <typename T>
+	size_t CountTo(uint64_t vaddr) const
+	{
+		return Contains(vaddr, 0) ? (size_t)((max_vaddr() - vaddr) / sizeof(T)) : 0;
+	}
+
+	//镜像内的宿主指针转虚拟地址
+	uint64_t ToVaddr(const void *p) const
+	{
+		return min_vaddr_ + (uint64_t)(reinterpret_cast<const uint8_t *>(p) - base_);
+	}
+
+private:
+	uint8_t *base_;
+	uint64_t min_vaddr_;
+	size_t size_;
+};
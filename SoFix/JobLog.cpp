@@ -0,0 +1,77 @@
+#include "JobLog.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <vector>
+
+JobLog::JobLog()
+	: level_(LL_DEBUG), stats_enabled_(false)
+{
+}
+
+QString JobLog::format(const char *fmt, va_list args)
+{
+	char buf[512];
+	va_list copy;
+	va_copy(copy, args);
+	int len = vsnprintf(buf, sizeof(buf), fmt, copy);
+	va_end(copy);
+
+	if (len < 0)
+	{
+		return QString();
+	}
+	if ((size_t)len < sizeof(buf))
+	{
+		return QString::fromLocal8Bit(buf, len);
+	}
+
+	//超过缓冲区的长消息
+	std::vector<char> big(len + 1);
+	vsnprintf(&big[0], big.size(), fmt, args);
+	return QString::fromLocal8Bit(&big[0], len);
+}
+
+void JobLog::Debug(const char *fmt, ...)
+{
+	if (!enabled(LL_DEBUG))
+	{
+		return;
+	}
+
+	va_list args;
+	va_start(args, fmt);
+	output_ += format(fmt, args) + "\n";
+	va_end(args);
+}
+
+void JobLog::Warn(const char *fmt, ...)
+{
+	if (!enabled(LL_WARN))
+	{
+		return;
+	}
+
+	va_list args;
+	va_start(args, fmt);
+	output_ += format(fmt, args) + "\n";
+	va_end(args);
+}
+
+void JobLog::Error(const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	Error(format(fmt, args));
+	va_end(args);
+}
+
+void JobLog::Error(const QString &msg)
+{
+	errors_ << msg;
+	output_ += msg + "\n";
+}
+
+void JobLog::Print(const QString &msg)
+{
+	output_ += msg + "\n";
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include "PhaseStats.h"
+#include <stdarg.h>
+
+//日志级别, 从低到高
+enum LogLevel
+{
+	LL_DEBUG = 0,
+	LL_INFO,
+	LL_WARN,
+	LL_ERROR,
+	LL_NONE,
+};
+
+//编译时的最低级别, 低于该级别的LOG_xxx调用连同参数求值一起被去掉
+//默认全部保留(与原来行为一致); 只跑批处理的构建可以在预处理器定义中加SOFIX_LOG_LEVEL=2(LL_WARN)
+#ifndef SOFIX_LOG_LEVEL
+#define SOFIX_LOG_LEVEL 0
+#endif
+
+//编译期开关, enabled为常量, 关闭时整个if分支被编译器丢弃
+template <int Level, int Threshold = SOFIX_LOG_LEVEL>
+struct LogGate
+{
+	static const bool enabled = Level >= Threshold;
+};
+
+//先检查编译期开关, 再检查运行时级别(内联的比较), 都通过才格式化; 参数只在需要输出时求值
+#define SOFIX_LOG_AT(threshold, log, level, method, ...) \
+	do { if (LogGate<level, threshold>::enabled && (log)->enabled(level)) (log)->method(__VA_ARGS__); } while (0)
+#define LOG_DEBUG(log, ...) SOFIX_LOG_AT(SOFIX_LOG_LEVEL, log, LL_DEBUG, Debug, __VA_ARGS__)
+#define LOG_WARN(log, ...) SOFIX_LOG_AT(SOFIX_LOG_LEVEL, log, LL_WARN, Warn, __VA_ARGS__)
+//错误决定任务是否失败, 总是记录, 不受级别影响
+#define LOG_ERROR(log, ...) (log)->Error(__VA_ARGS__)
+
+//单个任务的日志, 代替全局的qDebug/stdout输出
+//错误列表和输出内容只属于该任务, 多个任务在不同线程上运行时互不干扰, 不需要加锁
+class JobLog
+{
+public:
+	JobLog();
+
+	//printf风格, 与原来的DEBUG/DL_ERR用法一致; 一般通过LOG_xxx宏调用, 以便按级别去掉
+	void Debug(const char *fmt, ...);
+	void Warn(const char *fmt, ...);
+	void Error(const char *fmt, ...);
+	void Error(const QString &msg);
+
+	//给用户看的信息
+	void Print(const QString &msg);
+
+	//运行时级别, 低于该级别的Debug/Warn不写入输出; Error不受影响
+	void set_level(LogLevel level) { level_ = level; }
+	LogLevel level() const { return level_; }
+	bool enabled(LogLevel level) const { return level >= level_; }
+
+	//是否把Debug信息写入输出, 批处理时关闭(只保留警告)
+	void set_verbose(bool verbose) { level_ = verbose ? LL_DEBUG : LL_WARN; }
+
+	//是否记录各阶段的耗时和计数, 不记录时stats()为nullptr
+	void set_stats(bool enabled) { stats_enabled_ = enabled; }
+	PhaseStats *stats() { return stats_enabled_ ? &stats_ : nullptr; }
+
+	const QString& output() const { return output_; }
+	const QStringList& errors() const { return errors_; }
+
+private:
+	QString format(const char *fmt, va_list args);
+
+	LogLevel level_;
+	bool stats_enabled_;
+	PhaseStats stats_;
+	QString output_;
+	QStringList errors_;
+};
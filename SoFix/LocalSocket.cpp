@@ -0,0 +1,199 @@
+#include "LocalSocket.h"
+#include <QDir>
+#include <QFile>
+#include <string.h>
+#include <mutex>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#define closeHandle(fd) closesocket((SOCKET)(fd))
+#define SHUT_WR SD_SEND
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define closeHandle(fd) ::close((int)(fd))
+#endif
+
+//对端已关闭时send不产生SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+static bool fillAddr(const QString &path, sockaddr_un &addr)
+{
+	QByteArray native = QFile::encodeName(QDir::toNativeSeparators(path));
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if ((size_t)native.size() >= sizeof(addr.sun_path))
+	{
+		return false;
+	}
+
+	memcpy(addr.sun_path, native.constData(), native.size());
+	return true;
+}
+
+LocalSocket::LocalSocket()
+	: fd_(kInvalid)
+{
+}
+
+LocalSocket::~LocalSocket()
+{
+	Close();
+}
+
+bool LocalSocket::startup()
+{
+#ifdef _WIN32
+	static std::once_flag once;
+	static bool ok = false;
+	std::call_once(once, [] {
+		WSADATA data;
+		ok = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	});
+	return ok;
+#else
+	return true;
+#endif
+}
+
+QString LocalSocket::DefaultPath()
+{
+	return QDir::temp().filePath("sofix.sock");
+}
+
+bool LocalSocket::Listen(const QString &path, int backlog)
+{
+	sockaddr_un addr;
+	if (!startup() || !fillAddr(path, addr))
+	{
+		return false;
+	}
+
+	Close();
+	fd_ = (Handle)socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd_ == kInvalid)
+	{
+		return false;
+	}
+
+	//上次异常退出留下的套接字文件
+	QFile::remove(path);
+	if (bind(fd_, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd_, backlog) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool LocalSocket::Accept(LocalSocket &client)
+{
+	Handle fd = (Handle)accept(fd_, nullptr, nullptr);
+	if (fd == kInvalid)
+	{
+		return false;
+	}
+
+	client.Close();
+	client.fd_ = fd;
+	return true;
+}
+
+bool LocalSocket::Connect(const QString &path)
+{
+	sockaddr_un addr;
+	if (!startup() || !fillAddr(path, addr))
+	{
+		return false;
+	}
+
+	Close();
+	fd_ = (Handle)socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd_ == kInvalid)
+	{
+		return false;
+	}
+
+	if (connect(fd_, (sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool LocalSocket::ReadLine(QByteArray &line)
+{
+	char chunk[4096];
+
+	while (true)
+	{
+		int pos = buf_.indexOf('\n');
+		if (pos >= 0)
+		{
+			line = buf_.left(pos);
+			buf_.remove(0, pos + 1);
+			return true;
+		}
+
+		int n = (int)recv(fd_, chunk, sizeof(chunk), 0);
+		if (n <= 0)
+		{
+			//最后一行没有换行符
+			if (buf_.isEmpty())
+			{
+				return false;
+			}
+			line = buf_;
+			buf_.clear();
+			return true;
+		}
+		buf_.append(chunk, n);
+	}
+}
+
+bool LocalSocket::Write(const QByteArray &data)
+{
+	const char *p = data.constData();
+	int left = data.size();
+
+	while (left > 0)
+	{
+		int n = (int)send(fd_, p, left, SEND_FLAGS);
+		if (n <= 0)
+		{
+			return false;
+		}
+		p += n;
+		left -= n;
+	}
+
+	return true;
+}
+
+void LocalSocket::ShutdownWrite()
+{
+	if (fd_ != kInvalid)
+	{
+		shutdown(fd_, SHUT_WR);
+	}
+}
+
+void LocalSocket::Close()
+{
+	if (fd_ != kInvalid)
+	{
+		closeHandle(fd_);
+		fd_ = kInvalid;
+	}
+	buf_.clear();
+}
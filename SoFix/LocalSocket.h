@@ -0,0 +1,49 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <stdint.h>
+
+//本机Unix域套接字(AF_UNIX)的简单封装, Windows 10 1803以上同样支持AF_UNIX
+//阻塞读写, 按行收发, 一个对象同一时间只在一个线程上读, 写由调用者加锁
+class LocalSocket
+{
+public:
+	LocalSocket();
+	~LocalSocket();
+
+	//监听path, 已存在的套接字文件会被删除
+	bool Listen(const QString &path, int backlog = 64);
+
+	//阻塞等待连接, 成功时client接管新连接
+	bool Accept(LocalSocket &client);
+
+	bool Connect(const QString &path);
+
+	//读取一行(不含'\n'), 对端关闭且没有剩余数据时返回false
+	bool ReadLine(QByteArray &line);
+
+	//写入全部数据
+	bool Write(const QByteArray &data);
+
+	//不再写入, 对端读到EOF
+	void ShutdownWrite();
+
+	void Close();
+
+	bool valid() const { return fd_ != kInvalid; }
+
+	//缺省的套接字路径: 临时目录下的sofix.sock
+	static QString DefaultPath();
+
+private:
+	typedef intptr_t Handle;
+	static const Handle kInvalid = -1;
+
+	LocalSocket(const LocalSocket &) = delete;
+	LocalSocket &operator=(const LocalSocket &) = delete;
+
+	static bool startup();
+
+	Handle fd_;
+	QByteArray buf_;	//已读取未返回的数据
+};
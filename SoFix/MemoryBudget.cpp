@@ -0,0 +1,33 @@
+#include "MemoryBudget.h"
+#include <QElapsedTimer>
+
+MemoryBudget::MemoryBudget(qint64 budget)
+	: budget_(budget), used_(0), peak_(0), waits_(0), wait_ns_(0)
+{
+}
+
+void MemoryBudget::Acquire(qint64 bytes)
+{
+	std::unique_lock<std::mutex> guard(lock_);
+	if (budget_ > 0 && used_ > 0 && used_ + bytes > budget_)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		waits_++;
+		released_.wait(guard, [this, bytes]() { return used_ == 0 || used_ + bytes <= budget_; });
+		wait_ns_ += timer.nsecsElapsed();
+	}
+
+	used_ += bytes;
+	if (used_ > peak_)
+	{
+		peak_ = used_;
+	}
+}
+
+void MemoryBudget::Release(qint64 bytes)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	used_ -= bytes;
+	released_.notify_all();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <QtGlobal>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+
+//批处理的内存准入控制: 任务开始前按估计的内存占用申请额度, 总额超出预算时等待其他任务结束
+//大文件和小文件混合时, 线程数可以开到最大, 同时运行的大文件数由预算限制, 不会因内存耗尽被杀
+//单个任务的估计超过整个预算时, 等到没有其他任务运行后单独执行, 不会永远等待
+class MemoryBudget
+{
+public:
+	//budget为总预算(字节), <= 0表示不限制
+	explicit MemoryBudget(qint64 budget);
+
+	//申请bytes字节, 预算不足时等待
+	void Acquire(qint64 bytes);
+	void Release(qint64 bytes);
+
+	qint64 budget() const { return budget_; }
+	qint64 peak() const { return peak_; }		//同时占用的最大值
+	uint64_t waits() const { return waits_; }	//因预算不足等待的次数
+	double wait_ms() const { return wait_ns_ / 1e6; }
+
+private:
+	MemoryBudget(const MemoryBudget &) = delete;
+	MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+	qint64 budget_;
+	qint64 used_;
+	qint64 peak_;
+	uint64_t waits_;
+	qint64 wait_ns_;
+	std::mutex lock_;		//保护以上计数
+	std::condition_variable released_;
+};
@@ -0,0 +1,298 @@
+#include "PhaseStats.h"
+#include "Trace.h"
+#include "Util.h"
+#include <string.h>
+
+PhaseStats::Scope::Scope(PhaseStats *stats, Phase phase)
+	: stats_(stats), phase_(phase), prev_(PH_LOAD), trace_begin_(Trace::enabled() ? Trace::Now() : -1)
+{
+	if (stats_ != nullptr)
+	{
+		prev_ = stats_->current_;
+		stats_->current_ = phase;
+		stats_->counters_[phase].calls++;
+		alloc_start_ = AllocCounter::thread_usage();
+		timer_.start();
+	}
+}
+
+PhaseStats::Scope::~Scope()
+{
+	if (stats_ != nullptr)
+	{
+		//嵌套的阶段各自计时, 外层的时间包含内层
+		Counters &c = stats_->counters_[stats_->current_];
+		c.ns += timer_.nsecsElapsed();
+		AllocCounter::Usage usage = AllocCounter::thread_usage();
+		c.allocs += usage.count - alloc_start_.count;
+		c.alloc_bytes += usage.bytes - alloc_start_.bytes;
+		stats_->current_ = prev_;
+	}
+	if (trace_begin_ >= 0)
+	{
+		Trace::Complete(Name(phase_), "phase", trace_begin_, Trace::Now());
+	}
+}
+
+PhaseStats::MemoryScope::MemoryScope(PhaseStats *stats, bool reset_peak)
+	: stats_(stats), peak_base_(0)
+{
+	if (stats_ != nullptr)
+	{
+		if (reset_peak)
+		{
+			Util::resetPeakRss();
+		}
+		peak_base_ = Util::peakRss();
+	}
+}
+
+PhaseStats::MemoryScope::~MemoryScope()
+{
+	if (stats_ != nullptr)
+	{
+		//同一任务分在几个线程上执行时(流水线的修复和写出), 次数和字节累加, 最大值取较大者
+		AllocCounter::Usage usage = allocs_.usage();
+		Memory &m = stats_->memory_;
+		m.allocs += usage.count;
+		m.alloc_bytes += usage.bytes;
+		m.alloc_largest = qMax(m.alloc_largest, (qint64)usage.largest);
+		m.rss_delta = qMax(m.rss_delta, Util::peakRss() - peak_base_);
+	}
+}
+
+PhaseStats::PhaseStats()
+	: current_(PH_LOAD)
+{
+	memset(counters_, 0, sizeof(counters_));
+	memset(&memory_, 0, sizeof(memory_));
+}
+
+void PhaseStats::Merge(const PhaseStats &other)
+{
+	for (int i = 0; i < PH_MAX; i++)
+	{
+		Counters &c = counters_[i];
+		const Counters &o = other.counters_[i];
+		c.ns += o.ns;
+		c.calls += o.calls;
+		c.bytes_read += o.bytes_read;
+		c.bytes_written += o.bytes_written;
+		c.relocs += o.relocs;
+		c.symbols += o.symbols;
+		c.scanned += o.scanned;
+		c.seeks += o.seeks;
+		c.reads += o.reads;
+		c.writes += o.writes;
+		c.io_read += o.io_read;
+		c.io_written += o.io_written;
+		c.io_ns += o.io_ns;
+		c.allocs += o.allocs;
+		c.alloc_bytes += o.alloc_bytes;
+	}
+
+	memory_.allocs += other.memory_.allocs;
+	memory_.alloc_bytes += other.memory_.alloc_bytes;
+	memory_.alloc_largest = qMax(memory_.alloc_largest, other.memory_.alloc_largest);
+	memory_.rss_delta = qMax(memory_.rss_delta, other.memory_.rss_delta);
+
+	for (std::map<QString, FileIo>::const_iterator it = other.files_.begin(); it != other.files_.end(); ++it)
+	{
+		FileIo &f = *File(it->first);
+		const FileIo &o = it->second;
+		f.seeks += o.seeks;
+		f.reads += o.reads;
+		f.writes += o.writes;
+		f.bytes_read += o.bytes_read;
+		f.bytes_written += o.bytes_written;
+		f.ns += o.ns;
+		f.size = qMax(f.size, o.size);
+	}
+}
+
+QJsonObject PhaseStats::MemoryToJson() const
+{
+	QJsonObject obj;
+	obj.insert("allocs", (double)memory_.allocs);
+	obj.insert("alloc_bytes", (double)memory_.alloc_bytes);
+	obj.insert("alloc_largest", (double)memory_.alloc_largest);
+	obj.insert("rss_delta", (double)memory_.rss_delta);
+	return obj;
+}
+
+PhaseStats::FileIo *PhaseStats::File(const QString &name)
+{
+	std::map<QString, FileIo>::iterator it = files_.find(name);
+	if (it == files_.end())
+	{
+		FileIo file;
+		memset(&file, 0, sizeof(file));
+		it = files_.insert(std::make_pair(name, file)).first;
+	}
+	return &it->second;
+}
+
+void PhaseStats::AddIo(FileIo *file, IoOp op, qint64 bytes, qint64 ns)
+{
+	Counters &c = counters_[current_];
+	c.io_ns += ns;
+	file->ns += ns;
+	switch (op)
+	{
+	case IO_SEEK:
+		c.seeks++;
+		file->seeks++;
+		break;
+	case IO_READ:
+		c.reads++;
+		c.io_read += bytes;
+		file->reads++;
+		file->bytes_read += bytes;
+		break;
+	case IO_WRITE:
+		c.writes++;
+		c.io_written += bytes;
+		file->writes++;
+		file->bytes_written += bytes;
+		break;
+	}
+}
+
+void PhaseStats::AddFileIo(const QString &name, IoOp op, qint64 bytes, qint64 ns)
+{
+	FileIo *file = File(name);
+	file->size = qMax(file->size, bytes);
+	AddIo(file, op, bytes, ns);
+}
+
+double PhaseStats::ReadAmplification() const
+{
+	qint64 bytes = 0;
+	qint64 size = 0;
+	for (std::map<QString, FileIo>::const_iterator it = files_.begin(); it != files_.end(); ++it)
+	{
+		if (it->second.reads > 0)
+		{
+			bytes += it->second.bytes_read;
+			size += it->second.size;
+		}
+	}
+	return size > 0 ? (double)bytes / size : 0;
+}
+
+double PhaseStats::WriteAmplification() const
+{
+	qint64 bytes = 0;
+	qint64 size = 0;
+	for (std::map<QString, FileIo>::const_iterator it = files_.begin(); it != files_.end(); ++it)
+	{
+		if (it->second.writes > 0)
+		{
+			bytes += it->second.bytes_written;
+			size += it->second.size;
+		}
+	}
+	return size > 0 ? (double)bytes / size : 0;
+}
+
+QJsonObject PhaseStats::fileToJson(const FileIo &file)
+{
+	QJsonObject obj;
+	obj.insert("seeks", (double)file.seeks);
+	obj.insert("reads", (double)file.reads);
+	obj.insert("writes", (double)file.writes);
+	obj.insert("bytes_read", (double)file.bytes_read);
+	obj.insert("bytes_written", (double)file.bytes_written);
+	obj.insert("ms", file.ns / 1e6);
+	obj.insert("size", (double)file.size);
+	return obj;
+}
+
+QJsonObject PhaseStats::IoToJson(bool with_files) const
+{
+	FileIo sum;
+	memset(&sum, 0, sizeof(sum));
+	QJsonObject files;
+	for (std::map<QString, FileIo>::const_iterator it = files_.begin(); it != files_.end(); ++it)
+	{
+		const FileIo &f = it->second;
+		sum.seeks += f.seeks;
+		sum.reads += f.reads;
+		sum.writes += f.writes;
+		sum.bytes_read += f.bytes_read;
+		sum.bytes_written += f.bytes_written;
+		sum.ns += f.ns;
+		sum.size += f.size;
+		if (with_files)
+		{
+			files.insert(it->first, fileToJson(f));
+		}
+	}
+
+	QJsonObject io = fileToJson(sum);
+	io.insert("read_amplification", ReadAmplification());
+	io.insert("write_amplification", WriteAmplification());
+	if (with_files)
+	{
+		io.insert("files", files);
+	}
+	return io;
+}
+
+QJsonObject PhaseStats::ToJson() const
+{
+	QJsonObject phases;
+	for (int i = 0; i < PH_MAX; i++)
+	{
+		const Counters &c = counters_[i];
+		if (c.calls == 0 && c.seeks + c.reads + c.writes == 0)
+		{
+			continue;
+		}
+
+		//JSON数值为double, 计数在2^53以内没有精度问题
+		QJsonObject obj;
+		obj.insert("ms", c.ns / 1e6);
+		obj.insert("calls", (double)c.calls);
+		obj.insert("bytes_read", (double)c.bytes_read);
+		obj.insert("bytes_written", (double)c.bytes_written);
+		obj.insert("relocs", (double)c.relocs);
+		obj.insert("symbols", (double)c.symbols);
+		obj.insert("scanned", (double)c.scanned);
+		obj.insert("allocs", (double)c.allocs);
+		obj.insert("alloc_bytes", (double)c.alloc_bytes);
+		if (c.seeks + c.reads + c.writes > 0)
+		{
+			QJsonObject io;
+			io.insert("seeks", (double)c.seeks);
+			io.insert("reads", (double)c.reads);
+			io.insert("writes", (double)c.writes);
+			io.insert("bytes_read", (double)c.io_read);
+			io.insert("bytes_written", (double)c.io_written);
+			io.insert("ms", c.io_ns / 1e6);
+			obj.insert("io", io);
+		}
+		phases.insert(Name((Phase)i), obj);
+	}
+	return phases;
+}
+
+const char *PhaseStats::Name(Phase phase)
+{
+	static const char *const names[PH_MAX] = {
+		"load",
+		"phdr",
+		"ehdr",
+		"shdr_from_phdr",
+		"shdr_from_dynamic",
+		"shdr_from_shdr",
+		"dynsym",
+		"dynstr",
+		"shdr_from_rel_density",
+		"shdr_from_layout",
+		"sym_shndx",
+		"rel",
+		"write"
+	};
+	return names[phase];
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <QString>
+#include "AllocCounter.h"
+#include <stdint.h>
+#include <map>
+
+//单个任务各阶段的耗时和计数: 加载, 程序头, ELF头, 各FixShdr*, FixDynsym, FixRel, 写出
+//挂在JobLog上随任务传递, 不启用时JobLog::stats()为nullptr, 各阶段只多一次判断
+//文件访问(经CountingDevice或整个文件的读写)另按阶段和按文件记录seek/read/write次数, 字节数和耗时
+class PhaseStats
+{
+public:
+	enum Phase
+	{
+		PH_LOAD = 0,
+		PH_PHDR,
+		PH_EHDR,
+		PH_SHDR_FROM_PHDR,
+		PH_SHDR_FROM_DYNAMIC,
+		PH_SHDR_FROM_SHDR,
+		PH_DYNSYM,
+		PH_DYNSTR,
+		PH_SHDR_FROM_REL_DENSITY,
+		PH_SHDR_FROM_LAYOUT,
+		PH_SYM_SHNDX,
+		PH_REL,
+		PH_WRITE,
+		PH_MAX
+	};
+
+	struct Counters
+	{
+		qint64 ns;
+		uint64_t calls;
+		qint64 bytes_read;
+		qint64 bytes_written;
+		uint64_t relocs;		//处理的重定位项
+		uint64_t symbols;		//访问的符号
+		qint64 scanned;			//特征码搜索扫描的字节
+		uint64_t seeks;			//以下为文件访问
+		uint64_t reads;
+		uint64_t writes;
+		qint64 io_read;
+		qint64 io_written;
+		qint64 io_ns;
+		uint64_t allocs;		//阶段内的分配次数和字节(见AllocCounter)
+		qint64 alloc_bytes;
+	};
+
+	//整个任务的内存: 分配次数, 字节, 最大单次分配, 峰值常驻内存的增量
+	struct Memory
+	{
+		uint64_t allocs;
+		qint64 alloc_bytes;
+		qint64 alloc_largest;
+		qint64 rss_delta;
+	};
+
+	enum IoOp
+	{
+		IO_SEEK = 0,
+		IO_READ,
+		IO_WRITE
+	};
+
+	//单个文件的访问, size为打开时的大小和写到的最远位置中的较大者
+	struct FileIo
+	{
+		uint64_t seeks;
+		uint64_t reads;
+		uint64_t writes;
+		qint64 bytes_read;
+		qint64 bytes_written;
+		qint64 ns;
+		qint64 size;
+	};
+
+	//计时一个阶段, 期间Add*记到该阶段; stats为nullptr时不统计
+	//启用了Trace时同时记录一个区间, 与是否统计无关
+	class Scope
+	{
+	public:
+		Scope(PhaseStats *stats, Phase phase);
+		~Scope();
+
+	private:
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+		PhaseStats *stats_;
+		Phase phase_;
+		Phase prev_;
+		QElapsedTimer timer_;
+		AllocCounter::Usage alloc_start_;
+		qint64 trace_begin_;	//追踪未启用时为-1
+	};
+
+	//统计一项任务在一个线程上执行的部分的分配和峰值常驻内存增量, 结束时记入memory(); stats为nullptr时什么都不做
+	//reset_peak为true时先把进程峰值重置为当前RSS(只有一个任务在运行时才准确, 且仅Linux支持),
+	//否则增量为期间进程峰值的增长, 与同时运行的任务互相影响
+	class MemoryScope
+	{
+	public:
+		MemoryScope(PhaseStats *stats, bool reset_peak);
+		~MemoryScope();
+
+	private:
+		MemoryScope(const MemoryScope &) = delete;
+		MemoryScope &operator=(const MemoryScope &) = delete;
+
+		PhaseStats *stats_;
+		AllocCounter::Scope allocs_;
+		qint64 peak_base_;
+	};
+
+	PhaseStats();
+
+	//记到当前阶段(最内层的Scope), 没有Scope时记到PH_LOAD
+	void AddRead(qint64 bytes) { counters_[current_].bytes_read += bytes; }
+	void AddWritten(qint64 bytes) { counters_[current_].bytes_written += bytes; }
+	void AddRelocs(uint64_t count) { counters_[current_].relocs += count; }
+	void AddSymbols(uint64_t count) { counters_[current_].symbols += count; }
+	void AddScanned(qint64 bytes) { counters_[current_].scanned += bytes; }
+
+	const Counters &at(Phase phase) const { return counters_[phase]; }
+
+	//取得文件的记录, 指针在本对象内一直有效, 供CountingDevice打开时取得后逐次累加
+	FileIo *File(const QString &name);
+	void AddIo(FileIo *file, IoOp op, qint64 bytes, qint64 ns);
+	//整个文件一次读入或写出(Hash64::ReadFile, 推迟的写出等), 文件大小即bytes
+	void AddFileIo(const QString &name, IoOp op, qint64 bytes, qint64 ns);
+
+	const Memory &memory() const { return memory_; }
+	//{"allocs", "alloc_bytes", "alloc_largest", "rss_delta"}
+	QJsonObject MemoryToJson() const;
+
+	//读放大: 从文件读取的字节 / 被读取文件的大小; 写放大: 写入的字节 / 写出文件的大小; 没有读写时为0
+	double ReadAmplification() const;
+	double WriteAmplification() const;
+
+	//{"read_amplification", "write_amplification", "seeks", "reads", "writes", "bytes_read", "bytes_written", "ms", "size",
+	// "files": {"<路径>": {...}}}, size为各文件大小之和, with_files为false时不含files
+	QJsonObject IoToJson(bool with_files) const;
+
+	//累加另一个任务的统计, 用于批处理汇总; 同一文件的访问合并, 大小取较大者; 内存的最大分配和RSS增量取较大者
+	void Merge(const PhaseStats &other);
+
+	//{"<阶段>": {"ms", "calls", "bytes_read", "bytes_written", "relocs", "symbols", "scanned"}, ...}, 只含执行过的阶段
+	QJsonObject ToJson() const;
+
+	static const char *Name(Phase phase);
+
+private:
+	static QJsonObject fileToJson(const FileIo &file);
+
+	Counters counters_[PH_MAX];
+	Phase current_;
+	std::map<QString, FileIo> files_;
+	Memory memory_;
+};
@@ -0,0 +1,207 @@
+#include "Pipeline.h"
+#include "FixJob.h"
+#include "Hash64.h"
+#include "MemoryBudget.h"
+#include "Trace.h"
+#include <QElapsedTimer>
+#include <thread>
+
+#define QSTR8BIT(s) (QString::fromLocal8Bit(s))
+
+//在段之间传递的一项, 由当前所在的段独占
+struct Pipeline::Item
+{
+	size_t index;					//jobs中的下标
+	QByteArray input;				//预读的输入文件, 读取失败时为空, 由FixJob自己打开并报告错误
+	uint64_t hash;
+	qint64 footprint;				//向MemoryBudget申请的额度
+	qint64 read_ns;					//预读耗时, 修复时计入该项的文件访问统计
+	std::unique_ptr<FixJob> job;	//修复后保留到写出完成, 推迟写出的结果在其中
+	bool ok;
+	double ms;
+	QString error;
+
+	Item() : index(0), hash(0), footprint(0), read_ns(0), ok(false), ms(0) {}
+};
+
+Pipeline::Pipeline(Batch::Mode mode, int fixers, int depth, RefCache *ref_cache, ResultCache *result_cache,
+	MemoryBudget *budget)
+	: mode_(mode), fixers_(fixers > 0 ? fixers : 1), ref_cache_(ref_cache), result_cache_(result_cache), budget_(budget), phase_stats_(false),
+	read_queue_(depth), write_queue_(depth), prefetch_ns_(0), fix_ns_(0), write_ns_(0),
+	prefetch_bytes_(0), wall_ns_(0)
+{
+}
+
+Pipeline::~Pipeline()
+{
+}
+
+void Pipeline::Run(const std::vector<Batch::Job> &jobs, const std::vector<size_t> &order, const Done &done)
+{
+	QElapsedTimer wall;
+	wall.start();
+
+	std::thread prefetcher([this, &jobs, &order]() {
+		Trace::SetThreadName("prefetch");
+		prefetch(jobs, order);
+	});
+	std::vector<std::thread> fixers;
+	for (int i = 0; i < fixers_; i++)
+	{
+		fixers.push_back(std::thread([this, &jobs, i]() {
+			Trace::SetThreadName(QString("fixer %1").arg(i));
+			fix(jobs);
+		}));
+	}
+	std::thread writer([this, &jobs, &done]() {
+		Trace::SetThreadName("writer");
+		write(jobs, done);
+	});
+
+	//预读结束时关闭read_queue_, 修复线程取完后退出, 之后才能关闭write_queue_
+	prefetcher.join();
+	for (size_t i = 0; i < fixers.size(); i++)
+	{
+		fixers[i].join();
+	}
+	write_queue_.Close();
+	writer.join();
+
+	wall_ns_ = wall.nsecsElapsed();
+}
+
+void Pipeline::prefetch(const std::vector<Batch::Job> &jobs, const std::vector<size_t> &order)
+{
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		std::unique_ptr<Item> item(new Item);
+		item->index = order[i];
+
+		//额度在读入之前申请, 预读本身也受预算限制
+		const QString &name = Batch::JobName(jobs[item->index]);
+		if (budget_ != nullptr)
+		{
+			item->footprint = Batch::EstimateMemory(mode_, jobs[item->index], true);
+			Trace::Span span("budget wait", "batch", name);
+			budget_->Acquire(item->footprint);
+		}
+
+		//json重建由ElfBuilder自己读取
+		QElapsedTimer timer;
+		timer.start();
+		if (mode_ != Batch::MODE_REBUILD)
+		{
+			Trace::Span span("prefetch", "io", name);
+			if (!Hash64::ReadFile(name, item->input, item->hash))
+			{
+				item->input.clear();
+			}
+		}
+		item->read_ns = timer.nsecsElapsed();
+		prefetch_ns_ += item->read_ns;
+		prefetch_bytes_ += item->input.size();
+
+		//队列满时等待, 区间越长说明修复越跟不上
+		Trace::Span span("push read queue", "batch");
+		if (!read_queue_.Push(std::move(item)))
+		{
+			break;
+		}
+	}
+	read_queue_.Close();
+}
+
+void Pipeline::fix(const std::vector<Batch::Job> &jobs)
+{
+	std::unique_ptr<Item> item;
+	while (read_queue_.Pop(item))
+	{
+		QElapsedTimer timer;
+		timer.start();
+
+		const Batch::Job &job = jobs[item->index];
+		Trace::Span span("job", "batch", Batch::JobName(job));
+		item->job.reset(new FixJob);
+		FixJob &fix_job = *item->job;
+		fix_job.log().set_verbose(false);
+		fix_job.log().set_stats(phase_stats_);
+		fix_job.set_ref_cache(ref_cache_);
+		fix_job.set_result_cache(result_cache_);
+		fix_job.set_deferred_write(true);
+		if (!item->input.isEmpty())
+		{
+			if (PhaseStats *stats = fix_job.log().stats())
+			{
+				stats->AddFileIo(Batch::JobName(job), PhaseStats::IO_READ, item->input.size(), item->read_ns);
+			}
+			fix_job.set_input(Batch::JobName(job), item->input, item->hash);
+			item->input.clear();	//只由FixJob持有, 用完即释放
+		}
+		{
+			//修复线程有多个, 预读和写出同时进行, 峰值增量与其他项互相影响
+			PhaseStats::MemoryScope memory(fix_job.log().stats(), false);
+			item->ok = Batch::RunJob(mode_, job, fix_job, &item->error);
+		}
+
+		qint64 ns = timer.nsecsElapsed();
+		item->ms = ns / 1e6;
+		fix_ns_ += ns;
+		Trace::Span push_span("push write queue", "batch");
+		write_queue_.Push(std::move(item));
+	}
+}
+
+void Pipeline::write(const std::vector<Batch::Job> &jobs, const Done &done)
+{
+	std::unique_ptr<Item> item;
+	while (write_queue_.Pop(item))
+	{
+		Trace::Span span("flush", "io", Batch::JobName(jobs[item->index]));
+		QElapsedTimer timer;
+		timer.start();
+		{
+			PhaseStats::MemoryScope memory(item->job->log().stats(), false);
+			if (item->ok && !item->job->Flush())
+			{
+				item->ok = false;
+				item->error = item->job->log().errors().last();
+			}
+		}
+		if (budget_ != nullptr)
+		{
+			budget_->Release(item->footprint);
+		}
+
+		qint64 ns = timer.nsecsElapsed();
+		write_ns_ += ns;
+		done(item->index, item->ok, item->ms + ns / 1e6, item->error, *item->job);
+		item->job.reset();
+	}
+}
+
+QString Pipeline::formatQueue(const QString &name, const Queue::Stats &stats)
+{
+	return QSTR8BIT("%1队列: 平均深度 %2, 最大 %3/%4, 上游等待 %5 ms, 下游等待 %6 ms")
+		.arg(name)
+		.arg(stats.avg_depth, 0, 'f', 2)
+		.arg((quint64)stats.max_depth)
+		.arg((quint64)stats.capacity)
+		.arg(stats.push_wait_ms, 0, 'f', 1)
+		.arg(stats.pop_wait_ms, 0, 'f', 1);
+}
+
+QStringList Pipeline::Report()
+{
+	//利用率 = 该段累计工作时间 / (总耗时 * 该段线程数)
+	double wall = wall_ns_ > 0 ? (double)wall_ns_ : 1;
+	QStringList lines;
+	lines << QSTR8BIT("流水线利用率: 预读 %1% (%2 MB), 修复 %3% (%4 线程), 写出 %5%")
+		.arg(prefetch_ns_ / wall * 100, 0, 'f', 1)
+		.arg(prefetch_bytes_ / 1048576.0, 0, 'f', 1)
+		.arg(fix_ns_ / (wall * fixers_) * 100, 0, 'f', 1)
+		.arg(fixers_)
+		.arg(write_ns_ / wall * 100, 0, 'f', 1);
+	lines << formatQueue(QSTR8BIT("预读->修复"), read_queue_.stats());
+	lines << formatQueue(QSTR8BIT("修复->写出"), write_queue_.stats());
+	return lines;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Batch.h"
+#include "BoundedQueue.h"
+
+class RefCache;
+class ResultCache;
+class MemoryBudget;
+class FixJob;
+
+//批处理的三段流水线: 预读 -> 修复 -> 写出, 读盘, 计算和写盘互相重叠
+//预读线程按调度顺序把输入读入内存(同时计算内容哈希, 结果缓存直接使用),
+//修复线程只做计算, .loaded/.fixed留在内存中(FixJob::set_deferred_write), 由写出线程写到磁盘
+//段之间为有界队列, 同时在内存中的最多为 2 * depth + 修复线程数 项
+class Pipeline
+{
+public:
+	//每项完成(写出)后在写出线程上调用, ms为修复和写出的耗时, job为该项的FixJob(内存占用, 各阶段统计), 调用后释放
+	typedef std::function<void(size_t index, bool ok, double ms, const QString &error, FixJob &job)> Done;
+
+	//fixers为修复线程数, depth为每个队列的容量
+	//budget不为空时, 预读前按估计占用申请额度, 写出后归还
+	Pipeline(Batch::Mode mode, int fixers, int depth, RefCache *ref_cache, ResultCache *result_cache,
+		MemoryBudget *budget = nullptr);
+	~Pipeline();
+
+	//按order的顺序处理jobs, 全部完成后返回
+	void Run(const std::vector<Batch::Job> &jobs, const std::vector<size_t> &order, const Done &done);
+
+	//各项是否记录各阶段的统计(JobLog::set_stats), Run之前调用
+	void set_phase_stats(bool enabled) { phase_stats_ = enabled; }
+
+	//各段的利用率和两个队列的占用, 每行一项, Run之后调用
+	QStringList Report();
+
+private:
+	struct Item;
+	typedef BoundedQueue<std::unique_ptr<Item> > Queue;
+
+	void prefetch(const std::vector<Batch::Job> &jobs, const std::vector<size_t> &order);
+	void fix(const std::vector<Batch::Job> &jobs);
+	void write(const std::vector<Batch::Job> &jobs, const Done &done);
+	static QString formatQueue(const QString &name, const Queue::Stats &stats);
+
+	Pipeline(const Pipeline &) = delete;
+	Pipeline &operator=(const Pipeline &) = delete;
+
+	Batch::Mode mode_;
+	int fixers_;
+	RefCache *ref_cache_;
+	ResultCache *result_cache_;
+	MemoryBudget *budget_;
+	bool phase_stats_;
+	Queue read_queue_;		//预读 -> 修复
+	Queue write_queue_;		//修复 -> 写出
+
+	std::atomic<qint64> prefetch_ns_;	//各段累计工作时间
+	std::atomic<qint64> fix_ns_;
+	std::atomic<qint64> write_ns_;
+	std::atomic<qint64> prefetch_bytes_;
+	qint64 wall_ns_;
+};
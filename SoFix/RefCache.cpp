@@ -0,0 +1,115 @@
+#include "RefCache.h"
+#include "Hash64.h"
+#include "Trace.h"
+#include <QFileInfo>
+#include <QDateTime>
+
+RefCache::RefCache(qint64 max_bytes)
+	: max_bytes_(max_bytes), bytes_(0), hits_(0), misses_(0)
+{
+}
+
+QString RefCache::keyOf(const QString &path)
+{
+	QFileInfo info(path);
+	QString canonical = info.canonicalFilePath();
+	if (canonical.isEmpty())
+	{
+		return QString();
+	}
+
+	return QString("%1|%2|%3").arg(canonical).arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+}
+
+bool RefCache::Get(const QString &path, QByteArray &bytes, uint64_t *hash)
+{
+	QString key = keyOf(path);
+	if (key.isEmpty())
+	{
+		return false;
+	}
+
+	std::shared_ptr<Entry> entry;
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		for (std::list<std::shared_ptr<Entry> >::iterator it = entries_.begin(); it != entries_.end(); ++it)
+		{
+			if ((*it)->key == key)
+			{
+				entry = *it;
+				entries_.erase(it);
+				break;
+			}
+		}
+
+		if (!entry)
+		{
+			entry.reset(new Entry);
+			entry->key = key;
+		}
+		entries_.push_front(entry);
+	}
+
+	//读文件时不持有lock_, 其他正常so的查找不受影响; 等待其他线程读取的时间记入追踪, 用于发现串行
+	qint64 wait_begin = Trace::enabled() ? Trace::Now() : -1;
+	std::lock_guard<std::mutex> guard(entry->load_lock);
+	if (wait_begin >= 0)
+	{
+		Trace::Complete("RefCache wait", "cache", wait_begin, Trace::Now(), path);
+	}
+	if (entry->loaded)
+	{
+		hits_++;
+		bytes = entry->bytes;
+		if (hash)
+		{
+			*hash = entry->hash;
+		}
+		return true;
+	}
+
+	misses_++;
+	{
+		Trace::Span span("RefCache read", "io", path);
+		entry->loaded = Hash64::ReadFile(path, entry->bytes, entry->hash) && !entry->bytes.isEmpty();
+	}
+
+	//读取失败的不缓存, 下次重试; 读取期间已被淘汰的不再计入
+	std::lock_guard<std::mutex> list_guard(lock_);
+	for (std::list<std::shared_ptr<Entry> >::iterator it = entries_.begin(); it != entries_.end(); ++it)
+	{
+		if (*it != entry)
+		{
+			continue;
+		}
+		if (entry->loaded)
+		{
+			entry->size = entry->bytes.size();
+			bytes_ += entry->size;
+		}
+		else
+		{
+			entries_.erase(it);
+		}
+		break;
+	}
+	evict();
+
+	bytes = entry->bytes;
+	if (hash)
+	{
+		*hash = entry->hash;
+	}
+	return entry->loaded;
+}
+
+void RefCache::evict()
+{
+	//至少保留刚使用的一项, 已被任务持有的数据在任务结束后释放
+	while (bytes_ > max_bytes_ && entries_.size() > 1)
+	{
+		std::shared_ptr<Entry> victim = entries_.back();
+		entries_.pop_back();
+		bytes_ -= victim->size;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <stdint.h>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+
+//正常so(参考文件)缓存: 用同一个正常so修复大量dump时, 文件只读一次,
+//之后各任务的ElfReader/ElfFixer从内存中读取程序头, 段数据和重定位原值
+//按文件标识(规范路径, 大小, 修改时间)区分, 文件被替换后自动重新读取
+//缓存的数据只读, QByteArray隐式共享, 多个线程同时使用不需要加锁, 只有查找时加锁
+class RefCache
+{
+public:
+	//最多缓存max_bytes字节, 超出时淘汰最久未使用的
+	explicit RefCache(qint64 max_bytes = 1024LL * 1024 * 1024);
+
+	//取得正常so的内容, 首次使用时读入, 失败返回false
+	//hash不为空时返回内容哈希(XXH64), 读入时顺带计算
+	bool Get(const QString &path, QByteArray &bytes, uint64_t *hash = nullptr);
+
+	uint64_t hits() const { return hits_; }
+	uint64_t misses() const { return misses_; }
+
+private:
+	struct Entry
+	{
+		QString key;
+		QByteArray bytes;
+		uint64_t hash;
+		bool loaded;
+		qint64 size;			//计入bytes_的大小, 由lock_保护
+		std::mutex load_lock;	//同一文件只由一个线程读取, 保护bytes和loaded
+
+		Entry() : hash(0), loaded(false), size(0) {}
+	};
+
+	static QString keyOf(const QString &path);
+	void evict();
+
+	RefCache(const RefCache &) = delete;
+	RefCache &operator=(const RefCache &) = delete;
+
+	std::mutex lock_;	//保护entries_和bytes_
+	std::list<std::shared_ptr<Entry> > entries_;	//最近使用的在前
+	qint64 max_bytes_;
+	qint64 bytes_;
+	std::atomic<uint64_t> hits_;
+	std::atomic<uint64_t> misses_;
+};
@@ -0,0 +1,110 @@
+#include "ResultCache.h"
+#include "Hash64.h"
+#include <QDir>
+#include <QFile>
+#include <QCoreApplication>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char *kLoadedName = "loaded";
+static const char *kFixedName = "fixed";
+static const char *kReportName = "report.txt";
+
+ResultCache::ResultCache(const QString &dir)
+	: dir_(dir), valid_(false), hits_(0), misses_(0), seq_(0)
+{
+	valid_ = !dir.isEmpty() && QDir().mkpath(dir);
+}
+
+uint64_t ResultCache::Key(uint64_t input_hash, uint64_t ref_hash, int mode, uint64_t dump_bias)
+{
+	uint64_t fields[5] = { input_hash, ref_hash, (uint64_t)mode, dump_bias, (uint64_t)kFormatVersion };
+	return Hash64::Of(fields, sizeof(fields));
+}
+
+bool ResultCache::linkOrCopy(const QString &src, const QString &dst)
+{
+	//输出路径上可能是上次命中留下的硬链接, 先删除, 不能覆盖写入缓存中的文件
+	QFile::remove(dst);
+#ifdef _WIN32
+	if (CreateHardLinkW((LPCWSTR)QDir::toNativeSeparators(dst).utf16(),
+		(LPCWSTR)QDir::toNativeSeparators(src).utf16(), NULL))
+	{
+		return true;
+	}
+#else
+	if (::link(QFile::encodeName(src).constData(), QFile::encodeName(dst).constData()) == 0)
+	{
+		return true;
+	}
+#endif
+	return QFile::copy(src, dst);
+}
+
+bool ResultCache::Fetch(uint64_t key, const QString &loadedpath, const QString &fixedpath, QString &report)
+{
+	if (!valid_)
+	{
+		return false;
+	}
+
+	QDir entry(QDir(dir_).filePath(Hash64::ToHex(key)));
+	QFile file(entry.filePath(kReportName));
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		misses_++;
+		return false;
+	}
+	report = QString::fromUtf8(file.readAll());
+	file.close();
+
+	if (!linkOrCopy(entry.filePath(kLoadedName), loadedpath) ||
+		!linkOrCopy(entry.filePath(kFixedName), fixedpath))
+	{
+		misses_++;
+		return false;
+	}
+
+	hits_++;
+	return true;
+}
+
+void ResultCache::Store(uint64_t key, const QString &loadedpath, const QString &fixedpath, const QString &report)
+{
+	if (!valid_)
+	{
+		return;
+	}
+
+	QDir root(dir_);
+	QString name = Hash64::ToHex(key);
+	if (root.exists(name))
+	{
+		return;
+	}
+
+	//先写到本进程独有的临时目录, 再整体改名, 其他进程不会看到写了一半的结果
+	QString tmpname = QString("%1.tmp-%2-%3").arg(name).arg(QCoreApplication::applicationPid()).arg((quint64)seq_++);
+	if (!root.mkdir(tmpname))
+	{
+		return;
+	}
+
+	QDir tmp(root.filePath(tmpname));
+	QFile file(tmp.filePath(kReportName));
+	bool ok = QFile::copy(loadedpath, tmp.filePath(kLoadedName)) &&
+		QFile::copy(fixedpath, tmp.filePath(kFixedName)) &&
+		file.open(QIODevice::WriteOnly) &&
+		file.write(report.toUtf8()) >= 0;
+	file.close();
+
+	//其他进程已经放入同一结果时改名失败, 丢弃自己的
+	if (!ok || !root.rename(tmpname, name))
+	{
+		tmp.removeRecursively();
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <QString>
+#include <stdint.h>
+#include <atomic>
+
+//按内容寻址的修复结果缓存: 语料中大量dump逐字节相同, 相同输入直接取上次的结果
+//键为输入内容, 正常so内容, 修复模式, load_bias和结果格式版本的XXH64,
+//每个键一个目录<dir>/<16位十六进制>, 保存loaded, fixed和report.txt(当时的输出)
+//命中时用硬链接放到输出路径(跨卷等失败时复制), 不再加载和修复
+//多个进程可共用一个缓存目录: 写入先放在临时目录, 完成后整体改名
+class ResultCache
+{
+public:
+	//修复结果的格式发生变化(ElfFixer输出不同)时增加, 旧缓存自动失效
+	static const int kFormatVersion = 2;
+
+	explicit ResultCache(const QString &dir);
+
+	bool valid() const { return valid_; }
+
+	static uint64_t Key(uint64_t input_hash, uint64_t ref_hash, int mode, uint64_t dump_bias);
+
+	//命中时把结果链接到loadedpath/fixedpath, report为当时的输出
+	bool Fetch(uint64_t key, const QString &loadedpath, const QString &fixedpath, QString &report);
+
+	//保存修复结果, 已存在时什么都不做
+	void Store(uint64_t key, const QString &loadedpath, const QString &fixedpath, const QString &report);
+
+	uint64_t hits() const { return hits_; }
+	uint64_t misses() const { return misses_; }
+
+private:
+	//硬链接dst到src, 失败时复制
+	static bool linkOrCopy(const QString &src, const QString &dst);
+
+	ResultCache(const ResultCache &) = delete;
+	ResultCache &operator=(const ResultCache &) = delete;
+
+	QString dir_;
+	bool valid_;
+	std::atomic<uint64_t> hits_;
+	std::atomic<uint64_t> misses_;
+	std::atomic<uint64_t> seq_;		//临时目录名
+};
@@ -0,0 +1,127 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+
+ThreadPool::ThreadPool(int threads)
+	: next_(0), queued_(0), pending_(0), steals_(0), stop_(false)
+{
+	if (threads <= 0)
+	{
+		threads = (int)std::thread::hardware_concurrency();
+	}
+	if (threads <= 0)
+	{
+		threads = 1;
+	}
+
+	for (int i = 0; i < threads; i++)
+	{
+		workers_.push_back(new Worker);
+	}
+
+	for (size_t i = 0; i < workers_.size(); i++)
+	{
+		threads_.push_back(std::thread(&ThreadPool::workerMain, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(mutex_);
+		stop_ = true;
+	}
+	work_cv_.notify_all();
+
+	for (size_t i = 0; i < threads_.size(); i++)
+	{
+		threads_[i].join();
+	}
+
+	for (size_t i = 0; i < workers_.size(); i++)
+	{
+		delete workers_[i];
+	}
+}
+
+void ThreadPool::Submit(const Task &task)
+{
+	Worker *worker = workers_[next_.fetch_add(1) % workers_.size()];
+
+	pending_++;
+
+	//先计数再放入队列: 否则其他线程可能先取走任务, queued_--在0上回绕, 空闲线程的等待条件一直成立而空转
+	//两步都在mutex_内, 等待的线程不会在计数之后, 放入之前醒来
+	{
+		std::lock_guard<std::mutex> guard(mutex_);
+		queued_++;
+		std::lock_guard<std::mutex> worker_guard(worker->lock);
+		worker->tasks.push_back(task);
+	}
+	work_cv_.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> guard(mutex_);
+	done_cv_.wait(guard, [this] { return pending_ == 0; });
+}
+
+bool ThreadPool::popLocal(size_t idx, Task &task)
+{
+	Worker *worker = workers_[idx];
+	std::lock_guard<std::mutex> guard(worker->lock);
+	if (worker->tasks.empty())
+	{
+		return false;
+	}
+
+	task = worker->tasks.front();
+	worker->tasks.pop_front();
+	return true;
+}
+
+bool ThreadPool::steal(size_t idx, Task &task)
+{
+	for (size_t i = 1; i < workers_.size(); i++)
+	{
+		Worker *victim = workers_[(idx + i) % workers_.size()];
+		std::lock_guard<std::mutex> guard(victim->lock);
+		if (!victim->tasks.empty())
+		{
+			task = victim->tasks.back();
+			victim->tasks.pop_back();
+			steals_++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::workerMain(size_t idx)
+{
+	Trace::SetThreadName(QString("worker %1").arg((qint64)idx));
+	while (true)
+	{
+		Task task;
+		if (popLocal(idx, task) || steal(idx, task))
+		{
+			queued_--;
+			task();
+
+			if (--pending_ == 0)
+			{
+				std::lock_guard<std::mutex> guard(mutex_);
+				done_cv_.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(mutex_);
+		work_cv_.wait(guard, [this] { return stop_ || queued_ > 0; });
+		if (stop_ && queued_ == 0)
+		{
+			return;
+		}
+	}
+}
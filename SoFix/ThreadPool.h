@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//工作窃取线程池: 每个线程一个双端队列, 任务按提交顺序轮流放入各队列,
+//线程从自己队列的头部取任务, 自己的队列空了就从其他线程队列的尾部窃取
+//按从大到小的顺序提交时, 大任务最先开始, 被窃取的是尾部的小任务, 不会在最后剩下一个大任务拖尾
+class ThreadPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	//threads <= 0时使用硬件线程数
+	explicit ThreadPool(int threads);
+	~ThreadPool();
+
+	//可以从多个线程同时调用
+	void Submit(const Task &task);
+
+	//等待已提交的任务全部完成
+	void Wait();
+
+	int thread_count() const { return (int)workers_.size(); }
+	uint64_t steal_count() const { return steals_; }
+
+private:
+	struct Worker
+	{
+		std::deque<Task> tasks;
+		std::mutex lock;
+	};
+
+	void workerMain(size_t idx);
+	bool popLocal(size_t idx, Task &task);
+	bool steal(size_t idx, Task &task);
+
+	std::vector<Worker *> workers_;
+	std::vector<std::thread> threads_;
+	std::atomic<size_t> next_;		//下一个任务放入的队列, daemon的多个连接线程会同时Submit
+
+	std::mutex mutex_;				//保护下面两个条件变量的等待
+	std::condition_variable work_cv_;
+	std::condition_variable done_cv_;
+	std::atomic<size_t> queued_;	//队列中的任务数
+	std::atomic<size_t> pending_;	//已提交未完成的任务数
+	std::atomic<uint64_t> steals_;
+	bool stop_;
+};
@@ -0,0 +1,310 @@
+#include "Throughput.h"
+#include "ThreadPool.h"
+#include "RefCache.h"
+#include "Util.h"
+#include "Baseline.h"
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <algorithm>
+#include <math.h>
+
+#define QSTR8BIT(s) (QString::fromLocal8Bit(s))
+
+QStringList Throughput::inputsOf(Batch::Mode mode, const Batch::Job &job, bool with_ref)
+{
+	QStringList inputs;
+	switch (mode)
+	{
+	case Batch::MODE_DUMP_FROM_NORMAL:
+		if (with_ref)
+		{
+			inputs << job.sopath;
+		}
+		inputs << job.dumppath;
+		break;
+	case Batch::MODE_DUMP:
+		inputs << job.dumppath;
+		break;
+	case Batch::MODE_REBUILD:
+	{
+		//段数据在json的raw_file中
+		inputs << job.sopath;
+		QFile json(job.sopath);
+		if (json.open(QIODevice::ReadOnly))
+		{
+			QJsonArray phdrs = QJsonDocument::fromJson(json.readAll()).object().value("program headers").toArray();
+			for (int i = 0; i < phdrs.size(); i++)
+			{
+				QString raw = phdrs.at(i).toObject().value("raw_file").toString();
+				if (!raw.isEmpty())
+				{
+					inputs << raw;
+				}
+			}
+		}
+		break;
+	}
+	default:
+		inputs << job.sopath;
+		break;
+	}
+	return inputs;
+}
+
+double Throughput::Percentile(const std::vector<double> &sorted, double p)
+{
+	if (sorted.empty())
+	{
+		return 0;
+	}
+
+	size_t rank = (size_t)ceil(p * sorted.size());
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+Throughput::Summary Throughput::RunOnce(Batch::Mode mode, const std::vector<Batch::Job> &jobs, int threads, bool cold)
+{
+	Summary summary;
+	summary.cache = cold ? "cold" : "warm";
+	summary.files = (qint64)jobs.size();
+	summary.ok = 0;
+	summary.bytes = 0;
+
+	//cold丢弃页缓存, warm把输入全部读一遍; 两者都包括共享的正常so
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		QStringList inputs = inputsOf(mode, jobs[i], true);
+		for (int k = 0; k < inputs.size(); k++)
+		{
+			if (cold)
+			{
+				Util::dropFileCache(inputs.at(k));
+			}
+			else
+			{
+				QFile file(inputs.at(k));
+				if (file.open(QIODevice::ReadOnly))
+				{
+					while (!file.read(1024 * 1024).isEmpty())
+					{
+					}
+				}
+			}
+		}
+
+		QStringList own = inputsOf(mode, jobs[i], false);
+		for (int k = 0; k < own.size(); k++)
+		{
+			summary.bytes += QFileInfo(own.at(k)).size();
+		}
+	}
+
+	//每次重新建立正常so缓存, cold时第一次使用也从磁盘读取
+	RefCache ref_cache;
+	std::vector<double> ms(jobs.size(), 0);
+	std::vector<char> ok(jobs.size(), 0);
+	Util::resetPeakRss();
+
+	QElapsedTimer wall;
+	wall.start();
+	{
+		ThreadPool pool(threads);
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			pool.Submit([&, i]() {
+				QElapsedTimer timer;
+				timer.start();
+				ok[i] = Batch::RunJob(mode, jobs[i], nullptr, &ref_cache);
+				ms[i] = timer.nsecsElapsed() / 1e6;
+			});
+		}
+		pool.Wait();
+	}
+	summary.wall_ms = wall.nsecsElapsed() / 1e6;
+	summary.peak_rss = Util::peakRss();
+
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		summary.ok += ok[i] ? 1 : 0;
+	}
+	std::sort(ms.begin(), ms.end());
+	summary.p50_ms = Percentile(ms, 0.50);
+	summary.p95_ms = Percentile(ms, 0.95);
+	summary.p99_ms = Percentile(ms, 0.99);
+	return summary;
+}
+
+bool Throughput::loadJobs(const QString &dir, const QString &mode, std::vector<Batch::Job> &jobs)
+{
+	return LoadList(QDir(dir).filePath(mode + ".lst"), mode, jobs);
+}
+
+bool Throughput::LoadList(const QString &path, const QString &mode, std::vector<Batch::Job> &jobs)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		return false;
+	}
+
+	while (!file.atEnd())
+	{
+		QString line = QString::fromLocal8Bit(file.readLine()).trimmed();
+		if (line.isEmpty() || line.startsWith("#"))
+		{
+			continue;
+		}
+
+		Batch::Job job;
+		if (!Batch::ParseJob(Batch::ParseMode(mode), line.split('\t', QString::SkipEmptyParts), QString(), 0, job))
+		{
+			return false;
+		}
+		jobs.push_back(job);
+	}
+	return !jobs.empty();
+}
+
+int Throughput::Run(int argc, char *argv[])
+{
+	QTextStream qout(stdout);
+	Options opts;
+	if (!parseArgs(argc, argv, opts))
+	{
+		printUsage();
+		return 2;
+	}
+
+	if (!Util::resetPeakRss())
+	{
+		qout << QSTR8BIT("注意: 本平台不能重置峰值内存, peak RSS为进程开始以来的峰值") << endl;
+	}
+	qout << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10")
+		.arg("mode", -18).arg("cache", -6).arg("files", 7).arg("ok", 7).arg("files/s", 10).arg("MB/s", 9)
+		.arg("p50(ms)", 9).arg("p95(ms)", 9).arg("p99(ms)", 9).arg("peakRSS(MB)", 12) << endl;
+
+	Baseline::Run run = Baseline::NewRun("throughput", opts.commit);
+	bool all_ok = true;
+	for (int m = 0; m < opts.modes.size(); m++)
+	{
+		const QString &mode = opts.modes.at(m);
+		std::vector<Batch::Job> jobs;
+		if (!loadJobs(opts.dir, mode, jobs))
+		{
+			qout << QSTR8BIT("无法读取清单: ") + QDir(opts.dir).filePath(mode + ".lst") << endl;
+			return 2;
+		}
+
+		//先cold后warm, 避免warm的读取影响cold
+		for (int variant = 0; variant < 2; variant++)
+		{
+			bool cold = variant == 0;
+			if ((cold && !opts.cold) || (!cold && !opts.warm))
+			{
+				continue;
+			}
+
+			for (int round = 0; round < opts.repeat; round++)
+			{
+				Summary s = RunOnce(Batch::ParseMode(mode), jobs, opts.jobs, cold);
+				s.mode = mode;
+				double sec = s.wall_ms / 1000;
+				qout << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10")
+					.arg(s.mode, -18).arg(s.cache, -6).arg(s.files, 7).arg(s.ok, 7)
+					.arg(sec > 0 ? s.files / sec : 0, 10, 'f', 1)
+					.arg(sec > 0 ? s.bytes / sec / (1024 * 1024) : 0, 9, 'f', 1)
+					.arg(s.p50_ms, 9, 'f', 2).arg(s.p95_ms, 9, 'f', 2).arg(s.p99_ms, 9, 'f', 2)
+					.arg(s.peak_rss / (1024.0 * 1024), 12, 'f', 1) << endl;
+				all_ok = all_ok && s.ok == s.files;
+
+				QString name = QString("throughput/%1/%2").arg(s.mode).arg(s.cache);
+				Baseline::AddSample(run, name + "/wall", "ms", s.wall_ms);
+				Baseline::AddSample(run, name + "/p95", "ms", s.p95_ms);
+			}
+		}
+	}
+
+	if (!opts.save.isEmpty() && !Baseline::Save(run, opts.save))
+	{
+		qout << QSTR8BIT("无法写入结果: ") + opts.save << endl;
+		return 2;
+	}
+	return all_ok ? 0 : 1;
+}
+
+bool Throughput::parseArgs(int argc, char *argv[], Options &opts)
+{
+	opts.modes << "normal" << "dump-from-normal" << "dump" << "rebuild";
+	opts.jobs = 0;
+	opts.warm = true;
+	opts.cold = true;
+	opts.repeat = 1;
+
+	//argv[1]为"throughput"
+	for (int i = 2; i < argc; i++)
+	{
+		QString arg = QSTR8BIT(argv[i]);
+		if (i + 1 >= argc)
+		{
+			return false;
+		}
+
+		QString value = QSTR8BIT(argv[++i]);
+		if (arg == "--dir")
+		{
+			opts.dir = value;
+		}
+		else if (arg == "--modes")
+		{
+			opts.modes = value.split(',', QString::SkipEmptyParts);
+		}
+		else if (arg == "--jobs")
+		{
+			opts.jobs = value.toInt();
+		}
+		else if (arg == "--cache")
+		{
+			opts.warm = value == "warm" || value == "both";
+			opts.cold = value == "cold" || value == "both";
+		}
+		else if (arg == "--repeat")
+		{
+			opts.repeat = value.toInt();
+		}
+		else if (arg == "--save")
+		{
+			opts.save = value;
+		}
+		else if (arg == "--commit")
+		{
+			opts.commit = value;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < opts.modes.size(); i++)
+	{
+		if (Batch::ParseMode(opts.modes.at(i)) == Batch::MODE_NONE)
+		{
+			return false;
+		}
+	}
+	return !opts.dir.isEmpty() && !opts.modes.isEmpty() && (opts.warm || opts.cold) && opts.repeat > 0;
+}
+
+void Throughput::printUsage()
+{
+	QTextStream qout(stdout);
+	qout << QSTR8BIT("用法: SoFix throughput --dir <语料目录> [--modes <normal,dump-from-normal,dump,rebuild>] [--jobs <线程数>] [--cache <warm|cold|both>]\n"
+		"	[--repeat <轮数>] [--save <结果JSON>] [--commit <提交号>]\n"
+		"语料目录中每种模式一个清单<mode>.lst, 格式与batch相同, 可由SoFix gen生成") << endl;
+}
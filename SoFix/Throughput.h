@@ -0,0 +1,64 @@
+#pragma once
+#include "Batch.h"
+#include <QString>
+#include <QStringList>
+#include <vector>
+
+//端到端吞吐测试: 对语料目录(gen生成或相同格式的清单)按完整流程修复, 用于估算夜间任务所需的机器和发现整体耗时的退化
+//用法:
+//	SoFix throughput --dir <语料目录> [--modes <normal,dump-from-normal,dump,rebuild>] [--jobs <n>] [--cache <warm|cold|both>]
+//		[--repeat <n>] [--save <JSON>] [--commit <提交号>]
+//每种模式读取<dir>/<mode>.lst, 每个变体输出: 文件数, 成功数, 个/秒, MB/秒, 单个文件耗时的p50/p95/p99, 峰值常驻内存
+//warm: 先把全部输入读一遍, 再计时; cold: 先从页缓存中丢弃全部输入(见Util::dropFileCache), 正常so缓存也重新建立
+//--repeat把每个变体重复n轮, --save按Baseline格式保存每轮的总耗时和p95, 供compare比较
+class Throughput
+{
+public:
+	struct Summary
+	{
+		QString mode;
+		QString cache;		//warm/cold
+		qint64 files;
+		qint64 ok;
+		qint64 bytes;		//输入的总字节数
+		double wall_ms;
+		double p50_ms;
+		double p95_ms;
+		double p99_ms;
+		qint64 peak_rss;	//字节, 不能重置峰值的平台上为整个进程的峰值
+	};
+
+	Throughput() = delete;
+	~Throughput() = delete;
+
+	//命令行入口, 返回进程退出码: 0全部成功, 1有失败, 2参数错误
+	static int Run(int argc, char *argv[]);
+
+	//对jobs完整执行一遍, threads <= 0时使用硬件线程数
+	static Summary RunOnce(Batch::Mode mode, const std::vector<Batch::Job> &jobs, int threads, bool cold);
+
+	//已排序的耗时中第p(0~1)分位, 取最近秩
+	static double Percentile(const std::vector<double> &sorted, double p);
+
+	//读取mode格式的清单(与batch相同, 每行一项, #开头为注释), 空清单返回false
+	static bool LoadList(const QString &path, const QString &mode, std::vector<Batch::Job> &jobs);
+
+private:
+	struct Options
+	{
+		QString dir;
+		QStringList modes;
+		int jobs;
+		bool warm;
+		bool cold;
+		int repeat;
+		QString save;
+		QString commit;
+	};
+
+	//一项读取的全部文件; with_ref为false时不含dump-from-normal共享的正常so
+	static QStringList inputsOf(Batch::Mode mode, const Batch::Job &job, bool with_ref);
+	static bool loadJobs(const QString &dir, const QString &mode, std::vector<Batch::Job> &jobs);
+	static bool parseArgs(int argc, char *argv[], Options &opts);
+	static void printUsage();
+};
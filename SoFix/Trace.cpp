@@ -0,0 +1,149 @@
+#include "Trace.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+std::atomic<bool> Trace::enabled_(false);
+std::mutex Trace::lock_;
+std::vector<std::unique_ptr<Trace::Buffer> > Trace::buffers_;
+QElapsedTimer Trace::epoch_;
+thread_local Trace::Buffer *Trace::local_ = nullptr;
+
+Trace::Span::Span(const char *name, const char *cat)
+	: name_(name), cat_(cat), begin_(enabled() ? Now() : -1)
+{
+}
+
+Trace::Span::Span(const char *name, const char *cat, const QString &detail)
+	: name_(name), cat_(cat), begin_(enabled() ? Now() : -1)
+{
+	if (begin_ >= 0)
+	{
+		detail_ = detail;
+	}
+}
+
+Trace::Span::~Span()
+{
+	if (begin_ >= 0)
+	{
+		Complete(name_, cat_, begin_, Now(), detail_);
+	}
+}
+
+void Trace::Start()
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	epoch_.start();
+	enabled_ = true;
+}
+
+qint64 Trace::Now()
+{
+	return epoch_.nsecsElapsed();
+}
+
+Trace::Buffer *Trace::buffer()
+{
+	if (local_ == nullptr)
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		std::unique_ptr<Buffer> buffer(new Buffer);
+		buffer->tid = (int)buffers_.size() + 1;
+		buffer->name = buffers_.empty() ? QString("main") : QString("thread %1").arg(buffer->tid);
+		local_ = buffer.get();
+		buffers_.push_back(std::move(buffer));
+	}
+	return local_;
+}
+
+void Trace::append(const Event &event)
+{
+	buffer()->events.push_back(event);
+}
+
+void Trace::Complete(const char *name, const char *cat, qint64 begin_ns, qint64 end_ns, const QString &detail)
+{
+	if (!enabled())
+	{
+		return;
+	}
+
+	Event event = { name, cat, "X", begin_ns, end_ns - begin_ns, detail };
+	append(event);
+}
+
+void Trace::Instant(const char *name, const char *cat, const QString &detail)
+{
+	if (!enabled())
+	{
+		return;
+	}
+
+	Event event = { name, cat, "i", Now(), 0, detail };
+	append(event);
+}
+
+void Trace::SetThreadName(const QString &name)
+{
+	if (enabled())
+	{
+		buffer()->name = name;
+	}
+}
+
+bool Trace::Save(const QString &path)
+{
+	//时间单位为微秒, 保留纳秒精度的小数
+	std::lock_guard<std::mutex> guard(lock_);
+	QJsonArray events;
+	for (size_t i = 0; i < buffers_.size(); i++)
+	{
+		const Buffer &buffer = *buffers_[i];
+		QJsonObject meta;
+		meta.insert("name", "thread_name");
+		meta.insert("ph", "M");
+		meta.insert("pid", 1);
+		meta.insert("tid", buffer.tid);
+		QJsonObject meta_args;
+		meta_args.insert("name", buffer.name);
+		meta.insert("args", meta_args);
+		events.append(meta);
+
+		for (size_t k = 0; k < buffer.events.size(); k++)
+		{
+			const Event &e = buffer.events[k];
+			QJsonObject obj;
+			obj.insert("name", QString(e.name));
+			obj.insert("cat", QString(e.cat));
+			obj.insert("ph", QString(e.ph));
+			obj.insert("ts", e.ts / 1000.0);
+			if (e.ph[0] == 'X')
+			{
+				obj.insert("dur", e.dur / 1000.0);
+			}
+			else
+			{
+				obj.insert("s", "t");	//瞬时事件只画在所在线程上
+			}
+			obj.insert("pid", 1);
+			obj.insert("tid", buffer.tid);
+			if (!e.detail.isEmpty())
+			{
+				QJsonObject args;
+				args.insert("detail", e.detail);
+				obj.insert("args", args);
+			}
+			events.append(obj);
+		}
+	}
+
+	QJsonObject root;
+	root.insert("traceEvents", events);
+	root.insert("displayTimeUnit", "ms");
+
+	QFile file(path);
+	QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+	return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(json) == json.size();
+}
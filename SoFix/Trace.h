@@ -0,0 +1,83 @@
+#pragma once
+#include <QString>
+#include <QElapsedTimer>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//区间追踪, 输出Chrome trace-event格式的JSON, 可在Perfetto(ui.perfetto.dev)或chrome://tracing中打开
+//进程内全局开关, 未启用时Span只多一次判断; 每个线程一个缓冲区, 在查看器中为一条轨道,
+//只有线程第一次记录时加锁注册, 之后只写自己的缓冲区
+//记录的区间: ElfReader::Load的各步骤, PhaseStats::Scope的各阶段(ElfFixer各步骤, 写出等), 批处理的调度事件
+class Trace
+{
+public:
+	//RAII记录一个区间, 析构时结束; name/cat必须是字符串常量, 只保存指针
+	class Span
+	{
+	public:
+		explicit Span(const char *name, const char *cat = "fix");
+		Span(const char *name, const char *cat, const QString &detail);
+		~Span();
+
+	private:
+		Span(const Span &) = delete;
+		Span &operator=(const Span &) = delete;
+
+		const char *name_;
+		const char *cat_;
+		QString detail_;
+		qint64 begin_;		//未启用时为-1
+	};
+
+	Trace() = delete;
+	~Trace() = delete;
+
+	//开始记录, 时间从此刻算起; 应在创建工作线程之前调用, 以便线程能设置轨道名
+	static void Start();
+	static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+	//从Start开始的纳秒数
+	static qint64 Now();
+
+	//记录一个已结束的区间(ph X), 用于不便使用Span的地方
+	static void Complete(const char *name, const char *cat, qint64 begin_ns, qint64 end_ns, const QString &detail = QString());
+
+	//瞬时事件(ph i), 如缓存命中
+	static void Instant(const char *name, const char *cat, const QString &detail = QString());
+
+	//当前线程的轨道名, 未启用时什么都不做
+	static void SetThreadName(const QString &name);
+
+	//写出全部线程的事件, 调用时记录的线程都应已结束或空闲
+	static bool Save(const QString &path);
+
+private:
+	struct Event
+	{
+		const char *name;
+		const char *cat;
+		const char *ph;	//X区间, i瞬时
+		qint64 ts;		//纳秒
+		qint64 dur;
+		QString detail;
+	};
+
+	struct Buffer
+	{
+		int tid;
+		QString name;
+		std::vector<Event> events;
+	};
+
+	static Buffer *buffer();
+	static void append(const Event &event);
+
+	static std::atomic<bool> enabled_;
+	static std::mutex lock_;		//保护buffers_的注册
+	static std::vector<std::unique_ptr<Buffer> > buffers_;
+	static QElapsedTimer epoch_;
+	static thread_local Buffer *local_;	//当前线程的缓冲区, 事件只由所属线程追加
+};
@@ -1,26 +1,70 @@
 #include "Util.h"
+#include "AllocCounter.h"
+#ifdef _WIN32
 #include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "Psapi.lib")
+#else
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <assert.h>
+#include <string.h>
 
-void * Util::mmap(void *addr, uint32_t size, QFile &file, uint32_t offset)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTIL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+//按页分配可读写内存, 失败返回nullptr
+static void *pageAlloc(size_t size)
+{
+	AllocCounter::Note(size);
+#ifdef _WIN32
+	return VirtualAlloc(NULL, size, MEM_COMMIT, PAGE_READWRITE);
+#else
+	void *ret = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return ret == MAP_FAILED ? nullptr : ret;
+#endif
+}
+
+static void pageFree(void *addr, size_t size)
+{
+#ifdef _WIN32
+	//pageAlloc的每次分配都整块释放, MEM_DECOMMIT只释放物理页, 地址空间仍被占用
+	(void)size;
+	VirtualFree(addr, 0, MEM_RELEASE);
+#else
+	::munmap(addr, size);
+#endif
+}
+
+void * Util::mmap(void *addr, size_t size, QIODevice &file, qint64 offset)
 {
 	void *ret = nullptr;
 	size = PAGE_END(size);
-	addr = (void *)PAGE_END((size_t)addr);
+	addr = (void *)PAGE_END((uintptr_t)addr);
 	if (file.seek(offset))
 	{
-		ret = VirtualAlloc(NULL, size, MEM_COMMIT, PAGE_READWRITE);
-		assert(((uint32_t)ret % 0x1000 == 0));
+		ret = pageAlloc(size);
+		if (ret == nullptr)
+		{
+			return nullptr;
+		}
+		assert(((uintptr_t)ret % PAGE_SIZE == 0));
 		qint64 rc = file.read((char *)ret, size);
 		if (rc < 0)
 		{
-			VirtualFree(ret, size, MEM_DECOMMIT);
+			pageFree(ret, size);
 			return nullptr;
 		}
 
 		if (addr)
 		{
 			memcpy(addr, ret, size);
-			VirtualFree(ret, size, MEM_DECOMMIT);
+			pageFree(ret, size);
 			ret = addr;
 		}
 	}
@@ -28,10 +72,10 @@ void * Util::mmap(void *addr, uint32_t size, QFile &file, uint32_t offset)
 	return ret;
 }
 
-void * Util::mmap(void *addr, uint32_t size)
+void * Util::mmap(void *addr, size_t size)
 {
 	size = PAGE_END(size);
-	addr = (void *)PAGE_END((size_t)addr);
+	addr = (void *)PAGE_END((uintptr_t)addr);
 	if (addr)
 	{
 		memset(addr, 0, size);
@@ -39,17 +83,17 @@ void * Util::mmap(void *addr, uint32_t size)
 	}
 	else
 	{
-		return VirtualAlloc(NULL, size, MEM_COMMIT, PAGE_READWRITE);
+		return pageAlloc(size);
 	}
 }
 
-int Util::munmap(void *addr, uint32_t size)
+int Util::munmap(void *addr, size_t size)
 {
 	size = PAGE_END(size);
-	addr = (void *)PAGE_END((size_t)addr);
+	addr = (void *)PAGE_END((uintptr_t)addr);
 	if (addr)
 	{
-		VirtualFree(addr, size, MEM_DECOMMIT);
+		pageFree(addr, size);
 	}
 	
 	return 0;
@@ -63,16 +107,16 @@ void Util::kmpGetNext(const char *p, int pSize, int next[])
 	int j = 0;
 	while (j < pLen - 1)
 	{
-		//p[k]ʾǰ׺p[j]ʾ׺    
+		//p[k]表示前缀，p[j]表示后缀    
 		if (k == -1 || p[j] == p[k])
 		{
 			++j;
 			++k;
-			//֮ǰnext󷨣Ķ4  
+			//较之前next数组求法，改动在下面4行  
 			if (p[j] != p[k])
-				next[j] = k;   //֮ǰֻһ  
+				next[j] = k;   //之前只有这一行  
 			else
-				//Ϊܳp[j] = p[ next[j ]]ԵʱҪݹ飬k = next[k] = next[next[k]]  
+				//因为不能出现p[j] = p[ next[j ]]，所以当出现时需要继续递归，k = next[k] = next[next[k]]  
 				next[j] = next[k];
 		}
 		else
@@ -95,7 +139,7 @@ int Util::kmpSearch(const char *s, int sSize,const char *p, int pSize)
 
 	while (i < sLen && j < pLen)
 	{
-		//1. j = -1, ߵǰַƥɹS[i] == P[j], i++, j++      
+		//1. 如果j = -1, 或者当前字符匹配成功（即S[i] == P[j], 都令i++, j++      
 		if (j == -1 || s[i] == p[j])
 		{
 			i++;
@@ -103,8 +147,8 @@ int Util::kmpSearch(const char *s, int sSize,const char *p, int pSize)
 		}
 		else
 		{
-			//2. j != -1, ҵǰַƥʧܣS[i] != P[j],  i 䣬j = next[j]      
-			//next[j]ΪjӦnextֵ        
+			//2. 如果j != -1, 且当前字符匹配失败（即S[i] != P[j], 则令 i 不变，j = next[j]      
+			//next[j]即为j所对应的next值        
 			j = next[j];
 		}
 	}
@@ -120,3 +164,132 @@ int Util::kmpSearch(const char *s, int sSize,const char *p, int pSize)
 	}
 }
 
+void Util::subtractBias(uint32_t *p, size_t n, uint32_t bias)
+{
+	size_t i = 0;
+#ifdef UTIL_SSE2
+	//SSE2没有无符号比较, 两边异或0x80000000后用有符号比较得到 p[i] >= bias 的掩码
+	const __m128i sign = _mm_set1_epi32((int)0x80000000);
+	const __m128i vbias = _mm_set1_epi32((int)bias);
+	const __m128i vlimit = _mm_xor_si128(_mm_set1_epi32((int)(bias - 1)), sign);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+		__m128i mask = _mm_cmpgt_epi32(_mm_xor_si128(v, sign), vlimit);
+		v = _mm_sub_epi32(v, _mm_and_si128(vbias, mask));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), v);
+	}
+#endif
+	for (; i < n; i++)
+	{
+		if (p[i] >= bias)
+		{
+			p[i] -= bias;
+		}
+	}
+}
+
+void Util::subtractBias(uint64_t *p, size_t n, uint64_t bias)
+{
+	//SSE2没有64位比较, 64位的值逐个处理
+	for (size_t i = 0; i < n; i++)
+	{
+		if (p[i] >= bias)
+		{
+			p[i] -= bias;
+		}
+	}
+}
+
+double Util::cpuSeconds()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+	{
+		return 0;
+	}
+
+	//FILETIME单位为100ns
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) / 1e7;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+		+ (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+qint64 Util::peakRss()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return 0;
+	}
+	return (qint64)counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+
+	//Linux下ru_maxrss单位为KB
+	return (qint64)usage.ru_maxrss * 1024;
+#endif
+}
+
+bool Util::resetPeakRss()
+{
+#ifdef __linux__
+	//向clear_refs写5把VmHWM重置为当前RSS(Linux 4.0+), 之后getrusage读到的峰值从此刻算起
+	int fd = open("/proc/self/clear_refs", O_WRONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	bool ok = write(fd, "5", 1) == 1;
+	close(fd);
+	return ok;
+#else
+	return false;
+#endif
+}
+
+bool Util::dropFileCache(const QString &path)
+{
+#ifdef _WIN32
+	//没有其他句柄映射该文件时, 以FILE_FLAG_NO_BUFFERING打开会让缓存管理器清除该文件的缓存页
+	HANDLE file = CreateFileW((LPCWSTR)path.utf16(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	CloseHandle(file);
+	return true;
+#else
+	//只丢弃干净的页, 刚写完的文件先fdatasync
+	QByteArray path8 = path.toLocal8Bit();
+	int fd = open(path8.constData(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	fdatasync(fd);
+	bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	close(fd);
+	return ok;
+#endif
+}
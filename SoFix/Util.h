@@ -21,18 +21,34 @@ public:
 	Util() = delete;
 	~Util() = delete;
 
-	//ȡļݵڴ, addrΪNULL·ڴ, ʹVirtualAlloc֤ҳ, addr, sizeǿҳ
-	static void *mmap(void *addr, uint32_t size, QFile &file, uint32_t offset);
+	//读取文件内容到内存中, 若addr为NULL则新分配内存, 使用VirtualAlloc(非Windows下为匿名mmap)保证按页对齐, addr, size将被强制页对齐
+	static void *mmap(void *addr, size_t size, QIODevice &file, qint64 offset);
 
-	//addrΪNULL·ڴ, ڴΪ0
-	static void *mmap(void *addr, uint32_t size);
+	//如果addr为NULL则新分配内存, 否则将内存置为0
+	static void *mmap(void *addr, size_t size);
 
-	//ͷmmapڴ
-	static int munmap(void *addr, uint32_t size);
+	//释放由mmap分配的内存
+	static int munmap(void *addr, size_t size);
 
-	//Kmp㷨, KmpSearch, -1ʾʧ
+	//Kmp搜索算法, 调用KmpSearch即可, 返回-1表示失败
 	static int kmpSearch(const char *s, int sSize, const char *p, int pSize);
 
+	//对连续的n个字减去bias, 小于bias的字(如0)保持不变, 32位的字在支持SSE2时4个一组处理
+	static void subtractBias(uint32_t *p, size_t n, uint32_t bias);
+	static void subtractBias(uint64_t *p, size_t n, uint64_t bias);
+
+	//进程已使用的CPU时间(用户态 + 内核态), 单位秒
+	static double cpuSeconds();
+
+	//进程的峰值常驻内存(字节), 取不到时返回0
+	static qint64 peakRss();
+
+	//从此刻重新统计峰值常驻内存, 只有Linux支持, 不支持返回false
+	static bool resetPeakRss();
+
+	//从系统页缓存中丢弃文件的内容, 用于冷缓存测试, 失败返回false
+	static bool dropFileCache(const QString &path);
+
 private:
 	static void kmpGetNext(const char *p, int pSize, int next[]);
 };
@@ -0,0 +1,513 @@
+#include "Watch.h"
+#include "ThreadPool.h"
+#include "RefCache.h"
+#include "ResultCache.h"
+#include <QTextStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <map>
+#include <mutex>
+#include <set>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#define QSTR8BIT(s) (QString::fromLocal8Bit(s))
+
+//修复时生成在输入文件旁边的结果文件
+static const char *const kResultSuffixes[] = { ".loaded", ".fixed", ".normal", ".normal.loaded", ".normal.fixed" };
+
+//目录变化通知, Wait返回这段时间内写完或移入的文件路径
+class Watch::Notifier
+{
+public:
+	Notifier();
+	~Notifier();
+
+	bool Open(const QString &dir);
+
+	//timeout_ms < 0时一直等待, 出错返回false
+	//overflow: 通知缓冲区溢出, 有事件丢失, 调用者需要重新扫描目录
+	bool Wait(int timeout_ms, QStringList &paths, bool &overflow);
+
+	//写入方是否已经关闭文件
+	bool Ready(const QString &path);
+
+private:
+	QDir dir_;
+#ifdef _WIN32
+	bool issue();
+
+	HANDLE handle_;
+	HANDLE event_;
+	OVERLAPPED overlapped_;
+	DWORD buf_[16 * 1024];	//FILE_NOTIFY_INFORMATION要求DWORD对齐
+#elif defined(__linux__)
+	int fd_;
+#endif
+};
+
+#ifdef _WIN32
+Watch::Notifier::Notifier()
+	: handle_(INVALID_HANDLE_VALUE), event_(NULL)
+{
+	memset(&overlapped_, 0, sizeof(overlapped_));
+}
+
+Watch::Notifier::~Notifier()
+{
+	if (handle_ != INVALID_HANDLE_VALUE)
+	{
+		CancelIo(handle_);
+		CloseHandle(handle_);
+	}
+	if (event_ != NULL)
+	{
+		CloseHandle(event_);
+	}
+}
+
+bool Watch::Notifier::Open(const QString &dir)
+{
+	dir_.setPath(dir);
+	handle_ = CreateFileW((LPCWSTR)QDir::toNativeSeparators(dir).utf16(), FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	event_ = CreateEventW(NULL, TRUE, FALSE, NULL);
+	return handle_ != INVALID_HANDLE_VALUE && event_ != NULL && issue();
+}
+
+bool Watch::Notifier::issue()
+{
+	ResetEvent(event_);
+	memset(&overlapped_, 0, sizeof(overlapped_));
+	overlapped_.hEvent = event_;
+	return ReadDirectoryChangesW(handle_, buf_, sizeof(buf_), FALSE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+		NULL, &overlapped_, NULL) != FALSE;
+}
+
+bool Watch::Notifier::Wait(int timeout_ms, QStringList &paths, bool &overflow)
+{
+	overflow = false;
+	DWORD ret = WaitForSingleObject(event_, timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms);
+	if (ret == WAIT_TIMEOUT)
+	{
+		return true;
+	}
+
+	DWORD bytes = 0;
+	if (ret != WAIT_OBJECT_0 || !GetOverlappedResult(handle_, &overlapped_, &bytes, FALSE))
+	{
+		return false;
+	}
+
+	//bytes为0表示缓冲区溢出, 丢失的事件由调用者重新扫描目录补上
+	overflow = bytes == 0;
+	const char *p = (const char *)buf_;
+	while (bytes != 0)
+	{
+		const FILE_NOTIFY_INFORMATION *info = (const FILE_NOTIFY_INFORMATION *)p;
+		if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED
+			|| info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+		{
+			paths << dir_.filePath(QString::fromWCharArray(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+		}
+		if (info->NextEntryOffset == 0)
+		{
+			break;
+		}
+		p += info->NextEntryOffset;
+	}
+
+	return issue();
+}
+
+bool Watch::Notifier::Ready(const QString &path)
+{
+	//写入方未关闭时独占打开会失败(ERROR_SHARING_VIOLATION)
+	HANDLE file = CreateFileW((LPCWSTR)QDir::toNativeSeparators(path).utf16(), GENERIC_READ, 0, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	CloseHandle(file);
+	return true;
+}
+#elif defined(__linux__)
+Watch::Notifier::Notifier()
+	: fd_(-1)
+{
+}
+
+Watch::Notifier::~Notifier()
+{
+	if (fd_ >= 0)
+	{
+		close(fd_);
+	}
+}
+
+bool Watch::Notifier::Open(const QString &dir)
+{
+	dir_.setPath(dir);
+	fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd_ < 0)
+	{
+		return false;
+	}
+
+	//只关心写完关闭和移入的文件, 正在写入的文件不会产生事件
+	return inotify_add_watch(fd_, QFile::encodeName(dir).constData(), IN_CLOSE_WRITE | IN_MOVED_TO) >= 0;
+}
+
+bool Watch::Notifier::Wait(int timeout_ms, QStringList &paths, bool &overflow)
+{
+	overflow = false;
+	pollfd pfd = { fd_, POLLIN, 0 };
+	int ret = poll(&pfd, 1, timeout_ms);
+	if (ret <= 0)
+	{
+		return ret == 0 || errno == EINTR;
+	}
+
+	char buf[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while (true)
+	{
+		ssize_t len = read(fd_, buf, sizeof(buf));
+		if (len <= 0)
+		{
+			return len == 0 || errno == EAGAIN || errno == EINTR;
+		}
+
+		for (char *p = buf; p < buf + len; p += sizeof(inotify_event) + ((inotify_event *)p)->len)
+		{
+			const inotify_event *ev = (const inotify_event *)p;
+			if (ev->mask & IN_Q_OVERFLOW)
+			{
+				overflow = true;
+			}
+			if (ev->len != 0 && (ev->mask & IN_ISDIR) == 0)
+			{
+				paths << dir_.filePath(QFile::decodeName(ev->name));
+			}
+		}
+	}
+}
+
+bool Watch::Notifier::Ready(const QString &)
+{
+	//事件本身就是IN_CLOSE_WRITE/IN_MOVED_TO; 扫描到的文件无法判断, 由Run等待大小和修改时间稳定
+	return true;
+}
+#else
+Watch::Notifier::Notifier()
+{
+}
+
+Watch::Notifier::~Notifier()
+{
+}
+
+bool Watch::Notifier::Open(const QString &)
+{
+	return false;
+}
+
+bool Watch::Notifier::Wait(int, QStringList &, bool &)
+{
+	return false;
+}
+
+bool Watch::Notifier::Ready(const QString &)
+{
+	return false;
+}
+#endif
+
+int Watch::Run(int argc, char *argv[])
+{
+	QTextStream qout(stdout);
+	Options opts;
+
+	if (!parseArgs(argc, argv, opts))
+	{
+		printUsage();
+		return 2;
+	}
+
+	if (!QDir().mkpath(opts.out) || !QDir().mkpath(QDir(opts.out).filePath("failed")))
+	{
+		qout << QSTR8BIT("无法创建输出目录: ") + opts.out << endl;
+		return 2;
+	}
+
+	Notifier notifier;
+	if (!notifier.Open(opts.dir))
+	{
+		qout << QSTR8BIT("无法监视目录: ") + opts.dir << endl;
+		return 1;
+	}
+
+	struct Pending
+	{
+		qint64 first_ms;	//第一次看到的时间, 用于统计端到端延迟
+		qint64 last_ms;		//最后一次事件(或扫描到的文件最后一次变化)的时间, 用于去抖
+		bool scanned;		//只由扫描发现, 还没有收到事件
+		qint64 size;		//scanned时上次看到的大小和修改时间
+		qint64 mtime_ms;
+	};
+	std::map<QString, Pending> pending;
+	std::set<QString> running;	//已提交未完成, 避免重复处理
+	std::mutex lock;			//保护running和输出
+	RefCache ref_cache;			//dump-from-normal的正常so只读一次
+	ResultCache result_cache(opts.cache);
+	ResultCache *cache = opts.cache.isEmpty() ? nullptr : &result_cache;
+	if (cache != nullptr && !result_cache.valid())
+	{
+		qout << QSTR8BIT("无法创建结果缓存目录: ") + opts.cache << endl;
+		return 2;
+	}
+
+	ThreadPool pool(opts.jobs);
+	qout << QSTR8BIT("监视 %1 -> %2, 线程 %3").arg(opts.dir).arg(opts.out).arg(pool.thread_count()) << endl;
+
+	//启动前已经在目录中的文件, 以及通知缓冲区溢出后, 都重新扫描一次
+	//溢出时同一批收到的事件照常处理, 下一轮先扫描再等待
+	bool rescan = true;
+	while (true)
+	{
+		QStringList paths;
+		bool scanned = rescan;
+		if (rescan)
+		{
+			QFileInfoList entries = QDir(opts.dir).entryInfoList(QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+			for (int i = 0; i < entries.size(); i++)
+			{
+				paths << entries.at(i).filePath();
+			}
+			rescan = false;
+		}
+		else if (!notifier.Wait(pending.empty() ? -1 : opts.debounce_ms, paths, rescan))
+		{
+			qout << QSTR8BIT("监视出错, 退出") << endl;
+			return 1;
+		}
+
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
+		for (int i = 0; i < paths.size(); i++)
+		{
+			const QString &path = paths.at(i);
+			if (!accept(path))
+			{
+				continue;
+			}
+
+			std::map<QString, Pending>::iterator it = pending.find(path);
+			if (it == pending.end())
+			{
+				QFileInfo info(path);
+				Pending p = { now, now, scanned, info.size(), info.lastModified().toMSecsSinceEpoch() };
+				pending[path] = p;
+			}
+			else if (!scanned)
+			{
+				it->second.last_ms = now;
+				it->second.scanned = false;
+			}
+		}
+
+		//最后一次事件后安静了debounce_ms的文件才提交
+		for (std::map<QString, Pending>::iterator it = pending.begin(); it != pending.end();)
+		{
+			QString path = it->first;
+			QFileInfo info(path);
+			if (!info.exists())
+			{
+				it = pending.erase(it);
+				continue;
+			}
+
+			//扫描到的文件可能仍在写入(Linux上写入中的文件没有事件), 变化时重新开始去抖
+			if (it->second.scanned)
+			{
+				qint64 size = info.size();
+				qint64 mtime_ms = info.lastModified().toMSecsSinceEpoch();
+				if (size != it->second.size || mtime_ms != it->second.mtime_ms)
+				{
+					it->second.size = size;
+					it->second.mtime_ms = mtime_ms;
+					it->second.last_ms = now;
+				}
+			}
+
+			Pending p = it->second;
+			if (now - p.last_ms < opts.debounce_ms || !notifier.Ready(path))
+			{
+				++it;
+				continue;
+			}
+
+			it = pending.erase(it);
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (!running.insert(path).second)
+				{
+					continue;
+				}
+			}
+
+			pool.Submit([&opts, &lock, &running, &qout, &ref_cache, cache, path, p]() {
+				Batch::Job job = { QString(), QString(), opts.dump_bias, 0, 0 };
+				if (opts.mode == Batch::MODE_NORMAL)
+				{
+					job.sopath = path;
+				}
+				else
+				{
+					job.sopath = opts.ref;
+					job.dumppath = path;
+				}
+
+				QString error;
+				bool ok = Batch::RunJob(opts.mode, job, &error, &ref_cache, cache);
+				finish(opts, path, ok);
+				qint64 latency = QDateTime::currentMSecsSinceEpoch() - p.first_ms;
+
+				//每项一行: 状态	从发现到完成的耗时	路径	[错误]
+				std::lock_guard<std::mutex> guard(lock);
+				running.erase(path);
+				qout << (ok ? "OK" : "FAIL") << "\t" << latency << " ms\t" << path;
+				if (!ok && !error.isEmpty())
+				{
+					qout << "\t" << error;
+				}
+				qout << endl;
+			});
+		}
+	}
+}
+
+bool Watch::accept(const QString &path)
+{
+	QString name = QFileInfo(path).fileName();
+	if (name.isEmpty() || name.startsWith("."))
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < sizeof(kResultSuffixes) / sizeof(kResultSuffixes[0]); i++)
+	{
+		if (name.endsWith(kResultSuffixes[i]))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Watch::finish(const Options &opts, const QString &path, bool ok)
+{
+	QDir out(ok ? opts.out : QDir(opts.out).filePath("failed"));
+	QString name = QFileInfo(path).fileName();
+
+	QStringList moves;
+	moves << QString();
+	for (size_t i = 0; i < sizeof(kResultSuffixes) / sizeof(kResultSuffixes[0]); i++)
+	{
+		moves << kResultSuffixes[i];
+	}
+
+	//输入文件最后移动, 输出目录中出现输入文件时结果已经全部就位
+	for (int i = moves.size() - 1; i >= 0; i--)
+	{
+		QString src = path + moves.at(i);
+		QString dst = out.filePath(name + moves.at(i));
+		if (QFile::exists(src))
+		{
+			QFile::remove(dst);
+			QFile::rename(src, dst);
+		}
+	}
+}
+
+bool Watch::parseArgs(int argc, char *argv[], Options &opts)
+{
+	opts.mode = Batch::MODE_NONE;
+	opts.dump_bias = 0;
+	opts.jobs = 0;
+	opts.debounce_ms = 100;
+
+	//argv[1]为"watch"
+	for (int i = 2; i < argc; i++)
+	{
+		QString arg = QSTR8BIT(argv[i]);
+		if (i + 1 >= argc)
+		{
+			return false;
+		}
+
+		QString value = QSTR8BIT(argv[++i]);
+		if (arg == "--mode")
+		{
+			opts.mode = Batch::ParseMode(value);
+		}
+		else if (arg == "--dir")
+		{
+			opts.dir = value;
+		}
+		else if (arg == "--out")
+		{
+			opts.out = value;
+		}
+		else if (arg == "--ref")
+		{
+			opts.ref = value;
+		}
+		else if (arg == "--bias")
+		{
+			opts.dump_bias = value.toULongLong(nullptr, 16);
+		}
+		else if (arg == "--jobs")
+		{
+			opts.jobs = value.toInt();
+		}
+		else if (arg == "--debounce")
+		{
+			opts.debounce_ms = value.toInt();
+		}
+		else if (arg == "--cache")
+		{
+			opts.cache = value;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	//json重建不在监视范围内
+	if (opts.mode == Batch::MODE_NONE || opts.mode == Batch::MODE_REBUILD || opts.dir.isEmpty() || opts.out.isEmpty())
+	{
+		return false;
+	}
+	return opts.mode != Batch::MODE_DUMP_FROM_NORMAL || !opts.ref.isEmpty();
+}
+
+void Watch::printUsage()
+{
+	QTextStream qout(stdout);
+	qout << QSTR8BIT("用法: SoFix watch --mode <normal|dump-from-normal|dump> --dir <监视目录> --out <输出目录> "
+		"[--ref <正常so>] [--bias <load_bias>] [--jobs <线程数>] [--debounce <毫秒>] [--cache <结果缓存目录>]") << endl;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <stdint.h>
+#include "Batch.h"
+
+//监视目录: 文件写完(关闭)后立即修复, 结果移动到输出目录
+//Linux使用inotify(IN_CLOSE_WRITE/IN_MOVED_TO), Windows使用ReadDirectoryChangesW,
+//Windows没有关闭事件, 以能否独占打开判断写入方是否已经关闭文件
+//启动时和通知溢出后扫描到的文件没有关闭事件, 可能仍在写入, 大小和修改时间在debounce内不变才处理
+//用法:
+//	SoFix watch --mode <normal|dump-from-normal|dump> --dir <监视目录> --out <输出目录>
+//		[--ref <正常so>] [--bias <load_bias>] [--jobs <n>] [--debounce <毫秒>] [--cache <目录>]
+//成功的文件和修复结果移动到输出目录, 失败的移动到输出目录下的failed
+class Watch
+{
+public:
+	struct Options
+	{
+		Batch::Mode mode;
+		QString dir;
+		QString out;
+		QString ref;		//dump-from-normal使用的正常so
+		uint64_t dump_bias;
+		int jobs;
+		int debounce_ms;	//最后一次事件后等待的时间, 同一文件的多次写入只处理一次
+		QString cache;		//结果缓存目录, 不能在监视目录内
+	};
+
+	Watch() = delete;
+	~Watch() = delete;
+
+	//命令行入口, 返回进程退出码
+	static int Run(int argc, char *argv[]);
+
+private:
+	class Notifier;
+
+	static bool parseArgs(int argc, char *argv[], Options &opts);
+	//是否为需要处理的文件(跳过修复输出和隐藏文件)
+	static bool accept(const QString &path);
+	//把输入文件和修复结果移动到输出目录
+	static void finish(const Options &opts, const QString &path, bool ok);
+	static void printUsage();
+};
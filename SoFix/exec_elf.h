@@ -47,21 +47,38 @@ typedef uint16_t	Elf64_Half;
 #define ELF_NIDENT	16
 
 typedef struct {
-	unsigned char	e_ident[ELF_NIDENT];	/* Id bytes ʶ*/
-	Elf32_Half	e_type;			/* file type ļ 32bit? */
-	Elf32_Half	e_machine;		/* machine type  Ҫʹƥ */
-	Elf32_Word	e_version;		/* version number 汾 VT_CURRENT? */
-	Elf32_Addr	e_entry;		/* entry point exeַ */
-	Elf32_Off	e_phoff;		/* Program hdr offset phdr_tableļƫ(̬ӿѡ) */
-	Elf32_Off	e_shoff;		/* Section hdr offset shdr_tableļƫ(ִпѡ) */
-	Elf32_Word	e_flags;		/* Processor flags 봦صı־ */
-	Elf32_Half	e_ehsize;		/* sizeof ehdr ehdrĴС */
-	Elf32_Half	e_phentsize;	/* Program header entry size phdrĴС(̬ӿѡ) */
-	Elf32_Half	e_phnum;		/* Number of program headers phdr(̬ӿѡ) */
-	Elf32_Half	e_shentsize;	/* Section header entry size shdrĴС(ִпѡ) */
-	Elf32_Half	e_shnum;		/* Number of section headers shdr(ִпѡ) */
-	Elf32_Half	e_shstrndx;		/* String table index ַstrtabڽڵ(ִпѡ) */
-} Elf32_Ehdr; //ELFļͷ
+	unsigned char	e_ident[ELF_NIDENT];	/* Id bytes 标识*/
+	Elf32_Half	e_type;			/* file type 文件类型 32bit? */
+	Elf32_Half	e_machine;		/* machine type 机器类型 需要和处理器匹配 */
+	Elf32_Word	e_version;		/* version number 版本 VT_CURRENT? */
+	Elf32_Addr	e_entry;		/* entry point exe的入口虚拟地址 */
+	Elf32_Off	e_phoff;		/* Program hdr offset phdr_table的文件偏移(静态链接可选) */
+	Elf32_Off	e_shoff;		/* Section hdr offset shdr_table的文件偏移(执行可选) */
+	Elf32_Word	e_flags;		/* Processor flags 与处理器相关的标志 */
+	Elf32_Half	e_ehsize;		/* sizeof ehdr ehdr的大小 */
+	Elf32_Half	e_phentsize;	/* Program header entry size phdr的大小(静态链接可选) */
+	Elf32_Half	e_phnum;		/* Number of program headers phdr的数量(静态链接可选) */
+	Elf32_Half	e_shentsize;	/* Section header entry size shdr的大小(执行可选) */
+	Elf32_Half	e_shnum;		/* Number of section headers shdr的数量(执行可选) */
+	Elf32_Half	e_shstrndx;		/* String table index 字符串表strtab的所在节的索引(执行可选) */
+} Elf32_Ehdr; //ELF文件头
+
+typedef struct {
+	unsigned char	e_ident[ELF_NIDENT];	/* Id bytes */
+	Elf64_Half	e_type;			/* file type */
+	Elf64_Half	e_machine;		/* machine type */
+	Elf64_Word	e_version;		/* version number */
+	Elf64_Addr	e_entry;		/* entry point */
+	Elf64_Off	e_phoff;		/* Program hdr offset */
+	Elf64_Off	e_shoff;		/* Section hdr offset */
+	Elf64_Word	e_flags;		/* Processor flags */
+	Elf64_Half	e_ehsize;		/* sizeof ehdr */
+	Elf64_Half	e_phentsize;	/* Program header entry size */
+	Elf64_Half	e_phnum;		/* Number of program headers */
+	Elf64_Half	e_shentsize;	/* Section header entry size */
+	Elf64_Half	e_shnum;		/* Number of section headers */
+	Elf64_Half	e_shstrndx;		/* String table index */
+} Elf64_Ehdr; //64位ELF文件头
 
 
 			  /* e_ident offsets */
@@ -236,6 +253,7 @@ typedef struct {
 #define EM_SEP		108	/* Sharp embedded microprocessor */
 #define EM_ARCA		109	/* Arca RISC microprocessor */
 #define EM_UNICORE	110	/* UNICORE from PKU-Unity Ltd. and MPRC Peking University */
+#define EM_AARCH64	183	/* ARM 64-bit architecture (AArch64) */
 
 			  /* Unofficial machine types follow */
 #define EM_AVR32	6317	/* used by NetBSD/avr32 */
@@ -243,28 +261,39 @@ typedef struct {
 #define EM_NUM		36903
 
 /*
-* Program Header ͷ: εϢ
+* Program Header 程序头部: 描述段的信息
 */
 typedef struct {
-	Elf32_Word	p_type;		/* entry type ε, ҪPHDR, LOAD, DYNAMIC */
-	Elf32_Off	p_offset;	/* offset εļƫ */
-	Elf32_Addr	p_vaddr;	/* virtual address εַ */
-	Elf32_Addr	p_paddr;	/* physical address ַ(ƺû) */
-	Elf32_Word	p_filesz;	/* file size ļС */
-	Elf32_Word	p_memsz;	/* memory size ڴС */
-	Elf32_Word	p_flags;	/* flags ־,  ˶εҳ */
-	Elf32_Word	p_align;	/* memory & file alignment ڴļ(ƺû, ̶4K) */
+	Elf32_Word	p_type;		/* entry type 段的类型, 主要是PHDR段, LOAD段, DYNAMIC段 */
+	Elf32_Off	p_offset;	/* offset 段的文件偏移 */
+	Elf32_Addr	p_vaddr;	/* virtual address 段的虚拟地址 */
+	Elf32_Addr	p_paddr;	/* physical address 物理地址(似乎没用) */
+	Elf32_Word	p_filesz;	/* file size 文件大小 */
+	Elf32_Word	p_memsz;	/* memory size 内存大小 */
+	Elf32_Word	p_flags;	/* flags 标志,  给出了段的页属性 */
+	Elf32_Word	p_align;	/* memory & file alignment 内存和文件对齐(似乎没用, 固定4K) */
 } Elf32_Phdr;
 
+typedef struct {
+	Elf64_Word	p_type;		/* entry type */
+	Elf64_Word	p_flags;	/* flags, 注意64位中p_flags位于p_offset之前 */
+	Elf64_Off	p_offset;	/* offset */
+	Elf64_Addr	p_vaddr;	/* virtual address */
+	Elf64_Addr	p_paddr;	/* physical address */
+	Elf64_Xword	p_filesz;	/* file size */
+	Elf64_Xword	p_memsz;	/* memory size */
+	Elf64_Xword	p_align;	/* memory & file alignment */
+} Elf64_Phdr;
+
 /* p_type */
-#define PT_NULL		0		/* Program header table entry unused δʹ */
-#define PT_LOAD		1		/* Loadable program segment LOAD, ɼض */
-#define PT_DYNAMIC	2		/* Dynamic linking information DYNAMIC, ̬Ϣ */
+#define PT_NULL		0		/* Program header table entry unused 未使用 */
+#define PT_LOAD		1		/* Loadable program segment LOAD段, 可加载段 */
+#define PT_DYNAMIC	2		/* Dynamic linking information DYNAMIC节, 包含动态链接信息 */
 #define PT_INTERP	3		/* Program interpreter */
 #define PT_NOTE		4		/* Auxiliary information */
 #define PT_SHLIB	5		/* Reserved, unspecified semantics */
 #define PT_PHDR		6		/* Entry for header table itself 
-* ͷĴСλ, LOAD֮ǰ, ֻһ
+* 表明程序头部表自身的大小和位置, 如果存在则必须在所有LOAD段之前, 且只包含一个
 */
 #define PT_TLS		7		/* TLS initialisation image */
 #define PT_NUM		8
@@ -294,77 +323,90 @@ typedef struct {
 #define PN_XNUM		0xffff
 
 /*
-* Section Headers ͷ: ˽ڵϢ
+* Section Headers 节头: 描述了节的信息
 */
-//1. нͷһн
-//2. ռļе(ȿΪ0)
-//3. ص
-//4. ļпܰǻռ, κͷͽ
+//1. 有节头部不一定有节
+//2. 节区占用文件中的连续区域(长度可能为0)
+//3. 节区不能重叠
+//4. 文件中可能包含非活动空间, 不属于任何头部和节区
 
 //sh_type		sh_link									sh_info
-//SHT_DYNAMIC	ýõַĽͷ				0
-//SHT_HASH		ñõķűĽͷ				0
-//SHT_REL		طűĽͷ				ضλõĽͷ
-//SHT_SYMTAB	ַĽͷ			һֲŵķűֵһ
-//SHT_DYNSYM	ͬ											ͬ
+//SHT_DYNAMIC	该节所用到的字符串表的节区头部索引				0
+//SHT_HASH		该表所用到的符号表的节区头部索引				0
+//SHT_REL		相关符号表的节区头部索引				重定位所适用的节区头部索引
+//SHT_SYMTAB	相关字符串表的节区头部索引			最后一个局部符号的符号表索引值加一
+//SHT_DYNSYM	同上											同上
 
-//ַ(String Table): 0βַ, , , char *
-//ű(Symbol Table): Ϣ, Ŷͷ, Elf32_Sym
-//ضλ: ŶӵϢ, Elf32_Rel
+//字符串表(String Table): 连续的0结尾的字符串, 包含节区名称, 符号名称, char *
+//符号表(Symbol Table): 符号信息, 包括符号定义和符号引用, Elf32_Sym
+//重定位表: 包含将符号引用与符号定义进行链接的信息, Elf32_Rel
 
 typedef struct {
-	Elf32_Word	sh_name;	/* section name (.shstrtab index)  */
-	Elf32_Word	sh_type;	/* section type  */
-	Elf32_Word	sh_flags;	/* section flags λ־ */
-	Elf32_Addr	sh_addr;	/* virtual address ַ(Ϊ0򲻻ӳ䵽ڴ) */
-	Elf32_Off	sh_offset;	/* file offset ļƫ */
-	Elf32_Word	sh_size;	/* section size ڴС */
-	Elf32_Word	sh_link;	/* link to another ؽͷ */
-	Elf32_Word	sh_info;	/* misc info Ϣ */
-	Elf32_Word	sh_addralign;	/* memory alignment ڴ,  sh_addr %   sh_addralign==0 */
-	Elf32_Word	sh_entsize;	/* table entry size ýһ, ʾĴС, ű, Ϊ0 */
+	Elf32_Word	sh_name;	/* section name (.shstrtab index) 节名称 */
+	Elf32_Word	sh_type;	/* section type 节类型 */
+	Elf32_Word	sh_flags;	/* section flags 位标志 */
+	Elf32_Addr	sh_addr;	/* virtual address 虚拟地址(若为0则不会映射到内存) */
+	Elf32_Off	sh_offset;	/* file offset 文件偏移 */
+	Elf32_Word	sh_size;	/* section size 节大小 */
+	Elf32_Word	sh_link;	/* link to another 相关节区头部索引 */
+	Elf32_Word	sh_info;	/* misc info 附加信息 */
+	Elf32_Word	sh_addralign;	/* memory alignment 内存对齐,  sh_addr %   sh_addralign==0 */
+	Elf32_Word	sh_entsize;	/* table entry size 若该节区是一个表, 则这里表示表项的大小, 如符号表, 否则为0 */
 } Elf32_Shdr;
 
-/* sh_type  */
-#define SHT_NULL	      0		/* Section header table entry unused δʹ */
-#define SHT_PROGBITS	  1		/* Program information ýϢ, ɳн
-* : .comments汾Ϣ, .data .data1ѳʼ, .debugϢ,
-* .fini˳, .gotȫƫƱ, .initʼ, .interp·,
-* ,lineкϢ, .pltӱ, .rodata .rodata1ֻ, .textĿִָ
+typedef struct {
+	Elf64_Word	sh_name;	/* section name (.shstrtab index) */
+	Elf64_Word	sh_type;	/* section type */
+	Elf64_Xword	sh_flags;	/* section flags */
+	Elf64_Addr	sh_addr;	/* virtual address */
+	Elf64_Off	sh_offset;	/* file offset */
+	Elf64_Xword	sh_size;	/* section size */
+	Elf64_Word	sh_link;	/* link to another */
+	Elf64_Word	sh_info;	/* misc info */
+	Elf64_Xword	sh_addralign;	/* memory alignment */
+	Elf64_Xword	sh_entsize;	/* table entry size */
+} Elf64_Shdr;
+
+/* sh_type 节区类型 */
+#define SHT_NULL	      0		/* Section header table entry unused 未使用 */
+#define SHT_PROGBITS	  1		/* Program information 该节区包含程序定义的信息, 由程序本身进行解释
+* 如: .comments版本控制信息, .data .data1已初始化数据, .debug调试信息,
+* .fini程序退出函数代码, .got全局偏移表, .init初始化代码, .interp解释器路径,
+* ,line调试行号信息, .plt过程链接表, .rodata .rodata1只读数据, .text程序的可执行指令
 */
-#define SHT_SYMTAB	      2		/* Symbol table ű , Ŀǰֻһ, һھ̬, Ҳڶ̬
-* : .symtabű
+#define SHT_SYMTAB	      2		/* Symbol table 符号表 , 目前只包含一个, 一般用于静态链接, 但也可用于动态链接
+* 如: .symtab符号表
 */
-#define SHT_STRTAB	      3		/* String table ַ, ж 
-* .dynstrַ̬, .shstrtab, .strtabűصƼ
+#define SHT_STRTAB	      3		/* String table 字符串表, 可能有多个 
+* .dynstr动态链接相关字符串, .shstrtab节区名称, .strtab与符号表项相关的名称即符号名
 */
-#define SHT_RELA	      4		/* Relocation information w/ addend ضλ, ж */
-#define SHT_HASH	      5		/* Symbol hash table Źϣ, Ŀǰֻһ 
-* .hashŹϣ
+#define SHT_RELA	      4		/* Relocation information w/ addend 重定位表项, 可能有对齐内容 */
+#define SHT_HASH	      5		/* Symbol hash table 符号哈希表, 目前只包含一个 
+* .hash符号哈希表
 */
-#define SHT_DYNAMIC	      6		/* Dynamic linking information ̬Ϣ, Ŀǰֻһ
-* : .dynamic̬Ϣ
+#define SHT_DYNAMIC	      6		/* Dynamic linking information 动态链接信息, 目前只包含一个
+* 如: .dynamic包含动态链接信息
 */
-#define SHT_NOTE	      7		/* Auxiliary information Ϣ 
-* : .noteעϢ
+#define SHT_NOTE	      7		/* Auxiliary information 辅助信息 
+* 如: .note包含注释信息
 */
-#define SHT_NOBITS	      8		/* No space allocated in file image ûļӳĽ 
-* : .bssûļӳ䵫ڴӳĽ, ᱻʼΪ0
+#define SHT_NOBITS	      8		/* No space allocated in file image 没有文件映射的节 
+* 如: .bss没有文件映射但有内存映射的节, 会被初始化为0
 */
-#define SHT_REL		      9		/* Relocation information w/o addend ضλ 
-* : .rel.xxx xxxڵضλϢ
+#define SHT_REL		      9		/* Relocation information w/o addend 重定位表项 
+* 如: .rel.xxx 包含了xxx节的重定位信息
 */
-#define SHT_SHLIB	     10		/* Reserved, unspecified semantics  */
-#define SHT_DYNSYM	     11		/* Symbol table for dynamic linker ķű, ڶ̬linker
-* : .dynsym˶̬ӷű
+#define SHT_SHLIB	     10		/* Reserved, unspecified semantics 保留 */
+#define SHT_DYNSYM	     11		/* Symbol table for dynamic linker 完整的符号表, 用于动态linker
+* 如: .dynsym包含了动态链接符号表
 */
-#define SHT_INIT_ARRAY	     14		/* Initialization function pointers ʼָ 
-* : .init_array
+#define SHT_INIT_ARRAY	     14		/* Initialization function pointers 初始化函数指针数组 
+* 如: .init_array
 */
-#define SHT_FINI_ARRAY	     15		/* Termination function pointers ָ 
-* 磺.fini_array
+#define SHT_FINI_ARRAY	     15		/* Termination function pointers 结束函数指针数组 
+* 如：.fini_array
 */
-#define SHT_PREINIT_ARRAY    16		/* Pre-initialization function ptrs Ԥʼָ */
+#define SHT_PREINIT_ARRAY    16		/* Pre-initialization function ptrs 预初始化函数指针数组 */
 #define SHT_GROUP	     	 17		/* Section group */
 #define SHT_SYMTAB_SHNDX     18		/* Section indexes (see SHN_XINDEX) */
 #define SHT_NUM		     	 19
@@ -388,18 +430,18 @@ typedef struct {
 #define SHT_HIUSER	     0xffffffff
 
 /* sh_flags */
-#define SHF_WRITE	     0x00000001 /* Contains writable data д */
-#define SHF_ALLOC	     0x00000002 /* Occupies memory ýռڴ */
-#define SHF_EXECINSTR	     0x00000004 /* Contains executable insns ִеĻָ  */
-#define SHF_MERGE	     0x00000010 /* Might be merged ܱϲ */
-#define SHF_STRINGS	     0x00000020 /* Contains nul terminated strings ַ */
-#define SHF_INFO_LINK	     0x00000040 /* "sh_info" contains SHT index sh_infoа */
-#define SHF_LINK_ORDER	     0x00000080 /* Preserve order after combining ϲ󱣳˳ */
+#define SHF_WRITE	     0x00000001 /* Contains writable data 包含可写数据 */
+#define SHF_ALLOC	     0x00000002 /* Occupies memory 该节区占用内存 */
+#define SHF_EXECINSTR	     0x00000004 /* Contains executable insns 包含可执行的机器指令  */
+#define SHF_MERGE	     0x00000010 /* Might be merged 可能被合并 */
+#define SHF_STRINGS	     0x00000020 /* Contains nul terminated strings 包含字符串 */
+#define SHF_INFO_LINK	     0x00000040 /* "sh_info" contains SHT index sh_info中包含索引 */
+#define SHF_LINK_ORDER	     0x00000080 /* Preserve order after combining 合并后保持顺序 */
 #define SHF_OS_NONCONFORMING 0x00000100 /* OS specific handling required */
-#define SHF_GROUP	     0x00000200 /* Is member of a group Ƿһ */
-#define SHF_TLS		     0x00000400 /* Holds thread-local data ֲ߳̾洢 */
+#define SHF_GROUP	     0x00000200 /* Is member of a group 是否是一组 */
+#define SHF_TLS		     0x00000400 /* Holds thread-local data 线程局部存储 */
 #define SHF_MASKOS	     0x0ff00000 /* Operating system specific values */
-#define SHF_MASKPROC	     0xf0000000 /* Processor-specific values ֵ */
+#define SHF_MASKPROC	     0xf0000000 /* Processor-specific values 处理器相关值 */
 #define SHF_ORDERED	     0x40000000 /* Ordering requirement (Solaris) */
 #define SHF_EXCLUDE	     0x80000000 /* Excluded unless unles ref/alloc
 (Solaris).*/
@@ -407,24 +449,33 @@ typedef struct {
 * Symbol Table
 */
 typedef struct {
-	Elf32_Word	st_name;	/* Symbol name (.strtab index) , ʵstrtabе  */
-	Elf32_Word	st_value;	/* value of symbol һΪŵַ */
-	Elf32_Word	st_size;	/* size of symbol صĴС, С */
-	Elf_Byte	st_info;	/* type / binding attrs ŵͺͰ */
-	Elf_Byte	st_other;	/* unused δʹ */
-	Elf32_Half	st_shndx;	/* section index of symbol ڽڵ(SHN_UNDEFʾδķ) */
+	Elf32_Word	st_name;	/* Symbol name (.strtab index) 符号名称, 实际上是在strtab节中的索引  */
+	Elf32_Word	st_value;	/* value of symbol 一般为符号的虚拟地址 */
+	Elf32_Word	st_size;	/* size of symbol 与符号相关的大小, 如对象大小等 */
+	Elf_Byte	st_info;	/* type / binding attrs 符号的类型和绑定属性 */
+	Elf_Byte	st_other;	/* unused 未使用 */
+	Elf32_Half	st_shndx;	/* section index of symbol 符号所在节的索引(SHN_UNDEF表示未定义的符号) */
 } Elf32_Sym;
 
+typedef struct {
+	Elf64_Word	st_name;	/* Symbol name (.strtab index) */
+	Elf_Byte	st_info;	/* type / binding attrs, 注意64位中的字段顺序不同 */
+	Elf_Byte	st_other;	/* unused */
+	Elf64_Half	st_shndx;	/* section index of symbol */
+	Elf64_Addr	st_value;	/* value of symbol */
+	Elf64_Xword	st_size;	/* size of symbol */
+} Elf64_Sym;
+
 
-/* Symbol Table index of the undefined symbol δķ */
+/* Symbol Table index of the undefined symbol 未定义的符号 */
 #define ELF_SYM_UNDEFINED	0
 
 #define STN_UNDEF		0	/* undefined index */
 
-/* st_info: Symbol Bindings Ű */
-#define STB_LOCAL		0	/* local symbol ֲ, ļⲻɼ, ˲ҷʱҸ */
-#define STB_GLOBAL		1	/* global symbol ȫַ */
-#define STB_WEAK		2	/* weakly defined global symbol ȫַ(ھ̬ʱ) */
+/* st_info: Symbol Bindings 符号绑定 */
+#define STB_LOCAL		0	/* local symbol 局部符号, 对所在文件外不可见, 因此查找符号时不会查找该类符号 */
+#define STB_GLOBAL		1	/* global symbol 全局符号 */
+#define STB_WEAK		2	/* weakly defined global symbol 弱全局符号(区别在于静态链接时) */
 #define STB_NUM			3
 
 #define STB_LOOS		10	/* Operating system specific range */
@@ -432,10 +483,10 @@ typedef struct {
 #define STB_LOPROC		13	/* Processor-specific range */
 #define STB_HIPROC		15
 
-/* st_info: Symbol Types (ִʱò) */
-#define STT_NOTYPE		0	/* Type not specified δָ */
-#define STT_OBJECT		1	/* Associated with a data object ݶ */
-#define STT_FUNC		2	/* Associated with a function 뺯ִд */
+/* st_info: Symbol Types 符号类型(执行时用不到) */
+#define STT_NOTYPE		0	/* Type not specified 类型未指定 */
+#define STT_OBJECT		1	/* Associated with a data object 与数据对象关联 */
+#define STT_FUNC		2	/* Associated with a function 与函数或可执行代码关联 */
 #define STT_SECTION		3	/* Associated with a section */
 #define STT_FILE		4	/* Associated with a file name */
 #define STT_COMMON		5	/* Uninitialised common block */
@@ -489,23 +540,23 @@ typedef struct {
 */
 
 //type:
-//	S: ŵַsym_addr=Elf32_Sym.st_value + sofino.load_bias
-//	A: ضλַ(r_offset + soinfo.load_bias)ŵԵַ *(Elf32_Addr *)(r_offset + soinfo.load_bias)
-//	B: soĻַsoinfo.base
-//  P: ضλַr_offset + soinfo.load_bias
+//	S: 符号地址sym_addr=Elf32_Sym.st_value + sofino.load_bias
+//	A: 待重定位地址处(r_offset + soinfo.load_bias)存放的相对地址即 *(Elf32_Addr *)(r_offset + soinfo.load_bias)
+//	B: so的基址soinfo.base
+//  P: 待重定位地址r_offset + soinfo.load_bias
 //	O: r_offset
 
-//	R_*_NONE: Ч
-//	R_ARM_JUMP_SLOT: PLTƫƱ, S
-//	R_ARM_GLOB_DAT: GOTȫƫƱ, S
+//	R_*_NONE: 无效项
+//	R_ARM_JUMP_SLOT: PLT过程偏移表项, S
+//	R_ARM_GLOB_DAT: GOT全局偏移表项, S
 //	R_ARM_ABS32: A + S
 //	R_ARM_REL32: A + S - O
 //	R_ARM_RELATIVE: A + B
 //
 
 typedef struct {
-	Elf32_Word	r_offset;	/* where to do it һҪضλַ */
-	Elf32_Word	r_info;		/* index & type of relocation 8λtype, 24λsym index, Ϊڷűе */
+	Elf32_Word	r_offset;	/* where to do it 一般是需要重定位的虚拟地址 */
+	Elf32_Word	r_info;		/* index & type of relocation 低8位是type, 高24位是sym index, 为所需符号在符号表中的索引 */
 } Elf32_Rel;
 
 /* r_info utility macros */
@@ -513,32 +564,47 @@ typedef struct {
 #define ELF32_R_TYPE(info)	((info) & 0xff)
 #define ELF32_R_INFO(sym, type) (((sym) << 8) + (unsigned char)(type))
 
+typedef struct {
+	Elf64_Addr	r_offset;	/* where to do it */
+	Elf64_Xword	r_info;		/* index & type of relocation, 低32位是type, 高32位是sym index */
+} Elf64_Rel;
+
+typedef struct {
+	Elf64_Addr	r_offset;	/* where to do it */
+	Elf64_Xword	r_info;		/* index & type of relocation */
+	Elf64_Sxword	r_addend;	/* adjustment value, AArch64只使用RELA */
+} Elf64_Rela;
+
+#define ELF64_R_SYM(info)	((info) >> 32)
+#define ELF64_R_TYPE(info)	((info) & 0xffffffff)
+#define ELF64_R_INFO(sym, type) (((Elf64_Xword)(sym) << 32) + (Elf64_Xword)(type))
+
 /*
 * Dynamic Section structure array
-* : 
-* DT_NULL: ־()
-* DT_NEEDED: , d_valַDT_STRTABеƫ(ѡ)
-* DT_HASH: Źϣ, d_ptrַ()
-* DT_STRTAB: ַ, d_ptrַ()
-* DT_STRSZ: ַĴС, d_valֽ(Ǳ)
-* DT_SYMTAB: ű, d_ptrַ(), ΪElf32_Sym
-* DT_INIT: ʼ, d_ptrַ
-* DT_SYMBOLIC: Ӱ캯soinfo_do_lookupҷŵ˳
-* DT_REL: ضλ, dt_ptrضλĵַ, ΪElf32_Rel
-* DT_RELSZ: ضλĴС, d_valֽ
-* DT_PLTREL: ضλ, d_valʾDT_RELDT_RELA, ֻ֧DT_REL
-* DT_TEXTREL: ǷҪضλ
-* DT_JMPREL: ضλ, d_ptrضλĵַ, ΪElf32_Rel
-* DT_PLTRELSZ: ضλĴС, d_valֽ
-* DT_INIT_ARRAY: ʼ, d_ptrдַ
-* DT_INIT_ARRAYSZ: ʼĴС, d_valдֽ
-* DT_PLTGOT: PLTƫƱ(R_ARM_JMP_SLOT), GOTȫƫƱ(R_ARM_GOT), d_ptrдַ
+* 有以下类型: 
+* DT_NULL: 结束标志(必需)
+* DT_NEEDED: 依赖库, d_val存放依赖库名称字符串在DT_STRTAB中的偏移(可选)
+* DT_HASH: 符号哈希表, d_ptr存放虚拟地址(与DT_GNU_HASH至少有一个)
+* DT_STRTAB: 字符串表, d_ptr存放虚拟地址(必需)
+* DT_STRSZ: 字符串表的大小, d_val存放字节数(非必需)
+* DT_SYMTAB: 符号表, d_ptr存放虚拟地址(必需), 类型为Elf32_Sym
+* DT_INIT: 初始化函数, d_ptr存放虚拟地址
+* DT_SYMBOLIC: 影响函数soinfo_do_lookup查找符号的顺序
+* DT_REL: 重定位表, dt_ptr存放重定位表的地址, 类型为Elf32_Rel
+* DT_RELSZ: 重定位表的大小, d_val存放字节数
+* DT_PLTREL: 重定位项的类型, d_val表示DT_REL或DT_RELA, 这里只支持DT_REL
+* DT_TEXTREL: 是否需要重定位
+* DT_JMPREL: 重定位表, d_ptr存放重定位表的地址, 类型为Elf32_Rel
+* DT_PLTRELSZ: 重定位表的大小, d_val存放字节数
+* DT_INIT_ARRAY: 初始化函数数组, d_ptr中存放虚拟地址
+* DT_INIT_ARRAYSZ: 初始化函数数组的大小, d_val中存放字节数
+* DT_PLTGOT: PLT过程偏移表(R_ARM_JMP_SLOT), GOT全局偏移表(R_ARM_GOT), d_ptr中存放虚拟地址
 */
 typedef struct {
-	Elf32_Word		d_tag;	/* entry tag value һDynamic */
+	Elf32_Word		d_tag;	/* entry tag value 表明哪一类的Dynamic节 */
 	union {
-		Elf32_Addr	d_ptr;	//ַ
-		Elf32_Word	d_val;	//ֵ, ݲͬtagвͬĽ
+		Elf32_Addr	d_ptr;	//虚拟地址
+		Elf32_Word	d_val;	//整数值, 根据不同的tag有不同的解释
 	} d_un;
 } Elf32_Dyn;
 
@@ -583,6 +649,7 @@ typedef struct {
 #define DT_NUM		29
 
 #define DT_LOOS		0x60000000	/* Operating system specific range */
+#define DT_GNU_HASH	0x6ffffef5	/* GNU-style hash table */
 #define DT_VERSYM	0x6ffffff0	/* Symbol versions */
 #define DT_FLAGS_1	0x6ffffffb	/* ELF dynamic flags */
 #define DT_VERDEF	0x6ffffffc	/* Versions defined by file */
@@ -604,6 +671,11 @@ typedef struct {
 #define ELF32_ST_INFO(bind,type)	ELF_ST_INFO(bind,type)
 #define ELF32_ST_VISIBILITY(other)	ELF_ST_VISIBILITY(other)
 
+#define ELF64_ST_BIND(info)		ELF_ST_BIND(info)
+#define ELF64_ST_TYPE(info)		ELF_ST_TYPE(info)
+#define ELF64_ST_INFO(bind,type)	ELF_ST_INFO(bind,type)
+#define ELF64_ST_VISIBILITY(other)	ELF_ST_VISIBILITY(other)
+
 #define R_ARM_NONE		0
 #define R_ARM_PC24		1
 #define R_ARM_ABS32		2
@@ -670,4 +742,12 @@ typedef struct {
 #define R_ARM_RPC24		254
 #define R_ARM_RBASE		255
 
+/* AArch64 dynamic relocations */
+#define R_AARCH64_NONE		0
+#define R_AARCH64_ABS64		257
+#define R_AARCH64_COPY		1024
+#define R_AARCH64_GLOB_DAT	1025
+#define R_AARCH64_JUMP_SLOT	1026
+#define R_AARCH64_RELATIVE	1027
+
 #pragma pack(pop)
\ No newline at end of file
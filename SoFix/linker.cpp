@@ -1,9 +1,5 @@
 #include "linker.h"
-#include <QDebug>
-#include <malloc.h>
-
-#define DEBUG qDebug
-#define DL_ERR qDebug
+#include <string.h>
 
 /*
 * Copy src to string dst of size siz.  At most siz-1 characters
@@ -39,28 +35,27 @@ strlcpy(char *dst, const char *src, size_t siz)
 	return(s - src - 1);	/* count does not include NUL */
 }
 
-soinfo* soinfo_alloc(const char* name) 
+template <typename ElfClass>
+bool soinfo_init(soinfo<ElfClass>* si, const char* name) 
 {
 	if (strlen(name) >= SOINFO_NAME_LEN)
 	{
-		DL_ERR("library name \"%s\" too long", name);
-		return NULL;
+		return false;
 	}
 
-	soinfo* si = (soinfo *)malloc(sizeof(soinfo));
-	memset(si, 0, sizeof(soinfo));
+	memset(si, 0, sizeof(soinfo<ElfClass>));
 	strlcpy(si->name, name, sizeof(si->name));
 
-	return si;
+	return true;
 }
 
 /* Return the address and size of the ELF file's .dynamic section in memory,
-* or NULL if missing. phdr_table, .dynamicڵڴַԼ
+* or NULL if missing. 遍历phdr_table, 返回.dynamic节的内存地址与数量以及保护属性
 *
 * Input:
 *   phdr_table  -> program header table
 *   phdr_count  -> number of entries in tables
-*   load_bias   -> load bias
+*   image       -> loaded image view
 * Output:
 *   dynamic       -> address of table in memory (NULL on failure).
 *   dynamic_count -> number of items in table (0 on failure).
@@ -68,16 +63,17 @@ soinfo* soinfo_alloc(const char* name)
 * Return:
 *   void
 */
+template <typename ElfClass>
 void
-phdr_table_get_dynamic_section(const Elf32_Phdr* phdr_table,
+phdr_table_get_dynamic_section(const typename ElfClass::Phdr* phdr_table,
 	int               phdr_count,
-	Elf32_Addr        load_bias,
-	Elf32_Dyn**       dynamic,
+	const ImageView& image,
+	typename ElfClass::Dyn** dynamic,
 	size_t*           dynamic_count,
-	Elf32_Word*       dynamic_flags)
+	typename ElfClass::Word* dynamic_flags)
 {
-	const Elf32_Phdr* phdr = phdr_table;
-	const Elf32_Phdr* phdr_limit = phdr + phdr_count;
+	const typename ElfClass::Phdr* phdr = phdr_table;
+	const typename ElfClass::Phdr* phdr_limit = phdr + phdr_count;
 
 	for (phdr = phdr_table; phdr < phdr_limit; phdr++)
 	{
@@ -86,10 +82,13 @@ phdr_table_get_dynamic_section(const Elf32_Phdr* phdr_table,
 			continue;
 		}
 
-		*dynamic = reinterpret_cast<Elf32_Dyn*>(load_bias + phdr->p_vaddr);
+		//p_memsz来自镜像, 不可信, 项数不超过镜像末尾
+		size_t count = (size_t)(phdr->p_memsz / sizeof(typename ElfClass::Dyn));
+		size_t limit = image.CountTo<typename ElfClass::Dyn>(phdr->p_vaddr);
+		*dynamic = image.At<typename ElfClass::Dyn>(phdr->p_vaddr);
 		if (dynamic_count) 
 		{
-			*dynamic_count = (unsigned)(phdr->p_memsz / 8);
+			*dynamic_count = count < limit ? count : limit;
 		}
 		if (dynamic_flags) 
 		{
@@ -107,12 +106,12 @@ phdr_table_get_dynamic_section(const Elf32_Phdr* phdr_table,
 
 
 /* Return the address and size of the .ARM.exidx section in memory,
-* if present. phdr_table, .ARM.exidxڴ򷵻صַ
+* if present. 遍历phdr_table, 如果.ARM.exidx节存在则返回地址和数量
 *
 * Input:
 *   phdr_table  -> program header table
 *   phdr_count  -> number of entries in tables
-*   load_bias   -> load bias
+*   image       -> loaded image view
 * Output:
 *   arm_exidx       -> address of table in memory (NULL on failure).
 *   arm_exidx_count -> number of items in table (0 on failure).
@@ -122,26 +121,37 @@ phdr_table_get_dynamic_section(const Elf32_Phdr* phdr_table,
 
 #define PT_ARM_EXIDX    0x70000001      /* .ARM.exidx segment */
 
+template <typename ElfClass>
 int
-phdr_table_get_arm_exidx(const Elf32_Phdr* phdr_table,
+phdr_table_get_arm_exidx(const typename ElfClass::Phdr* phdr_table,
 	int               phdr_count,
-	Elf32_Addr        load_bias,
-	Elf32_Addr**      arm_exidx,
-	unsigned*         arm_exidx_count)
+	const ImageView& image,
+	unsigned**        arm_exidx,
+	size_t*           arm_exidx_count)
 {
-	const Elf32_Phdr* phdr = phdr_table;
-	const Elf32_Phdr* phdr_limit = phdr + phdr_count;
+	const typename ElfClass::Phdr* phdr = phdr_table;
+	const typename ElfClass::Phdr* phdr_limit = phdr + phdr_count;
 
 	for (phdr = phdr_table; phdr < phdr_limit; phdr++) 
 	{
 		if (phdr->p_type != PT_ARM_EXIDX)
 			continue;
 
-		*arm_exidx = (Elf32_Addr*)(load_bias + phdr->p_vaddr);
-		*arm_exidx_count = (unsigned)(phdr->p_memsz / 8);
+		size_t count = (size_t)(phdr->p_memsz / 8);
+		size_t limit = image.CountTo<uint64_t>(phdr->p_vaddr);
+		*arm_exidx = image.At<unsigned>(phdr->p_vaddr);
+		*arm_exidx_count = count < limit ? count : limit;
 		return 0;
 	}
 	*arm_exidx = NULL;
 	*arm_exidx_count = 0;
 	return -1;
 }
+
+//显式实例化32位和64位版本
+template bool soinfo_init<Elf32Class>(soinfo<Elf32Class>* si, const char* name);
+template bool soinfo_init<Elf64Class>(soinfo<Elf64Class>* si, const char* name);
+template void phdr_table_get_dynamic_section<Elf32Class>(const Elf32_Phdr*, int, const ImageView&, Elf32_Dyn**, size_t*, Elf32_Word*);
+template void phdr_table_get_dynamic_section<Elf64Class>(const Elf64_Phdr*, int, const ImageView&, Elf64_Dyn**, size_t*, Elf64_Word*);
+template int phdr_table_get_arm_exidx<Elf32Class>(const Elf32_Phdr*, int, const ImageView&, unsigned**, size_t*);
+template int phdr_table_get_arm_exidx<Elf64Class>(const Elf64_Phdr*, int, const ImageView&, unsigned**, size_t*);
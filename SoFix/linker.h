@@ -1,6 +1,7 @@
 #pragma once
 
-#include "exec_elf.h"
+#include "ElfTraits.h"
+#include "ImageView.h"
 
 #define SOINFO_NAME_LEN 128
 typedef void(*linker_function_t)();
@@ -14,55 +15,70 @@ struct link_map_t
 	link_map_t* l_prev;
 };
 
+template <typename ElfClass>
 struct soinfo
 {
 public:
+	typedef typename ElfClass::Phdr Elf_Phdr;
+	typedef typename ElfClass::Dyn Elf_Dyn;
+	typedef typename ElfClass::Sym Elf_Sym;
+	typedef typename ElfClass::Rel Elf_Rel;
+	typedef typename ElfClass::Addr Elf_Addr;
+
+
 	char name[SOINFO_NAME_LEN];
-	const Elf32_Phdr* phdr; //ѼصPT_PHDR, һɼصĶPT_LOADļƫp_offsetΪ0Ķ
+	const Elf_Phdr* phdr; //已加载的PT_PHDR段, 或第一个可加载的段PT_LOAD并且文件偏移p_offset为0的段
 	size_t phnum;
-	Elf32_Addr entry;
-	Elf32_Addr base;	//ɼصĶεĻַ
-	unsigned size;		//ɼصĶεĴС
+	Elf_Addr entry;
+	ImageView image;	//可加载的段的内存视图(基址, 最小虚拟地址, 大小)
 
 	uint32_t unused1;  // DO NOT USE, maintained for compatibility.
 
-	Elf32_Dyn* dynamic; //PT_DYNAMIC
+	Elf_Dyn* dynamic; //PT_DYNAMIC
+	size_t dynamic_count;	//PT_DYNAMIC的p_memsz能容纳的项数, 限制在镜像之内
 
 	uint32_t unused2; // DO NOT USE, maintained for compatibility
 	uint32_t unused3; // DO NOT USE, maintained for compatibility
 
-	soinfo* next;    //һso
+	soinfo* next;    //链表的下一个so
 	unsigned flags;
 
 	//DT_STRTAB
 	const char* strtab;
 
 	//DT_SYMTAB
-	Elf32_Sym* symtab;
+	Elf_Sym* symtab;
 
-	//DT_HASH (ĸֶεַ), Źϣ
-	//ȸ bucket[hash % nbucket]õűchain, ٸchainѯ
+	//DT_HASH (下面四个字段地址是连续的), 符号哈希表
+	//先根据 bucket[hash % nbucket]得到符号表索引或chain表索引, 再根据chain表查询
 	size_t nbucket;
 	size_t nchain;
-	unsigned* bucket;	//˷űchain
-	unsigned* chain;	//ÿΪűһchain
+	unsigned* bucket;	//这个表给出了符号表的索引或chain表的索引
+	unsigned* chain;	//每个表项为符号表的索引或下一个chain项
+
+	//DT_GNU_HASH, 没有DT_HASH的库(多数arm64库)只有这个表
+	//bucket[hash % gnu_nbucket]为链上第一个符号的索引, 链上的符号索引连续, chain[i - gnu_symndx]最低位为1表示链结束
+	size_t gnu_nbucket;
+	uint32_t gnu_symndx;	//表中第一个符号的索引, 之前的符号不参与查找
+	uint32_t* gnu_bucket;
+	uint32_t* gnu_chain;	//chain[0]对应符号gnu_symndx, 长度由符号数决定, 表中没有记录
 
 						//DT_PLTGOT
 	unsigned* plt_got;
 
-	//DT_JMPREL, DT_PLTRELSZ, ضλ
-	Elf32_Rel* plt_rel;
+	//DT_JMPREL, DT_PLTRELSZ, 重定位
+	Elf_Rel* plt_rel;
 	size_t plt_rel_count;
 
-	//DT_REL, DT_RELSZ, ضλ
-	Elf32_Rel* rel;
+	//DT_REL, DT_RELSZ, 重定位
+	Elf_Rel* rel;
 	size_t rel_count;
 
 	//DT_PREINIT_ARRAY, DT_PREINIT_ARRAYSZ
 	linker_function_t* preinit_array;
 	size_t preinit_array_count;
 
-	//DT_INIT_ARRAY, DT_INIT_ARRAYSZ ɺøú
+	//DT_INIT_ARRAY, DT_INIT_ARRAYSZ 链接完成后会调用该函数数组
 	linker_function_t* init_array;
 	size_t init_array_count;
 
@@ -70,41 +86,44 @@ public:
 	linker_function_t* fini_array;
 	size_t fini_array_count;
 
-	//DT_INIT ɺøú
+	//DT_INIT 链接完成后会调用该函数
 	linker_function_t init_func;
 
 	//DT_FINI
 	linker_function_t fini_func;
 
-	//ARM EABI section used for stack unwinding. PT_ARM_EXIDXջչ
+	//ARM EABI section used for stack unwinding. PT_ARM_EXIDX用于栈展开
 	unsigned* ARM_exidx;
 	size_t ARM_exidx_count;
 
-	size_t ref_count;		//ü
+	size_t ref_count;		//引用计数
 	link_map_t link_map;
 
-	bool constructors_called; //Ƿѵ, ȷֻһ
+	bool constructors_called; //构造器是否已调用, 确保只调用一次
 
-							  // When you read a virtual address from the ELF file, add this
-							  // value to get the corresponding address in the process' address space.
-	Elf32_Addr load_bias; //ʵʶμػַμػַƫ
-
-						  //ǷDT_TEXTREL, DT_SYMBOLIC
+						  //是否有DT_TEXTREL, DT_SYMBOLIC
 	bool has_text_relocations;
 	bool has_DT_SYMBOLIC;
 };
 
 size_t strlcpy(char *dst, const char *src, size_t siz);
-soinfo* soinfo_alloc(const char* name);
-void phdr_table_get_dynamic_section(const Elf32_Phdr* phdr_table,
+
+//将调用者提供的soinfo清零并拷贝name, 名称过长返回false
+//soinfo由所属任务持有, 不再从堆上分配
+template <typename ElfClass>
+bool soinfo_init(soinfo<ElfClass>* si, const char* name);
+
+template <typename ElfClass>
+void phdr_table_get_dynamic_section(const typename ElfClass::Phdr* phdr_table,
 	int               phdr_count,
-	Elf32_Addr        load_bias,
-	Elf32_Dyn**       dynamic,
+	const ImageView& image,
+	typename ElfClass::Dyn** dynamic,
 	size_t*           dynamic_count,
-	Elf32_Word*       dynamic_flags);
+	typename ElfClass::Word* dynamic_flags);
 
-int phdr_table_get_arm_exidx(const Elf32_Phdr* phdr_table,
+template <typename ElfClass>
+int phdr_table_get_arm_exidx(const typename ElfClass::Phdr* phdr_table,
 	int               phdr_count,
-	Elf32_Addr        load_bias,
-	Elf32_Addr**      arm_exidx,
-	unsigned*         arm_exidx_count);
+	const ImageView& image,
+	unsigned**        arm_exidx,
+	size_t*           arm_exidx_count);
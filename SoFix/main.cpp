@@ -1,11 +1,61 @@
 #include <QTextStream>
 #include <Helper.h>
 #include "ElfBuilder.h"
+#include "Batch.h"
+#include "Daemon.h"
+#include "Watch.h"
+#include "Corpus.h"
+#include "Bench.h"
+#include "Throughput.h"
+#include "Baseline.h"
+#include "Budget.h"
 
 #define QSTR8BIT(s) (QString::fromLocal8Bit(s))
 
 int main(int argc, char *argv[])
 {
+	//带参数时进入非交互的批处理模式
+	if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "batch")
+	{
+		return Batch::Run(argc, argv);
+	}
+	if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "merge")
+	{
+		return Batch::Merge(argc, argv);
+	}
+	if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "daemon")
+	{
+		return Daemon::Run(argc, argv);
+	}
+	if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "client")
+	{
+		return Daemon::RunClient(argc, argv);
+	}
+	if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "watch")
+	{
+		return Watch::Run(argc, argv);
+	}
+	if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "gen")
+	{
+		return Corpus::Run(argc, argv);
+	}
+	if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "bench")
+	{
+		return Bench::Run(argc, argv);
+	}
+	if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "throughput")
+	{
+		return Throughput::Run(argc, argv);
+	}
+	if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "compare")
+	{
+		return Baseline::Compare(argc, argv);
+	}
+	if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "budget")
+	{
+		return Budget::Run(argc, argv);
+	}
+
 	QTextStream qout(stdout);
 	QTextStream qin(stdin);
 	int input = 0;
@@ -17,7 +67,7 @@ int main(int argc, char *argv[])
 		qin >> input;
 		if (input > Helper::cmdSo.cmdCount || input < 1)
 		{
-			qout << QSTR8BIT("Ч...") << endl;
+			qout << QSTR8BIT("无效输入...") << endl;
 			system("pause");
 			continue;
 		}
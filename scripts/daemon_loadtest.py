@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""SoFix daemon 压力测试
+
+用法:
+    SoFix daemon --socket /tmp/sofix.sock &
+    python3 daemon_loadtest.py --socket /tmp/sofix.sock --mode dump --manifest dumps.txt \
+        --connections 8 --requests 2000
+
+清单格式与 batch 相同(每行字段以 tab 分隔). 每个连接同一时间只有一个请求在途,
+统计往返延迟(p50/p95/p99)和吞吐量, 最后查询一次服务端的 stats.
+Windows 上需要支持 AF_UNIX 的 Python(3.9+, Windows 10 1803+).
+"""
+import argparse
+import socket
+import threading
+import time
+
+
+def load_manifest(path):
+    with open(path, encoding="utf-8", errors="replace") as f:
+        lines = [l.strip() for l in f]
+    return [l for l in lines if l and not l.startswith("#")]
+
+
+class Conn:
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.buf = b""
+
+    def request(self, line):
+        self.sock.sendall(line.encode("utf-8") + b"\n")
+        while b"\n" not in self.buf:
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError("daemon closed the connection")
+            self.buf += chunk
+        reply, self.buf = self.buf.split(b"\n", 1)
+        return reply.decode("utf-8", errors="replace")
+
+    def close(self):
+        self.sock.close()
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    k = min(len(sorted_values) - 1, int(round(p / 100.0 * (len(sorted_values) - 1))))
+    return sorted_values[k]
+
+
+def main():
+    ap = argparse.ArgumentParser(description="SoFix daemon load test")
+    ap.add_argument("--socket", default="/tmp/sofix.sock")
+    ap.add_argument("--mode", required=True, choices=["normal", "dump-from-normal", "dump", "rebuild"])
+    ap.add_argument("--manifest", required=True)
+    ap.add_argument("--connections", type=int, default=4)
+    ap.add_argument("--requests", type=int, default=0, help="请求总数, 0 表示清单每项一次")
+    args = ap.parse_args()
+
+    items = load_manifest(args.manifest)
+    if not items:
+        raise SystemExit("manifest is empty")
+    total = args.requests or len(items)
+
+    lock = threading.Lock()
+    next_index = [0]
+    latencies = []
+    failures = [0]
+
+    def worker():
+        conn = Conn(args.socket)
+        try:
+            while True:
+                with lock:
+                    i = next_index[0]
+                    if i >= total:
+                        return
+                    next_index[0] += 1
+                line = args.mode + "\t" + items[i % len(items)]
+                t0 = time.perf_counter()
+                reply = conn.request(line)
+                dt = (time.perf_counter() - t0) * 1000.0
+                with lock:
+                    latencies.append(dt)
+                    if reply.split("\t")[1:2] != ["OK"]:
+                        failures[0] += 1
+        finally:
+            conn.close()
+
+    start = time.perf_counter()
+    threads = [threading.Thread(target=worker) for _ in range(args.connections)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.perf_counter() - start
+
+    latencies.sort()
+    print("requests %d, failed %d, connections %d, %.3f s, %.1f req/s"
+          % (len(latencies), failures[0], args.connections, elapsed, len(latencies) / elapsed if elapsed else 0))
+    print("latency ms: p50 %.3f  p95 %.3f  p99 %.3f  max %.3f"
+          % (percentile(latencies, 50), percentile(latencies, 95), percentile(latencies, 99),
+             latencies[-1] if latencies else 0))
+
+    conn = Conn(args.socket)
+    print(conn.request("stats"))
+    conn.close()
+
+
+if __name__ == "__main__":
+    main()
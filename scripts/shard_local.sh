@@ -0,0 +1,27 @@
+#!/bin/sh
+# 在本机用N个进程分片运行批处理, 再合并结果
+# 用法: shard_local.sh <SoFix路径> <N> <batch参数...>
+# 例如: shard_local.sh ./SoFix 4 --mode dump --manifest dumps.txt --jobs 2
+set -e
+exe="$1"; n="$2"; shift 2
+
+i=0
+pids=""
+while [ "$i" -lt "$n" ]; do
+	"$exe" batch "$@" --shard "$i/$n" --results "results.$i-of-$n.tsv" > "shard.$i-of-$n.log" &
+	pids="$pids $!"
+	i=$((i + 1))
+done
+
+# 有失败项时batch返回1, 仍然合并
+for pid in $pids; do
+	wait "$pid" || true
+done
+
+files=""
+i=0
+while [ "$i" -lt "$n" ]; do
+	files="$files results.$i-of-$n.tsv"
+	i=$((i + 1))
+done
+"$exe" merge --out "results.merged.tsv" $files